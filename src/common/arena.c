@@ -0,0 +1,137 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Keeps the data after a block header aligned */
+#define ARENA_HEADER_SIZE \
+	((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+#define ARENA_ALIGN(n) (((n) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+int createArena(Arena* arena, size_t blockSize)
+{
+	arena->blocks = 0;
+	arena->current = 0;
+	arena->blockSize = blockSize ? blockSize : ARENA_DEFAULT_BLOCK_SIZE;
+	arena->last = 0;
+
+	return 0;
+}
+
+void destroyArena(Arena arena)
+{
+	ArenaBlock* block = arena.blocks;
+
+	while (block) {
+		ArenaBlock* next = block->next;
+		free(block);
+		block = next;
+	}
+}
+
+/* Every block stays allocated. Anything handed out before is invalid. */
+void arenaReset(Arena* arena)
+{
+	for (ArenaBlock* block = arena->blocks; block; block = block->next) {
+		block->used = 0;
+	}
+
+	arena->current = arena->blocks;
+	arena->last = 0;
+}
+
+void* arenaAlloc(Arena* arena, size_t size)
+{
+	size = ARENA_ALIGN(size);
+
+	/* Move along the chain of blocks until one has room. Blocks left behind
+	 * get used again after a reset. */
+	while (
+		arena->current
+		&& arena->current->size - arena->current->used < size
+	) {
+		arena->current = arena->current->next;
+	}
+
+	if (!arena->current) {
+		const size_t blockSize =
+			size > arena->blockSize ? size : arena->blockSize;
+
+		ArenaBlock* block = (ArenaBlock*)malloc(ARENA_HEADER_SIZE + blockSize);
+
+		if (!block) {
+			perror("Failed to allocate arena block");
+			return 0;
+		}
+
+		block->size = blockSize;
+		block->used = 0;
+
+		/* New blocks go at the front. Older blocks are either full or get
+		 * skipped over until the next reset. */
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->current = block;
+	}
+
+	void* ptr =
+		(char*)arena->current + ARENA_HEADER_SIZE + arena->current->used;
+	arena->current->used += size;
+	arena->last = ptr;
+
+	return ptr;
+}
+
+/* Growing the last allocation is free when there's room behind it. Anything
+ * else gets copied to a new allocation and the old one is wasted until the
+ * arena goes. Arrays that double in size waste at most as much as they use. */
+void* arenaRealloc(Arena* arena, void* ptr, size_t oldSize, size_t newSize)
+{
+	if (!ptr) return arenaAlloc(arena, newSize);
+
+	if (ptr == arena->last) {
+		ArenaBlock* block = arena->current;
+		const size_t start = (char*)ptr - ((char*)block + ARENA_HEADER_SIZE);
+
+		if (start + ARENA_ALIGN(newSize) <= block->size) {
+			block->used = start + ARENA_ALIGN(newSize);
+			return ptr;
+		}
+	}
+
+	void* newPtr = arenaAlloc(arena, newSize);
+
+	if (!newPtr) return 0;
+
+	memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+
+	return newPtr;
+}
+
+void createFreeList(FreeList* list, size_t itemSize)
+{
+	list->head = 0;
+
+	/* Free items hold the pointer to the next one. */
+	list->itemSize = itemSize > sizeof(void*) ? itemSize : sizeof(void*);
+}
+
+void* freeListAlloc(FreeList* list, Arena* arena)
+{
+	if (list->head) {
+		void* item = list->head;
+		list->head = *(void**)item;
+		return item;
+	}
+
+	return arenaAlloc(arena, list->itemSize);
+}
+
+void freeListFree(FreeList* list, void* item)
+{
+	if (!item) return;
+
+	*(void**)item = list->head;
+	list->head = item;
+}
@@ -0,0 +1,49 @@
+#ifndef COMMON_ARENA_H
+#define COMMON_ARENA_H 1
+
+#include <stddef.h>
+
+/* Blocks are at least this big. Bigger allocations get a block of their own. */
+#define ARENA_DEFAULT_BLOCK_SIZE 16384
+
+/* Everything handed out is aligned to this. */
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock
+{
+	struct ArenaBlock* next;
+	size_t size;
+	size_t used;
+} ArenaBlock;
+
+/* A bump allocator. Allocations are never freed one by one. The whole arena
+ * goes at once, or gets reset and reused without touching the heap again. */
+typedef struct
+{
+	ArenaBlock* blocks;
+	ArenaBlock* current;
+	size_t blockSize;
+
+	/* The last allocation, so it can be grown in place */
+	void* last;
+} Arena;
+
+/* Recycles fixed size items that came out of an arena. */
+typedef struct
+{
+	void* head;
+	size_t itemSize;
+} FreeList;
+
+int createArena(Arena* arena, size_t blockSize);
+void destroyArena(Arena arena);
+void arenaReset(Arena* arena);
+
+void* arenaAlloc(Arena* arena, size_t size);
+void* arenaRealloc(Arena* arena, void* ptr, size_t oldSize, size_t newSize);
+
+void createFreeList(FreeList* list, size_t itemSize);
+void* freeListAlloc(FreeList* list, Arena* arena);
+void freeListFree(FreeList* list, void* item);
+
+#endif
@@ -0,0 +1,166 @@
+#include "dense.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int createDenseArray(DenseArray* array, size_t stride, Arena* arena)
+{
+	array->stride = stride;
+	array->count = 0;
+	array->limit = DENSE_INITIAL_LIMIT;
+	array->arena = arena;
+
+	if (arena) {
+		array->items = arenaAlloc(arena, stride * DENSE_INITIAL_LIMIT);
+		array->ids = (int*)arenaAlloc(arena, sizeof(int) * DENSE_INITIAL_LIMIT);
+	} else {
+		array->items = malloc(stride * DENSE_INITIAL_LIMIT);
+		array->ids = (int*)malloc(sizeof(int) * DENSE_INITIAL_LIMIT);
+	}
+
+	if (!array->items || !array->ids) {
+		perror("Failed to allocate dense array");
+		return -1;
+	}
+
+	if (createIdMap(&array->map)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Whatever the items own has to be destroyed first. */
+void destroyDenseArray(DenseArray array)
+{
+	if (!array.arena) {
+		free(array.items);
+		free(array.ids);
+	}
+
+	destroyIdMap(array.map);
+}
+
+/* Returns the index of the item with the ID, or -1 if there isn't one. */
+int denseFind(const DenseArray* array, int id)
+{
+	return idMapFind(&array->map, id);
+}
+
+/* Copies the item onto the end and returns its index, or -1 on failure. The
+ * ID has to be new. */
+int denseAdd(DenseArray* array, int id, const void* item)
+{
+	if (array->count >= array->limit) {
+		if (denseResize(array, array->limit * 2)) {
+			return -1;
+		}
+	}
+
+	if (idMapSet(&array->map, id, array->count)) {
+		return -1;
+	}
+
+	memcpy(
+		(char*)array->items + array->count * array->stride,
+		item,
+		array->stride
+	);
+	array->ids[array->count] = id;
+
+	return array->count++;
+}
+
+/* Swap and pop. The item at idx is overwritten, so whatever it owned needs
+ * to be destroyed first. */
+int denseRemove(DenseArray* array, unsigned int idx)
+{
+	idMapRemove(&array->map, array->ids[idx]);
+	--array->count;
+
+	if (idx != array->count) {
+		memcpy(
+			(char*)array->items + idx * array->stride,
+			(char*)array->items + array->count * array->stride,
+			array->stride
+		);
+		array->ids[idx] = array->ids[array->count];
+
+		if (idMapSet(&array->map, array->ids[idx], idx)) {
+			return -1;
+		}
+	}
+
+	/* Halving at a quarter full instead of half full keeps an array that
+	 * hovers around a power of two from reallocating on every add and
+	 * delete. Shrinking in an arena would only waste more of it. */
+	if (
+		!array->arena
+		&& array->limit > DENSE_INITIAL_LIMIT
+		&& array->count < array->limit / 4
+	) {
+		if (denseResize(array, array->limit / 2)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int denseResize(DenseArray* array, unsigned int limit)
+{
+	if (array->arena) return denseArenaResize(array, limit);
+
+	void* newItems = realloc(array->items, array->stride * limit);
+
+	if (!newItems) {
+		perror("Failed to resize dense array");
+		return -1;
+	}
+
+	array->items = newItems;
+
+	int* newIds = (int*)realloc(array->ids, sizeof(int) * limit);
+
+	if (!newIds) {
+		perror("Failed to resize dense array IDs");
+
+		/* A shrunk item array is still smaller than the old limit. */
+		if (limit < array->limit) array->limit = limit;
+		return -1;
+	}
+
+	array->ids = newIds;
+	array->limit = limit;
+
+	return 0;
+}
+
+/* The old items and IDs stay in the arena until it goes. With the limit
+ * doubling each time, that's never more than the array itself uses. */
+int denseArenaResize(DenseArray* array, unsigned int limit)
+{
+	void* newItems = arenaRealloc(
+		array->arena,
+		array->items,
+		array->stride * array->limit,
+		array->stride * limit
+	);
+	int* newIds = (int*)arenaRealloc(
+		array->arena,
+		array->ids,
+		sizeof(int) * array->limit,
+		sizeof(int) * limit
+	);
+
+	if (!newItems || !newIds) {
+		printf("Failed to resize dense array in arena\n");
+		return -1;
+	}
+
+	array->items = newItems;
+	array->ids = newIds;
+	array->limit = limit;
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef COMMON_DENSE_H
+#define COMMON_DENSE_H 1
+
+#include <stddef.h>
+#include "idmap.h"
+#include "arena.h"
+
+/* Dense arrays never shrink below this. */
+#define DENSE_INITIAL_LIMIT 16
+
+/* An array with no gaps, for things that get walked every frame. Deleting
+ * moves the last item into the hole instead of shifting everything after it
+ * down, so the order isn't kept. Items are found by ID through the map.
+ *
+ * Arrays can live in an arena instead of the heap. Arena memory only goes
+ * back all at once, so those never shrink, and destroying them leaves the
+ * items and IDs for the arena to free.
+ *
+ * Items are stride bytes each and only ever get at through DENSE_AT() or
+ * DENSE_ITEMS() with the type they were added as. */
+typedef struct
+{
+	void* items;
+	int* ids;
+	IdMap map;
+	size_t stride;
+	unsigned int count;
+	unsigned int limit;
+
+	/* 0 for the heap */
+	Arena* arena;
+} DenseArray;
+
+#define DENSE_ITEMS(type, array) ((type*)(array).items)
+#define DENSE_AT(type, array, idx) (DENSE_ITEMS(type, array)[idx])
+
+int createDenseArray(DenseArray* array, size_t stride, Arena* arena);
+void destroyDenseArray(DenseArray array);
+
+int denseFind(const DenseArray* array, int id);
+int denseAdd(DenseArray* array, int id, const void* item);
+int denseRemove(DenseArray* array, unsigned int idx);
+
+int denseResize(DenseArray* array, unsigned int limit);
+int denseArenaResize(DenseArray* array, unsigned int limit);
+
+#endif
@@ -0,0 +1,133 @@
+#include "idmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int createIdMap(IdMap* map)
+{
+	map->size = IDMAP_INITIAL_SIZE;
+	map->count = 0;
+	map->shift = 32 - IDMAP_INITIAL_BITS;
+	map->buckets = (IdMapBucket*)malloc(sizeof(IdMapBucket) * map->size);
+
+	if (!map->buckets) {
+		perror("Failed to allocate ID map");
+		return -1;
+	}
+
+	for (int i = 0; i < map->size; i++) {
+		map->buckets[i].index = IDMAP_EMPTY;
+	}
+
+	return 0;
+}
+
+void destroyIdMap(IdMap map)
+{
+	free(map.buckets);
+}
+
+/* Returns the index the ID maps to, or -1 if there isn't one. */
+int idMapFind(const IdMap* map, int id)
+{
+	uint32_t i = IDMAP_HASH(id, map->shift);
+
+	while (map->buckets[i].index != IDMAP_EMPTY) {
+		if (map->buckets[i].id == id) return map->buckets[i].index;
+
+		i = (i + 1) & (map->size - 1);
+	}
+
+	return -1;
+}
+
+/* Adds the ID, or points it somewhere else if it's already there. */
+int idMapSet(IdMap* map, int id, uint32_t index)
+{
+	if ((map->count + 1) * 2 > map->size) {
+		if (idMapGrow(map)) {
+			return -1;
+		}
+	}
+
+	uint32_t i = IDMAP_HASH(id, map->shift);
+
+	while (map->buckets[i].index != IDMAP_EMPTY) {
+		if (map->buckets[i].id == id) {
+			map->buckets[i].index = index;
+			return 0;
+		}
+
+		i = (i + 1) & (map->size - 1);
+	}
+
+	map->buckets[i].id = id;
+	map->buckets[i].index = index;
+	++map->count;
+
+	return 0;
+}
+
+void idMapRemove(IdMap* map, int id)
+{
+	const uint32_t mask = map->size - 1;
+	uint32_t i = IDMAP_HASH(id, map->shift);
+
+	while (map->buckets[i].index != IDMAP_EMPTY) {
+		if (map->buckets[i].id == id) break;
+		i = (i + 1) & mask;
+	}
+
+	if (map->buckets[i].index == IDMAP_EMPTY) return;
+
+	/* Pull later buckets in the same run back into the hole, as long as that
+	 * doesn't move them in front of where they hash to. */
+	uint32_t j = i;
+
+	for (;;) {
+		j = (j + 1) & mask;
+
+		if (map->buckets[j].index == IDMAP_EMPTY) break;
+
+		const uint32_t home = IDMAP_HASH(map->buckets[j].id, map->shift);
+
+		/* Distance from home has to cover the hole for the move to be
+		 * allowed. */
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			map->buckets[i] = map->buckets[j];
+			i = j;
+		}
+	}
+
+	map->buckets[i].index = IDMAP_EMPTY;
+	--map->count;
+}
+
+int idMapGrow(IdMap* map)
+{
+	IdMap newMap;
+	newMap.size = map->size * 2;
+	newMap.count = 0;
+	newMap.shift = map->shift - 1;
+	newMap.buckets = (IdMapBucket*)malloc(sizeof(IdMapBucket) * newMap.size);
+
+	if (!newMap.buckets) {
+		perror("Failed to grow ID map");
+		return -1;
+	}
+
+	for (int i = 0; i < newMap.size; i++) {
+		newMap.buckets[i].index = IDMAP_EMPTY;
+	}
+
+	for (int i = 0; i < map->size; i++) {
+		if (map->buckets[i].index == IDMAP_EMPTY) continue;
+
+		/* Can't recurse into growing again. The new map is half as full. */
+		idMapSet(&newMap, map->buckets[i].id, map->buckets[i].index);
+	}
+
+	free(map->buckets);
+	*map = newMap;
+
+	return 0;
+}
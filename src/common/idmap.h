@@ -0,0 +1,49 @@
+#ifndef COMMON_IDMAP_H
+#define COMMON_IDMAP_H 1
+
+#include <stdint.h>
+
+/* Always a power of two */
+#define IDMAP_INITIAL_BITS 6
+#define IDMAP_INITIAL_SIZE (1u << IDMAP_INITIAL_BITS)
+
+/* Marks a free bucket. Dense arrays never get anywhere near this big. */
+#define IDMAP_EMPTY UINT32_MAX
+
+typedef struct
+{
+	int id;
+	uint32_t index;
+} IdMapBucket;
+
+/* Maps the IDs clients pick to where the element sits in its dense array.
+ * It's an open addressed hash table that's never more than half full, so a
+ * lookup only ever touches a bucket or two. Removal shifts the buckets after
+ * it back instead of leaving tombstones, so lookups don't slow down as
+ * elements come and go. */
+typedef struct
+{
+	IdMapBucket* buckets;
+	uint32_t size;
+	uint32_t count;
+
+	/* 32 minus log2 of the size, for IDMAP_HASH() */
+	uint32_t shift;
+} IdMap;
+
+/* Fibonacci hashing. Clients tend to hand out IDs counting up from zero, or
+ * in strides, so the bits have to be spread out or they'd pile up in a few
+ * runs. The multiply pushes every bit of the ID into the top ones, so those
+ * are the ones the bucket comes from. */
+#define IDMAP_HASH(id, shift) (((uint32_t)(id) * 2654435769u) >> (shift))
+
+int createIdMap(IdMap* map);
+void destroyIdMap(IdMap map);
+
+int idMapFind(const IdMap* map, int id);
+int idMapSet(IdMap* map, int id, uint32_t index);
+void idMapRemove(IdMap* map, int id);
+
+int idMapGrow(IdMap* map);
+
+#endif
@@ -1,5 +1,6 @@
 #include "maths.h"
 #include <math.h>
+#include <string.h>
 
 int clamp(int n, int min, int max)
 {
@@ -153,3 +154,86 @@ void transform3d(float (*m)[4], float x, float y, float z)
 	m[3][3] = 1.0f;
 }
 
+/* out = a * b, in the same column major order as the rest. out can't be
+ * either of the others. */
+void multiply3d(float (*out)[4], const float (*a)[4], const float (*b)[4])
+{
+	for (int c = 0; c < 4; c++) {
+		for (int r = 0; r < 4; r++) {
+			out[c][r] = a[0][r] * b[c][0]
+				+ a[1][r] * b[c][1]
+				+ a[2][r] * b[c][2]
+				+ a[3][r] * b[c][3];
+		}
+	}
+}
+
+
+/* Rounds to the nearest half. Anything too big for a half turns into
+ * infinity and anything too small flushes down through the subnormals. */
+uint16_t floatToHalf(float f)
+{
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+
+	const uint16_t sign = (bits >> 16) & 0x8000;
+	const int floatExponent = (bits >> 23) & 0xff;
+	const int exponent = floatExponent - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	/* NaN stays NaN */
+	if (floatExponent == 0xff) {
+		return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+	}
+
+	if (exponent >= 31) return sign | 0x7c00;
+
+	if (exponent <= 0) {
+		if (exponent < -10) return sign;
+
+		/* The implicit leading bit becomes explicit in a subnormal. */
+		mantissa |= 0x800000;
+
+		const int shift = 14 - exponent;
+		uint16_t half = mantissa >> shift;
+
+		if ((mantissa >> (shift - 1)) & 1) ++half;
+
+		return sign | half;
+	}
+
+	uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+
+	/* A carry out of the mantissa bumps the exponent, which is still the
+	 * right answer. */
+	if (mantissa & 0x1000) ++half;
+
+	return half;
+}
+
+/* Octahedral encoding. The unit sphere gets folded onto an octahedron and
+ * flattened into a square, so a normal fits in two snorm components with
+ * the error spread evenly in every direction. */
+void octEncode(Vec3 n, int16_t* out)
+{
+	const float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+
+	if (length == 0.0f) {
+		out[X] = 0;
+		out[Y] = 0;
+		return;
+	}
+
+	float u = n.x / length;
+	float v = n.y / length;
+
+	/* The lower half folds over the diagonals. */
+	if (n.z < 0.0f) {
+		const float oldU = u;
+		u = (1.0f - fabsf(v)) * (oldU >= 0.0f ? 1.0f : -1.0f);
+		v = (1.0f - fabsf(oldU)) * (v >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	out[X] = (int16_t)roundf(fmaxf(-1.0f, fminf(1.0f, u)) * 32767.0f);
+	out[Y] = (int16_t)roundf(fmaxf(-1.0f, fminf(1.0f, v)) * 32767.0f);
+}
@@ -1,6 +1,8 @@
 #ifndef COMMON_MATHS_H
 #define COMMON_MATHS_H 1
 
+#include <stdint.h>
+
 #define FILL_VEC4(n) {n, n, n, n}
 #define FILL_MAT4(n) {FILL_VEC4(n), FILL_VEC4(n), FILL_VEC4(n), FILL_VEC4(n)}
 
@@ -42,6 +44,10 @@ Mat4 matPersp(float fov, float aspect, float near, float far);
 void scale3d(float (*m)[4], float x, float y, float z);
 void rotate3d(float (*m)[4], float x, float y, float z);
 void transform3d(float (*m)[4], float x, float y, float z);
+void multiply3d(float (*out)[4], const float (*a)[4], const float (*b)[4]);
+
+uint16_t floatToHalf(float f);
+void octEncode(Vec3 n, int16_t* out);
 
 #endif
 
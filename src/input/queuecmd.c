@@ -1,13 +1,22 @@
 #include "queuecmd.h"
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h>
+
+/* Commands are small, so one block holds plenty of them. */
+#define QUEUE_ARENA_BLOCK_SIZE 4096
+#define QUEUE_INITIAL_LIMIT 16
 
 int createCommandQueue(CommandQueue* queue)
 {
-	queue->commandLimit = 1;
+	createArena(&queue->arena, QUEUE_ARENA_BLOCK_SIZE);
+	createFreeList(&queue->dataList, sizeof(QCmdData));
+
+	queue->commandLimit = QUEUE_INITIAL_LIMIT;
 	queue->commandCount = 0;
-	queue->commands = (QueueCommand*)malloc(sizeof(QueueCommand));
+	queue->commands = (QueueCommand*)arenaAlloc(
+		&queue->arena,
+		QUEUE_INITIAL_LIMIT * sizeof(QueueCommand)
+	);
 
 	if (!queue->commands) {
 		printf("Failed to create command queue\n");
@@ -17,30 +26,39 @@ int createCommandQueue(CommandQueue* queue)
 	return 0;
 }
 
+/* Command data goes along with the arena. */
 void destroyCommandQueue(CommandQueue queue)
 {
-	for (int i = 0; i < queue.commandCount; i++) {
-		free(queue.commands[i].data);
+	destroyArena(queue.arena);
+}
+
+void* allocCommandData(CommandQueue* queue)
+{
+	void* data = freeListAlloc(&queue->dataList, &queue->arena);
+
+	if (!data) {
+		printf("Failed to allocate queued command data\n");
 	}
 
-	free(queue.commands);
+	return data;
 }
 
 int pushCommandToQueue(CommandQueue* queue, QueueCommand cmd)
 {
 	if (queue->commandCount >= queue->commandLimit) {
-		queue->commandLimit *= 2;
-
-		void* newQueueCommands = realloc(
+		void* newQueueCommands = arenaRealloc(
+			&queue->arena,
 			queue->commands,
-			queue->commandLimit * sizeof(QueueCommand)
+			queue->commandLimit * sizeof(QueueCommand),
+			queue->commandLimit * 2 * sizeof(QueueCommand)
 		);
 
 		if (!newQueueCommands) {
-			perror("Failed to reallocate command queue");
+			printf("Failed to reallocate command queue\n");
 			return -1;
 		}
 
+		queue->commandLimit *= 2;
 		queue->commands = (QueueCommand*)newQueueCommands;
 	}
 
@@ -50,33 +68,9 @@ int pushCommandToQueue(CommandQueue* queue, QueueCommand cmd)
 	return 0;
 }
 
-
-int unqueueCommand(CommandQueue* queue, unsigned int index)
+/* For commands that are done. The queue itself keeps its capacity, since
+ * whatever it grew to once it'll likely need again. */
+void freeCommandData(CommandQueue* queue, void* data)
 {
-	--queue->commandCount;
-
-	free(queue->commands[index].data);
-
-	memcpy(
-		&queue->commands[index],
-		&queue->commands[index + 1],
-		(queue->commandCount - index) * sizeof(QueueCommand)
-	);
-
-	if (queue->commandCount < queue->commandLimit / 2) {
-		queue->commandLimit /= 2;
-
-		queue->commands = (QueueCommand*)realloc(
-			queue->commands,
-			queue->commandLimit * sizeof(QueueCommand)
-		);
-
-		if (!queue->commands) {
-			perror("Failed to reallocate command queue");
-			return -1;
-		}
-	}
-
-	return 0;
+	freeListFree(&queue->dataList, data);
 }
-
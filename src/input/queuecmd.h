@@ -8,6 +8,7 @@
 
 #include <libigni/render.h>
 #include <vulkan/vulkan.h>
+#include "common/arena.h"
 
 typedef unsigned char qCmdOpcode;
 enum
@@ -25,6 +26,12 @@ typedef struct
 	VkSampler sampler;
 } QCmdMeshBindTexture;
 
+/* Any command's data fits in one of these, so they can all share a free list */
+typedef union
+{
+	QCmdMeshBindTexture meshBindTexture;
+} QCmdData;
+
 typedef struct
 {
 	qCmdOpcode opcode;
@@ -37,13 +44,19 @@ typedef struct
 	QueueCommand* commands;
 	unsigned int commandCount;
 	unsigned int commandLimit;
+
+	/* The command array and command data both live in the queue's arena.
+	 * Data from unqueued commands goes on the free list for the next one. */
+	Arena arena;
+	FreeList dataList;
 } CommandQueue;
 
 int createCommandQueue(CommandQueue* queue);
 void destroyCommandQueue(CommandQueue queue);
 
+void* allocCommandData(CommandQueue* queue);
 int pushCommandToQueue(CommandQueue* queue, QueueCommand cmd);
-int unqueueCommand(CommandQueue* queue, unsigned int index);
+void freeCommandData(CommandQueue* queue, void* data);
 
 #endif
 
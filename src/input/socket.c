@@ -1,5 +1,10 @@
 #include "socket.h"
 #include "queuecmd.h"
+#include "render/meshopt.h"
+#include "render/meshlet.h"
+#include "render/simplify.h"
+#include "render/lights.h"
+#include "render/shadow.h"
 #include "common/maths.h"
 
 /* stb_image supports most of the classic image formats: JPG, PNG, BMP etc. */
@@ -9,6 +14,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <errno.h>
@@ -47,11 +53,12 @@ int createSocket(const char* path)
 	return fd;
 }
 
-int executeCmd(SceneArray* scenes, Display display, unsigned int idx)
+int executeCmd(SceneArray* scenes, Display* display, unsigned int idx)
 {
+	Scene* scene = &DENSE_AT(Scene, *scenes, idx);
 	int result = -1;
 	IgniRndOpcode opcode = IGNI_RENDER_OP_NUL;
-	int recvResult = recv(scenes->scenes[idx].fd, &opcode, sizeof(opcode), 0);
+	int recvResult = recv(scene->fd, &opcode, sizeof(opcode), 0);
 
 	switch (opcode) {
 	case IGNI_RENDER_OP_NUL:
@@ -77,55 +84,63 @@ int executeCmd(SceneArray* scenes, Display display, unsigned int idx)
 		break;
 
 	case IGNI_RENDER_OP_CONFIGURE:
-		result = cmdConfigure(&scenes->scenes[idx], display);
+		result = cmdConfigure(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_MESH_CREATE:
-		result = cmdMeshCreate(&scenes->scenes[idx], display);
+		result = cmdMeshCreate(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_MESH_SET_SHADER:
-		result = cmdMeshSetShader(&scenes->scenes[idx], display);
+		result = cmdMeshSetShader(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_MESH_BIND_TEXTURE:
-		result = cmdMeshBindTexture(&scenes->scenes[idx], display);
+		result = cmdMeshBindTexture(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_MESH_TRANSFORM:
-		result = cmdMeshTransform(&scenes->scenes[idx], display);
+		result = cmdMeshTransform(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_MESH_DELETE:
-		result = cmdMeshDelete(&scenes->scenes[idx], display);
+		result = cmdMeshDelete(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_POINT_LIGHT_CREATE:
-		result = cmdPointLightCreate(&scenes->scenes[idx], display);
+		result = cmdPointLightCreate(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_POINT_LIGHT_TRANSFORM:
-		result = cmdPointLightTransform(&scenes->scenes[idx], display);
+		result = cmdPointLightTransform(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_POINT_LIGHT_SET_COLOUR:
-		result = cmdPointLightSetColour(&scenes->scenes[idx], display);
+		result = cmdPointLightSetColour(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_POINT_LIGHT_DELETE:
-		result = cmdPointLightDelete(&scenes->scenes[idx], display);
+		result = cmdPointLightDelete(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_TEXTURE_CREATE:
-		result = cmdTextureCreate(&scenes->scenes[idx], display);
+		result = cmdTextureCreate(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_TEXTURE_DELETE:
-		result = cmdTextureDelete(&scenes->scenes[idx], display);
+		result = cmdTextureDelete(scene, display);
 		break;
 
 	case IGNI_RENDER_OP_VIEWPOINT_TRANSFORM:
-		result = cmdViewpointTransform(&scenes->scenes[idx], display);
+		result = cmdViewpointTransform(scene, display);
+		break;
+
+	case IGNI_RENDER_OP_SERVER_STATS:
+		result = cmdServerStats(scene, display);
+		break;
+
+	case IGNI_RENDER_OP_SCENE_LOD_BIAS:
+		result = cmdSceneLodBias(scene, display);
 		break;
 
 	default:
@@ -135,7 +150,10 @@ int executeCmd(SceneArray* scenes, Display display, unsigned int idx)
 
 	if (result) {
 		printf("scene close %i\n", idx);
-		sceneArrayRemoveEntry(scenes, idx, display.dev.device);
+
+		/* Other scenes' lights can have its meshes in their shadows. */
+		addSceneShadowRemovals(&display->shadows.cache, scene);
+		sceneArrayRemoveEntry(scenes, idx, &display->garbage);
 		return -1;
 	}
 
@@ -143,7 +161,7 @@ int executeCmd(SceneArray* scenes, Display display, unsigned int idx)
 }
 
 /* This command exists to add compatibility between versions. */
-int cmdConfigure(Scene* scene, Display display)
+int cmdConfigure(Scene* scene, Display* display)
 {
 	IgniRndCmdConfigure cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
@@ -166,9 +184,10 @@ int cmdConfigure(Scene* scene, Display display)
  * CONS:
  * - Cannot easily load embedded resources
  * - May not support all file formats */
-int cmdMeshCreate(Scene* scene, Display display)
+int cmdMeshCreate(Scene* scene, Display* display)
 {
 	Mesh newMesh = {};
+	newMesh.texId = -1;
 
 	IgniRndCmdMeshCreate cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
@@ -189,130 +208,337 @@ int cmdMeshCreate(Scene* scene, Display display)
 	}
 
 	/* Don't create a mesh with an already existing ID. */
-	if (findId(scene->meshIds, scene->meshCount, cmd.meshId) != -1) {
+	if (denseFind(&scene->meshes, cmd.meshId) != -1) {
 		printf("Mesh ID %i already exists.\n", cmd.meshId);
 		return -1;
 	}
 
-	/* Allocate enough space before writing up the mesh */
-	size_t vertexBufferSz = 0;
+	/* Count everything up before writing the mesh */
+	unsigned int vertexCount = 0;
+	unsigned int indexCount = 0;
 
-	/* At first, the vertex and index buffer sizes are simply the number of
-	 * vertices and indices. */
 	for (int i = 0; i < impScene->mNumMeshes; i++) {
-		vertexBufferSz += impScene->mMeshes[i]->mNumVertices;
+		vertexCount += impScene->mMeshes[i]->mNumVertices;
 
 		/* Assuming the mesh got triangulated, as instructed to assimp */
-		newMesh.indexCount += impScene->mMeshes[i]->mNumFaces * 3;
+		indexCount += impScene->mMeshes[i]->mNumFaces * 3;
 	}
 
-	/* If there are too many vertices, 16-bit indices are upgraded to
-	 * 32-bit indices and the buffer size is changed again. */
+	const size_t vertexStride =
+		display->packedVertices ? sizeof(PackedVertex) : sizeof(Vertex);
 
-	char indexSize = 2;
-	newMesh.indexType = VK_INDEX_TYPE_UINT16;
-	
-	if (vertexBufferSz > 32767) {
-		newMesh.indexType = VK_INDEX_TYPE_UINT32;
-		indexSize = 4;
+	/* Checked against the mesh as imported. Optimising it only ever makes it
+	 * smaller. */
+	if (checkSceneQuota(
+		scene,
+		display,
+		vertexCount * vertexStride
+		+ indexCount * (vertexCount > UINT16_MAX + 1 ? 4 : 2)
+	)) {
+		aiReleaseImport(impScene);
+		return idMapSet(&scene->refusedMeshes, cmd.meshId, 0);
 	}
 
-	vertexBufferSz *= sizeof(Vertex);	
+	Vertex* vertices = malloc(sizeof(Vertex) * vertexCount);
+	uint32_t* indices = malloc(sizeof(uint32_t) * indexCount);
 
-	Vertex* vertexData = malloc(vertexBufferSz);
-	if (!vertexData) {
-		printf("Failed to allocate space for vertex buffer.\n");
-		aiReleaseImport(impScene);
-		return -1;
-	}
+	newMesh.submeshCount = impScene->mNumMeshes;
+	newMesh.submeshes = malloc(sizeof(Submesh) * newMesh.submeshCount);
 
-	/* indexData is void because index size varies from mesh to mesh. */
-	void* indexData = malloc(newMesh.indexCount * indexSize);
-	if (!indexData) {
-		printf("Failed to allocate space for index buffer.\n");
+	if (!vertices || !indices || !newMesh.submeshes) {
+		printf("Failed to allocate space for mesh data.\n");
+		free(vertices);
+		free(indices);
+		free(newMesh.submeshes);
 		aiReleaseImport(impScene);
 		return -1;
 	}
 
-	uint16_t* indexPtr = indexData;
-
 	/* Assimp's mesh data must be reformatted for the vertex and index buffers.
 	 *
-	 * All meshes in the imported scene get merged into one because the 'Create
-	 * Mesh' command only provides one mesh ID. */
+	 * All meshes in the imported scene share one set of buffers because the
+	 * 'Create Mesh' command only provides one mesh ID. Each one keeps its own
+	 * range of indices, which get moved past the vertices of the ones
+	 * before it. */
 
 	struct aiMesh currentMesh;
+	unsigned int baseVertex = 0;
+	uint32_t* indexPtr = indices;
 
 	for (int i = 0; i < impScene->mNumMeshes; i++) {
 		currentMesh = *impScene->mMeshes[i];
 
+		newMesh.submeshes[i].firstIndex = indexPtr - indices;
+		newMesh.submeshes[i].indexCount = currentMesh.mNumFaces * 3;
+		newMesh.submeshes[i].materialIndex = currentMesh.mMaterialIndex;
+
 		/* Add vertices to mesh */
 		for (int j = 0; j < currentMesh.mNumVertices; j++) {
-			vertexData[j].pos[X] = currentMesh.mVertices[j].x;
-			vertexData[j].pos[Y] = currentMesh.mVertices[j].y;
-			vertexData[j].pos[Z] = currentMesh.mVertices[j].z;
+			Vertex* vertex = &vertices[baseVertex + j];
 
-			vertexData[j].texCoord[X] = currentMesh.mTextureCoords[0][j].x;
-			vertexData[j].texCoord[Y] = currentMesh.mTextureCoords[0][j].y;
+			vertex->pos[X] = currentMesh.mVertices[j].x;
+			vertex->pos[Y] = currentMesh.mVertices[j].y;
+			vertex->pos[Z] = currentMesh.mVertices[j].z;
 
-			vertexData[j].normal[X] = currentMesh.mNormals[j].x;
-			vertexData[j].normal[Y] = currentMesh.mNormals[j].y;
-			vertexData[j].normal[Z] = currentMesh.mNormals[j].z;
+			vertex->texCoord[X] = currentMesh.mTextureCoords[0][j].x;
+			vertex->texCoord[Y] = currentMesh.mTextureCoords[0][j].y;
+
+			vertex->normal[X] = currentMesh.mNormals[j].x;
+			vertex->normal[Y] = currentMesh.mNormals[j].y;
+			vertex->normal[Z] = currentMesh.mNormals[j].z;
 		}
 
 		/* Add indices to mesh */
 		for (int j = 0; j < currentMesh.mNumFaces; j++) {
 			for (int k = 0; k < 3; k++) {
-				*indexPtr = currentMesh.mFaces[j].mIndices[k];
-				*(uintptr_t*)&indexPtr += indexSize;
+				*indexPtr = baseVertex + currentMesh.mFaces[j].mIndices[k];
+				++indexPtr;
+			}
+		}
+
+		baseVertex += currentMesh.mNumVertices;
+	}
+
+	aiReleaseImport(impScene);
+
+	if (display->optimizeMeshes) {
+		const float oldAcmr = vertexCacheAcmr(indices, indexCount, vertexCount);
+
+		if (optimizeMesh(
+			vertices,
+			&vertexCount,
+			indices,
+			indexCount,
+			newMesh.submeshes,
+			newMesh.submeshCount
+		)) {
+			freeMeshData(vertices, indices, vertices, indices);
+			free(newMesh.submeshes);
+			return -1;
+		}
+
+		printf(
+			"Mesh %i: %u vertices, ACMR %.2f -> %.2f\n",
+			cmd.meshId,
+			vertexCount,
+			oldAcmr,
+			vertexCacheAcmr(indices, indexCount, vertexCount)
+		);
+	}
+
+	/* Packed positions are measured against the bounding box, so it has to
+	 * be known before any vertex gets packed. The whole mesh's box is the
+	 * box around its submeshes'. */
+	for (int i = 0; i < 3; i++) {
+		newMesh.aabbMin[i] = INFINITY;
+		newMesh.aabbMax[i] = -INFINITY;
+	}
+
+	for (int i = 0; i < newMesh.submeshCount; i++) {
+		Submesh* submesh = &newMesh.submeshes[i];
+
+		for (int j = 0; j < 3; j++) {
+			submesh->aabbMin[j] = INFINITY;
+			submesh->aabbMax[j] = -INFINITY;
+		}
+
+		for (int j = 0; j < submesh->indexCount; j++) {
+			const float* pos = vertices[indices[submesh->firstIndex + j]].pos;
+
+			for (int k = 0; k < 3; k++) {
+				submesh->aabbMin[k] = fminf(submesh->aabbMin[k], pos[k]);
+				submesh->aabbMax[k] = fmaxf(submesh->aabbMax[k], pos[k]);
+			}
+		}
+
+		for (int j = 0; j < 3; j++) {
+			newMesh.aabbMin[j] = fminf(newMesh.aabbMin[j], submesh->aabbMin[j]);
+			newMesh.aabbMax[j] = fmaxf(newMesh.aabbMax[j], submesh->aabbMax[j]);
+		}
+	}
+
+	/* Nothing to draw gets an empty box at the origin. */
+	for (int i = 0; i < 3; i++) {
+		if (newMesh.aabbMin[i] > newMesh.aabbMax[i]) {
+			newMesh.aabbMin[i] = 0.0f;
+			newMesh.aabbMax[i] = 0.0f;
+		}
+	}
+
+	/* The sphere shares the box's centre. It's a little looser than the
+	 * smallest one, but it's found in one pass. */
+	float radiusSq = 0.0f;
+
+	for (int i = 0; i < 3; i++) {
+		newMesh.sphereCentre[i] = (newMesh.aabbMin[i] + newMesh.aabbMax[i])
+			* 0.5f;
+	}
+
+	for (int i = 0; i < indexCount; i++) {
+		const float* pos = vertices[indices[i]].pos;
+		const float dx = pos[X] - newMesh.sphereCentre[X];
+		const float dy = pos[Y] - newMesh.sphereCentre[Y];
+		const float dz = pos[Z] - newMesh.sphereCentre[Z];
+
+		radiusSq = fmaxf(radiusSq, dx * dx + dy * dy + dz * dz);
+	}
+
+	newMesh.sphereRadius = sqrtf(radiusSq);
+	newMesh.visible = 1;
+
+	/* LOD 0 is the mesh as it is. The rest go on the end of the index
+	 * buffer, with copies of the submeshes and their boxes. */
+	newMesh.lods[0].triangleCount = indexCount / 3;
+	newMesh.lodCount = 1;
+
+	if (display->generateLods) {
+		const unsigned int fullIndexCount = indexCount;
+
+		if (buildLods(
+			&indices,
+			&indexCount,
+			&newMesh.submeshes,
+			newMesh.submeshCount,
+			newMesh.lods,
+			&newMesh.lodCount,
+			vertices,
+			vertexCount
+		)) {
+			freeMeshData(vertices, indices, vertices, indices);
+			free(newMesh.submeshes);
+			return -1;
+		}
+
+		/* Meshes that only fit under the quota without their LODs are
+		 * better off without them than refused. */
+		if (checkSceneQuota(
+			scene,
+			display,
+			vertexCount * vertexStride
+			+ indexCount * (vertexCount > UINT16_MAX + 1 ? 4 : 2)
+		)) {
+			indexCount = fullIndexCount;
+			newMesh.lodCount = 1;
+		}
+
+		/* Dropping triangles leaves the order a bit worse for the
+		 * vertex cache. */
+		const unsigned int lodSubmeshCount = display->optimizeMeshes
+			? newMesh.submeshCount * newMesh.lodCount
+			: 0;
+
+		for (int i = newMesh.submeshCount; i < lodSubmeshCount; i++) {
+			if (optimizeVertexCache(
+				&indices[newMesh.submeshes[i].firstIndex],
+				newMesh.submeshes[i].indexCount,
+				vertexCount
+			)) {
+				freeMeshData(vertices, indices, vertices, indices);
+				free(newMesh.submeshes);
+				return -1;
 			}
 		}
+
+		for (int i = 1; i < newMesh.lodCount; i++) {
+			printf(
+				"Mesh %i LOD %i: %u triangles, error %g\n",
+				cmd.meshId,
+				i,
+				newMesh.lods[i].triangleCount,
+				newMesh.lods[i].error
+			);
+		}
+	}
+
+	newMesh.indexCount = indexCount;
+
+	float quantScale[3];
+
+	for (int i = 0; i < 3; i++) {
+		quantScale[i] = newMesh.aabbMax[i] - newMesh.aabbMin[i];
+	}
+
+	/* If there are too many vertices, 16-bit indices are upgraded to
+	 * 32-bit indices. Unsigned 16-bit indices reach vertex 65535, and
+	 * primitive restart is off, so that one is fair game too. */
+
+	char indexSize = 2;
+	newMesh.indexType = VK_INDEX_TYPE_UINT16;
+	
+	if (vertexCount > UINT16_MAX + 1) {
+		newMesh.indexType = VK_INDEX_TYPE_UINT32;
+		indexSize = 4;
+	}
+
+	/* Converted to whatever format gets uploaded. Full vertices and 32-bit
+	 * indices go up as they are. */
+	const size_t vertexBufferSz = vertexCount * vertexStride;
+	void* vertexData = vertices;
+	void* indexData = indices;
+
+	if (display->packedVertices) {
+		vertexData = malloc(vertexBufferSz);
+
+		for (int i = 0; vertexData && i < vertexCount; i++) {
+			packVertex(
+				&((PackedVertex*)vertexData)[i],
+				&vertices[i],
+				newMesh.aabbMin,
+				quantScale
+			);
+		}
+	}
+
+	if (indexSize == 2) {
+		indexData = malloc(sizeof(uint16_t) * indexCount);
+
+		for (int i = 0; indexData && i < indexCount; i++) {
+			((uint16_t*)indexData)[i] = indices[i];
+		}
+	}
+
+	if (!vertexData || !indexData) {
+		printf("Failed to allocate space for vertex and index buffers.\n");
+		freeMeshData(vertices, indices, vertexData, indexData);
+		free(newMesh.submeshes);
+		return -1;
 	}
 
-	if (createVertexBuffer(
-		display.cmd,
-		display.dev.graphicsQueue,
-		display.dev.device,
-		display.physicalDevice,
+	if (createMeshBuffers(
+		&newMesh,
+		display,
 		vertexData,
+		vertexCount,
 		vertexBufferSz,
-		&newMesh.vertexBuffer,
-		&newMesh.vertexBufferMemory
+		indexData,
+		indexSize
 	)) {
-		aiReleaseImport(impScene);
-		destroyMesh(display.dev.device, newMesh);
+		freeMeshData(vertices, indices, vertexData, indexData);
+		destroyMesh(&display->garbage, newMesh);
 		return -1;
 	}
 
-	free(vertexData);
-
-	if (createIndexBuffer(
-		display.cmd,
-		display.dev.graphicsQueue,
-		display.dev.device,
-		display.physicalDevice,
-		indexData,
-		newMesh.indexCount * indexSize,
-		indexSize,
-		&newMesh.indexBuffer, 
-		&newMesh.indexBufferMemory
+	if (display->meshletCull && createMeshletBuffers(
+		&newMesh,
+		display,
+		vertices,
+		vertexCount,
+		indices
 	)) {
-		aiReleaseImport(impScene);
-		destroyMesh(display.dev.device, newMesh);
+		freeMeshData(vertices, indices, vertexData, indexData);
+		destroyMesh(&display->garbage, newMesh);
 		return -1;
 	}
 
-	free(indexData);
-
-	aiReleaseImport(impScene);
+	freeMeshData(vertices, indices, vertexData, indexData);
 
 	/* Create uniform buffers */
 
 	const VkDeviceSize bufferSize = sizeof(ModelUniforms);
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		if (createBuffer(
-			display.dev.device,
-			display.physicalDevice,
+			display->dev.device,
+			display->physicalDevice,
 			bufferSize,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
@@ -321,12 +547,12 @@ int cmdMeshCreate(Scene* scene, Display display)
 			&newMesh.uboMemory[i]
 		)) {
 			printf("Failed to create uniform buffers.\n");
-			destroyMesh(display.dev.device, newMesh);
+			destroyMesh(&display->garbage, newMesh);
 			return -1;
 		}
 
 		if (vkMapMemory(
-			display.dev.device,
+			display->dev.device,
 			newMesh.uboMemory[i],
 			0,
 			bufferSize,
@@ -334,60 +560,21 @@ int cmdMeshCreate(Scene* scene, Display display)
 			&newMesh.uboMapped[i]
 		) != VK_SUCCESS) {
 			printf("Failed to map uniform buffer memory.\n");
-			destroyMesh(display.dev.device, newMesh);
+			destroyMesh(&display->garbage, newMesh);
 			return -1;
 		}
 	}
 
-	/* Create descriptor pool */
-
-	VkDescriptorPoolSize poolSizes[3] = {};
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
-
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
-
-	poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT;
-
-	VkDescriptorPoolCreateInfo descPoolInfo = {};
-	descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descPoolInfo.poolSizeCount = 3;
-	descPoolInfo.pPoolSizes = poolSizes;
-	descPoolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
-
-	if (vkCreateDescriptorPool(
-		display.dev.device,
-		&descPoolInfo,
-		0,
-		&newMesh.descriptorPool
-	) != VK_SUCCESS) {
-		printf("Failed to create descriptor pool.\n");
-		destroyMesh(display.dev.device, newMesh);
-		return -1;
-	}
-
-	/* Create descriptor sets */
-
-	VkDescriptorSetLayout descSetLayouts[MAX_FRAMES_IN_FLIGHT];
-	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		descSetLayouts[i] = display.geom.descSetLayout;
-	}
-
-	VkDescriptorSetAllocateInfo gAllocInfo = {};
-	gAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	gAllocInfo.descriptorPool = newMesh.descriptorPool;
-	gAllocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
-	gAllocInfo.pSetLayouts = descSetLayouts;
+	/* Descriptor sets come out of the display's shared allocator */
 
-	if (vkAllocateDescriptorSets(
-		display.dev.device,
-		&gAllocInfo,
-		newMesh.descriptorSets
-	) != VK_SUCCESS) {
-		printf("Failed to allocate descriptor sets.\n");
-		destroyMesh(display.dev.device, newMesh);
+	if (allocDescriptorSets(
+		&display->meshDescAlloc,
+		display->dev.device,
+		display->geom.descSetLayout,
+		newMesh.descriptorSets,
+		MAX_FRAMES_IN_FLIGHT
+	)) {
+		destroyMesh(&display->garbage, newMesh);
 		return -1;
 	}
 
@@ -399,10 +586,21 @@ int cmdMeshCreate(Scene* scene, Display display)
 	meshUBO.tform[Z][Z] = 1.0f;
 	meshUBO.tform[W][W] = 1.0f;
 
+	memcpy(newMesh.tform, meshUBO.tform, sizeof(newMesh.tform));
+
+	/* New meshes start out moving, so lights around them get refreshed. */
+	newMesh.moved = 1;
+	meshShadowSphere(newMesh.shadowSphere, &newMesh);
+
+	for (int i = 0; i < 3; i++) {
+		meshUBO.quantOffset[i] = newMesh.aabbMin[i];
+		meshUBO.quantScale[i] = quantScale[i];
+	}
+
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		/* Viewpoint Uniform Buffer */
 		VkDescriptorBufferInfo povBufferInfo = {};
-		povBufferInfo.buffer = display.pov.uniformBuffers[i];
+		povBufferInfo.buffer = display->pov.uniformBuffers[i];
 		povBufferInfo.offset = 0;
 		povBufferInfo.range = sizeof(ViewpointUniforms);
 
@@ -415,7 +613,7 @@ int cmdMeshCreate(Scene* scene, Display display)
 		povWrite.descriptorCount = 1;
 		povWrite.pBufferInfo = &povBufferInfo;
 
-		vkUpdateDescriptorSets(display.dev.device, 1, &povWrite, 0, 0);
+		vkUpdateDescriptorSets(display->dev.device, 1, &povWrite, 0, 0);
 
 		/* The default texture is a single magenta pixel */
 		VkDescriptorBufferInfo nullBuffer = {};
@@ -425,8 +623,8 @@ int cmdMeshCreate(Scene* scene, Display display)
 
 		VkDescriptorImageInfo nullImage = {};
 		nullImage.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		nullImage.imageView = display.nulTexture.view;
-		nullImage.sampler = display.nulTexture.sampler;
+		nullImage.imageView = display->nulTexture.view;
+		nullImage.sampler = display->nulTexture.sampler;
 
 		VkWriteDescriptorSet nulTexWriteDesc = {};
 		nulTexWriteDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -438,7 +636,7 @@ int cmdMeshCreate(Scene* scene, Display display)
 		nulTexWriteDesc.descriptorCount = 1;
 		nulTexWriteDesc.pBufferInfo = &nullBuffer;
 		nulTexWriteDesc.pImageInfo = &nullImage;
-		vkUpdateDescriptorSets(display.dev.device, 1, &nulTexWriteDesc, 0, 0);
+		vkUpdateDescriptorSets(display->dev.device, 1, &nulTexWriteDesc, 0, 0);
 
 		/* Mesh Uniform Buffer */
 		VkDescriptorBufferInfo meshBufferInfo = {};
@@ -455,7 +653,42 @@ int cmdMeshCreate(Scene* scene, Display display)
 		meshWriteDesc.descriptorCount = 1;
 		meshWriteDesc.pBufferInfo = &meshBufferInfo;
 
-		vkUpdateDescriptorSets(display.dev.device, 1, &meshWriteDesc, 0, 0);
+		vkUpdateDescriptorSets(display->dev.device, 1, &meshWriteDesc, 0, 0);
+
+		/* Meshlets and the draw list, for the culling pass */
+		if (newMesh.meshletCount) {
+			VkDescriptorBufferInfo meshletBufferInfo = {};
+			meshletBufferInfo.buffer = newMesh.meshletBuffer;
+			meshletBufferInfo.offset = 0;
+			meshletBufferInfo.range = VK_WHOLE_SIZE;
+
+			VkDescriptorBufferInfo drawBufferInfo = {};
+			drawBufferInfo.buffer = newMesh.drawBuffer;
+			drawBufferInfo.offset = 0;
+			drawBufferInfo.range = VK_WHOLE_SIZE;
+
+			VkWriteDescriptorSet cullWriteDescs[2] = {};
+			cullWriteDescs[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			cullWriteDescs[0].dstSet = newMesh.descriptorSets[i];
+			cullWriteDescs[0].dstBinding = 3;
+			cullWriteDescs[0].dstArrayElement = 0;
+			cullWriteDescs[0].descriptorType =
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			cullWriteDescs[0].descriptorCount = 1;
+			cullWriteDescs[0].pBufferInfo = &meshletBufferInfo;
+
+			cullWriteDescs[1] = cullWriteDescs[0];
+			cullWriteDescs[1].dstBinding = 4;
+			cullWriteDescs[1].pBufferInfo = &drawBufferInfo;
+
+			vkUpdateDescriptorSets(
+				display->dev.device,
+				2,
+				cullWriteDescs,
+				0,
+				0
+			);
+		}
 
 		/* Start the mesh out with its default transforms */
 		memcpy(newMesh.uboMapped[i], &meshUBO, sizeof(ModelUniforms));
@@ -463,34 +696,238 @@ int cmdMeshCreate(Scene* scene, Display display)
 
 	/* Once the mesh is successfully set up, it is ready for the scene. */ 
 
-	if (scene->meshCount >= scene->meshLimit)  { 
-		scene->meshLimit *= 2; 
-		scene->meshes = (Mesh*)realloc( 
-			scene->meshes, 
-			sizeof(Mesh) * scene->meshLimit 
+	if (denseAdd(&scene->meshes, cmd.meshId, &newMesh) == -1) {
+		printf("Failed to add mesh to scene\n");
+		destroyMesh(&display->garbage, newMesh);
+		return -1;
+	}
+
+	/* It may have been refused before there was room for it. */
+	idMapRemove(&scene->refusedMeshes, cmd.meshId);
+	++scene->generation;
+
+	return 0;
+}
+
+/* Puts the mesh's vertices and indices on the device and charges them to
+ * the budget. Meshes with 16-bit indices go in the geometry pool if there's
+ * room. The rest, and the ones that don't fit, get buffers of their own. */
+int createMeshBuffers(
+	Mesh* mesh,
+	Display* display,
+	const void* vertexData,
+	unsigned int vertexCount,
+	VkDeviceSize vertexBufferSz,
+	const void* indexData,
+	char indexSize
+)
+{
+	const VkDeviceSize indexBufferSz = mesh->indexCount * indexSize;
+
+	const char poolable = display->multiDraw
+		&& indexSize == 2
+		&& vertexCount
+		&& mesh->indexCount;
+
+	if (poolable) {
+		const int result = geometryPoolAdd(
+			&display->geomPool,
+			display->cmd,
+			display->dev.graphicsQueue,
+			display->dev.device,
+			display->physicalDevice,
+			vertexData,
+			vertexCount,
+			indexData,
+			mesh->indexCount,
+			&mesh->vertexRange,
+			&mesh->indexRange
 		);
-		if (!scene->meshes)  {
-			perror("realloc(meshes) in cmdMeshCreate() failed");
+
+		if (result == -1) return -1;
+
+		if (!result) {
+			mesh->pooled = 1;
+			mesh->vertexBuffer = display->geomPool.vertices.buffer;
+			mesh->indexBuffer = display->geomPool.indices.buffer;
+
+			mesh->vertexMemSize = vertexBufferSz;
+			mesh->indexMemSize = indexBufferSz;
+			budgetCharge(&display->budget, mesh->vertexMemSize);
+			budgetCharge(&display->budget, mesh->indexMemSize);
+
+			return 0;
+		}
+	}
+
+	/* Both get a second go if the device runs out of memory, after unused
+	 * textures have made room. */
+	for (int attempt = 0; createVertexBuffer(
+		display->cmd,
+		display->dev.graphicsQueue,
+		display->dev.device,
+		display->physicalDevice,
+		vertexData,
+		vertexBufferSz,
+		&mesh->vertexBuffer,
+		&mesh->vertexBufferMemory
+	); attempt++) {
+		if (attempt || reclaimDeviceMemory(
+			display,
+			vertexBufferSz + indexBufferSz
+		)) {
 			return -1;
 		}
-		scene->meshIds = (int*)realloc( 
-			scene->meshIds, 
-			sizeof(int) * scene->meshLimit 
-		); 
-		if (!scene->meshes)  {
-			perror("realloc(meshIds) in cmdMeshCreate() failed");
+	}
+
+	mesh->vertexMemSize = vertexBufferSz;
+	budgetCharge(&display->budget, mesh->vertexMemSize);
+
+	for (int attempt = 0; createIndexBuffer(
+		display->cmd,
+		display->dev.graphicsQueue,
+		display->dev.device,
+		display->physicalDevice,
+		indexData,
+		indexBufferSz,
+		indexSize,
+		&mesh->indexBuffer,
+		&mesh->indexBufferMemory
+	); attempt++) {
+		if (attempt || reclaimDeviceMemory(display, indexBufferSz)) {
 			return -1;
 		}
 	}
 
-	scene->meshes[scene->meshCount] = newMesh;
-	scene->meshIds[scene->meshCount] = cmd.meshId;
-	++scene->meshCount;
+	mesh->indexMemSize = indexBufferSz;
+	budgetCharge(&display->budget, mesh->indexMemSize);
+
+	return 0;
+}
+
+/* Cuts the mesh into meshlets and uploads them, along with a draw list big
+ * enough for every one of them to survive culling. Meshes with nothing to
+ * draw get neither and fall back on drawing their submeshes. Every LOD gets
+ * its own run of meshlets, but only one LOD is drawn at a time, so the draw
+ * list only needs room for the biggest. */
+int createMeshletBuffers(
+	Mesh* mesh,
+	Display* display,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices
+)
+{
+	Meshlet* meshlets;
+
+	if (buildMeshlets(
+		&meshlets,
+		&mesh->meshletCount,
+		vertices,
+		vertexCount,
+		indices,
+		mesh->submeshes,
+		mesh->submeshCount * mesh->lodCount
+	)) {
+		return -1;
+	}
+
+	if (!mesh->meshletCount) {
+		free(meshlets);
+		return 0;
+	}
+
+	/* Meshlets never cross submeshes, and the submeshes come one LOD
+	 * after another, so each LOD's meshlets are in one piece. */
+	unsigned int lod = 0;
+	unsigned int maxDraws = 0;
+
+	for (int i = 0; i < mesh->lodCount; i++) {
+		mesh->lods[i].firstMeshlet = 0;
+		mesh->lods[i].meshletCount = 0;
+	}
+
+	for (int i = 0; i < mesh->meshletCount; i++) {
+		while (
+			lod + 1 < mesh->lodCount
+			&& meshlets[i].firstIndex
+			>= mesh->submeshes[(lod + 1) * mesh->submeshCount].firstIndex
+		) {
+			++lod;
+			mesh->lods[lod].firstMeshlet = i;
+		}
+
+		++mesh->lods[lod].meshletCount;
+		maxDraws = max(maxDraws, mesh->lods[lod].meshletCount);
+	}
+
+	const VkDeviceSize meshletBufferSz = sizeof(Meshlet) * mesh->meshletCount;
+
+	int result = createDeviceLocalBuffer(
+		display->cmd,
+		display->dev.graphicsQueue,
+		display->dev.device,
+		display->physicalDevice,
+		meshlets,
+		meshletBufferSz,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		&mesh->meshletBuffer,
+		&mesh->meshletMemory
+	);
+
+	free(meshlets);
+
+	if (result) {
+		mesh->meshletCount = 0;
+		return -1;
+	}
+
+	mesh->meshletMemSize = meshletBufferSz;
+	budgetCharge(&display->budget, mesh->meshletMemSize);
+
+	/* Filled in by the culling pass every frame, so there's nothing to
+	 * upload. */
+	const VkDeviceSize drawBufferSz = sizeof(uint32_t)
+		+ sizeof(VkDrawIndexedIndirectCommand) * maxDraws;
+
+	if (createBuffer(
+		display->dev.device,
+		display->physicalDevice,
+		drawBufferSz,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+		| VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+		| VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&mesh->drawBuffer,
+		&mesh->drawMemory
+	)) {
+		mesh->meshletCount = 0;
+		return -1;
+	}
+
+	mesh->drawMemSize = drawBufferSz;
+	budgetCharge(&display->budget, mesh->drawMemSize);
 
 	return 0;
 }
 
-int cmdMeshSetShader(Scene* scene, Display display)
+/* The upload copies are only separate allocations when they had to be
+ * converted. */
+void freeMeshData(
+	Vertex* vertices,
+	uint32_t* indices,
+	void* vertexData,
+	void* indexData
+)
+{
+	if (vertexData != vertices) free(vertexData);
+	if (indexData != indices) free(indexData);
+
+	free(vertices);
+	free(indices);
+}
+
+int cmdMeshSetShader(Scene* scene, Display* display)
 {
 	IgniRndCmdMeshSetShader cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
@@ -498,7 +935,7 @@ int cmdMeshSetShader(Scene* scene, Display display)
 	return 0;
 }
 
-int cmdMeshBindTexture(Scene* scene, Display display)
+int cmdMeshBindTexture(Scene* scene, Display* display)
 {
 	IgniRndCmdMeshBindTexture cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
@@ -508,71 +945,93 @@ int cmdMeshBindTexture(Scene* scene, Display display)
 		return -1;
 	};
 
-	int texIdx = findId(scene->textureIds, scene->texCount, cmd.textureId);
+	int texIdx = denseFind(&scene->textures, cmd.textureId);
 
 	if (texIdx == -1) {
-		printf("Failed to find texture.\n");
-		return -1;
+		return missingElement(
+			&scene->refusedTextures,
+			cmd.textureId,
+			"texture"
+		);
 	}
 
-	QueueCommand qCmd;
-	qCmd.opcode = QUEUE_CMD_MESH_BIND_TEXTURE;
-	qCmd.repeats = MAX_FRAMES_IN_FLIGHT;
-	qCmd.data = malloc(sizeof(QCmdMeshBindTexture));
+	int meshIdx = denseFind(&scene->meshes, cmd.meshId);
 
-	if (!qCmd.data) {
-		printf("Failed to allocate space for command qMeshBindTexture\n");
-		return -1;
+	if (meshIdx == -1) {
+		return missingElement(&scene->refusedMeshes, cmd.meshId, "mesh");
 	}
 
-	QCmdMeshBindTexture qCmdData = {0};
-	qCmdData.meshId = cmd.meshId;
-	qCmdData.view = scene->textures[texIdx].view;
-	qCmdData.sampler = scene->textures[texIdx].sampler;
-	qCmdData.pass = cmd.target;
-	*(QCmdMeshBindTexture*)qCmd.data = qCmdData;
+	/* Evicted textures come back as soon as something wants them. */
+	if (!DENSE_AT(Texture, scene->textures, texIdx).resident) {
+		if (reloadTexture(
+			&DENSE_AT(Texture, scene->textures, texIdx),
+			display
+		)) {
+			return -1;
+		}
+	}
 
-	pushCommandToQueue(&scene->uniformCommands, qCmd);
+	/* The texture being unbound was in use up to now. */
+	int oldTexIdx = denseFind(
+		&scene->textures,
+		DENSE_AT(Mesh, scene->meshes, meshIdx).texId
+	);
 
-	int meshIdx = findId(scene->meshIds, scene->meshCount, cmd.meshId);
+	if (oldTexIdx != -1) {
+		Texture* oldTex = &DENSE_AT(Texture, scene->textures, oldTexIdx);
 
-	if (meshIdx == -1) {
-		printf("mesh not found.\n");
-		return -1;
+		oldTex->lastUsed = display->frameCount;
+		removeTextureBinding(scene, oldTex, cmd.meshId);
 	}
 
-	/* Resize the texture's array of bound meshes */
-	Texture* selTex = &scene->textures[texIdx];
+	DENSE_AT(Mesh, scene->meshes, meshIdx).texId = cmd.textureId;
+	DENSE_AT(Texture, scene->textures, texIdx).lastUsed = display->frameCount;
+	++scene->generation;
+
+	/* With a texture table, the mesh just needs to know where to look. It
+	 * gets picked up by the next frame recorded. No descriptor writes, no
+	 * waiting on fences. */
+	if (display->bindless) {
+		DENSE_AT(Mesh, scene->meshes, meshIdx).texIndex =
+			DENSE_AT(Texture, scene->textures, texIdx).tableSlot;
+	} else {
+		QueueCommand qCmd;
+		qCmd.opcode = QUEUE_CMD_MESH_BIND_TEXTURE;
+		qCmd.repeats = MAX_FRAMES_IN_FLIGHT;
+		qCmd.data = allocCommandData(&scene->uniformCommands);
+
+		if (!qCmd.data) {
+			printf("Failed to allocate space for command qMeshBindTexture\n");
+			return -1;
+		}
 
-	selTex->boundMeshes[selTex->boundMeshCount] = cmd.meshId;
-	selTex->boundPasses[selTex->boundMeshCount] = cmd.target;
-	++selTex->boundMeshCount;
+		QCmdMeshBindTexture qCmdData = {0};
+		qCmdData.meshId = cmd.meshId;
+		qCmdData.view = DENSE_AT(Texture, scene->textures, texIdx).view;
+		qCmdData.sampler = DENSE_AT(Texture, scene->textures, texIdx).sampler;
+		qCmdData.pass = cmd.target;
+		*(QCmdMeshBindTexture*)qCmd.data = qCmdData;
 
-	if (selTex->boundMeshCount >= selTex->boundMeshLimit) {
-		selTex->boundMeshLimit *= 2;
-		selTex->boundMeshes = (int*)realloc(
-			selTex->boundMeshes,
-			sizeof(int) * selTex->boundMeshLimit
-		);
-		selTex->boundPasses = (int*)realloc(
-			selTex->boundPasses,
-			sizeof(int) * selTex->boundMeshLimit
-		);
+		pushCommandToQueue(&scene->uniformCommands, qCmd);
 	}
 
-	return 0;
+	return addTextureBinding(
+		scene,
+		&DENSE_AT(Texture, scene->textures, texIdx),
+		cmd.meshId,
+		cmd.target
+	);
 }
 
-int cmdMeshTransform(Scene* scene, Display display)
+int cmdMeshTransform(Scene* scene, Display* display)
 {
 	IgniRndCmdMeshTransform cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
 
-	int meshIdx = findId(scene->meshIds, scene->meshCount, cmd.meshId);
+	int meshIdx = denseFind(&scene->meshes, cmd.meshId);
 
 	if (meshIdx == -1) {
-		printf("mesh not found.\n");
-		return -1;
+		return missingElement(&scene->refusedMeshes, cmd.meshId, "mesh");
 	}
 
 	float transform[4][4] = FILL_MAT4(0.0f);
@@ -585,104 +1044,173 @@ int cmdMeshTransform(Scene* scene, Display display)
 	rotate3d(transform, cmd.xRot, cmd.yRot, cmd.zRot);
 
 
+	Mesh* mesh = &DENSE_AT(Mesh, scene->meshes, meshIdx);
+
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		memcpy(
-			scene->meshes[meshIdx].uboMapped[i],
-			transform,
-			sizeof(transform)
-		);
+		memcpy(mesh->uboMapped[i], transform, sizeof(transform));
 	}
 
+	memcpy(mesh->tform, transform, sizeof(transform));
+	mesh->moved = 1;
+
 	return 0;
 }
 
-int cmdMeshDelete(Scene* scene, Display display)
+int cmdMeshDelete(Scene* scene, Display* display)
 {
 	IgniRndCmdMeshDelete cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
 
-	int meshIdx = findId(scene->meshIds, scene->meshCount, cmd.meshId);
+	int meshIdx = denseFind(&scene->meshes, cmd.meshId);
 
 	if (meshIdx == -1) {
-		printf("mesh not found.\n");
-		return -1;
+		const int result = missingElement(
+			&scene->refusedMeshes,
+			cmd.meshId,
+			"mesh"
+		);
+
+		idMapRemove(&scene->refusedMeshes, cmd.meshId);
+		return result;
 	}
 
-	destroyMesh(display.dev.device, scene->meshes[meshIdx]);
+	if (addShadowRemoval(
+		&display->shadows.cache,
+		&DENSE_AT(Mesh, scene->meshes, meshIdx)
+	)) {
+		return -1;
+	}
 
-	scene->meshCount--;
-	
-	memcpy(
-		&scene->meshes[meshIdx],
-		&scene->meshes[meshIdx + 1],
-		(scene->meshCount - meshIdx) * sizeof(Scene)
+	const int texIdx = denseFind(
+		&scene->textures,
+		DENSE_AT(Mesh, scene->meshes, meshIdx).texId
 	);
 
-	/* Allocate less space if too much is allocated */
-	while (scene->meshCount < scene->meshLimit / 2) {
-		scene->meshLimit /= 2;
-		scene->meshes = 
-			(Mesh*)realloc(scene->meshes, sizeof(Mesh) * scene->meshLimit);
+	if (texIdx != -1) {
+		removeTextureBinding(
+			scene,
+			&DENSE_AT(Texture, scene->textures, texIdx),
+			cmd.meshId
+		);
+	}
+
+	destroyMesh(&display->garbage, DENSE_AT(Mesh, scene->meshes, meshIdx));
 
-		if (!scene->meshes) {
-			perror("Failed to reallocate meshes");
-			return -1;
-		}
+	/* Draw order doesn't matter, so the last mesh can fill the hole. */
+	if (denseRemove(&scene->meshes, meshIdx)) {
+		return -1;
 	}
 
+	++scene->generation;
+
 	return 0;
 }
 
-int cmdPointLightCreate(Scene* scene, Display display)
+/* New lights are white, at the origin and at full intensity until they're
+ * told otherwise. */
+int cmdPointLightCreate(Scene* scene, Display* display)
 {
 	IgniRndCmdPointLightCreate cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
 
+	if (denseFind(&scene->pointLights, cmd.lightId) != -1) {
+		printf("Light ID %i already exists.\n", cmd.lightId);
+		return -1;
+	}
+
+	PointLight light = {};
+	light.r = 1.0f;
+	light.g = 1.0f;
+	light.b = 1.0f;
+	light.intensity = 1.0f;
+	light.distance = pointLightRange(light.intensity);
+	light.shadowTile = -1;
+	light.staticDirty = 1;
+	light.dirty = 1;
+
+	if (denseAdd(&scene->pointLights, cmd.lightId, &light) == -1) {
+		printf("Failed to add light to scene\n");
+		return -1;
+	}
+
 	return 0;
 }
 
-int cmdPointLightTransform(Scene* scene, Display display)
+int cmdPointLightTransform(Scene* scene, Display* display)
 {
 	IgniRndCmdPointLightTransform cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
 
+	int lightIdx = denseFind(&scene->pointLights, cmd.lightId);
+
+	if (lightIdx == -1) {
+		printf("light not found.\n");
+		return -1;
+	}
+
+	PointLight* light = &DENSE_AT(PointLight, scene->pointLights, lightIdx);
+	light->x = cmd.xLoc;
+	light->y = cmd.yLoc;
+	light->z = cmd.zLoc;
+	light->staticDirty = 1;
+	light->dirty = 1;
+
 	return 0;
 }
 
-int cmdPointLightSetColour(Scene* scene, Display display)
+/* How far the light reaches goes with its intensity, so it's worked out
+ * here rather than every frame. */
+int cmdPointLightSetColour(Scene* scene, Display* display)
 {
 	IgniRndCmdPointLightSetColour cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
 
-	return 0;
-}
+	int lightIdx = denseFind(&scene->pointLights, cmd.lightId);
 
-int cmdPointLightDelete(Scene* scene, Display display)
-{
-	IgniRndCmdPointLightDelete cmd;
-	recv(scene->fd, &cmd, sizeof(cmd), 0);
+	if (lightIdx == -1) {
+		printf("light not found.\n");
+		return -1;
+	}
+
+	PointLight* light = &DENSE_AT(PointLight, scene->pointLights, lightIdx);
+	light->r = cmd.r;
+	light->g = cmd.g;
+	light->b = cmd.b;
+	light->intensity = cmd.intensity;
+	light->distance = pointLightRange(cmd.intensity);
+
+	/* The range is where the shadows' projections end. */
+	light->staticDirty = 1;
+	light->dirty = 1;
 
 	return 0;
 }
 
-int cmdTextureCreate(Scene* scene, Display display)
+/* Lights only live on the CPU until they're written into a frame, so there's
+ * nothing for the garbage queue. */
+int cmdPointLightDelete(Scene* scene, Display* display)
 {
-	IgniRndCmdTextureCreate cmd;
+	IgniRndCmdPointLightDelete cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
 
-	char* path = malloc(cmd.pathLen + 1);
-	recv(scene->fd, path, cmd.pathLen, 0);
+	int lightIdx = denseFind(&scene->pointLights, cmd.lightId);
 
-	if (!path) {
-		printf("Failed to allocate memory for filename\n");
+	if (lightIdx == -1) {
+		printf("light not found.\n");
 		return -1;
 	}
 
-	path[cmd.pathLen] = 0;
+	if (denseRemove(&scene->pointLights, lightIdx)) {
+		return -1;
+	}
 
-	/* Read image data */
+	return 0;
+}
 
-	Texture newTexture;
+/* Reads an image file into the texture's device memory. Used when textures
+ * are created and when evicted textures are brought back. */
+int loadTextureImage(Texture* tex, const char* path, Display* display)
+{
 	stbi_uc* pixels;
 	int texDepth;
 
@@ -690,132 +1218,249 @@ int cmdTextureCreate(Scene* scene, Display display)
 	 * RGB sometimes isn't even available. It's all because 4 colour channels 
 	 * are easier to align than 3. */
 	pixels = stbi_load(path,
-		&newTexture.width,
-		&newTexture.height,
+		&tex->width,
+		&tex->height,
 		&texDepth,
 		STBI_rgb_alpha
 	);
 
-	free(path);
-
 	if (!pixels) {
 		printf("Failed to load image.\n");
 		return -1; 
 	}
 
+	/* A failure is most likely the device running out of memory. Unused
+	 * textures can make room for a second go. */
+	for (int attempt = 0; createTextureImage(
+		tex,
+		display->dev.device,
+		display->physicalDevice
+	); attempt++) {
+		if (attempt || reclaimDeviceMemory(
+			display,
+			(VkDeviceSize)tex->width * tex->height * 4 / 3 * 4
+		)) {
+			stbi_image_free(pixels);
+			return -1;
+		}
+	}
+
+	budgetCharge(&display->budget, tex->memSize);
+
+	if (writeTexture(
+		tex,
+		pixels,
+		display->dev.device,
+		display->physicalDevice,
+		display->cmd,
+		display->dev.graphicsQueue
+	)) {
+		stbi_image_free(pixels);
+		evictTexture(&display->garbage, tex);
+		return -1;
+	}
+
+	stbi_image_free(pixels);
+
+	return 0;
+}
+
+/* Evicted textures keep their table slot, so only the descriptor needs to
+ * point at the new image. */
+int reloadTexture(Texture* tex, Display* display)
+{
+	if (loadTextureImage(tex, tex->path, display)) {
+		printf("Failed to reload texture (%s).\n", tex->path);
+		return -1;
+	}
+
+	if (display->bindless) {
+		texTableWrite(
+			&display->texTable,
+			display->dev.device,
+			tex->tableSlot,
+			tex->view
+		);
+	}
+
+	return 0;
+}
+
+int cmdTextureCreate(Scene* scene, Display* display)
+{
+	IgniRndCmdTextureCreate cmd;
+	recv(scene->fd, &cmd, sizeof(cmd), 0);
+
+	char* path = malloc(cmd.pathLen + 1);
+	recv(scene->fd, path, cmd.pathLen, 0);
+
+	if (!path) {
+		printf("Failed to allocate memory for filename\n");
+		return -1;
+	}
+
+	path[cmd.pathLen] = 0;
+
 	/* Don't create a texture with an already existing ID. */
-	if (findId(scene->textureIds, scene->texCount, cmd.textureId) != -1) {
+	if (denseFind(&scene->textures, cmd.textureId) != -1) {
 		printf("Texture ID %i already exists.\n", cmd.textureId);
+		free(path);
 		return -1;
 	}
 
-	if (createTexture(
-		&newTexture, 
-		display.dev.device,
-		display.physicalDevice
+	/* Only the header gets read here. A third on top covers the mip
+	 * levels. */
+	int width, height, channels;
+
+	if (stbi_info(path, &width, &height, &channels) && checkSceneQuota(
+		scene,
+		display,
+		(VkDeviceSize)width * height * 4 / 3 * 4
 	)) {
+		free(path);
+		return idMapSet(&scene->refusedTextures, cmd.textureId, 0);
+	}
+
+	/* Read image data */
+
+	Texture newTexture = {};
+
+	if (loadTextureImage(&newTexture, path, display)) {
+		free(path);
 		return -1;
 	}
 
-	if (writeTexture(
-		&newTexture,
-		pixels,
-		display.dev.device,
-		display.physicalDevice,
-		display.cmd,
-		display.dev.graphicsQueue
+	if (getSampler(
+		&display->samplers,
+		display->dev.device,
+		defSamplerKey,
+		&newTexture.sampler
 	)) {
-		stbi_image_free(pixels);
+		free(path);
+		destroyTexture(&display->garbage, newTexture);
 		return -1;
 	}
 
-	stbi_image_free(pixels);
-
-	/* Once the texture is successfully set up, it is ready for the scene. */
+	/* The path is kept for reloading the texture after eviction. */
+	newTexture.path = path;
+	newTexture.lastUsed = display->frameCount;
 
-	if (scene->texCount >= scene->texLimit) {
-		scene->texLimit *= 2;
-		scene->textures = (Texture*)
-			realloc(scene->textures, sizeof(Texture) * scene->texLimit);
+	newTexture.bindings = 0;
 
-		scene->textureIds = (int*)
-			realloc(scene->textureIds,sizeof(int) * scene->texLimit);
+	if (display->bindless && texTableAdd(
+		&display->texTable,
+		display->dev.device,
+		newTexture.view,
+		&newTexture.tableSlot
+	)) {
+		destroyTexture(&display->garbage, newTexture);
+		return -1;
 	}
 
-	scene->textures[scene->texCount] = newTexture;
-	scene->textureIds[scene->texCount] = cmd.textureId;
+	/* Once the texture is successfully set up, it is ready for the scene. */
+
+	if (denseAdd(&scene->textures, cmd.textureId, &newTexture) == -1) {
+		printf("Failed to add texture to scene\n");
+		destroyTexture(&display->garbage, newTexture);
+		return -1;
+	}
 
-	++scene->texCount;
+	idMapRemove(&scene->refusedTextures, cmd.textureId);
 
 	return 0;
 }
 
-int cmdTextureDelete(Scene* scene, Display display)
+int cmdTextureDelete(Scene* scene, Display* display)
 {
 	IgniRndCmdTextureDelete cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
 
-	int texIdx = findId(scene->textureIds, scene->texCount, cmd.textureId);
+	int texIdx = denseFind(&scene->textures, cmd.textureId);
 
 	if (texIdx == -1) {
-		printf("texture not found.\n");
-		return -1;
+		const int result = missingElement(
+			&scene->refusedTextures,
+			cmd.textureId,
+			"texture"
+		);
+
+		idMapRemove(&scene->refusedTextures, cmd.textureId);
+		return result;
 	}
 
 	/* If a mesh has this texture bound, the GPU will freeze up mid render. */
 
-	QueueCommand qCmd = {};
-	qCmd.opcode = QUEUE_CMD_MESH_BIND_TEXTURE;
-	qCmd.repeats = MAX_FRAMES_IN_FLIGHT;
+	const Texture tex = DENSE_AT(Texture, scene->textures, texIdx);
 
-	QCmdMeshBindTexture qCmdData = {0};
+	if (display->bindless) {
+		/* Meshes still pointing at the slot go back to the null texture.
+		 * Some may have been rebound to something else since. */
+		for (
+			TextureBinding* binding = tex.bindings;
+			binding;
+			binding = binding->next
+		) {
+			int meshIdx = denseFind(&scene->meshes, binding->meshId);
 
-	for (int i = 0; i < scene->textures[texIdx].boundMeshCount; ++i) {
-		qCmd.data = malloc(sizeof(QCmdMeshBindTexture));
+			if (meshIdx == -1) continue;
 
-		if (!qCmd.data) {
-			printf("Failed to allocate space for command qMeshBindTexture\n\
-	reverse causality\n");
-			return -1;
+			Mesh* mesh = &DENSE_AT(Mesh, scene->meshes, meshIdx);
+
+			if (mesh->texIndex == tex.tableSlot) {
+				mesh->texIndex = TEX_TABLE_NUL_SLOT;
+			}
 		}
+	} else {
+		QueueCommand qCmd = {};
+		qCmd.opcode = QUEUE_CMD_MESH_BIND_TEXTURE;
+		qCmd.repeats = MAX_FRAMES_IN_FLIGHT;
+
+		QCmdMeshBindTexture qCmdData = {0};
+
+		for (
+			TextureBinding* binding = tex.bindings;
+			binding;
+			binding = binding->next
+		) {
+			qCmd.data = allocCommandData(&scene->uniformCommands);
+
+			if (!qCmd.data) {
+				printf("Failed to allocate space for command qMeshBindTexture\n\
+	reverse causality\n");
+				return -1;
+			}
 
-		qCmdData.meshId = scene->textures[texIdx].boundMeshes[i];
-		qCmdData.view = display.nulTexture.view;
-		qCmdData.sampler = display.nulTexture.sampler;
-		qCmdData.pass = scene->textures[texIdx].boundPasses[i];
-		*(QCmdMeshBindTexture*)qCmd.data = qCmdData;
+			qCmdData.meshId = binding->meshId;
+			qCmdData.view = display->nulTexture.view;
+			qCmdData.sampler = display->nulTexture.sampler;
+			qCmdData.pass = binding->pass;
+			*(QCmdMeshBindTexture*)qCmd.data = qCmdData;
 
-		pushCommandToQueue(&scene->uniformCommands, qCmd);
+			pushCommandToQueue(&scene->uniformCommands, qCmd);
+		}
 	}
 
-	
-	destroyTexture(display.dev.device, scene->textures[texIdx]);
-
-	scene->texCount--;
-	
-	memcpy(
-		&scene->textures[texIdx],
-		&scene->textures[texIdx + 1],
-		(scene->texCount - texIdx) * sizeof(Scene)
+	freeTextureBindings(
+		scene,
+		&DENSE_AT(Texture, scene->textures, texIdx)
 	);
 
-	/* Allocate less space if too much is allocated */
-	while (scene->texCount < scene->texLimit / 2) {
-		scene->texLimit /= 2;
-		scene->textures = (Texture*)
-			realloc(scene->textures, sizeof(Texture) * scene->texLimit);
+	/* The table slot goes back along with the rest of the texture, once no
+	 * frame in flight can be reading it. */
+	destroyTexture(&display->garbage, tex);
+	++scene->generation;
 
-		if (!scene->textures) {
-			perror("Failed to reallocate textures");
-			return -1;
-		}
+	/* Meshes refer to textures by ID, never by index, so textures can be
+	 * moved around too. */
+	if (denseRemove(&scene->textures, texIdx)) {
+		return -1;
 	}
 
 	return 0;
 
 }
 
-int cmdViewpointTransform(Scene* scene, Display display)
+int cmdViewpointTransform(Scene* scene, Display* display)
 {
 	IgniRndCmdViewpointTransform cmd;
 	recv(scene->fd, &cmd, sizeof(cmd), 0);
@@ -831,19 +1476,23 @@ int cmdViewpointTransform(Scene* scene, Display display)
 	centre.z = cmd.zLook;
 	up.z = 1.0f;
 
-	display.pov.fov = cmd.fov;
+	display->pov.fov = cmd.fov;
 	ubo.view = matLook(eye, centre, up);
 	ubo.proj = matPersp(
-		display.pov.fov,
-		(float)display.swapchain.extent.width
-		/ (float)display.swapchain.extent.height,
+		display->pov.fov,
+		(float)display->swapchain.extent.width
+		/ (float)display->swapchain.extent.height,
 		0.1f,
 		10.0f
 	);
 
+	display->pov.eye = eye;
+	display->pov.projScale = fabsf(ubo.proj.y.y);
+	display->pov.uniforms = ubo;
+
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		memcpy(
-			display.pov.uboMapped[i],
+			display->pov.uboMapped[i],
 			&ubo,
 			sizeof(ViewpointUniforms)
 		);
@@ -854,19 +1503,32 @@ int cmdViewpointTransform(Scene* scene, Display display)
 
 int execUniformCommands(Scene* scene, Display* display)
 {
-	for (int i = 0; i < scene->uniformCommands.commandCount; i++) {
+	CommandQueue* queue = &scene->uniformCommands;
+	unsigned int keptCount = 0;
+
+	/* Commands that are done get dropped and the rest slide down over them
+	 * in the same pass. Unlike scene elements, the order has to stay, since
+	 * the last bind to a mesh is the one that should stick. */
+	for (int i = 0; i < queue->commandCount; i++) {
+		QueueCommand cmd = queue->commands[i];
+
 		/* A command with 0 repeats is removed from the command queue 
 		 * and skipped. */
-		if (!scene->uniformCommands.commands[i].repeats) {
-			unqueueCommand(&scene->uniformCommands, i);
+		if (!cmd.repeats) {
+			freeCommandData(queue, cmd.data);
 			continue;
 		}
 
-		scene->uniformCommands.commands[i].repeats--;
+		cmd.repeats--;
 	
-		execUboCommand(display, scene, &scene->uniformCommands.commands[i]);
+		execUboCommand(display, scene, &cmd);
+
+		queue->commands[keptCount] = cmd;
+		++keptCount;
 	}
 
+	queue->commandCount = keptCount;
+
 	return 0;
 }
 
@@ -882,22 +1544,16 @@ int execUboCommand(Display* display, Scene* scene, QueueCommand* cmd)
 	return 0;
 }
 
+/* Only rewrites the current frame's descriptor set, which the main loop has
+ * waited to be out of use. The command repeats for every frame in flight, so
+ * each copy gets its turn without stalling on the others. */
 int qMeshBindTexture(
 	Display* display,
 	Scene* scene,
 	QCmdMeshBindTexture* cmd
 )
 {
-	/* Wait for frame */
-	vkWaitForFences(
-		display->dev.device,
-		1,
-		&display->geomSync[display->currentFrame].inFlight,
-		VK_TRUE,
-		UINT64_MAX
-	);
-
-	int meshIdx = findId(scene->meshIds, scene->meshCount, cmd->meshId);
+	int meshIdx = denseFind(&scene->meshes, cmd->meshId);
 
 	if (meshIdx == -1) {
 		printf("Failed to find mesh.\n");
@@ -911,8 +1567,8 @@ int qMeshBindTexture(
 
 	VkWriteDescriptorSet writeDesc = {};
 	writeDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	writeDesc.dstSet =
-		scene->meshes[meshIdx].descriptorSets[display->currentFrame];
+	writeDesc.dstSet = DENSE_AT(Mesh, scene->meshes, meshIdx)
+		.descriptorSets[display->currentFrame];
 	writeDesc.dstBinding = 1;
 	writeDesc.dstArrayElement = 0;
 	writeDesc.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -921,6 +1577,73 @@ int qMeshBindTexture(
 
 	vkUpdateDescriptorSets(display->dev.device, 1, &writeDesc, 0, 0);
 
+	/* Command buffers the set was bound in are invalid after a write. */
+	++scene->generation;
+
+	return 0;
+}
+
+/* Sends the scene's stats back to the client */
+int cmdServerStats(Scene* scene, Display* display)
+{
+	SceneStats stats;
+	getSceneStats(scene, &stats);
+
+	if (send(scene->fd, &stats, sizeof(stats), 0) == -1) {
+		perror("Failed to send scene stats");
+		return -1;
+	}
+
 	return 0;
 }
 
+/* Scenes can trade detail for speed. Each step of bias doubles the screen
+ * space error allowed. */
+int cmdSceneLodBias(Scene* scene, Display* display)
+{
+	IgniRndCmdSceneLodBias cmd;
+	recv(scene->fd, &cmd, sizeof(cmd), 0);
+
+	if (!isfinite(cmd.bias)) {
+		printf("Invalid LOD bias.\n");
+		return -1;
+	}
+
+	scene->lodBias = cmd.bias;
+
+	return 0;
+}
+
+/* Scenes over their quota get their create commands refused. The client
+ * stays connected, it just doesn't get the mesh or texture. */
+int checkSceneQuota(Scene* scene, Display* display, VkDeviceSize size)
+{
+	const VkDeviceSize quota = display->budget.sceneQuota;
+
+	if (!quota) return 0;
+
+	const uint64_t used = sceneDeviceBytes(scene);
+
+	if (used + size > quota) {
+		printf(
+			"Scene (fd %i) over quota: %llu KiB used, %llu KiB requested.\n",
+			scene->fd,
+			(unsigned long long)(used >> 10),
+			(unsigned long long)(size >> 10)
+		);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* For commands naming an element that isn't in the scene. The client can't
+ * tell a create was refused over quota, so commands for those are dropped
+ * quietly. Anything else closes the scene. */
+int missingElement(const IdMap* refused, int id, const char* name)
+{
+	if (idMapFind(refused, id) != -1) return 0;
+
+	printf("%s not found.\n", name);
+	return -1;
+}
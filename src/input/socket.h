@@ -4,25 +4,67 @@
 #include "render/scene.h"
 #include "render/display.h"
 
+/* Not part of libigni's protocol yet. Its opcodes count up from 0, so this one
+ * sits at the other end of the range. The reply is a SceneStats. */
+#define IGNI_RENDER_OP_SERVER_STATS 0xff
+
+/* Also not in libigni. Sets the scene's lodBias. */
+#define IGNI_RENDER_OP_SCENE_LOD_BIAS 0xfe
+
+typedef struct
+{
+	float bias;
+} IgniRndCmdSceneLodBias;
+
 int createSocket(const char* path);
 
-int executeCmd(SceneArray* scenes, Display display, unsigned int idx);
+int executeCmd(SceneArray* scenes, Display* display, unsigned int idx);
+
+int cmdConfigure(Scene* scene, Display* display);
+
+int cmdMeshCreate(Scene* scene, Display* display);
+int createMeshBuffers(
+	Mesh* mesh,
+	Display* display,
+	const void* vertexData,
+	unsigned int vertexCount,
+	VkDeviceSize vertexBufferSz,
+	const void* indexData,
+	char indexSize
+);
+int createMeshletBuffers(
+	Mesh* mesh,
+	Display* display,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices
+);
+void freeMeshData(
+	Vertex* vertices,
+	uint32_t* indices,
+	void* vertexData,
+	void* indexData
+);
+int cmdMeshSetShader(Scene* scene, Display* display);
+int cmdMeshBindTexture(Scene* scene, Display* display);
+int cmdMeshTransform(Scene* scene, Display* display);
+int cmdMeshDelete(Scene* scene, Display* display);
 
-int cmdConfigure(Scene* scene, Display display);
+int cmdPointLightCreate(Scene* scene, Display* display);
+int cmdPointLightTransform(Scene* scene, Display* display);
+int cmdPointLightSetColour(Scene* scene, Display* display);
+int cmdPointLightDelete(Scene* scene, Display* display);
+int cmdTextureCreate(Scene* scene, Display* display);
+int cmdTextureDelete(Scene* scene, Display* display);
+int cmdViewpointTransform(Scene* scene, Display* display);
+int cmdServerStats(Scene* scene, Display* display);
+int cmdSceneLodBias(Scene* scene, Display* display);
 
-int cmdMeshCreate(Scene* scene, Display display);
-int cmdMeshSetShader(Scene* scene, Display display);
-int cmdMeshBindTexture(Scene* scene, Display display);
-int cmdMeshTransform(Scene* scene, Display display);
-int cmdMeshDelete(Scene* scene, Display display);
+int checkSceneQuota(Scene* scene, Display* display, VkDeviceSize size);
+int missingElement(const IdMap* refused, int id, const char* name);
 
-int cmdPointLightCreate(Scene* scene, Display display);
-int cmdPointLightTransform(Scene* scene, Display display);
-int cmdPointLightSetColour(Scene* scene, Display display);
-int cmdPointLightDelete(Scene* scene, Display display);
-int cmdTextureCreate(Scene* scene, Display display);
-int cmdTextureDelete(Scene* scene, Display display);
-int cmdViewpointTransform(Scene* scene, Display display);
+int loadTextureImage(Texture* tex, const char* path, Display* display);
+int reloadTexture(Texture* tex, Display* display);
 
 int execUniformCommands(Scene* scene, Display* display);
 int execUboCommand(Display* display, Scene* scene, QueueCommand* cmd);
@@ -10,9 +10,19 @@
 #include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
+#include <signal.h>
 
 #define FPS_CAP 60
 
+/* Set by SIGUSR1. The stats get printed from the main loop since printf()
+ * isn't safe in a signal handler. */
+volatile sig_atomic_t statsRequested = 0;
+
+void requestStats(int sig)
+{
+	statsRequested = 1;
+}
+
 int main(int argc, char* argv[], char* envp[])
 {
 	int srvFd = createSocket(getenv("IGNI_RENDER_SRV"));
@@ -54,6 +64,16 @@ int main(int argc, char* argv[], char* envp[])
 	/* Scene Array */	
 	SceneArray scenes;
 	if (createSceneArray(&scenes) == -1) exit(EXIT_FAILURE);
+	display.scenes = &scenes;
+
+	/* kill -USR1 dumps every scene's stats */
+	struct sigaction statsAction = {};
+	statsAction.sa_handler = requestStats;
+	sigemptyset(&statsAction.sa_mask);
+
+	if (sigaction(SIGUSR1, &statsAction, 0) == -1) {
+		perror("Failed to set SIGUSR1 handler");
+	}
 
 	/* In windowed mode, the display server refreshes at a constant rate
 	 * to detect window closing and resizing. */
@@ -78,8 +98,11 @@ int main(int argc, char* argv[], char* envp[])
 			display.currentFrame = 
 				++display.currentFrame % MAX_FRAMES_IN_FLIGHT;
 
-			for (int i = scenes.sceneCount - 1; i != -1; --i) {
-				execUniformCommands(&scenes.scenes[i], &display);
+			/* Uniform commands write this frame's descriptor sets. */
+			waitForFrame(&display);
+
+			for (int i = scenes.count - 1; i != -1; --i) {
+				execUniformCommands(&DENSE_AT(Scene, scenes, i), &display);
 			}
 
 			shouldClose = renderScenes(&display, scenes);
@@ -89,12 +112,11 @@ int main(int argc, char* argv[], char* envp[])
 		FD_SET(srvFd, &readFds);
 
 		maxFd = srvFd;
-		for (int i = 0; i < scenes.sceneCount; i++) {
-			FD_SET(scenes.scenes[i].fd, &readFds);
+		for (int i = 0; i < scenes.count; i++) {
+			const int fd = DENSE_AT(Scene, scenes, i).fd;
 
-			if (scenes.scenes[i].fd > maxFd) {
-				maxFd = scenes.scenes[i].fd;
-			}
+			FD_SET(fd, &readFds);
+			if (fd > maxFd) maxFd = fd;
 		}
 
 		activity = select(maxFd + 1, &readFds, 0, 0, &idleFrameTime);
@@ -102,6 +124,24 @@ int main(int argc, char* argv[], char* envp[])
 			perror("Socket select failed");
 		}
 
+		/* The fd set can't be trusted after a failed select(), which
+		 * SIGUSR1 now causes. */
+		if (activity == -1) FD_ZERO(&readFds);
+
+		if (statsRequested) {
+			statsRequested = 0;
+
+			printf("%u scene(s)\n", scenes.count);
+			for (int i = 0; i < scenes.count; i++) {
+				printSceneStats(&DENSE_AT(Scene, scenes, i));
+			}
+
+			printDrawStats(&display);
+
+			printLightStats(&display.lights);
+			printShadowStats(&display.shadows);
+		}
+
 		/* Activity on the server socket means a new connection */
 		if (FD_ISSET(srvFd, &readFds)) {
 			/* Throwaway variables for accept() */
@@ -124,15 +164,15 @@ int main(int argc, char* argv[], char* envp[])
 		 *
 		 * In addition, it gives the early connections priority over the
 		 * camera. */
-		for (int i = scenes.sceneCount - 1; i != -1; --i) {
-			if (FD_ISSET(scenes.scenes[i].fd, &readFds)) {
-				executeCmd(&scenes, display, i);
+		for (int i = scenes.count - 1; i != -1; --i) {
+			if (FD_ISSET(DENSE_AT(Scene, scenes, i).fd, &readFds)) {
+				executeCmd(&scenes, &display, i);
 			}
 		}
 	}
 
 	vkDeviceWaitIdle(display.dev.device);
-	destroySceneArray(display.dev.device, scenes);
+	destroySceneArray(&display.garbage, scenes);
 	destroyRenderPasses(display);
 	destroyDisplay(display);
 
@@ -1,6 +1,7 @@
 #ifndef MAIN_H
 #define MAIN_H 1
 
+void requestStats(int sig);
 int main(int argc, char* argv[], char* envp[]);
 
 #endif // MAIN_H
@@ -0,0 +1,117 @@
+#include "budget.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int createMemoryBudget(
+	MemoryBudget* budget,
+	VkPhysicalDevice physDev,
+	char hasBudgetExt
+)
+{
+	budget->hasBudgetExt = hasBudgetExt;
+	budget->deviceLocalHeaps = 0;
+	budget->limit = 0;
+	budget->ledger = 0;
+	budget->evictFrames = BUDGET_DEFAULT_EVICT_FRAMES;
+	budget->sceneQuota = 0;
+
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physDev, &memProperties);
+
+	VkDeviceSize localSize = 0;
+
+	for (int i = 0; i < memProperties.memoryHeapCount; i++) {
+		if (
+			memProperties.memoryHeaps[i].flags
+			& VK_MEMORY_HEAP_DEVICE_LOCAL_BIT
+		) {
+			budget->deviceLocalHeaps |= 1 << i;
+			localSize += memProperties.memoryHeaps[i].size;
+		}
+	}
+
+	/* Without the extension, the ledger is all there is to go on. It doesn't
+	 * know about framebuffers or anything other processes have allocated,
+	 * so leave some room. */
+	if (!hasBudgetExt) {
+		budget->limit = localSize / 100 * BUDGET_DEFAULT_HEAP_PERCENT;
+	}
+
+	const char* budgetEnv = getenv("IGNI_RENDER_VRAM_BUDGET");
+
+	if (budgetEnv) {
+		budget->limit = (VkDeviceSize)strtoull(budgetEnv, 0, 10) << 20;
+	}
+
+	const char* evictEnv = getenv("IGNI_RENDER_EVICT_FRAMES");
+
+	if (evictEnv) {
+		budget->evictFrames = strtoull(evictEnv, 0, 10);
+	}
+
+	const char* quotaEnv = getenv("IGNI_RENDER_SCENE_QUOTA");
+
+	if (quotaEnv) {
+		budget->sceneQuota = (VkDeviceSize)strtoull(quotaEnv, 0, 10) << 20;
+	}
+
+	printf(
+		"Memory budget: %llu MiB (%s)\n",
+		(unsigned long long)(budget->limit >> 20),
+		hasBudgetExt ? "VK_EXT_memory_budget" : "ledger"
+	);
+
+	return 0;
+}
+
+void budgetCharge(MemoryBudget* budget, VkDeviceSize size)
+{
+	budget->ledger += size;
+}
+
+void budgetRelease(MemoryBudget* budget, VkDeviceSize size)
+{
+	budget->ledger -= size > budget->ledger ? budget->ledger : size;
+}
+
+VkDeviceSize budgetOverrun(
+	MemoryBudget* budget,
+	VkPhysicalDevice physDev,
+	VkDeviceSize pending
+)
+{
+	VkDeviceSize usage = budget->ledger;
+	VkDeviceSize limit = budget->limit;
+
+	if (budget->hasBudgetExt) {
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT heapBudgets = {};
+		heapBudgets.sType =
+			VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memProperties = {};
+		memProperties.sType =
+			VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memProperties.pNext = &heapBudgets;
+
+		vkGetPhysicalDeviceMemoryProperties2(physDev, &memProperties);
+
+		VkDeviceSize heapUsage = 0;
+		VkDeviceSize heapBudget = 0;
+
+		for (int i = 0; i < VK_MAX_MEMORY_HEAPS; i++) {
+			if (!(budget->deviceLocalHeaps & (1 << i))) continue;
+
+			heapUsage += heapBudgets.heapUsage[i];
+			heapBudget += heapBudgets.heapBudget[i];
+		}
+
+		/* The driver's budget already accounts for other processes. A
+		 * configured budget can only make it tighter. */
+		usage = heapUsage;
+		if (!limit || heapBudget < limit) limit = heapBudget;
+	}
+
+	usage -= pending > usage ? usage : pending;
+
+	return usage > limit ? usage - limit : 0;
+}
@@ -0,0 +1,60 @@
+#ifndef RENDER_BUDGET_H
+#define RENDER_BUDGET_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/* Textures that haven't been bound to anything for this many frames can be
+ * evicted when the server runs over its budget. */
+#define BUDGET_DEFAULT_EVICT_FRAMES 300
+
+/* Without a configured budget or VK_EXT_memory_budget, this much of the
+ * device's local memory is used before textures start getting evicted. */
+#define BUDGET_DEFAULT_HEAP_PERCENT 80
+
+/* Device memory budgeting. With VK_EXT_memory_budget, the driver says how much
+ * is in use and how much is left. Without it, the server keeps its own ledger
+ * of what textures and meshes have allocated.
+ *
+ * IGNI_RENDER_VRAM_BUDGET caps the budget in MiB either way.
+ * IGNI_RENDER_EVICT_FRAMES overrides BUDGET_DEFAULT_EVICT_FRAMES.
+ * IGNI_RENDER_SCENE_QUOTA caps the device memory of each scene in MiB. */
+typedef struct
+{
+	char hasBudgetExt;
+
+	/* Heaps that count towards the budget */
+	uint32_t deviceLocalHeaps;
+
+	/* Set by IGNI_RENDER_VRAM_BUDGET or worked out from the heap sizes. 0
+	 * means it's left up to VK_EXT_memory_budget. */
+	VkDeviceSize limit;
+
+	/* Device local memory held by textures and meshes, including memory
+	 * still waiting in the garbage queue */
+	VkDeviceSize ledger;
+
+	uint64_t evictFrames;
+
+	/* 0 for no quota */
+	VkDeviceSize sceneQuota;
+} MemoryBudget;
+
+int createMemoryBudget(
+	MemoryBudget* budget,
+	VkPhysicalDevice physDev,
+	char hasBudgetExt
+);
+
+void budgetCharge(MemoryBudget* budget, VkDeviceSize size);
+void budgetRelease(MemoryBudget* budget, VkDeviceSize size);
+
+/* How far over budget the server is. pending is memory already thrown away
+ * that hasn't been freed yet. */
+VkDeviceSize budgetOverrun(
+	MemoryBudget* budget,
+	VkPhysicalDevice physDev,
+	VkDeviceSize pending
+);
+
+#endif
@@ -0,0 +1,175 @@
+#include "cluster.h"
+#include "frustum.h"
+#include <math.h>
+
+/* Read back out of the projection, as cluster.comp's viewZ() does at depths
+ * 0 and 1 */
+ClusterDepth clusterDepth(const ViewpointUniforms* pov)
+{
+	ClusterDepth depth;
+	depth.near = pov->proj.w.z / pov->proj.z.z;
+	depth.far = pov->proj.w.z / (1.0f + pov->proj.z.z);
+
+	return depth;
+}
+
+/* View space box around the cluster, as cluster.comp works it out */
+void clusterBox(
+	float* boxMin,
+	float* boxMax,
+	uint32_t cluster,
+	const ViewpointUniforms* pov
+)
+{
+	const uint32_t cell[3] = {
+		cluster % CLUSTER_X,
+		cluster / CLUSTER_X % CLUSTER_Y,
+		cluster / (CLUSTER_X * CLUSTER_Y)
+	};
+	const uint32_t cells[2] = {CLUSTER_X, CLUSTER_Y};
+	const float scale[2] = {pov->proj.x.x, pov->proj.y.y};
+
+	const ClusterDepth depth = clusterDepth(pov);
+	const float ratio = depth.far / depth.near;
+	const float sliceNear =
+		depth.near * powf(ratio, (float)cell[Z] / CLUSTER_Z);
+	const float sliceFar =
+		depth.near * powf(ratio, (float)(cell[Z] + 1) / CLUSTER_Z);
+
+	for (int i = 0; i < 2; i++) {
+		const float ndcMin = (float)cell[i] / cells[i] * 2.0f - 1.0f;
+		const float ndcMax = (float)(cell[i] + 1) / cells[i] * 2.0f - 1.0f;
+
+		const float a = ndcMin * sliceNear / scale[i];
+		const float b = ndcMax * sliceNear / scale[i];
+		const float c = ndcMin * sliceFar / scale[i];
+		const float d = ndcMax * sliceFar / scale[i];
+
+		boxMin[i] = fminf(fminf(a, b), fminf(c, d));
+		boxMax[i] = fmaxf(fmaxf(a, b), fmaxf(c, d));
+	}
+
+	boxMin[Z] = -sliceFar;
+	boxMax[Z] = -sliceNear;
+}
+
+/* The cluster a pixel at uv and distance along -z is in, as beauty.frag's
+ * clusterIndex() finds it */
+uint32_t clusterAt(
+	float u,
+	float v,
+	float distance,
+	const ViewpointUniforms* pov
+)
+{
+	const ClusterDepth depth = clusterDepth(pov);
+
+	const uint32_t x = (uint32_t)fminf(u * CLUSTER_X, CLUSTER_X - 1);
+	const uint32_t y = (uint32_t)fminf(v * CLUSTER_Y, CLUSTER_Y - 1);
+	const float slice = logf(distance / depth.near)
+		/ logf(depth.far / depth.near) * CLUSTER_Z;
+	const uint32_t z = (uint32_t)fmaxf(0.0f, fminf(slice, CLUSTER_Z - 1));
+
+	return (z * CLUSTER_Y + y) * CLUSTER_X + x;
+}
+
+/* Whether the light's sphere touches the box */
+char lightReachesBox(
+	const GpuLight* light,
+	const float* boxMin,
+	const float* boxMax
+)
+{
+	float distanceSq = 0.0f;
+
+	for (int i = 0; i < 3; i++) {
+		const float nearest =
+			fmaxf(boxMin[i], fminf(light->position[i], boxMax[i]));
+		const float offset = nearest - light->position[i];
+
+		distanceSq += offset * offset;
+	}
+
+	return distanceSq <= light->range * light->range;
+}
+
+/* Fills the cluster buffer the way cluster.comp does, each cluster's lights
+ * in the order they're in the light buffer. Returns how many times a light
+ * was left out of a cluster that was already full. */
+uint32_t binLightsOnCpu(
+	uint32_t* counts,
+	uint32_t* indices,
+	const GpuLight* lights,
+	uint32_t lightCount,
+	const ViewpointUniforms* pov
+)
+{
+	uint32_t dropped = 0;
+
+	for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+		float boxMin[3];
+		float boxMax[3];
+		uint32_t count = 0;
+
+		clusterBox(boxMin, boxMax, cluster, pov);
+
+		for (uint32_t i = 0; i < lightCount; i++) {
+			if (!lightReachesBox(&lights[i], boxMin, boxMax)) continue;
+
+			if (count < CLUSTER_MAX_LIGHTS) {
+				indices[cluster * CLUSTER_MAX_LIGHTS + count] = i;
+				++count;
+			} else {
+				++dropped;
+			}
+		}
+
+		counts[cluster] = count;
+	}
+
+	return dropped;
+}
+
+/* Dim lights scattered over a wide, flat slab, the same ones every frame.
+ * At 10,000 a lit cluster has a couple of dozen in reach on average, which is
+ * about what a busy scene would have. Packing them any closer fills the far
+ * clusters past CLUSTER_MAX_LIGHTS, and test/cluster.c checks it doesn't. */
+void writeBenchLight(GpuLight* light, uint32_t i, const ViewpointUniforms* pov)
+{
+	uint32_t h = i * 0x9e3779b9u;
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+
+	uint32_t g = h * 0x9e3779b9u + i;
+	g ^= g >> 15;
+	g *= 0x2c1b3c6du;
+	g ^= g >> 12;
+
+	const float pos[3] = {
+		((h & 0xffff) / 65535.0f - 0.5f) * 240.0f,
+		((h >> 16) / 65535.0f - 0.5f) * 240.0f,
+		((g & 0xff) / 255.0f) * 4.0f
+	};
+
+	const float intensity = 0.05f;
+
+	transformPoint(light->position, (const float (*)[4])&pov->view, pos);
+	light->range = pointLightRange(intensity);
+	light->colour[0] = ((g >> 8) & 0xff) / 255.0f * intensity;
+	light->colour[1] = ((g >> 16) & 0xff) / 255.0f * intensity;
+	light->colour[2] = (g >> 24) / 255.0f * intensity;
+	light->intensity = intensity;
+	light->shadowTile = -1;
+}
+
+/* Lights fall off with 1 / (1 + d^2) of their intensity, so this is where
+ * that reaches LIGHT_CUTOFF. beauty.frag fades them out to nothing there. */
+float pointLightRange(float intensity)
+{
+	const float rangeSq = intensity / LIGHT_CUTOFF - 1.0f;
+
+	return rangeSq > 0.0f ? sqrtf(rangeSq) : 0.0f;
+}
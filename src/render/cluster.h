@@ -0,0 +1,78 @@
+#ifndef RENDER_CLUSTER_H
+#define RENDER_CLUSTER_H 1
+
+#include <stdint.h>
+#include "scene.h"
+
+/* The cluster grid the light shaders share, and the maths they do on it
+ * written out again in C. cluster.comp bins lights into clusters and
+ * beauty.frag finds the cluster each pixel is in. The C versions do the same
+ * on the CPU, where they can be tested without a GPU. Changes to one side
+ * have to be made to the other. */
+
+/* The view frustum is cut into this many clusters across, down and in
+ * depth. Depth slices get thicker further away so clusters stay roughly as
+ * deep as they are wide. cluster.comp and beauty.frag have the same
+ * numbers. */
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+
+/* Lights past this many in one cluster are left out of it. */
+#define CLUSTER_MAX_LIGHTS 256
+
+/* A light stops where it's down to this much of full brightness. */
+#define LIGHT_CUTOFF (1.0f / 256.0f)
+
+/* A light as the shaders see it, in view space. The colour is already
+ * scaled by the intensity. shadowTile is -1 for lights without a shadow yet.
+ * Laid out to match the std430 struct in cluster.comp and beauty.frag, which
+ * is padded out to a multiple of 16 bytes. */
+typedef struct
+{
+	float position[3];
+	float range;
+	float colour[3];
+	float intensity;
+	int32_t shadowTile;
+	uint32_t padding[3];
+} GpuLight;
+
+/* The near and far distances a viewpoint's projection was made with */
+typedef struct
+{
+	float near;
+	float far;
+} ClusterDepth;
+
+ClusterDepth clusterDepth(const ViewpointUniforms* pov);
+void clusterBox(
+	float* boxMin,
+	float* boxMax,
+	uint32_t cluster,
+	const ViewpointUniforms* pov
+);
+uint32_t clusterAt(
+	float u,
+	float v,
+	float distance,
+	const ViewpointUniforms* pov
+);
+char lightReachesBox(
+	const GpuLight* light,
+	const float* boxMin,
+	const float* boxMax
+);
+uint32_t binLightsOnCpu(
+	uint32_t* counts,
+	uint32_t* indices,
+	const GpuLight* lights,
+	uint32_t lightCount,
+	const ViewpointUniforms* pov
+);
+
+void writeBenchLight(GpuLight* light, uint32_t i, const ViewpointUniforms* pov);
+float pointLightRange(float intensity);
+
+#endif
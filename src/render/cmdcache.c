@@ -0,0 +1,137 @@
+#include "cmdcache.h"
+#include <stdio.h>
+
+char commandCacheValid(
+	const CommandCache* cache,
+	unsigned int frame,
+	uint32_t generation,
+	uint32_t passGeneration,
+	uint64_t drawHash
+)
+{
+	return cache->recorded[frame]
+		&& cache->generation[frame] == generation
+		&& cache->passGeneration[frame] == passGeneration
+		&& cache->drawHash[frame] == drawHash;
+}
+
+/* Only for a frame whose fence has been waited on, since the buffer could
+ * still be executing otherwise. pool has to belong to the thread calling
+ * this. */
+int beginCachedCommands(
+	CommandCache* cache,
+	VkDevice device,
+	VkCommandPool pool,
+	unsigned int frame,
+	VkRenderPass pass,
+	VkFramebuffer fb
+)
+{
+	if (!cache->pools[frame]) {
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(
+			device,
+			&allocInfo,
+			&cache->cmdBufs[frame]
+		) != VK_SUCCESS) {
+			printf("Failed to allocate cached command buffer\n");
+			return -1;
+		}
+
+		cache->pools[frame] = pool;
+	}
+
+	/* Nothing counts as recorded until it's finished. */
+	cache->recorded[frame] = 0;
+
+	vkResetCommandBuffer(cache->cmdBufs[frame], 0);
+
+	VkCommandBufferInheritanceInfo inheritInfo = {};
+	inheritInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritInfo.renderPass = pass;
+	inheritInfo.subpass = 0;
+	inheritInfo.framebuffer = fb;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritInfo;
+
+	if (vkBeginCommandBuffer(
+		cache->cmdBufs[frame],
+		&beginInfo
+	) != VK_SUCCESS) {
+		printf("Failed to begin cached command buffer\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int endCachedCommands(
+	CommandCache* cache,
+	unsigned int frame,
+	uint32_t generation,
+	uint32_t passGeneration,
+	uint64_t drawHash
+)
+{
+	if (vkEndCommandBuffer(cache->cmdBufs[frame]) != VK_SUCCESS) {
+		printf("Failed to record cached command buffer\n");
+		return -1;
+	}
+
+	cache->recorded[frame] = 1;
+	cache->generation[frame] = generation;
+	cache->passGeneration[frame] = passGeneration;
+	cache->drawHash[frame] = drawHash;
+
+	return 0;
+}
+
+/* The hash of a scene's draws is the sum of its items' hashes, so it doesn't
+ * change with the order they're drawn in. Sorting by distance shuffles them
+ * whenever anything moves, and a slightly stale order is still fine to draw
+ * in. */
+uint64_t drawHashItem(uint32_t mesh, uint32_t lod, uint32_t texIndex)
+{
+	return hashMix((uint64_t)mesh << 32 ^ (uint64_t)lod << 24 ^ texIndex);
+}
+
+/* For hashes of things in a particular order, like a draw list chunk's
+ * buffers */
+uint64_t hashCombine(uint64_t hash, uint64_t value)
+{
+	return hashMix(hash ^ hashMix(value));
+}
+
+/* The finaliser from SplitMix64 */
+uint64_t hashMix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+
+	return x;
+}
+
+void destroyCommandCache(GarbageQueue* garbage, CommandCache cache)
+{
+	Garbage item = {};
+	item.type = GARBAGE_COMMAND_BUFFER;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (!cache.pools[i]) continue;
+
+		item.cmdPool = cache.pools[i];
+		item.cmdBuf = cache.cmdBufs[i];
+		throwAway(garbage, item);
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef RENDER_CMDCACHE_H
+#define RENDER_CMDCACHE_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "misc.h"
+#include "garbage.h"
+
+/* A scene's part of the geometry pass, kept in secondary command buffers and
+ * executed again frame after frame until something it was recorded from
+ * changes. Transforms live in uniform buffers, so moving meshes around
+ * doesn't count. */
+typedef struct
+{
+	/* The recording thread the scene belongs to. Its buffers come from
+	 * that thread's pools the first time they're recorded, and only that
+	 * thread records them after. */
+	char assigned;
+	unsigned int worker;
+	VkCommandPool pools[MAX_FRAMES_IN_FLIGHT];
+	VkCommandBuffer cmdBufs[MAX_FRAMES_IN_FLIGHT];
+
+	/* What each buffer was recorded against. The scene's generation
+	 * covers meshes and textures, the display's covers the render pass
+	 * and swapchain, and the draw hash covers culling and LODs. */
+	char recorded[MAX_FRAMES_IN_FLIGHT];
+	uint32_t generation[MAX_FRAMES_IN_FLIGHT];
+	uint32_t passGeneration[MAX_FRAMES_IN_FLIGHT];
+	uint64_t drawHash[MAX_FRAMES_IN_FLIGHT];
+} CommandCache;
+
+char commandCacheValid(
+	const CommandCache* cache,
+	unsigned int frame,
+	uint32_t generation,
+	uint32_t passGeneration,
+	uint64_t drawHash
+);
+
+int beginCachedCommands(
+	CommandCache* cache,
+	VkDevice device,
+	VkCommandPool pool,
+	unsigned int frame,
+	VkRenderPass pass,
+	VkFramebuffer fb
+);
+int endCachedCommands(
+	CommandCache* cache,
+	unsigned int frame,
+	uint32_t generation,
+	uint32_t passGeneration,
+	uint64_t drawHash
+);
+
+uint64_t drawHashItem(uint32_t mesh, uint32_t lod, uint32_t texIndex);
+uint64_t hashCombine(uint64_t hash, uint64_t value);
+uint64_t hashMix(uint64_t x);
+
+/* Handles as something to hash. They're pointers on 64-bit platforms. On
+ * others they're 64-bit integers, and only the low half counts. */
+#define HANDLE_HASH(handle) ((uint64_t)(uintptr_t)(handle))
+
+void destroyCommandCache(GarbageQueue* garbage, CommandCache cache);
+
+#endif
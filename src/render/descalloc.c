@@ -0,0 +1,209 @@
+#include "descalloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int createDescriptorAllocator(DescriptorAllocator* alloc)
+{
+	alloc->poolCount = 0;
+	alloc->poolLimit = 1;
+	alloc->pools = (VkDescriptorPool*)malloc(sizeof(VkDescriptorPool));
+
+	alloc->freeCount = 0;
+	alloc->freeLimit = 1;
+	alloc->freeSets = (VkDescriptorSet*)malloc(sizeof(VkDescriptorSet));
+
+	if (!alloc->pools || !alloc->freeSets) {
+		perror("Failed to allocate descriptor allocator");
+		return -1;
+	}
+
+	alloc->poolSetsLeft = 0;
+	alloc->nextPoolSize = DESC_POOL_MIN_SETS;
+	alloc->liveSets = 0;
+
+	return 0;
+}
+
+void destroyDescriptorAllocator(VkDevice device, DescriptorAllocator alloc)
+{
+	/* Destroying a pool frees every set that came out of it. */
+	for (int i = 0; i < alloc.poolCount; i++) {
+		vkDestroyDescriptorPool(device, alloc.pools[i], 0);
+	}
+
+	free(alloc.pools);
+	free(alloc.freeSets);
+}
+
+int descAllocAddPool(DescriptorAllocator* alloc, VkDevice device)
+{
+	if (alloc->poolCount >= alloc->poolLimit) {
+		alloc->poolLimit *= 2;
+
+		void* newPools = realloc(
+			alloc->pools,
+			sizeof(VkDescriptorPool) * alloc->poolLimit
+		);
+
+		if (!newPools) {
+			perror("Failed to reallocate descriptor pools");
+			return -1;
+		}
+
+		alloc->pools = (VkDescriptorPool*)newPools;
+	}
+
+	const unsigned int setCount = alloc->nextPoolSize;
+
+	VkDescriptorPoolSize poolSizes[3] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = setCount * DESC_SET_UNIFORM_BUFFERS;
+
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = setCount * DESC_SET_IMAGE_SAMPLERS;
+
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = setCount * DESC_SET_STORAGE_BUFFERS;
+
+	VkDescriptorPoolCreateInfo descPoolInfo = {};
+	descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descPoolInfo.poolSizeCount = 3;
+	descPoolInfo.pPoolSizes = poolSizes;
+	descPoolInfo.maxSets = setCount;
+
+	if (vkCreateDescriptorPool(
+		device,
+		&descPoolInfo,
+		0,
+		&alloc->pools[alloc->poolCount]
+	) != VK_SUCCESS) {
+		printf("Failed to create descriptor pool.\n");
+		return -1;
+	}
+
+	++alloc->poolCount;
+	alloc->poolSetsLeft = setCount;
+
+	if (alloc->nextPoolSize < DESC_POOL_MAX_SETS) {
+		alloc->nextPoolSize *= 2;
+	}
+
+	return 0;
+}
+
+int allocDescriptorSets(
+	DescriptorAllocator* alloc,
+	VkDevice device,
+	VkDescriptorSetLayout layout,
+	VkDescriptorSet* sets,
+	unsigned int setCount
+)
+{
+	unsigned int setIdx = 0;
+
+	/* Anything left empty on failure stays VK_NULL_HANDLE, so the caller can
+	 * hand the whole array back through freeDescriptorSets(). */
+	for (int i = 0; i < setCount; i++) {
+		sets[i] = VK_NULL_HANDLE;
+	}
+
+	/* Recycled sets go first. Whatever was written to them before gets
+	 * overwritten by the new owner. */
+	while (setIdx < setCount && alloc->freeCount) {
+		sets[setIdx] = alloc->freeSets[--alloc->freeCount];
+		++alloc->liveSets;
+		++setIdx;
+	}
+
+	const unsigned int newSetCount = setCount - setIdx;
+
+	if (!newSetCount) return 0;
+
+	/* A request that doesn't fit in what's left of the newest pool moves on
+	 * to a fresh one. At most a couple of sets get left behind. */
+	if (newSetCount > alloc->poolSetsLeft) {
+		if (descAllocAddPool(alloc, device)) {
+			return -1;
+		}
+	}
+
+	VkDescriptorSetLayout layouts[newSetCount];
+	for (int i = 0; i < newSetCount; i++) {
+		layouts[i] = layout;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = alloc->pools[alloc->poolCount - 1];
+	allocInfo.descriptorSetCount = newSetCount;
+	allocInfo.pSetLayouts = layouts;
+
+	VkResult result = vkAllocateDescriptorSets(
+		device,
+		&allocInfo,
+		&sets[setIdx]
+	);
+
+	/* Pools can still run dry early through fragmentation. One more pool
+	 * is worth a try before giving up. */
+	if (
+		result == VK_ERROR_OUT_OF_POOL_MEMORY
+		|| result == VK_ERROR_FRAGMENTED_POOL
+	) {
+		if (descAllocAddPool(alloc, device)) {
+			return -1;
+		}
+
+		allocInfo.descriptorPool = alloc->pools[alloc->poolCount - 1];
+		result = vkAllocateDescriptorSets(device, &allocInfo, &sets[setIdx]);
+	}
+
+	if (result != VK_SUCCESS) {
+		printf("Failed to allocate descriptor sets.\n");
+
+		for (int i = setIdx; i < setCount; i++) {
+			sets[i] = VK_NULL_HANDLE;
+		}
+
+		return -1;
+	}
+
+	alloc->poolSetsLeft -= newSetCount;
+	alloc->liveSets += newSetCount;
+
+	return 0;
+}
+
+int freeDescriptorSets(
+	DescriptorAllocator* alloc,
+	const VkDescriptorSet* sets,
+	unsigned int setCount
+)
+{
+	for (int i = 0; i < setCount; i++) {
+		/* Meshes that failed halfway through creation have empty slots. */
+		if (sets[i] == VK_NULL_HANDLE) continue;
+
+		if (alloc->freeCount >= alloc->freeLimit) {
+			alloc->freeLimit *= 2;
+
+			void* newFreeSets = realloc(
+				alloc->freeSets,
+				sizeof(VkDescriptorSet) * alloc->freeLimit
+			);
+
+			if (!newFreeSets) {
+				perror("Failed to reallocate free descriptor sets");
+				return -1;
+			}
+
+			alloc->freeSets = (VkDescriptorSet*)newFreeSets;
+		}
+
+		alloc->freeSets[alloc->freeCount] = sets[i];
+		++alloc->freeCount;
+		--alloc->liveSets;
+	}
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#ifndef RENDER_DESCALLOC_H
+#define RENDER_DESCALLOC_H 1
+
+#include <vulkan/vulkan.h>
+
+/* Every pool the allocator creates is twice as big as the last, starting at
+ * DESC_POOL_MIN_SETS and topping out at DESC_POOL_MAX_SETS. */
+#define DESC_POOL_MIN_SETS 64
+#define DESC_POOL_MAX_SETS 4096
+
+/* The per-mesh descriptor layout holds two uniform buffers (viewpoint and
+ * model), one combined image sampler and two storage buffers (meshlets and
+ * the draw list). */
+#define DESC_SET_UNIFORM_BUFFERS 2
+#define DESC_SET_IMAGE_SAMPLERS 1
+#define DESC_SET_STORAGE_BUFFERS 2
+
+/* Mesh descriptor sets all come out of the same chain of pools instead of each
+ * mesh making its own pool. Sets belonging to deleted meshes are kept around
+ * and handed to the next mesh that asks, since every mesh uses the same
+ * layout anyway. */
+typedef struct
+{
+	VkDescriptorPool* pools;
+	unsigned int poolCount;
+	unsigned int poolLimit;
+
+	VkDescriptorSet* freeSets;
+	unsigned int freeCount;
+	unsigned int freeLimit;
+
+	/* Sets left in the newest pool and the size of the pool after it. */
+	unsigned int poolSetsLeft;
+	unsigned int nextPoolSize;
+
+	/* Sets currently owned by meshes */
+	unsigned int liveSets;
+} DescriptorAllocator;
+
+int createDescriptorAllocator(DescriptorAllocator* alloc);
+void destroyDescriptorAllocator(VkDevice device, DescriptorAllocator alloc);
+
+int descAllocAddPool(DescriptorAllocator* alloc, VkDevice device);
+
+int allocDescriptorSets(
+	DescriptorAllocator* alloc,
+	VkDevice device,
+	VkDescriptorSetLayout layout,
+	VkDescriptorSet* sets,
+	unsigned int setCount
+);
+
+int freeDescriptorSets(
+	DescriptorAllocator* alloc,
+	const VkDescriptorSet* sets,
+	unsigned int setCount
+);
+
+#endif
@@ -1,98 +1,1076 @@
 #include "config.h"
 #include "display.h"
 #include "physdev.h"
+#include "meshlet.h"
+#include "frustum.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
 
+/* Separate from beginning the render pass so compute work can go in
+ * first. */
+int beginCommandBuffer(VkCommandBuffer* cmdBuf)
+{
+	vkResetCommandBuffer(*cmdBuf, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+	if (vkBeginCommandBuffer(*cmdBuf, &beginInfo) != VK_SUCCESS) {
+		printf("Failed to begin command buffer\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 int beginRenderPass(
 	VkCommandBuffer* cmdBuf,
 	RenderPass pass,
 	VkFramebuffer fb,
-	VkExtent2D ext
+	VkExtent2D ext,
+	VkSubpassContents contents
+)
+{
+	/* The G-buffer's colour, depth and normal, then the swapchain image.
+	 * Only the first two are cleared. */
+	VkClearValue clearValues[4] = {
+		{color: {{0.0f, 0.0f, 0.0f, 1.0f}}},
+		{depthStencil: {1.0f, 0}},
+		{color: {{0.0f, 0.0f, 0.0f, 1.0f}}},
+		{color: {{0.0f, 0.0f, 0.0f, 1.0f}}}
+	};
+
+	VkRenderPassBeginInfo passBeginInfo = defRenderPassBeginInfo;
+	passBeginInfo.renderPass = pass.pass;
+	passBeginInfo.framebuffer = fb;
+	passBeginInfo.renderArea.offset.x = 0;
+	passBeginInfo.renderArea.offset.y = 0;
+	passBeginInfo.renderArea.extent = ext;
+	passBeginInfo.clearValueCount = 4;
+	passBeginInfo.pClearValues = clearValues;
+
+	vkCmdBeginRenderPass(*cmdBuf, &passBeginInfo, contents);
+
+	/* Secondary command buffers set all of their own state. */
+	if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+		bindPassState(cmdBuf, pass, ext);
+	}
+
+	return 0;
+}
+
+/* Dynamic state and the pipeline, which don't carry over from a primary
+ * command buffer into secondaries */
+void bindPassState(VkCommandBuffer* cmdBuf, RenderPass pass, VkExtent2D ext)
+{
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)ext.width;
+	viewport.height = (float)ext.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(*cmdBuf, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset.x = 0;
+	scissor.offset.y = 0;
+	scissor.extent = ext;
+	vkCmdSetScissor(*cmdBuf, 0, 1, &scissor);
+
+	vkCmdBindPipeline(*cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+}
+
+/* Splits this frame's sorted draws up by scene and has the recorder's
+ * threads record the secondary command buffers of the scenes whose draws
+ * changed. Each scene keeps the order it was recorded in until then. The
+ * buffers for the geometry pass to execute come back in cmdBufs, which is in
+ * the frame arena. */
+int recordSceneCommands(
+	Display* display,
+	SceneArray scenes,
+	VkCommandBuffer** cmdBufs,
+	unsigned int* cmdBufCount
+)
+{
+	const unsigned int frame = display->currentFrame;
+	const SortedDraws* draws = &display->sortedDraws;
+
+	*cmdBufs = 0;
+	*cmdBufCount = 0;
+
+	if (!scenes.count) return 0;
+
+	SceneRecordJob job = {};
+	job.display = display;
+	job.scenes = scenes;
+	job.frame = frame;
+
+	job.sceneDraws = (SortedDraws*)arenaAlloc(
+		&display->frameArena,
+		sizeof(SortedDraws) * scenes.count
+	);
+	job.hashes = (uint64_t*)arenaAlloc(
+		&display->frameArena,
+		sizeof(uint64_t) * scenes.count
+	);
+	job.dirty = (char*)arenaAlloc(&display->frameArena, scenes.count);
+	DrawItem* items = (DrawItem*)arenaAlloc(
+		&display->frameArena,
+		sizeof(DrawItem) * (draws->count ? draws->count : 1)
+	);
+	*cmdBufs = (VkCommandBuffer*)arenaAlloc(
+		&display->frameArena,
+		sizeof(VkCommandBuffer) * scenes.count
+	);
+
+	if (!job.sceneDraws || !job.hashes || !job.dirty || !items || !*cmdBufs) {
+		printf("Failed to allocate scene draws\n");
+		return -1;
+	}
+
+	for (int i = 0; i < scenes.count; i++) {
+		job.sceneDraws[i].count = 0;
+		job.hashes[i] = 0;
+	}
+
+	for (int i = 0; i < draws->count; i++) {
+		++job.sceneDraws[draws->items[i].scene].count;
+	}
+
+	unsigned int first = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		job.sceneDraws[i].items = &items[first];
+		first += job.sceneDraws[i].count;
+		job.sceneDraws[i].count = 0;
+	}
+
+	for (int i = 0; i < draws->count; i++) {
+		const DrawItem item = draws->items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
+		SortedDraws* sceneDraw = &job.sceneDraws[item.scene];
+
+		sceneDraw->items[sceneDraw->count] = item;
+		++sceneDraw->count;
+
+		job.hashes[item.scene] +=
+			drawHashItem(item.mesh, mesh->lod, mesh->texIndex);
+	}
+
+	unsigned int dirtyCount = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		CommandCache* cache = &DENSE_AT(Scene, scenes, i).commands;
+
+		job.dirty[i] = job.sceneDraws[i].count && !commandCacheValid(
+			cache,
+			frame,
+			DENSE_AT(Scene, scenes, i).generation,
+			display->passGeneration,
+			job.hashes[i]
+		);
+
+		if (!cache->assigned) {
+			cache->worker = recorderAssignWorker(display->recorder);
+			cache->assigned = 1;
+		}
+
+		dirtyCount += job.dirty[i];
+	}
+
+	if (dirtyCount && runRecorder(
+		display->recorder,
+		recordSceneJob,
+		&job,
+		frame
+	)) {
+		return -1;
+	}
+
+	for (int i = 0; i < scenes.count; i++) {
+		if (!job.sceneDraws[i].count) continue;
+
+		(*cmdBufs)[*cmdBufCount] =
+			DENSE_AT(Scene, scenes, i).commands.cmdBufs[frame];
+		++*cmdBufCount;
+	}
+
+	return 0;
+}
+
+/* One recording thread's share of recordSceneCommands(), the dirty scenes
+ * that belong to it. Nothing but the scenes' own command caches gets
+ * written, so the threads never touch the same thing. */
+int recordSceneJob(void* data, unsigned int worker, VkCommandPool pool)
+{
+	const SceneRecordJob* job = (const SceneRecordJob*)data;
+	const Display* display = job->display;
+
+	for (int i = 0; i < job->scenes.count; i++) {
+		Scene* scene = &DENSE_AT(Scene, job->scenes, i);
+
+		if (!job->dirty[i] || scene->commands.worker != worker) continue;
+
+		if (beginCachedCommands(
+			&scene->commands,
+			display->dev.device,
+			pool,
+			job->frame,
+			display->geom.pass,
+			VK_NULL_HANDLE
+		)) {
+			return -1;
+		}
+
+		VkCommandBuffer* cmdBuf = &scene->commands.cmdBufs[job->frame];
+
+		bindPassState(cmdBuf, display->geom, display->swapchain.extent);
+
+		if (iterateScenes(
+			cmdBuf,
+			job->scenes,
+			&job->sceneDraws[i],
+			job->frame,
+			display->geom.pipelineLayout,
+			display->bindless ? display->texTable.set : VK_NULL_HANDLE
+		)) {
+			return -1;
+		}
+
+		if (endCachedCommands(
+			&scene->commands,
+			job->frame,
+			scene->generation,
+			display->passGeneration,
+			job->hashes[i]
+		)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Everything a draw list chunk's commands are recorded from, apart from the
+ * pass, which passGeneration covers. Buffers that get recreated would leave
+ * stale commands drawing from freed memory otherwise. The meshes drawn on
+ * their own are summed like drawHashItem()'s, so their order doesn't count.
+ * Pooled meshes drawn from the commands aren't in it at all, since their
+ * objects and commands are rewritten every frame anyway. */
+uint64_t hashDrawListChunk(
+	const Display* display,
+	SceneArray scenes,
+	const DrawListChunk* chunk
+)
+{
+	const DrawList* list = &display->drawLists.lists[display->currentFrame];
+	const SortedDraws* draws = &display->sortedDraws;
+
+	uint64_t hash = HANDLE_HASH(list->set);
+	hash = hashCombine(hash, HANDLE_HASH(display->texTable.set));
+	hash = hashCombine(hash, HANDLE_HASH(list->commandBuffer));
+	hash = hashCombine(hash, HANDLE_HASH(list->culledBuffer));
+	hash = hashCombine(hash, HANDLE_HASH(display->geomPool.vertices.buffer));
+	hash = hashCombine(hash, HANDLE_HASH(display->geomPool.indices.buffer));
+	hash = hashCombine(hash, display->maxDrawIndirectCount);
+	hash = hashCombine(
+		hash,
+		(uint64_t)chunk->firstCommand << 32 | chunk->commandCount
+	);
+	hash = hashCombine(
+		hash,
+		(uint64_t)list->pooledCommandCount << 1 | chunk->countDraw
+	);
+
+	uint64_t itemHash = 0;
+
+	for (int i = 0; i < chunk->itemCount; i++) {
+		const DrawItem item = draws->items[chunk->firstItem + i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
+
+		if (mesh->pooled && !mesh->meshletCount) continue;
+
+		uint64_t meshHash = HANDLE_HASH(mesh->vertexBuffer);
+		meshHash = hashCombine(meshHash, HANDLE_HASH(mesh->indexBuffer));
+		meshHash = hashCombine(meshHash, HANDLE_HASH(mesh->drawBuffer));
+		meshHash = hashCombine(
+			meshHash,
+			(uint64_t)mesh->firstDraw << 32 | mesh->submeshCount
+		);
+		meshHash = hashCombine(
+			meshHash,
+			(uint64_t)mesh->lods[mesh->lod].meshletCount << 32
+			| (uint64_t)mesh->indexType << 1
+			| mesh->pooled
+		);
+
+		itemHash += meshHash;
+	}
+
+	return hashCombine(hash, itemHash);
+}
+
+/* recordSceneCommands() for the multi-draw pipeline. The draw list is split
+ * into a chunk for each recording thread, and the threads record theirs in
+ * parallel. A chunk is only recorded again when hashDrawListChunk() says
+ * something it was recorded from has changed. Moving pooled meshes around
+ * doesn't count, and nor does culling them on the GPU. Meshes outside the
+ * pool are drawn from wherever the list put their commands, which moves
+ * with the sort order, so for them it does. */
+int recordDrawListCommands(
+	Display* display,
+	SceneArray scenes,
+	VkCommandBuffer** cmdBufs,
+	unsigned int* cmdBufCount
+)
+{
+	const unsigned int frame = display->currentFrame;
+
+	*cmdBufs = 0;
+	*cmdBufCount = 0;
+
+	DrawListRecordJob job = {};
+	job.display = display;
+	job.scenes = scenes;
+	job.frame = frame;
+	job.chunkCount = display->recorder->workerCount;
+
+	splitDrawList(
+		job.chunks,
+		job.chunkCount,
+		scenes,
+		&display->sortedDraws,
+		&display->drawLists.lists[frame]
+	);
+
+	*cmdBufs = (VkCommandBuffer*)arenaAlloc(
+		&display->frameArena,
+		sizeof(VkCommandBuffer) * job.chunkCount
+	);
+
+	if (!*cmdBufs) {
+		printf("Failed to allocate draw list chunks\n");
+		return -1;
+	}
+
+	char drawn[RECORDER_MAX_WORKERS] = {};
+	unsigned int dirtyCount = 0;
+
+	for (int i = 0; i < job.chunkCount; i++) {
+		const DrawListChunk* chunk = &job.chunks[i];
+
+		/* Nothing to draw, so nothing to execute either */
+		drawn[i] = chunk->countDraw || chunk->commandCount || chunk->itemCount;
+		if (!drawn[i]) continue;
+
+		job.hashes[i] = hashDrawListChunk(display, scenes, chunk);
+		job.dirty[i] = !commandCacheValid(
+			&display->drawListCommands[i],
+			frame,
+			0,
+			display->passGeneration,
+			job.hashes[i]
+		);
+
+		dirtyCount += job.dirty[i];
+	}
+
+	if (dirtyCount && runRecorder(
+		display->recorder,
+		recordDrawListJob,
+		&job,
+		frame
+	)) {
+		return -1;
+	}
+
+	for (int i = 0; i < job.chunkCount; i++) {
+		if (!drawn[i]) continue;
+
+		(*cmdBufs)[*cmdBufCount] = display->drawListCommands[i].cmdBufs[frame];
+		++*cmdBufCount;
+	}
+
+	return 0;
+}
+
+/* One recording thread's chunk of recordDrawListCommands(), if it has one
+ * and it needs recording. */
+int recordDrawListJob(void* data, unsigned int worker, VkCommandPool pool)
+{
+	const DrawListRecordJob* job = (const DrawListRecordJob*)data;
+	Display* display = job->display;
+
+	if (worker >= job->chunkCount || !job->dirty[worker]) return 0;
+
+	CommandCache* cache = &display->drawListCommands[worker];
+
+	if (beginCachedCommands(
+		cache,
+		display->dev.device,
+		pool,
+		job->frame,
+		display->geom.pass,
+		VK_NULL_HANDLE
+	)) {
+		return -1;
+	}
+
+	VkCommandBuffer* cmdBuf = &cache->cmdBufs[job->frame];
+
+	bindPassState(cmdBuf, display->geom, display->swapchain.extent);
+
+	if (iterateDrawList(
+		cmdBuf,
+		job->scenes,
+		&display->sortedDraws,
+		display->geom.pipelineLayout,
+		display->texTable.set,
+		&display->drawLists.lists[job->frame],
+		&display->geomPool,
+		display->maxDrawIndirectCount,
+		&job->chunks[worker]
+	)) {
+		return -1;
+	}
+
+	return endCachedCommands(
+		cache,
+		job->frame,
+		0,
+		display->passGeneration,
+		job->hashes[worker]
+	);
+}
+
+/* Records cull.comp for every mesh with meshlets, outside the render pass.
+ * Each mesh's draw list gets cleared and refilled with the meshlets that
+ * are in view. */
+int cullMeshlets(
+	VkCommandBuffer* cmdBuf,
+	SceneArray scenes,
+	int frame,
+	VkPipelineLayout pipelineLayout,
+	VkPipeline pipeline,
+	VkDescriptorSet pyramidSet,
+	char coneCull,
+	char occlusionCull
+)
+{
+	/* The last frame could still be drawing from the lists. Everything
+	 * before it on the queue is covered by the barrier. */
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		0,
+		0,
+		0,
+		0,
+		0
+	);
+
+	for (int i = 0; i < scenes.count; i++) {
+		for (int j = 0; j < DENSE_AT(Scene, scenes, i).meshes.count; j++) {
+			const Mesh* mesh = &SCENE_MESH(scenes, i, j);
+
+			if (!mesh->meshletCount) continue;
+
+			vkCmdFillBuffer(*cmdBuf, mesh->drawBuffer, 0, sizeof(uint32_t), 0);
+		}
+	}
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask =
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		0,
+		0,
+		0
+	);
+
+	vkCmdBindPipeline(*cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	/* Same for every mesh. Binding each mesh's set later leaves it be. */
+	vkCmdBindDescriptorSets(
+		*cmdBuf,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		pipelineLayout,
+		1,
+		1,
+		&pyramidSet,
+		0,
+		0
+	);
+
+	MeshletCullConstants constants = {};
+	constants.coneCull = coneCull;
+	constants.occlusionCull = occlusionCull;
+
+	for (int i = 0; i < scenes.count; i++) {
+		for (int j = 0; j < DENSE_AT(Scene, scenes, i).meshes.count; j++) {
+			const Mesh* mesh = &SCENE_MESH(scenes, i, j);
+
+			if (!mesh->meshletCount || !mesh->visible) continue;
+
+			/* The mesh's own set has its transforms, meshlets and
+			 * draw list. */
+			vkCmdBindDescriptorSets(
+				*cmdBuf,
+				VK_PIPELINE_BIND_POINT_COMPUTE,
+				pipelineLayout,
+				0,
+				1,
+				&mesh->descriptorSets[frame],
+				0,
+				0
+			);
+
+			constants.firstMeshlet = mesh->lods[mesh->lod].firstMeshlet;
+			constants.meshletCount = mesh->lods[mesh->lod].meshletCount;
+
+			/* All 0 unless the mesh is in the geometry pool and
+			 * the draw list gave it an object. */
+			constants.firstIndex = mesh->indexRange.first;
+			constants.vertexOffset = mesh->vertexRange.first;
+			constants.firstInstance = mesh->drawObject;
+
+			vkCmdPushConstants(
+				*cmdBuf,
+				pipelineLayout,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				0,
+				sizeof(MeshletCullConstants),
+				&constants
+			);
+
+			vkCmdDispatch(
+				*cmdBuf,
+				(constants.meshletCount + MESHLET_CULL_GROUP_SIZE - 1)
+				/ MESHLET_CULL_GROUP_SIZE,
+				1,
+				1
+			);
+		}
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		0,
+		0,
+		0
+	);
+
+	return 0;
+}
+
+/* Records instcull.comp over the draw list's pooled commands, outside the
+ * render pass. It tests each one's object against the frustum, and the depth
+ * pyramid if there is one, and packs the ones left into the culled buffer
+ * for iterateDrawList(). */
+void cullDrawList(
+	VkCommandBuffer* cmdBuf,
+	const DrawList* list,
+	VkPipelineLayout pipelineLayout,
+	VkPipeline pipeline,
+	VkDescriptorSet pyramidSet,
+	char occlusionCull
+)
+{
+	if (!list->pooledCommandCount) return;
+
+	/* Same as cullMeshlets(), for the last frame drawing from this list */
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		0,
+		0,
+		0,
+		0,
+		0
+	);
+
+	vkCmdFillBuffer(*cmdBuf, list->culledBuffer, 0, sizeof(uint32_t), 0);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask =
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		0,
+		0,
+		0
+	);
+
+	vkCmdBindPipeline(*cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	VkDescriptorSet sets[] = {list->set, pyramidSet};
+
+	vkCmdBindDescriptorSets(
+		*cmdBuf,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		pipelineLayout,
+		0,
+		2,
+		sets,
+		0,
+		0
+	);
+
+	DrawListCullConstants constants = {};
+	constants.commandCount = list->pooledCommandCount;
+	constants.occlusionCull = occlusionCull;
+
+	vkCmdPushConstants(
+		*cmdBuf,
+		pipelineLayout,
+		VK_SHADER_STAGE_COMPUTE_BIT,
+		0,
+		sizeof(DrawListCullConstants),
+		&constants
+	);
+
+	vkCmdDispatch(
+		*cmdBuf,
+		(constants.commandCount + DRAW_LIST_CULL_GROUP_SIZE - 1)
+		/ DRAW_LIST_CULL_GROUP_SIZE,
+		1,
+		1
+	);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		0,
+		0,
+		0
+	);
+}
+
+/* The coarsest LOD whose error, projected from the nearest point of the
+ * mesh's bounds, stays under maxPixels. The error is scaled by the biggest
+ * axis of the transform, so squashed meshes lean towards finer LODs. */
+unsigned int selectMeshLod(
+	const Mesh* mesh,
+	Vec3 eye,
+	float pixelScale,
+	float maxPixels
+)
+{
+	const float scale = transformMaxScale(mesh->tform);
+	float pos[3];
+
+	transformPoint(pos, mesh->tform, mesh->sphereCentre);
+
+	const Vec3 toEye = {eye.x - pos[X], eye.y - pos[Y], eye.z - pos[Z]};
+	const float distance =
+		sqrtf(dotVec3(toEye, toEye)) - mesh->sphereRadius * scale;
+
+	/* Inside the bounds, nothing but the full mesh will do. */
+	if (distance <= 0.0f) return 0;
+
+	unsigned int lod = 0;
+
+	for (int i = 1; i < mesh->lodCount; i++) {
+		const float pixels =
+			mesh->lods[i].error * scale * pixelScale / distance;
+
+		if (pixels > maxPixels) break;
+
+		lod = i;
+	}
+
+	return lod;
+}
+
+/* Whether instcull.comp culls the mesh, which leaves it out of the CPU's
+ * frustum test. Meshlets are culled one by one instead. */
+char meshCulledOnGpu(const Display* display, const Mesh* mesh)
+{
+	return display->gpuCull && mesh->pooled && !mesh->meshletCount;
+}
+
+/* Tests every mesh in every scene against the viewpoint's frustum in one
+ * batch. With frustum culling off, everything is visible. Meshes culled on
+ * the GPU are visible as far as the CPU knows, and count as drawn. */
+int cullMeshes(Display* display, SceneArray scenes)
+{
+	unsigned int meshCount = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		for (int j = 0; j < DENSE_AT(Scene, scenes, i).meshes.count; j++) {
+			meshCount += !meshCulledOnGpu(
+				display,
+				&SCENE_MESH(scenes, i, j)
+			);
+		}
+	}
+
+	MeshBounds bounds = {};
+
+	if (display->frustumCull) {
+		if (createMeshBounds(&bounds, &display->frameArena, meshCount)) {
+			printf("Failed to allocate mesh bounds\n");
+			return -1;
+		}
+
+		unsigned int idx = 0;
+
+		for (int i = 0; i < scenes.count; i++) {
+			for (int j = 0; j < DENSE_AT(Scene, scenes, i).meshes.count; j++) {
+				const Mesh* mesh = &SCENE_MESH(scenes, i, j);
+
+				if (meshCulledOnGpu(display, mesh)) continue;
+
+				setMeshBounds(&bounds, idx, mesh);
+				++idx;
+			}
+		}
+
+		float planes[6][4];
+		extractFrustumPlanes(planes, &display->pov.uniforms);
+		cullMeshBounds(&bounds, (const float (*)[4])planes);
+	}
+
+	unsigned int idx = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		Scene* scene = &DENSE_AT(Scene, scenes, i);
+
+		scene->drawnMeshes = 0;
+		scene->culledMeshes = 0;
+
+		for (int j = 0; j < scene->meshes.count; j++) {
+			Mesh* mesh = &DENSE_AT(Mesh, scene->meshes, j);
+
+			if (meshCulledOnGpu(display, mesh)) {
+				mesh->visible = 1;
+			} else {
+				mesh->visible = !display->frustumCull || bounds.visible[idx];
+				++idx;
+			}
+
+			if (mesh->visible) {
+				++scene->drawnMeshes;
+			} else {
+				++scene->culledMeshes;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Picks every mesh's LOD for the frame and counts what it saved. */
+void selectLods(Display* display, SceneArray scenes)
+{
+	const float pixelScale = display->pov.projScale
+		* (float)display->swapchain.extent.height * 0.5f;
+
+	for (int i = 0; i < scenes.count; i++) {
+		Scene* scene = &DENSE_AT(Scene, scenes, i);
+		const float maxPixels = LOD_PIXEL_ERROR * exp2f(scene->lodBias);
+
+		scene->submittedTriangles = 0;
+		scene->fullTriangles = 0;
+
+		for (int j = 0; j < scene->meshes.count; j++) {
+			Mesh* mesh = &DENSE_AT(Mesh, scene->meshes, j);
+
+			mesh->lod = selectMeshLod(
+				mesh,
+				display->pov.eye,
+				pixelScale,
+				maxPixels
+			);
+
+			scene->submittedTriangles += mesh->lods[mesh->lod].triangleCount;
+			scene->fullTriangles += mesh->lods[0].triangleCount;
+		}
+	}
+}
+
+/* Writes this frame's draw list. Every visible mesh gets an object, and
+ * the ones that aren't drawn from meshlets get a command for each submesh of
+ * their LOD. Meshes outside the pool have empty ranges, so the same sums
+ * work for them. */
+int buildDrawList(
+	Display* display,
+	SceneArray scenes,
+	const SortedDraws* draws
 )
 {
-	vkResetCommandBuffer(*cmdBuf, 0);
+	DrawList* list = &display->drawLists.lists[display->currentFrame];
+	uint32_t objectCount = 0;
+	uint32_t commandCount = 0;
+	uint32_t pooledCount = 0;
 
-	VkCommandBufferBeginInfo beginInfo = {};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	for (int i = 0; i < draws->count; i++) {
+		const DrawItem item = draws->items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
 
-	if (vkBeginCommandBuffer(*cmdBuf, &beginInfo) != VK_SUCCESS) {
-		printf("Failed to begin command buffer\n");
+		++objectCount;
+
+		if (mesh->meshletCount) continue;
+
+		commandCount += mesh->submeshCount;
+
+		if (mesh->pooled) pooledCount += mesh->submeshCount;
+	}
+
+	if (reserveDrawList(
+		list,
+		display->dev.device,
+		display->physicalDevice,
+		objectCount,
+		commandCount
+	)) {
+		printf("Failed to grow draw list\n");
 		return -1;
 	}
 
-	VkClearValue clearValues[4] = { {color: {{0.0f, 0.0f, 0.0f, 1.0f}}}, {depthStencil: {1.0f, 0}}, {color: {{0.0f, 0.0f, 0.0f, 1.0f}}}, {color: {{0.0f, 0.0f, 0.0f, 1.0f}}}
-	};
+	uint32_t object = 0;
+	uint32_t pooledDraw = 0;
+	uint32_t ownDraw = pooledCount;
 
-	VkRenderPassBeginInfo passBeginInfo = defRenderPassBeginInfo;
-	passBeginInfo.renderPass = pass.pass;
-	passBeginInfo.framebuffer = fb;
-	passBeginInfo.renderArea.offset.x = 0;
-	passBeginInfo.renderArea.offset.y = 0;
-	passBeginInfo.renderArea.extent = ext;
-	passBeginInfo.clearValueCount = 4;
-	passBeginInfo.pClearValues = clearValues;
+	for (int i = 0; i < draws->count; i++) {
+		const DrawItem item = draws->items[i];
+		Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
 
-	vkCmdBeginRenderPass(*cmdBuf, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		/* Put together here and written out whole, since the list
+		 * is probably write combined. */
+		ObjectData data = {};
 
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)ext.width;
-	viewport.height = (float)ext.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(*cmdBuf, 0, 1, &viewport);
+		memcpy(data.model.tform, mesh->tform, sizeof(mesh->tform));
+		data.texIndex = mesh->texIndex;
 
-	VkRect2D scissor = {};
-	scissor.offset.x = 0;
-	scissor.offset.y = 0;
-	scissor.extent = ext;
-	vkCmdSetScissor(*cmdBuf, 0, 1, &scissor);
+		for (int k = 0; k < 3; k++) {
+			data.model.quantOffset[k] = mesh->aabbMin[k];
+			data.model.quantScale[k] =
+				mesh->aabbMax[k] - mesh->aabbMin[k];
+		}
 
-	vkCmdBindPipeline(*cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pass.pipeline);
+		if (list->cullable) {
+			transformPoint(
+				data.sphere,
+				(const float (*)[4])mesh->tform,
+				mesh->sphereCentre
+			);
+			data.sphere[3] = mesh->sphereRadius
+				* transformMaxScale((const float (*)[4])mesh->tform);
+		}
+
+		list->objects[object] = data;
+		mesh->drawObject = object;
+		++object;
+
+		if (mesh->meshletCount) continue;
+
+		uint32_t* next = mesh->pooled ? &pooledDraw : &ownDraw;
+		const Submesh* submeshes =
+			&mesh->submeshes[mesh->lod * mesh->submeshCount];
+
+		mesh->firstDraw = *next;
+
+		for (int k = 0; k < mesh->submeshCount; k++) {
+			VkDrawIndexedIndirectCommand command = {};
+			command.indexCount = submeshes[k].indexCount;
+			command.instanceCount = 1;
+			command.firstIndex =
+				mesh->indexRange.first + submeshes[k].firstIndex;
+			command.vertexOffset = mesh->vertexRange.first;
+			command.firstInstance = mesh->drawObject;
+
+			list->commands[*next] = command;
+			++*next;
+		}
+	}
+
+	list->objectCount = objectCount;
+	list->commandCount = commandCount;
+	list->pooledCommandCount = pooledCount;
+
+	/* A count draw can't be split up like the others. Past what the device
+	 * takes in one, the pooled meshes are drawn without culling. */
+	list->culled = list->cullable
+		&& display->frustumCull
+		&& pooledCount <= display->maxDrawIndirectCount;
 
 	return 0;
 }
 
-int iterateScenes(
-	VkCommandBuffer* cmdBuf,
+int compareTextureAge(const void* a, const void* b)
+{
+	const uint64_t ageA = (*(Texture**)a)->lastUsed;
+	const uint64_t ageB = (*(Texture**)b)->lastUsed;
+
+	return (ageA > ageB) - (ageA < ageB);
+}
+
+/* Evicts the least recently used textures until size bytes are on their way
+ * out. Only textures no mesh has bound and that have sat unused for at least
+ * idleFrames are up for eviction. They come back next time they're bound. */
+int evictTextures(
+	Display* display,
 	SceneArray scenes,
-	int frame,
-	VkPipelineLayout pipelineLayout
+	VkDeviceSize size,
+	uint64_t idleFrames
 )
 {
-	VkBuffer vertexBuffers[1];
-	VkDeviceSize offsets[] = {0};
+	unsigned int candidateCount = 0;
+	unsigned int textureCount = 0;
 
-	for (int i = 0; i < scenes.sceneCount; i++) {
-		for (int j = 0; j < scenes.scenes[i].meshCount; j++) {
-			const Mesh mesh = scenes.scenes[i].meshes[j];
+	for (int i = 0; i < scenes.count; i++) {
+		textureCount += DENSE_AT(Scene, scenes, i).textures.count;
+	}
 
-			vkCmdBindDescriptorSets(
-				*cmdBuf,
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipelineLayout,
-				0,
-				1,
-				&mesh.descriptorSets[frame],
-				0,
-				0	
-			);
+	if (!textureCount) return 0;
+
+	Texture** candidates = (Texture**)
+		arenaAlloc(&display->frameArena, sizeof(Texture*) * textureCount);
+
+	if (!candidates) {
+		printf("Failed to allocate eviction candidates\n");
+		return -1;
+	}
+
+	for (int i = 0; i < scenes.count; i++) {
+		Scene* scene = &DENSE_AT(Scene, scenes, i);
+
+		for (int j = 0; j < scene->textures.count; j++) {
+			Texture* tex = &DENSE_AT(Texture, scene->textures, j);
+
+			if (!tex->resident) continue;
 
-			vertexBuffers[0] = mesh.vertexBuffer;
-			vkCmdBindVertexBuffers(*cmdBuf, 0, 1, vertexBuffers, offsets);
+			/* Bound textures are drawn every frame. */
+			if (textureInUse(scene, j)) {
+				tex->lastUsed = display->frameCount;
+				continue;
+			}
 
-			vkCmdBindIndexBuffer(*cmdBuf, mesh.indexBuffer, 0, mesh.indexType);
-			
-			vkCmdDrawIndexed(*cmdBuf, mesh.indexCount, 1, 0, 0, 0);
+			/* Textures without a path can't be loaded again. */
+			if (
+				!tex->path
+				|| display->frameCount - tex->lastUsed < idleFrames
+			) {
+				continue;
+			}
+
+			candidates[candidateCount] = tex;
+			++candidateCount;
 		}
 	}
 
+	qsort(candidates, candidateCount, sizeof(Texture*), compareTextureAge);
+
+	VkDeviceSize evicted = 0;
+
+	for (int i = 0; i < candidateCount && evicted < size; i++) {
+		evicted += candidates[i]->memSize;
+		evictTexture(&display->garbage, candidates[i]);
+	}
+
+	return 0;
+}
+
+/* Keeps the server under budget, giving textures a while unused before
+ * they're evicted. */
+int enforceMemoryBudget(Display* display, SceneArray scenes)
+{
+	VkDeviceSize overrun = budgetOverrun(
+		&display->budget,
+		display->physicalDevice,
+		display->garbage.pendingBytes
+	);
+
+	if (!overrun) return 0;
+
+	return evictTextures(
+		display,
+		scenes,
+		overrun,
+		display->budget.evictFrames
+	);
+}
+
+/* For when an allocation has already failed. Unbound textures go however
+ * recently they were used, and the device is waited on so they and the rest
+ * of the garbage are actually freed before the allocation is tried again.
+ * That stalls, but only on the way to failing a command otherwise. */
+int reclaimDeviceMemory(Display* display, VkDeviceSize size)
+{
+	printf(
+		"Out of device memory, evicting textures to make %llu KiB.\n",
+		(unsigned long long)(size >> 10)
+	);
+
+	if (display->scenes && evictTextures(
+		display,
+		*display->scenes,
+		size,
+		0
+	)) {
+		return -1;
+	}
+
+	vkDeviceWaitIdle(display->dev.device);
+
+	flushGarbage(
+		&display->garbage,
+		display->dev.device,
+		&display->meshDescAlloc,
+		display->bindless ? &display->texTable : 0,
+		display->multiDraw ? &display->geomPool : 0,
+		&display->budget
+	);
+
 	return 0;
 }
 
@@ -132,35 +1110,21 @@ int endRenderPass(VkCommandBuffer* cmdBuf, VkQueue queue, FrameSync sync)
 	return 0;
 }
 
-int endRenderPassA(VkCommandBuffer* cmdBuf, VkQueue queue, FrameSync sync)
+/* Once per frame, before anything touches the current frame's copies of
+ * descriptor sets and buffers. That includes the scenes' uniform commands as
+ * well as renderScenes(). */
+void waitForFrame(Display* display)
 {
-	vkCmdEndRenderPass(*cmdBuf);
-
-	if (vkEndCommandBuffer(*cmdBuf) != VK_SUCCESS) {
-		printf("Failed to record command buffer.\n");
-		return -1;
-	}
-
-	VkSemaphore signalSemaphores[] = {sync.renderDone};
-
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	VkPipelineStageFlags waitStages =
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	submitInfo.pWaitDstStageMask = &waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = cmdBuf;
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
-
-	if (vkQueueSubmit(queue, 1, &submitInfo, sync.inFlight) != VK_SUCCESS) {
-		printf("Failed to submit draw command buffer\n");
-		return -1;
-	}
-
-	return 0;
+	vkWaitForFences(
+		display->dev.device,
+		1,
+		&display->geomSync[display->currentFrame].inFlight,
+		VK_TRUE,
+		UINT64_MAX
+	);
 }
 
+/* The current frame has to have been waited for already. */
 int renderScenes(Display* display, SceneArray scenes)
 {
 	/* The window needs regular polling to close when ordered to */
@@ -169,96 +1133,288 @@ int renderScenes(Display* display, SceneArray scenes)
 	if (glfwWindowShouldClose(display->window)) return 1;
 #endif
 
-	/* Geometry Pass */
-
-	vkWaitForFences(
+	/* The framebuffer depends on the swapchain image, so it's needed
+	 * before anything is recorded. The fence stays signalled if the
+	 * swapchain has to be recreated, since nothing gets submitted. */
+	uint32_t imageIndex;
+	VkResult result = vkAcquireNextImageKHR(
 		display->dev.device,
-		1,
-		&display->geomSync[display->currentFrame].inFlight,
-		VK_TRUE,
-		UINT64_MAX
+		display->swapchain.swapchain,
+		UINT64_MAX,
+		display->geomSync[display->currentFrame].imageAvailable,
+		VK_NULL_HANDLE,
+		&imageIndex
 	);
 
+	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		if (recreateSwapchain(display)) return -1;
+		if (recreateRenderPasses(display)) return -1;
+		if (recreatePOV(display)) return -1;
+		return 0;
+	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+		printf("Failed to acquire swapchain image.\n");
+	}
+
 	vkResetFences(
 		display->dev.device,
 		1, 
 		&display->geomSync[display->currentFrame].inFlight
 	);
 
-	if (beginRenderPass(
-		&display->geom.commandBuffers[display->currentFrame],
-		display->geom,
-		display->geomFb[display->currentFrame],
-		display->swapchain.extent
-	)) {
-		printf("Failed to begin render pass\n");
+	/* Nothing from the last frame's scratch memory is still around. */
+	arenaReset(&display->frameArena);
+
+	/* This frame's timestamps from last time round are done too. */
+	readLightTimings(
+		&display->lights,
+		display->dev.device,
+		display->currentFrame
+	);
+
+	/* Anything thrown away before this frame's last submission is done
+	 * with now. */
+	collectGarbage(
+		&display->garbage,
+		display->currentFrame,
+		display->dev.device,
+		&display->meshDescAlloc,
+		display->bindless ? &display->texTable : 0,
+		display->multiDraw ? &display->geomPool : 0,
+		&display->budget
+	);
+
+	if (enforceMemoryBudget(display, scenes)) {
 		return -1;
 	}
 
-	if (iterateScenes(
-		&display->geom.commandBuffers[display->currentFrame],
+	if (cullMeshes(display, scenes)) {
+		return -1;
+	}
+
+	selectLods(display, scenes);
+
+	if (sortDraws(
+		&display->sortedDraws,
+		&display->frameArena,
 		scenes,
+		display->pov.eye
+	)) {
+		printf("Failed to sort draws\n");
+		return -1;
+	}
+
+	/* Before the lights are written, since they say whose shadow tiles
+	 * are ready */
+	updateShadowCasters(&display->shadows.cache, scenes);
+	assignShadowTiles(&display->shadows.cache, scenes);
+
+	/* A new light buffer has to be named in the beauty subpass's set as
+	 * well as cluster.comp's. */
+	const int lightResult = writeLights(
+		&display->lights,
+		display->dev.device,
+		display->physicalDevice,
 		display->currentFrame,
-		display->geom.pipelineLayout
+		scenes,
+		&display->pov.uniforms
+	);
+
+	if (lightResult < 0) return -1;
+	if (lightResult) writeBeautyLights(display, display->currentFrame);
+
+	/* Before culling meshlets, which needs to know every mesh's object */
+	if (display->multiDraw && buildDrawList(
+		display,
+		scenes,
+		&display->sortedDraws
+	)) {
+		return -1;
+	}
+
+	/* Scenes, or draw list chunks, whose draws haven't changed get their
+	 * commands from last time. */
+	VkCommandBuffer* cachedCmdBufs = 0;
+	unsigned int cachedCmdBufCount = 0;
+
+	/* Recording the geometry subpass is timed for printDrawStats(). Only
+	 * one of the parts runs, depending on the draw mode. */
+	uint64_t recordStart = recordClockNanos();
+
+	if (display->cacheCommands && display->multiDraw) {
+		if (recordDrawListCommands(
+			display,
+			scenes,
+			&cachedCmdBufs,
+			&cachedCmdBufCount
+		)) {
+			return -1;
+		}
+	} else if (display->cacheCommands && recordSceneCommands(
+		display,
+		scenes,
+		&cachedCmdBufs,
+		&cachedCmdBufCount
+	)) {
+		return -1;
+	}
+
+	uint64_t recordNanos = recordClockNanos() - recordStart;
+
+	if (beginCommandBuffer(
+		&display->geom.commandBuffers[display->currentFrame]
 	)) {
 		return -1;
 	}
 
-	if (endRenderPassA(
+	if (recordShadows(
 		&display->geom.commandBuffers[display->currentFrame],
-		display->dev.graphicsQueue,
-		display->geomSync[display->currentFrame]
+		&display->shadows,
+		scenes
 	)) {
 		return -1;
 	}
 
-	/* Beauty Pass*/
+	/* The depth pyramid comes from the geometry pass before this one.
+	 * There's none to use on the first frame after the attachments are
+	 * made. */
+	const char occlusionCull = display->occlusionCull
+		&& display->depthPyramid.depthFrames;
 
-	vkWaitForFences(
-		display->dev.device,
-		1,
-		&display->beautySync[display->currentFrame].inFlight,
-		VK_TRUE,
-		UINT64_MAX
-	);
+	if (occlusionCull) {
+		const unsigned int lastFrame =
+			(display->currentFrame + MAX_FRAMES_IN_FLIGHT - 1)
+			% MAX_FRAMES_IN_FLIGHT;
 
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(
-		display->dev.device,
-		display->swapchain.swapchain,
-		UINT64_MAX,
-		display->beautySync[display->currentFrame].imageAvailable,
-		VK_NULL_HANDLE,
-		&imageIndex
+		buildDepthPyramid(
+			&display->geom.commandBuffers[display->currentFrame],
+			&display->depthPyramid,
+			display->depth[lastFrame].image,
+			lastFrame
+		);
+	}
+
+	if (display->meshletCull && cullMeshlets(
+		&display->geom.commandBuffers[display->currentFrame],
+		scenes,
+		display->currentFrame,
+		display->cullPipelineLayout,
+		display->cullPipeline,
+		display->depthPyramid.cullSet,
+		display->coneCull,
+		occlusionCull
+	)) {
+		return -1;
+	}
+
+	const DrawList* drawList = &display->drawLists.lists[display->currentFrame];
+
+	if (display->multiDraw && drawList->culled) {
+		cullDrawList(
+			&display->geom.commandBuffers[display->currentFrame],
+			drawList,
+			display->drawCullPipelineLayout,
+			display->drawCullPipeline,
+			display->depthPyramid.cullSet,
+			occlusionCull
+		);
+	}
+
+	binLights(
+		&display->geom.commandBuffers[display->currentFrame],
+		&display->lights,
+		display->currentFrame
 	);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		if (recreateSwapchain(display)) return -1;
-		if (recreateRenderPasses(display)) return -1;
-		if (recreatePOV(display)) return -1;
-		return 0;
-	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-		printf("Failed to acquire swapchain image.\n");
+	/* Geometry Subpass */
+
+	if (beginRenderPass(
+		&display->geom.commandBuffers[display->currentFrame],
+		display->geom,
+		display->frameFb[
+			imageIndex * MAX_FRAMES_IN_FLIGHT + display->currentFrame
+		],
+		display->swapchain.extent,
+		display->cacheCommands
+		? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+		: VK_SUBPASS_CONTENTS_INLINE
+	)) {
+		printf("Failed to begin render pass\n");
+		return -1;
+	}
+
+	recordStart = recordClockNanos();
+
+	if (display->cacheCommands) {
+		if (cachedCmdBufCount) {
+			vkCmdExecuteCommands(
+				display->geom.commandBuffers[display->currentFrame],
+				cachedCmdBufCount,
+				cachedCmdBufs
+			);
+		}
+	} else if (display->multiDraw) {
+		const DrawList* drawList =
+			&display->drawLists.lists[display->currentFrame];
+		const DrawListChunk chunk =
+			wholeDrawList(drawList, &display->sortedDraws);
+
+		if (iterateDrawList(
+			&display->geom.commandBuffers[display->currentFrame],
+			scenes,
+			&display->sortedDraws,
+			display->geom.pipelineLayout,
+			display->texTable.set,
+			drawList,
+			&display->geomPool,
+			display->maxDrawIndirectCount,
+			&chunk
+		)) {
+			return -1;
+		}
+	} else if (iterateScenes(
+		&display->geom.commandBuffers[display->currentFrame],
+		scenes,
+		&display->sortedDraws,
+		display->currentFrame,
+		display->geom.pipelineLayout,
+		display->bindless ? display->texTable.set : VK_NULL_HANDLE
+	)) {
+		return -1;
 	}
 
-	vkResetFences(
-		display->dev.device,
-		1, 
-		&display->beautySync[display->currentFrame].inFlight
+	recordNanos += recordClockNanos() - recordStart;
+	display->lastRecordNanos = recordNanos;
+	display->totalRecordNanos += recordNanos;
+	++display->recordFrames;
+
+	/* Beauty Subpass
+	 * Reads the G-buffer straight out of the attachments, which can stay
+	 * in tile memory on GPUs that have it. */
+
+	vkCmdNextSubpass(
+		display->geom.commandBuffers[display->currentFrame],
+		VK_SUBPASS_CONTENTS_INLINE
 	);
 
-	if (beginRenderPass(
-		&display->beauty.commandBuffers[display->currentFrame],
+	/* The G-buffer subpass can be all secondary command buffers, which
+	 * leaves no room for a timestamp, so shading starts being timed here.
+	 * Bottom of pipe still waits on the G-buffer being finished. */
+	writeLightTimestamp(
+		&display->geom.commandBuffers[display->currentFrame],
+		&display->lights,
+		display->currentFrame,
+		LIGHT_QUERY_SHADE_START,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+	);
+
+	bindPassState(
+		&display->geom.commandBuffers[display->currentFrame],
 		display->beauty,
-		display->beautyFb[imageIndex],
 		display->swapchain.extent
-	)) {
-		printf("Failed to begin render pass\n");
-		return -1;
-	}
+	);
 
 	vkCmdBindDescriptorSets(
-		display->beauty.commandBuffers[display->currentFrame],
+		display->geom.commandBuffers[display->currentFrame],
 		VK_PIPELINE_BIND_POINT_GRAPHICS,
 		display->beauty.pipelineLayout,
 		0,
@@ -269,28 +1425,41 @@ int renderScenes(Display* display, SceneArray scenes)
 	);
 
 	vkCmdDraw(
-		display->beauty.commandBuffers[display->currentFrame],
+		display->geom.commandBuffers[display->currentFrame],
 		3, 1, 0, 0
 	);
 
+	writeLightTimestamp(
+		&display->geom.commandBuffers[display->currentFrame],
+		&display->lights,
+		display->currentFrame,
+		LIGHT_QUERY_SHADE_END,
+		VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+	);
+
+	/* One submission for the whole frame */
 	if (endRenderPass(
-		&display->beauty.commandBuffers[display->currentFrame],
+		&display->geom.commandBuffers[display->currentFrame],
 		display->dev.graphicsQueue,
-		display->beautySync[display->currentFrame]
+		display->geomSync[display->currentFrame]
 	)) {
 		return -1;
 	}
 
+	/* Meshes and textures deleted from here on could be in this frame. */
+	display->garbage.frame = display->currentFrame;
+	++display->frameCount;
+	++display->depthPyramid.depthFrames;
+
 	/* Post-render */
 
 	VkSemaphore waitSemaphores[] = {
-		display->beautySync[display->currentFrame].renderDone,
 		display->geomSync[display->currentFrame].renderDone
 	};
 
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 2;
+	presentInfo.waitSemaphoreCount = 1;
 	presentInfo.pWaitSemaphores = waitSemaphores;
 	presentInfo.pImageIndices = &imageIndex;
 
@@ -462,8 +1631,167 @@ int createDisplaySurface(Display* display) {
 
 #endif /* HAVE_LIBDRM == 1 && !WINDOWED */
 
+/* Bindless textures get used whenever the device can do them. Setting
+ * IGNI_RENDER_BINDLESS=0 forces the old per-mesh bindings. */
+void selectTextureMode(Display* display)
+{
+	const char* bindlessEnv = getenv("IGNI_RENDER_BINDLESS");
+
+	display->bindless = deviceSupportsBindless(display->physicalDevice);
+
+	if (bindlessEnv && !strcmp(bindlessEnv, "0")) {
+		display->bindless = 0;
+	}
+
+	printf(
+		"Texture mode: %s\n",
+		display->bindless ? "bindless" : "per-mesh"
+	);
+}
+
+/* Packed vertices are opt in with IGNI_RENDER_PACKED_VERTICES=1. They cost
+ * a little precision on big meshes. Optimising meshes on import is on unless
+ * IGNI_RENDER_MESH_OPTIMIZE=0, for when imports need to be quick. LODs are
+ * the same with IGNI_RENDER_LODS=0, which also saves their index memory. */
+void selectVertexFormat(Display* display)
+{
+	const char* packedEnv = getenv("IGNI_RENDER_PACKED_VERTICES");
+	const char* optimizeEnv = getenv("IGNI_RENDER_MESH_OPTIMIZE");
+	const char* lodEnv = getenv("IGNI_RENDER_LODS");
+
+	display->packedVertices = packedEnv && !strcmp(packedEnv, "1");
+	display->optimizeMeshes = !optimizeEnv || strcmp(optimizeEnv, "0");
+	display->generateLods = !lodEnv || strcmp(lodEnv, "0");
+
+	printf(
+		"Vertex format: %s%s%s\n",
+		display->packedVertices ? "packed" : "full",
+		display->optimizeMeshes ? ", optimised on import" : "",
+		display->generateLods ? ", LODs" : ""
+	);
+}
+
+/* Meshlet culling is on wherever the device can fill its own draw lists.
+ * IGNI_RENDER_MESHLETS=0 turns it off. Cone culling throws away meshlets
+ * facing away from the viewpoint and is opt in with
+ * IGNI_RENDER_CONE_CULL=1, for scenes without double sided meshes. Meshlets
+ * behind the last frame's depth go too, unless IGNI_RENDER_HIZ=0. Whole
+ * meshes are frustum culled on the CPU unless IGNI_RENDER_FRUSTUM_CULL=0. */
+void selectCullMode(Display* display)
+{
+	const char* meshletEnv = getenv("IGNI_RENDER_MESHLETS");
+	const char* coneEnv = getenv("IGNI_RENDER_CONE_CULL");
+	const char* frustumEnv = getenv("IGNI_RENDER_FRUSTUM_CULL");
+	const char* hizEnv = getenv("IGNI_RENDER_HIZ");
+
+	display->frustumCull = !frustumEnv || strcmp(frustumEnv, "0");
+
+	display->meshletCull = deviceSupportsMeshletCull(display->physicalDevice);
+
+	if (meshletEnv && !strcmp(meshletEnv, "0")) {
+		display->meshletCull = 0;
+	}
+
+	display->coneCull = display->meshletCull
+		&& coneEnv && !strcmp(coneEnv, "1");
+	display->occlusionCull = display->meshletCull
+		&& (!hizEnv || strcmp(hizEnv, "0"));
+
+	printf(
+		"Culling: %s%s%s%s\n",
+		display->frustumCull ? "meshes, " : "",
+		display->meshletCull ? "meshlets" : "no meshlets",
+		display->coneCull ? ", normal cones" : "",
+		display->occlusionCull ? ", depth pyramid" : ""
+	);
+}
+
+/* For SIGUSR1. How long the CPU spent recording the geometry subpass, and
+ * how that was split between the recording threads when there are any. */
+void printDrawStats(const Display* display)
+{
+	printf(
+		"Geometry pass recording: last %.3f ms, average %.3f ms over %llu "
+		"frames\n",
+		display->lastRecordNanos / 1e6,
+		display->recordFrames
+		? display->totalRecordNanos / 1e6 / display->recordFrames
+		: 0.0,
+		(unsigned long long)display->recordFrames
+	);
+
+	if (display->cacheCommands) printRecorderStats(display->recorder);
+}
+
+/* The geometry pass draws from per-frame draw lists wherever the device can
+ * take a different first instance for every indirect draw and textures are
+ * bindless. Where meshlets are culled as well, so are the lists' pooled
+ * meshes, by instcull.comp instead of the CPU, unless IGNI_RENDER_GPU_CULL=0.
+ * IGNI_RENDER_MULTIDRAW=0 goes back to binding and drawing each
+ * mesh on its own.
+ *
+ * Either way, the geometry pass is recorded into secondary command buffers
+ * that are reused until what they were recorded from changes, each scene's
+ * or the draw list's. They're recorded on up to IGNI_RENDER_RECORD_THREADS
+ * threads. IGNI_RENDER_CACHE_COMMANDS=0 records everything inline every
+ * frame instead. */
+void selectDrawMode(Display* display)
+{
+	const char* multiDrawEnv = getenv("IGNI_RENDER_MULTIDRAW");
+	const char* cacheEnv = getenv("IGNI_RENDER_CACHE_COMMANDS");
+	const char* threadsEnv = getenv("IGNI_RENDER_RECORD_THREADS");
+	const char* gpuCullEnv = getenv("IGNI_RENDER_GPU_CULL");
+
+	display->multiDraw = display->bindless
+		&& deviceSupportsMultiDraw(display->physicalDevice);
+
+	if (multiDrawEnv && !strcmp(multiDrawEnv, "0")) {
+		display->multiDraw = 0;
+	}
+
+	/* The count draw and the depth pyramid both come with meshlet
+	 * culling. */
+	display->gpuCull = display->multiDraw
+		&& display->meshletCull
+		&& (!gpuCullEnv || strcmp(gpuCullEnv, "0"));
+
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(display->physicalDevice, &properties);
+	display->maxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
+
+	display->cacheCommands = !cacheEnv || strcmp(cacheEnv, "0");
+
+	/* A thread for every core, counting the main one, unless there's a
+	 * number in IGNI_RENDER_RECORD_THREADS. */
+	const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	display->recordThreads = threadsEnv
+		? strtoul(threadsEnv, 0, 10)
+		: cores > 0 ? cores : 1;
+
+	if (display->recordThreads < 1) display->recordThreads = 1;
+	if (display->recordThreads > RECORDER_MAX_WORKERS) {
+		display->recordThreads = RECORDER_MAX_WORKERS;
+	}
+
+	printf(
+		"Draw submission: %s%s%s\n",
+		display->multiDraw ? "multi-draw indirect" : "per mesh",
+		display->gpuCull ? ", culled on the GPU" : "",
+		!display->cacheCommands ? ""
+		: display->multiDraw ? ", cached draw list"
+		: ", cached per scene"
+	);
+
+	if (display->cacheCommands) {
+		printf("Recording threads: %u\n", display->recordThreads);
+	}
+}
+
 int createDisplay(Display* display)
 {
+	/* Set by the main loop once there are scenes */
+	display->scenes = 0;
 
 	unsigned int instLayerCount = 1; 
 	const char* instLayers[] = {"VK_LAYER_KHRONOS_validation"}; 
@@ -474,8 +1802,12 @@ int createDisplay(Display* display)
 
 	unsigned int instExtCount = 0; 
 	const char** instExtensions; 
-	const unsigned int deviceExtensionCount = 1;
-	const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+	/* Required extensions first, then optional ones */
+	unsigned int deviceExtensionCount = 1;
+	const char* deviceExtensions[] = {
+		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+	};
 
 	glfwInit();
 
@@ -519,6 +1851,18 @@ int createDisplay(Display* display)
 		return -1;
 	}
 
+	selectTextureMode(display);
+	selectVertexFormat(display);
+	selectCullMode(display);
+	selectDrawMode(display);
+
+	display->memoryBudgetExt = deviceHasExtensions(
+		display->physicalDevice,
+		&deviceExtensions[deviceExtensionCount],
+		1
+	);
+	deviceExtensionCount += display->memoryBudgetExt;
+
 	if (createLogicalDevice(
 		&display->dev,
 		display->physicalDevice,
@@ -526,7 +1870,10 @@ int createDisplay(Display* display)
 		deviceExtensions,
 		deviceExtensionCount,
 		instLayerCount,
-		instLayers
+		instLayers,
+		display->bindless,
+		display->meshletCull,
+		display->multiDraw
 	)) {
 		return -1;
 	}
@@ -549,10 +1896,11 @@ int createDisplay(Display* display)
 		"VK_KHR_external_memory_capabilities"
 	};
 
-	const unsigned int deviceExtensionCount = 1;
+	/* Required extensions first, then optional ones */
+	unsigned int deviceExtensionCount = 1;
 	const char* deviceExtensions[] = {
-
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
+		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
 	};
 
 	if(createInstance(
@@ -575,6 +1923,18 @@ int createDisplay(Display* display)
 		return -1;
 	}
 
+	selectTextureMode(display);
+	selectVertexFormat(display);
+	selectCullMode(display);
+	selectDrawMode(display);
+
+	display->memoryBudgetExt = deviceHasExtensions(
+		display->physicalDevice,
+		&deviceExtensions[deviceExtensionCount],
+		1
+	);
+	deviceExtensionCount += display->memoryBudgetExt;
+
 	printf("Create FUllScreen Display\n");
 
 	if (createDisplaySurface(display)) {
@@ -588,7 +1948,10 @@ int createDisplay(Display* display)
 		deviceExtensions,
 		deviceExtensionCount,
 		instLayerCount,
-		instLayers
+		instLayers,
+		display->bindless,
+		display->meshletCull,
+		display->multiDraw
 	)) {
 		return -1;
 	}
@@ -640,6 +2003,10 @@ int createDisplay(Display* display)
 	   	10.0f
 	);
 
+	display->pov.eye = eye;
+	display->pov.projScale = fabsf(ubo.proj.y.y);
+	display->pov.uniforms = ubo;
+
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		memcpy(display->pov.uboMapped[i], &ubo, sizeof(ViewpointUniforms));
 	}
@@ -661,6 +2028,34 @@ int createDisplay(Display* display)
 		return -1;
 	}
 
+	if (createSamplerCache(&display->samplers, display->physicalDevice)) {
+		return -1;
+	}
+
+	if (createDescriptorAllocator(&display->meshDescAlloc)) {
+		return -1;
+	}
+
+	if (createGarbageQueue(&display->garbage)) {
+		return -1;
+	}
+
+	if (createMemoryBudget(
+		&display->budget,
+		display->physicalDevice,
+		display->memoryBudgetExt
+	)) {
+		return -1;
+	}
+
+	display->frameCount = 0;
+	display->passGeneration = 0;
+	display->lastRecordNanos = 0;
+	display->totalRecordNanos = 0;
+	display->recordFrames = 0;
+
+	createArena(&display->frameArena, ARENA_DEFAULT_BLOCK_SIZE);
+
 	/* Null Texture - a 1x1 magenta pixel */
 
 	display->nulTexture.width = 1;
@@ -669,11 +2064,14 @@ int createDisplay(Display* display)
 	if (createTexture(
 		&display->nulTexture, 
 		display->dev.device,
-		display->physicalDevice
+		display->physicalDevice,
+		&display->samplers
 	)) {
 		return -1;
 	}
 
+	budgetCharge(&display->budget, display->nulTexture.memSize);
+
 	unsigned char magenta[4] = {255, 0, 255, 255};
 
 	if (writeTexture(
@@ -687,6 +2085,125 @@ int createDisplay(Display* display)
 		return -1;
 	}
 
+	/* Texture Table - the null texture goes in first so it ends up in
+	 * TEX_TABLE_NUL_SLOT */
+
+	if (display->bindless) {
+		if (createTextureTable(
+			&display->texTable,
+			display->dev.device,
+			&display->samplers
+		)) {
+			return -1;
+		}
+
+		if (texTableAdd(
+			&display->texTable,
+			display->dev.device,
+			display->nulTexture.view,
+			&display->nulTexture.tableSlot
+		)) {
+			return -1;
+		}
+	}
+
+	/* Geometry Pool and Draw Lists */
+
+	if (display->multiDraw) {
+		if (createGeometryPool(
+			&display->geomPool,
+			display->dev.device,
+			display->physicalDevice,
+			display->packedVertices ? sizeof(PackedVertex) : sizeof(Vertex)
+		)) {
+			printf("Failed to create geometry pool\n");
+			return -1;
+		}
+
+		if (createDrawLists(
+			&display->drawLists,
+			display->dev.device,
+			display->physicalDevice,
+			&display->pov,
+			display->gpuCull
+		)) {
+			return -1;
+		}
+	}
+
+	/* Point Lights */
+
+	if (createLightClusters(
+		&display->lights,
+		display->dev.device,
+		display->physicalDevice,
+		&display->pov
+	)) {
+		return -1;
+	}
+
+	/* A fixed number of made up lights on top of the scenes', for seeing
+	 * how lighting scales */
+	const char* benchLightsEnv = getenv("IGNI_RENDER_BENCH_LIGHTS");
+
+	if (benchLightsEnv) {
+		display->lights.benchLights = strtoul(benchLightsEnv, 0, 10);
+		printf("Made up lights: %u\n", display->lights.benchLights);
+	}
+
+	/* Shadows */
+
+	if (createShadowAtlas(
+		&display->shadows,
+		display->cmd,
+		display->dev.graphicsQueue,
+		display->dev.device,
+		display->physicalDevice,
+		&display->samplers,
+		display->packedVertices
+	)) {
+		return -1;
+	}
+
+	/* How many tiles can be drawn a frame, for trading how quickly shadows
+	 * catch up against the frame time */
+	const char* shadowBudgetEnv = getenv("IGNI_RENDER_SHADOW_BUDGET");
+
+	if (shadowBudgetEnv) {
+		const unsigned long budget = strtoul(shadowBudgetEnv, 0, 10);
+
+		display->shadows.cache.budget =
+			budget < SHADOW_TILE_COUNT ? budget : SHADOW_TILE_COUNT;
+	}
+
+	printf("Shadow tiles a frame: %u\n", display->shadows.cache.budget);
+
+	/* Scene Recording Threads */
+
+	if (display->cacheCommands) {
+		display->recorder = (SceneRecorder*)malloc(sizeof(SceneRecorder));
+
+		if (!display->recorder) {
+			perror("Failed to allocate scene recorder");
+			return -1;
+		}
+
+		if (createSceneRecorder(
+			display->recorder,
+			display->dev.device,
+			display->physicalDevice,
+			display->surface,
+			display->recordThreads
+		)) {
+			return -1;
+		}
+
+		/* The buffers are freed with the recorder's pools. */
+		for (int i = 0; i < RECORDER_MAX_WORKERS; i++) {
+			display->drawListCommands[i] = (CommandCache){};
+		}
+	}
+
 	return 0;
 }
 
@@ -702,6 +2219,34 @@ int createRenderPasses(Display* display)
 		return -1;
 	}
 
+	/* The depth attachments are transient unless the pyramid is built
+	 * from them, in which case createGeomPass() keeps them sampleable.
+	 * Meshlet culling needs a pyramid to name either way. */
+	if (display->meshletCull && createDepthPyramid(
+		&display->depthPyramid,
+		display->cmd,
+		display->dev.graphicsQueue,
+		display->dev.device,
+		display->physicalDevice,
+		&display->samplers,
+		display->swapchain.extent,
+		findDepthFormat(display->physicalDevice),
+		display->occlusionCull ? display->depth : 0
+	)) {
+		printf("Failed to create depth pyramid.\n");
+		return -1;
+	}
+
+	if (display->meshletCull && createCullPipeline(display)) {
+		printf("Failed to create meshlet culling pipeline.\n");
+		return -1;
+	}
+
+	if (display->gpuCull && createDrawListCullPipeline(display)) {
+		printf("Failed to create draw list culling pipeline.\n");
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -714,69 +2259,114 @@ int createGeomPass(Display* display)
 		}
 	}
 
-	/* Framebuffer Attachments */
-	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		/* Depth Buffer */
-		if (createFramebufferAttachment(
-			&display->depth[i],
-			findDepthFormat(display->physicalDevice),
+	/* Framebuffer Attachments
+	 * The colour and normal never leave the render pass, so they're
+	 * transient and every frame in flight's copy shares the same memory.
+	 * So does the depth unless the depth pyramid needs last frame's. */
+
+	const char transientDepth = !display->occlusionCull;
+	const VkFormat depthFormat = findDepthFormat(display->physicalDevice);
+
+	if (transientDepth) {
+		if (createAliasedAttachments(
+			display->depth,
+			MAX_FRAMES_IN_FLIGHT,
+			depthFormat,
 			display->dev.device,
 			display->physicalDevice,
+			&display->samplers,
 			display->swapchain.extent,
 			VK_IMAGE_ASPECT_DEPTH_BIT,
 			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+			| VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
+			| VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
 		)) {
 			return -1;
 		}
-
-		/* Colour */
-		if (createFramebufferAttachment(
-			&display->colour[i],
-			VK_FORMAT_R8G8B8A8_UNORM,
-			display->dev.device,
-			display->physicalDevice,
-			display->swapchain.extent,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-			VK_IMAGE_USAGE_SAMPLED_BIT
-		)) {
-			return -1;
+	} else {
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			if (createFramebufferAttachment(
+				&display->depth[i],
+				depthFormat,
+				display->dev.device,
+				display->physicalDevice,
+				&display->samplers,
+				display->swapchain.extent,
+				VK_IMAGE_ASPECT_DEPTH_BIT,
+				VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+				| VK_IMAGE_USAGE_SAMPLED_BIT
+				| VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
+			)) {
+				return -1;
+			}
 		}
+	}
 
-		/* Normal */
-		if (createFramebufferAttachment(
-			&display->normal[i],
-			VK_FORMAT_R8G8B8A8_UNORM,
-			display->dev.device,
-			display->physicalDevice,
-			display->swapchain.extent,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-			VK_IMAGE_USAGE_SAMPLED_BIT
-		)) {
-			return -1;
-		}
+	/* Colour */
+	if (createAliasedAttachments(
+		display->colour,
+		MAX_FRAMES_IN_FLIGHT,
+		VK_FORMAT_R8G8B8A8_UNORM,
+		display->dev.device,
+		display->physicalDevice,
+		&display->samplers,
+		display->swapchain.extent,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+	)) {
+		return -1;
+	}
 
-		/* Position */
-		if (createFramebufferAttachment(
-			&display->position[i],
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			display->dev.device,
-			display->physicalDevice,
-			display->swapchain.extent,
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
-			VK_IMAGE_USAGE_SAMPLED_BIT
-		)) {
-			return -1;
-		}
+	/* Normal, octahedral encoded. Half floats rather than snorm since
+	 * every device has to be able to render to them. */
+	if (createAliasedAttachments(
+		display->normal,
+		MAX_FRAMES_IN_FLIGHT,
+		VK_FORMAT_R16G16_SFLOAT,
+		display->dev.device,
+		display->physicalDevice,
+		&display->samplers,
+		display->swapchain.extent,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+	)) {
+		return -1;
+	}
+
+	VkDeviceSize gBufferSize = 0;
+	char gBufferLazy = 1;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		gBufferSize += display->colour[i].memSize
+			+ display->normal[i].memSize
+			+ display->depth[i].memSize;
+		gBufferLazy &= display->colour[i].lazy && display->normal[i].lazy;
 	}
 
+	printf(
+		"G-buffer memory: %llu KiB%s\n",
+		(unsigned long long)gBufferSize / 1024,
+		gBufferLazy ? ", colour and normal lazily allocated" : ""
+	);
 
-	/* Render Pass */
+	/* Render Pass
+	 * The G-buffer is written by the first subpass and read as input
+	 * attachments by the second, which draws to the swapchain image. Only
+	 * the depth can outlive the pass, for the depth pyramid. Positions are
+	 * worked back out of the depth, so there's no attachment for them.
+	 *
+	 * The normals and the swapchain image don't get cleared. The beauty
+	 * pass writes every pixel of the swapchain image and only reads the
+	 * normal where the depth says something was drawn. The colour still
+	 * is, since meshes are blended onto it. */
 
 	VkAttachmentDescription colourAttachment = defAttachmentDescription;
-	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colourAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	colourAttachment.format = VK_FORMAT_R8G8B8A8_UNORM;
 
 	VkAttachmentReference colourAttachmentRef = {};
@@ -786,116 +2376,133 @@ int createGeomPass(Display* display)
 	VkAttachmentDescription depthAttachment = defAttachmentDescription;
 	depthAttachment.finalLayout = 
 		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	depthAttachment.format = findDepthFormat(display->physicalDevice);
+	depthAttachment.format = depthFormat;
+
+	if (transientDepth) {
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
 
 	VkAttachmentReference depthAttachmentRef = {};
 	depthAttachmentRef.layout = 
 		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	depthAttachmentRef.attachment = 1;
 
-	VkAttachmentDescription normalAttachment = defAttachmentDescription;
-	normalAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	normalAttachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+	VkAttachmentDescription normalAttachment = colourAttachment;
+	normalAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	normalAttachment.format = VK_FORMAT_R16G16_SFLOAT;
 
 	VkAttachmentReference normalAttachmentRef = {};
 	normalAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	normalAttachmentRef.attachment = 2;
 
-	VkAttachmentDescription posAttachment = defAttachmentDescription;
-	posAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	posAttachment.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	VkAttachmentDescription beautyAttachment = defAttachmentDescription;
+	beautyAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	beautyAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	beautyAttachment.format = display->swapchain.imageFormat;
 
-	VkAttachmentReference posAttachmentRef = {};
-	posAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	posAttachmentRef.attachment = 3;
+	VkAttachmentReference beautyAttachmentRef = {};
+	beautyAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	beautyAttachmentRef.attachment = 3;
 
 	const int attachmentCount = 4;
 	VkAttachmentDescription attachments[] =  {
 		colourAttachment, 
 		depthAttachment,
 		normalAttachment,
-	   	posAttachment
-	};
-	VkAttachmentReference attachmentRefs[] =  {
-		colourAttachmentRef,
-		depthAttachmentRef,
-		normalAttachmentRef,
-		posAttachmentRef
+		beautyAttachment
 	};
-	const int colourAttachmentCount = 3;
+	const int colourAttachmentCount = 2;
 	VkAttachmentReference colourAttachmentRefs[] = {
 		colourAttachmentRef,
-		normalAttachmentRef, 
-		posAttachmentRef
+		normalAttachmentRef
 	};
 
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = colourAttachmentCount;
-	subpass.pColorAttachments = colourAttachmentRefs;
-	subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask =
+	/* The beauty subpass reads the colour, normal and depth, in that
+	 * order */
+	VkAttachmentReference inputAttachmentRefs[3];
+
+	for (int i = 0; i < colourAttachmentCount; i++) {
+		inputAttachmentRefs[i] = colourAttachmentRefs[i];
+		inputAttachmentRefs[i].layout =
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	inputAttachmentRefs[2] = depthAttachmentRef;
+	inputAttachmentRefs[2].layout =
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkSubpassDescription subpasses[2] = {};
+	subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[0].colorAttachmentCount = colourAttachmentCount;
+	subpasses[0].pColorAttachments = colourAttachmentRefs;
+	subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+
+	subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[1].inputAttachmentCount = 3;
+	subpasses[1].pInputAttachments = inputAttachmentRefs;
+	subpasses[1].colorAttachmentCount = 1;
+	subpasses[1].pColorAttachments = &beautyAttachmentRef;
+
+	/* The last frame's pass has to be done with the attachments, since
+	 * this frame's are in the same memory. */
+	VkSubpassDependency dependencies[3] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask =
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-		| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask =
+		| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+		| VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+		| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].srcAccessMask =
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask =
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 		| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.dstAccessMask =
+	dependencies[0].dstAccessMask =
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	/* Each pixel only reads its own texel of the G-buffer, so tilers can
+	 * go straight on from one subpass to the next. */
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = 1;
+	dependencies[1].srcStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+		| VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask =
 		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
 		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	/* The swapchain image, once the acquire semaphore says it's free */
+	dependencies[2].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[2].dstSubpass = 1;
+	dependencies[2].srcStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[2].srcAccessMask = 0;
+	dependencies[2].dstStageMask =
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[2].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
 	VkRenderPassCreateInfo passInfo = defRenderPassCreateInfo;
 	passInfo.attachmentCount = attachmentCount;
-	passInfo.pAttachments = attachments;
-	passInfo.subpassCount = 1;
-	passInfo.pSubpasses = &subpass;
-	passInfo.dependencyCount = 1;
-	passInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(
-		display->dev.device,
-		&passInfo,
-		0,
-		&display->geom.pass
-	) != VK_SUCCESS) {
-		printf("Failed to create beauty render pass\n");
-		return -1;
-	}
-
-	/* Framebuffers */
-
-	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-
-		VkImageView imgViewAttachments[] = {
-			display->colour[i].view, 
-			display->depth[i].view,
-			display->normal[i].view,
-			display->position[i].view
-		};
-
-		VkFramebufferCreateInfo fbInfo = {};
-		fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		fbInfo.renderPass = display->geom.pass;
-		fbInfo.attachmentCount = 4;
-		fbInfo.pAttachments = imgViewAttachments;
-		fbInfo.width = display->swapchain.extent.width;
-		fbInfo.height = display->swapchain.extent.height;
-		fbInfo.layers = 1;
-
-		if (vkCreateFramebuffer(
-			display->dev.device,
-			&fbInfo,
-			0,
-			&display->geomFb[i]
-		) != VK_SUCCESS) {
-			printf("Failed to create framebuffer\n");
-			return -1;
-		}
+	passInfo.pAttachments = attachments;
+	passInfo.subpassCount = 2;
+	passInfo.pSubpasses = subpasses;
+	passInfo.dependencyCount = 3;
+	passInfo.pDependencies = dependencies;
+
+	if (vkCreateRenderPass(
+		display->dev.device,
+		&passInfo,
+		0,
+		&display->geom.pass
+	) != VK_SUCCESS) {
+		printf("Failed to create frame render pass\n");
+		return -1;
 	}
 
 	/* Command Pool */
@@ -941,7 +2548,8 @@ int createGeomPass(Display* display)
 	uboLayoutBinding.binding = 0;
 	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	uboLayoutBinding.stageFlags =
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
 
 	VkDescriptorSetLayoutBinding colourSamplerLayoutBinding = {};
 	colourSamplerLayoutBinding.binding = 1;
@@ -955,17 +2563,31 @@ int createGeomPass(Display* display)
 	objectUniformLayoutBinding.descriptorType =
 		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	objectUniformLayoutBinding.descriptorCount = 1;
-	objectUniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	objectUniformLayoutBinding.stageFlags =
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	/* Only the culling pass reads these. They're left empty for meshes
+	 * without meshlets. */
+	VkDescriptorSetLayoutBinding meshletLayoutBinding = {};
+	meshletLayoutBinding.binding = 3;
+	meshletLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	meshletLayoutBinding.descriptorCount = 1;
+	meshletLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding drawLayoutBinding = meshletLayoutBinding;
+	drawLayoutBinding.binding = 4;
 
 	VkDescriptorSetLayoutBinding descSetLayoutBindings[] = {
 		uboLayoutBinding,
 		colourSamplerLayoutBinding,
-		objectUniformLayoutBinding
+		objectUniformLayoutBinding,
+		meshletLayoutBinding,
+		drawLayoutBinding
 	};
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = 3;
+	layoutInfo.bindingCount = 5;
 	layoutInfo.pBindings = descSetLayoutBindings;
 
 	if (vkCreateDescriptorSetLayout(
@@ -983,10 +2605,34 @@ int createGeomPass(Display* display)
 
 	/* Pipeline Layout */
 
+	VkDescriptorSetLayout setLayouts[] = {
+		display->geom.descSetLayout,
+		display->texTable.layout
+	};
+
+	/* The mesh's index into the texture table */
+	VkPushConstantRange texIndexRange = {};
+	texIndexRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	texIndexRange.offset = 0;
+	texIndexRange.size = sizeof(uint32_t);
+
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &display->geom.descSetLayout;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+
+	if (display->bindless) {
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &texIndexRange;
+	}
+
+	/* Multi-draw takes everything about the mesh from its object in the
+	 * draw list, texture index included. */
+	if (display->multiDraw) {
+		setLayouts[0] = display->drawLists.layout;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+	}
 
 	if (vkCreatePipelineLayout(
 		display->dev.device,
@@ -1007,14 +2653,27 @@ int createGeomPass(Display* display)
 	/* +1 to account for the null terminator */
 	int dataDirLen = strlen(dataDir) + 1;
 
-	/* 20 chars is enough for the base filename */
-	char* fragPath = malloc(dataDirLen + 20);
+	/* 32 chars is enough for the base filename */
+	char* fragPath = malloc(dataDirLen + 32);
 	memcpy(fragPath, dataDir, dataDirLen);
-	strcat(fragPath, "/frag.spv");
+	strcat(fragPath, display->bindless ? "/bindlessfrag.spv" : "/frag.spv");
 
-	char* vertPath = malloc(dataDirLen + 20);
+	char* vertPath = malloc(dataDirLen + 32);
 	memcpy(vertPath, dataDir, dataDirLen);
-	strcat(vertPath, "/vert.spv");
+	strcat(vertPath, display->packedVertices ? "/packedvert.spv" : "/vert.spv");
+
+	if (display->multiDraw) {
+		memcpy(fragPath, dataDir, dataDirLen);
+		strcat(fragPath, "/multidrawfrag.spv");
+
+		memcpy(vertPath, dataDir, dataDirLen);
+		strcat(
+			vertPath,
+			display->packedVertices
+				? "/multidrawpackedvert.spv"
+				: "/multidrawvert.spv"
+		);
+	}
 
 	VkShaderModule basicFrag;
 
@@ -1095,6 +2754,26 @@ int createGeomPass(Display* display)
 		inputRate: VK_VERTEX_INPUT_RATE_VERTEX
 	};
 
+	/* The same three attributes, squeezed. The vertex shader turns them
+	 * back into what main.vert gets. */
+	VkVertexInputAttributeDescription packedAttributeDescriptions[] = { {
+			location: 0,
+			binding: 0,
+			format: VK_FORMAT_R16G16B16A16_UNORM,
+			offset: offsetof(PackedVertex, pos)
+		},   {
+			location: 1,
+			binding: 0,
+			format: VK_FORMAT_R16G16_SNORM,
+			offset: offsetof(PackedVertex, normal)
+		}, {
+			location: 2,
+			binding: 0,
+			format: VK_FORMAT_R16G16_SFLOAT,
+			offset: offsetof(PackedVertex, texCoord)
+		}
+	};
+
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 	vertexInputInfo.sType =
 		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -1106,6 +2785,12 @@ int createGeomPass(Display* display)
 	vertexInputInfo.pVertexAttributeDescriptions =
 		vertexAttributeDescriptions;
 
+	if (display->packedVertices) {
+		vertexBindingDescription.stride = sizeof(PackedVertex);
+		vertexInputInfo.pVertexAttributeDescriptions =
+			packedAttributeDescriptions;
+	}
+
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
 	inputAssemblyInfo.sType =
 		VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -1174,16 +2859,21 @@ int createGeomPass(Display* display)
 	colourBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
 	colourBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
-	/* they're all colour channels so this will do for now */
-	VkPipelineColorBlendAttachmentState colourBlendAttachments[3] =  {
-		colourBlendAttachment, colourBlendAttachment, colourBlendAttachment
+	/* Normals are written as they are. */
+	VkPipelineColorBlendAttachmentState normalBlendAttachment = {};
+	normalBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT
+		| VK_COLOR_COMPONENT_G_BIT;
+	normalBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendAttachmentState colourBlendAttachments[2] =  {
+		colourBlendAttachment, normalBlendAttachment
 	};
 
 	VkPipelineColorBlendStateCreateInfo colourBlendInfo = {};
 	colourBlendInfo.sType =
 		VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	colourBlendInfo.logicOpEnable = VK_FALSE;
-	colourBlendInfo.attachmentCount = 3;
+	colourBlendInfo.attachmentCount = 2;
 	colourBlendInfo.pAttachments = colourBlendAttachments;
 
 	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
@@ -1231,151 +2921,251 @@ int createGeomPass(Display* display)
 	return 0;
 }
 
-int createBeautyPass(Display* display)
+/* cull.comp shares the geometry pass's per-mesh descriptor set layout, so
+ * it has to be remade along with the pass. */
+int createCullPipeline(Display* display)
 {
-	/* Image View */
-	
-	display->swapchainImageView = (VkImageView*)malloc(
-		display->swapchain.imageCount * sizeof(VkImageView)
-	);
+	VkPushConstantRange constantRange = {};
+	constantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	constantRange.offset = 0;
+	constantRange.size = sizeof(MeshletCullConstants);
+
+	/* Each mesh's own set, then the depth pyramid */
+	VkDescriptorSetLayout setLayouts[] = {
+		display->geom.descSetLayout,
+		display->depthPyramid.cullSetLayout
+	};
 
-	VkImageViewCreateInfo gpImageView = defImageViewCreateInfo;
-	for (int i = 0; i < display->swapchain.imageCount; i++) {
-		gpImageView.image = display->swapchain.images[i];
-		gpImageView.format = display->swapchain.imageFormat; 
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 2;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &constantRange;
 
-		if (vkCreateImageView(
-			display->dev.device,
-			&gpImageView,
-			0,
-			&display->swapchainImageView[i]
-		) != VK_SUCCESS) {
-			printf("Failed to create colour image view\n");
-			return -1;
-		}
+	if (vkCreatePipelineLayout(
+		display->dev.device,
+		&pipelineLayoutInfo,
+		0,
+		&display->cullPipelineLayout
+	) != VK_SUCCESS) {
+		printf("Failed to create pipeline layout\n");
+		return -1;
 	}
 
-	/* Sync */
-
-	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		if (createFrameSync(&display->beautySync[i], display->dev.device))  {
-			return -1;
-		}
-	}
+	const char* dataDir = getenv("IGNI_RENDER_DATA_DIR");
 
-	/* Base render pass */
+	/* +1 to account for the null terminator */
+	int dataDirLen = strlen(dataDir) + 1;
 
-	VkAttachmentDescription beautyAttachment = defAttachmentDescription;
-	beautyAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-	beautyAttachment.format = display->swapchain.imageFormat;
+	char* compPath = malloc(dataDirLen + 20);
+	memcpy(compPath, dataDir, dataDirLen);
+	strcat(compPath, "/cull.spv");
 
-	VkAttachmentReference beautyAttachmentRef;
-	beautyAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-	beautyAttachmentRef.attachment = 0;
+	VkShaderModule cullComp;
 
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &beautyAttachmentRef;
+	int result = loadShaderModule(display->dev.device, &cullComp, compPath);
+	free(compPath);
 
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask =
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-		| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask =
-		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-		| VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.dstAccessMask =
-		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
-		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	if (result) return -1;
 
-	VkRenderPassCreateInfo passInfo = defRenderPassCreateInfo;
-	passInfo.attachmentCount = 1;
-	passInfo.pAttachments = &beautyAttachment;
-	passInfo.subpassCount = 1;
-	passInfo.pSubpasses = &subpass;
-	passInfo.dependencyCount = 1;
-	passInfo.pDependencies = &dependency;
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = cullComp;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = display->cullPipelineLayout;
 
-	if (vkCreateRenderPass(
+	VkResult pipelineResult = vkCreateComputePipelines(
 		display->dev.device,
-		&passInfo,
+		VK_NULL_HANDLE,
+		1,
+		&pipelineInfo,
 		0,
-		&display->beauty.pass
-	) != VK_SUCCESS) {
-		printf("Failed to create beauty render pass\n");
+		&display->cullPipeline
+	);
+
+	vkDestroyShaderModule(display->dev.device, cullComp, 0);
+
+	if (pipelineResult != VK_SUCCESS) {
+		printf("Failed to create compute pipeline\n");
 		return -1;
 	}
 
-	/* Command Pool */
-	QueueFamilyIndices queueFamilies = 
-		findQueueFamilies(display->physicalDevice, display->surface);
+	return 0;
+}
 
-	VkCommandPoolCreateInfo commandPoolInfo = defCommandPoolCreateInfo;
-	commandPoolInfo.queueFamilyIndex = queueFamilies.graphics;
-	
-	if (vkCreateCommandPool(
+/* instcull.comp reads and writes the draw lists through their own set. It's
+ * remade with the passes because the depth pyramid is. */
+int createDrawListCullPipeline(Display* display)
+{
+	VkPushConstantRange constantRange = {};
+	constantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	constantRange.offset = 0;
+	constantRange.size = sizeof(DrawListCullConstants);
+
+	/* The frame's draw list, then the depth pyramid */
+	VkDescriptorSetLayout setLayouts[] = {
+		display->drawLists.layout,
+		display->depthPyramid.cullSetLayout
+	};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 2;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &constantRange;
+
+	if (vkCreatePipelineLayout(
 		display->dev.device,
-		&commandPoolInfo,
+		&pipelineLayoutInfo,
 		0,
-		&display->beauty.commandPool
+		&display->drawCullPipelineLayout
 	) != VK_SUCCESS) {
-		printf("Failed to create command pool\n");
+		printf("Failed to create pipeline layout\n");
 		return -1;
 	}
 
-	/* Command Buffers */
+	const char* dataDir = getenv("IGNI_RENDER_DATA_DIR");
 
-	VkCommandBufferAllocateInfo allocInfo = defCommandBufferAllocateInfo;
-	allocInfo.commandPool = display->beauty.commandPool;
+	/* +1 to account for the null terminator */
+	int dataDirLen = strlen(dataDir) + 1;
 
-	display->beauty.commandBuffers = (VkCommandBuffer*)
-		malloc(sizeof(VkCommandBuffer) * MAX_FRAMES_IN_FLIGHT);
+	char* compPath = malloc(dataDirLen + 20);
+	memcpy(compPath, dataDir, dataDirLen);
+	strcat(compPath, "/instcull.spv");
 
-	if (vkAllocateCommandBuffers(
+	VkShaderModule cullComp;
+
+	int result = loadShaderModule(display->dev.device, &cullComp, compPath);
+	free(compPath);
+
+	if (result) return -1;
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = cullComp;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = display->drawCullPipelineLayout;
+
+	VkResult pipelineResult = vkCreateComputePipelines(
 		display->dev.device,
-		&allocInfo,
-		display->beauty.commandBuffers
-	) != VK_SUCCESS) {
-		printf("Failed to create command buffers\n");
+		VK_NULL_HANDLE,
+		1,
+		&pipelineInfo,
+		0,
+		&display->drawCullPipeline
+	);
+
+	vkDestroyShaderModule(display->dev.device, cullComp, 0);
+
+	if (pipelineResult != VK_SUCCESS) {
+		printf("Failed to create compute pipeline\n");
 		return -1;
 	}
 
-	/* Descriptor Set Layout */
+	return 0;
+}
 
-	VkDescriptorSetLayoutBinding colourSamplerLayoutBinding = {};
-	colourSamplerLayoutBinding.binding = 0;
-	colourSamplerLayoutBinding.descriptorCount = 1;
-	colourSamplerLayoutBinding.descriptorType =
-		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	colourSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+int createBeautyPass(Display* display)
+{
+	/* Image View */
+	
+	display->swapchainImageView = (VkImageView*)malloc(
+		display->swapchain.imageCount * sizeof(VkImageView)
+	);
 
-	VkDescriptorSetLayoutBinding normalSamplerLayoutBinding = {};
-	normalSamplerLayoutBinding.binding = 1;
-	normalSamplerLayoutBinding.descriptorCount = 1;
-	normalSamplerLayoutBinding.descriptorType =
-		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	normalSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkImageViewCreateInfo gpImageView = defImageViewCreateInfo;
+	for (int i = 0; i < display->swapchain.imageCount; i++) {
+		gpImageView.image = display->swapchain.images[i];
+		gpImageView.format = display->swapchain.imageFormat; 
+
+		if (vkCreateImageView(
+			display->dev.device,
+			&gpImageView,
+			0,
+			&display->swapchainImageView[i]
+		) != VK_SUCCESS) {
+			printf("Failed to create colour image view\n");
+			return -1;
+		}
+	}
+
+	/* The beauty pass is the second subpass of geom.pass and is recorded
+	 * into the geometry pass's command buffers, so all it has of its own is
+	 * the pipeline. */
+
+	display->beauty.pass = VK_NULL_HANDLE;
+	display->beauty.commandPool = VK_NULL_HANDLE;
+	display->beauty.commandBuffers = 0;
 
-	VkDescriptorSetLayoutBinding positionSamplerLayoutBinding = {};
-	positionSamplerLayoutBinding.binding = 2;
-	positionSamplerLayoutBinding.descriptorCount = 1;
-	positionSamplerLayoutBinding.descriptorType =
+	/* Descriptor Set Layout */
+
+	VkDescriptorSetLayoutBinding colourInputLayoutBinding = {};
+	colourInputLayoutBinding.binding = 0;
+	colourInputLayoutBinding.descriptorCount = 1;
+	colourInputLayoutBinding.descriptorType =
+		VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	colourInputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutBinding normalInputLayoutBinding = {};
+	normalInputLayoutBinding.binding = 1;
+	normalInputLayoutBinding.descriptorCount = 1;
+	normalInputLayoutBinding.descriptorType =
+		VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	normalInputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutBinding depthInputLayoutBinding = {};
+	depthInputLayoutBinding.binding = 2;
+	depthInputLayoutBinding.descriptorCount = 1;
+	depthInputLayoutBinding.descriptorType =
+		VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	depthInputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	/* For taking positions back out of the depth */
+	VkDescriptorSetLayoutBinding povLayoutBinding = {};
+	povLayoutBinding.binding = 3;
+	povLayoutBinding.descriptorCount = 1;
+	povLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	povLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	/* The lights and which of them reach each cluster */
+	VkDescriptorSetLayoutBinding lightLayoutBinding = {};
+	lightLayoutBinding.binding = 4;
+	lightLayoutBinding.descriptorCount = 1;
+	lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutBinding clusterLayoutBinding = lightLayoutBinding;
+	clusterLayoutBinding.binding = 5;
+
+	/* The lights' shadows */
+	VkDescriptorSetLayoutBinding shadowLayoutBinding = {};
+	shadowLayoutBinding.binding = 6;
+	shadowLayoutBinding.descriptorCount = 1;
+	shadowLayoutBinding.descriptorType =
 		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	positionSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shadowLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	VkDescriptorSetLayoutBinding descSetLayoutBindings[] = {
-		colourSamplerLayoutBinding,
-		normalSamplerLayoutBinding,
-		positionSamplerLayoutBinding
+		colourInputLayoutBinding,
+		normalInputLayoutBinding,
+		depthInputLayoutBinding,
+		povLayoutBinding,
+		lightLayoutBinding,
+		clusterLayoutBinding,
+		shadowLayoutBinding
 	};
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = 3;
+	layoutInfo.bindingCount = 7;
 	layoutInfo.pBindings = descSetLayoutBindings;
 
 	if (vkCreateDescriptorSetLayout(
@@ -1390,13 +3180,19 @@ int createBeautyPass(Display* display)
 
 	/* Descriptor Pool */
 
-	VkDescriptorPoolSize poolSizes[1] = {};
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	VkDescriptorPoolSize poolSizes[4] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
 	poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT * 3;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT * 2;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[3].descriptorCount = MAX_FRAMES_IN_FLIGHT;
 
 	VkDescriptorPoolCreateInfo descPoolInfo = {};
 	descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	descPoolInfo.poolSizeCount = 1;
+	descPoolInfo.poolSizeCount = 4;
 	descPoolInfo.pPoolSizes = poolSizes;
 	descPoolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
 
@@ -1432,12 +3228,13 @@ int createBeautyPass(Display* display)
 		return -1;
 	}
 
+	/* Input attachments are read at the pixel being shaded, so there are no
+	 * samplers. */
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		/* Colour */
 		VkDescriptorImageInfo colourImageInfo = {};
 		colourImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		colourImageInfo.imageView = display->colour[i].view;
-		colourImageInfo.sampler = display->colour[i].sampler;
 
 		VkWriteDescriptorSet colourWriteDesc = {};
 		colourWriteDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1445,7 +3242,7 @@ int createBeautyPass(Display* display)
 		colourWriteDesc.dstBinding = 0;
 		colourWriteDesc.dstArrayElement = 0;
 		colourWriteDesc.descriptorType =
-			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
 		colourWriteDesc.descriptorCount = 1;
 		colourWriteDesc.pImageInfo = &colourImageInfo;
 
@@ -1461,7 +3258,6 @@ int createBeautyPass(Display* display)
 		VkDescriptorImageInfo normalImageInfo = {};
 		normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		normalImageInfo.imageView = display->normal[i].view;
-		normalImageInfo.sampler = display->normal[i].sampler;
 
 		VkWriteDescriptorSet normalWriteDesc = {};
 		normalWriteDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1469,7 +3265,7 @@ int createBeautyPass(Display* display)
 		normalWriteDesc.dstBinding = 1;
 		normalWriteDesc.dstArrayElement = 0;
 		normalWriteDesc.descriptorType =
-			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
 		normalWriteDesc.descriptorCount = 1;
 		normalWriteDesc.pImageInfo = &normalImageInfo;
 
@@ -1481,29 +3277,81 @@ int createBeautyPass(Display* display)
 			0
 		);
 
-		/* Position */
-		VkDescriptorImageInfo posImageInfo = {};
-		posImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		posImageInfo.imageView = display->position[i].view;
-		posImageInfo.sampler = display->position[i].sampler;
-
-		VkWriteDescriptorSet posWriteDesc = {};
-		posWriteDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		posWriteDesc.dstSet = display->beautyDescSets[i];
-		posWriteDesc.dstBinding = 2;
-		posWriteDesc.dstArrayElement = 0;
-		posWriteDesc.descriptorType =
+		/* Depth */
+		VkDescriptorImageInfo depthImageInfo = {};
+		depthImageInfo.imageLayout =
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		depthImageInfo.imageView = display->depth[i].view;
+
+		VkWriteDescriptorSet depthWriteDesc = {};
+		depthWriteDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		depthWriteDesc.dstSet = display->beautyDescSets[i];
+		depthWriteDesc.dstBinding = 2;
+		depthWriteDesc.dstArrayElement = 0;
+		depthWriteDesc.descriptorType =
+			VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		depthWriteDesc.descriptorCount = 1;
+		depthWriteDesc.pImageInfo = &depthImageInfo;
+
+		vkUpdateDescriptorSets(
+			display->dev.device,
+			1,
+			&depthWriteDesc,
+			0,
+			0
+		);
+
+		/* Viewpoint */
+		VkDescriptorBufferInfo povBufferInfo = {};
+		povBufferInfo.buffer = display->pov.uniformBuffers[i];
+		povBufferInfo.offset = 0;
+		povBufferInfo.range = sizeof(ViewpointUniforms);
+
+		VkWriteDescriptorSet povWriteDesc = {};
+		povWriteDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		povWriteDesc.dstSet = display->beautyDescSets[i];
+		povWriteDesc.dstBinding = 3;
+		povWriteDesc.dstArrayElement = 0;
+		povWriteDesc.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		povWriteDesc.descriptorCount = 1;
+		povWriteDesc.pBufferInfo = &povBufferInfo;
+
+		vkUpdateDescriptorSets(
+			display->dev.device,
+			1,
+			&povWriteDesc,
+			0,
+			0
+		);
+
+		/* Shadow Atlas
+		 * The one image for every frame, since a frame's tiles are
+		 * only drawn once the last frame is done reading them. */
+		VkDescriptorImageInfo shadowImageInfo = {};
+		shadowImageInfo.imageLayout =
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		shadowImageInfo.imageView = display->shadows.view;
+		shadowImageInfo.sampler = display->shadows.sampler;
+
+		VkWriteDescriptorSet shadowWriteDesc = {};
+		shadowWriteDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		shadowWriteDesc.dstSet = display->beautyDescSets[i];
+		shadowWriteDesc.dstBinding = 6;
+		shadowWriteDesc.dstArrayElement = 0;
+		shadowWriteDesc.descriptorType =
 			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		posWriteDesc.descriptorCount = 1;
-		posWriteDesc.pImageInfo = &posImageInfo;
+		shadowWriteDesc.descriptorCount = 1;
+		shadowWriteDesc.pImageInfo = &shadowImageInfo;
 
 		vkUpdateDescriptorSets(
 			display->dev.device,
 			1,
-			&posWriteDesc,
+			&shadowWriteDesc,
 			0,
 			0
 		);
+
+		writeBeautyLights(display, i);
 	}
 
 	/* Pipeline Layout */
@@ -1623,16 +3471,10 @@ int createBeautyPass(Display* display)
 		| VK_COLOR_COMPONENT_B_BIT
 		| VK_COLOR_COMPONENT_A_BIT;
 
-	/* In this case, alpha blending is used.*/
+	/* Nothing to blend with, the swapchain image isn't cleared. The
+	 * fragment shader does what blending onto black used to. */
 
-	colourBlendAttachment.blendEnable = VK_TRUE;
-	colourBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colourBlendAttachment.dstColorBlendFactor =
-		VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	colourBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-	colourBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	colourBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colourBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	colourBlendAttachment.blendEnable = VK_FALSE;
 
 	pipelineInfos.colourBlendState.attachmentCount = 1;
 	pipelineInfos.colourBlendState.pAttachments = &colourBlendAttachment;
@@ -1641,8 +3483,8 @@ int createBeautyPass(Display* display)
 	pipelineInfos.pipeline.stageCount = shaderStageCount;
 	pipelineInfos.pipeline.pStages = shaderStages;
 	pipelineInfos.pipeline.layout = display->beauty.pipelineLayout;
-	pipelineInfos.pipeline.renderPass = display->beauty.pass;
-	pipelineInfos.pipeline.subpass = 0;
+	pipelineInfos.pipeline.renderPass = display->geom.pass;
+	pipelineInfos.pipeline.subpass = 1;
 
 	VkResult pipelineResult = vkCreateGraphicsPipelines(
 		display->dev.device,
@@ -1661,59 +3503,132 @@ int createBeautyPass(Display* display)
 		return -1;
 	}
 
-	/* Framebuffer */
+	/* Framebuffers
+	 * One for each pairing of a frame's G-buffer with a swapchain image,
+	 * since which image gets acquired has nothing to do with which frame
+	 * is being drawn. */
+
+	const unsigned int fbCount =
+		display->swapchain.imageCount * MAX_FRAMES_IN_FLIGHT;
 
-	display->beautyFb = (VkFramebuffer*)malloc(
-		display->swapchain.imageCount * sizeof(VkFramebuffer)
+	display->frameFb = (VkFramebuffer*)malloc(
+		fbCount * sizeof(VkFramebuffer)
 	);
 
+	if (!display->frameFb) {
+		perror("Failed to allocate framebuffers");
+		return -1;
+	}
+
 	for (int i = 0; i < display->swapchain.imageCount; i++) {
-		VkFramebufferCreateInfo fbInfo = {};
-		fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		fbInfo.renderPass = display->beauty.pass;
-		fbInfo.attachmentCount = 1;
-		fbInfo.pAttachments = &display->swapchainImageView[i];
-		fbInfo.width = display->swapchain.extent.width;
-		fbInfo.height = display->swapchain.extent.height;
-		fbInfo.layers = 1;
-
-		if (vkCreateFramebuffer(
-			display->dev.device,
-			&fbInfo,
-			0,
-			&display->beautyFb[i]
-		) != VK_SUCCESS) {
-			printf("Failed to create framebuffer\n");
-			return -1;
+		for (int f = 0; f < MAX_FRAMES_IN_FLIGHT; f++) {
+			VkImageView fbAttachments[] = {
+				display->colour[f].view,
+				display->depth[f].view,
+				display->normal[f].view,
+				display->swapchainImageView[i]
+			};
+
+			VkFramebufferCreateInfo fbInfo = {};
+			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			fbInfo.renderPass = display->geom.pass;
+			fbInfo.attachmentCount = 4;
+			fbInfo.pAttachments = fbAttachments;
+			fbInfo.width = display->swapchain.extent.width;
+			fbInfo.height = display->swapchain.extent.height;
+			fbInfo.layers = 1;
+
+			if (vkCreateFramebuffer(
+				display->dev.device,
+				&fbInfo,
+				0,
+				&display->frameFb[i * MAX_FRAMES_IN_FLIGHT + f]
+			) != VK_SUCCESS) {
+				printf("Failed to create framebuffer\n");
+				return -1;
+			}
 		}
 	}
 
-
 	return 0;
 }
 
+/* Points the frame's beauty set at its light buffers, whenever they're made
+ * again. */
+void writeBeautyLights(Display* display, unsigned int frame)
+{
+	const LightFrame* lights = &display->lights.frames[frame];
+
+	VkDescriptorBufferInfo bufferInfos[2] = {};
+	bufferInfos[0].buffer = lights->lightBuffer;
+	bufferInfos[0].offset = 0;
+	bufferInfos[0].range = VK_WHOLE_SIZE;
+
+	bufferInfos[1].buffer = lights->clusterBuffer;
+	bufferInfos[1].offset = 0;
+	bufferInfos[1].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[2] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = display->beautyDescSets[frame];
+	writes[0].dstBinding = 4;
+	writes[0].dstArrayElement = 0;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[0].descriptorCount = 1;
+	writes[0].pBufferInfo = &bufferInfos[0];
+
+	writes[1] = writes[0];
+	writes[1].dstBinding = 5;
+	writes[1].pBufferInfo = &bufferInfos[1];
+
+	vkUpdateDescriptorSets(display->dev.device, 2, writes, 0, 0);
+}
+
 void destroyRenderPasses(Display display)
 {
 	destroyRenderPass(display.dev.device, display.geom);
 	destroyRenderPass(display.dev.device, display.beauty);
 	vkDestroyDescriptorPool(display.dev.device, display.beautyDescPool, 0);
 
+	if (display.meshletCull) {
+		destroyDepthPyramid(display.dev.device, display.depthPyramid);
+		vkDestroyPipeline(display.dev.device, display.cullPipeline, 0);
+		vkDestroyPipelineLayout(
+			display.dev.device,
+			display.cullPipelineLayout,
+			0
+		);
+	}
+
+	if (display.gpuCull) {
+		vkDestroyPipeline(display.dev.device, display.drawCullPipeline, 0);
+		vkDestroyPipelineLayout(
+			display.dev.device,
+			display.drawCullPipelineLayout,
+			0
+		);
+	}
+
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroyFramebuffer(display.dev.device, display.geomFb[i], 0);
 		destroyFramebufferAttachment(display.dev.device, display.depth[i]);
 		destroyFramebufferAttachment(display.dev.device, display.colour[i]);
 		destroyFramebufferAttachment(display.dev.device, display.normal[i]);
-		destroyFramebufferAttachment(display.dev.device, display.position[i]);
 		destroyFrameSync(display.dev.device, display.geomSync[i]);
-		destroyFrameSync(display.dev.device, display.beautySync[i]);
 	}
 
 	for (int i = 0; i < display.swapchain.imageCount; i++) {
-		vkDestroyFramebuffer(display.dev.device, display.beautyFb[i], 0);
+		for (int f = 0; f < MAX_FRAMES_IN_FLIGHT; f++) {
+			vkDestroyFramebuffer(
+				display.dev.device,
+				display.frameFb[i * MAX_FRAMES_IN_FLIGHT + f],
+				0
+			);
+		}
+
 		vkDestroyImageView(display.dev.device, display.swapchainImageView[i], 0);
 	}
 
-	free(display.beautyFb);
+	free(display.frameFb);
 	free(display.swapchainImageView);
 }
 
@@ -1724,7 +3639,42 @@ void destroyDisplay(Display display)
 
 	destroyExtendedSwapchain(display.dev.device, display.swapchain);
 	destroyViewpoint(display.dev.device, display.pov);
-	destroyTexture(display.dev.device, display.nulTexture);
+	destroyTexture(&display.garbage, display.nulTexture);
+
+	/* Everything still in the garbage queue gets destroyed now. The device
+	 * is idle by the time the display is destroyed. */
+	flushGarbage(
+		&display.garbage,
+		display.dev.device,
+		&display.meshDescAlloc,
+		display.bindless ? &display.texTable : 0,
+		display.multiDraw ? &display.geomPool : 0,
+		&display.budget
+	);
+	destroyGarbageQueue(display.garbage);
+	destroyArena(display.frameArena);
+
+	/* After the garbage, which can still have buffers from the pools */
+	if (display.cacheCommands) {
+		destroySceneRecorder(display.dev.device, display.recorder);
+		free(display.recorder);
+	}
+
+	destroyDescriptorAllocator(display.dev.device, display.meshDescAlloc);
+
+	if (display.bindless) {
+		destroyTextureTable(display.dev.device, display.texTable);
+	}
+
+	if (display.multiDraw) {
+		destroyGeometryPool(display.dev.device, display.geomPool);
+		destroyDrawLists(display.dev.device, display.drawLists);
+	}
+
+	destroyLightClusters(display.dev.device, display.lights);
+	destroyShadowAtlas(display.dev.device, display.shadows);
+
+	destroySamplerCache(display.dev.device, display.samplers);
 
 	vkDestroyDevice(display.dev.device, 0);
 	vkDestroySurfaceKHR(display.instance, display.surface, 0);
@@ -1785,26 +3735,32 @@ int recreateRenderPasses(Display* display)
 
 	if (createRenderPasses(display)) return -1;
 
+	/* Every scene's cached commands point at the old pass. */
+	++display->passGeneration;
+
 	return 0;
 }
 
 int recreatePOV(Display* display)
 {
+	/* The CPU copy saves reading back from the mapped buffers. */
+	ViewpointUniforms ubo = display->pov.uniforms;
 
-	ViewpointUniforms ubo;
+	ubo.proj = matPersp(
+		display->pov.fov,
+		(float)display->swapchain.extent.width
+		/ (float)display->swapchain.extent.height,
+		0.1f,
+		10.0f
+	);
 
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		ubo = *(ViewpointUniforms*)display->pov.uboMapped[i];
-		ubo.proj = matPersp(
-			display->pov.fov,
-			(float)display->swapchain.extent.width
-			/ (float)display->swapchain.extent.height,
-			0.1f,
-			10.0f
-		);
-
 		*(ViewpointUniforms*)display->pov.uboMapped[i] = ubo;
 	}
+
+	display->pov.projScale = fabsf(ubo.proj.y.y);
+	display->pov.uniforms = ubo;
+
 	return 0;
 }
 
@@ -1823,7 +3779,9 @@ int createInstance(
 	appInfo.applicationVersion = VK_MAKE_VERSION(MAJ_V, MIN_V, PATCH_V);
 	appInfo.pEngineName = "None";
 	appInfo.engineVersion = VK_MAKE_VERSION(MAJ_V, MIN_V, PATCH_V);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	/* 1.2 for descriptor indexing. Older devices still get picked, they
+	 * just fall back to per-mesh texture bindings. */
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo instanceInfo = {0};
 	instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -1902,7 +3860,10 @@ int createLogicalDevice(
 	const char** deviceExtensions,
 	unsigned int deviceExtensionCount,
 	unsigned int instLayerCount,
-	const char* instLayers[]
+	const char* instLayers[],
+	char bindless,
+	char meshletCull,
+	char multiDraw
 )
 {
 	QueueFamilyIndices queueFamilies = findQueueFamilies(physDev, surface);
@@ -1921,8 +3882,38 @@ int createLogicalDevice(
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
 	VkDeviceCreateInfo deviceInfo = {};
 	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+
+	/* Everything the texture table needs, see deviceSupportsBindless() */
+	if (bindless) {
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+		features12.runtimeDescriptorArray = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+		deviceInfo.pNext = &features12;
+	}
+
+	/* Draw lists filled by cull.comp, see deviceSupportsMeshletCull() */
+	if (meshletCull) {
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		features12.drawIndirectCount = VK_TRUE;
+
+		deviceInfo.pNext = &features12;
+	}
+
+	/* Draw lists written by the CPU, see deviceSupportsMultiDraw() */
+	if (multiDraw) {
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	}
+
 	deviceInfo.pQueueCreateInfos = queueInfo;
 	deviceInfo.queueCreateInfoCount = queueFamilies.uniqueIndexCount;
 	deviceInfo.pEnabledFeatures = &deviceFeatures;
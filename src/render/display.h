@@ -10,6 +10,15 @@
 #include "scene.h"
 #include "pass.h"
 #include "sync.h"
+#include "textable.h"
+#include "hiz.h"
+#include "geompool.h"
+#include "drawlist.h"
+#include "drawsort.h"
+#include "recorder.h"
+#include "drawrecord.h"
+#include "lights.h"
+#include "shadow.h"
 
 /* This program uses GLFW to create windows. */
 #if HAVE_LIBGLFW == 1 && WINDOWED 
@@ -40,47 +49,235 @@ typedef struct
 	VkCommandPool cmdPool;
 	VkCommandBuffer cmd;
 
+	/* Every sampler on the server comes from here. */
+	SamplerCache samplers;
+
 	Texture nulTexture;
 	Viewpoint pov;
 
+	/* The geometry and beauty passes are the two subpasses of geom.pass,
+	 * recorded into geom's command buffers and submitted once a frame.
+	 * beauty just holds the second subpass's pipeline and layouts. */
 	RenderPass beauty;
-	VkFramebuffer* beautyFb;
 	VkImageView* swapchainImageView;
-	FrameSync beautySync[MAX_FRAMES_IN_FLIGHT];	
 	VkDescriptorSet beautyDescSets[MAX_FRAMES_IN_FLIGHT];
 	VkDescriptorPool beautyDescPool;
 
 	RenderPass geom;
 	FrameSync geomSync[MAX_FRAMES_IN_FLIGHT];
-	VkFramebuffer geomFb[MAX_FRAMES_IN_FLIGHT];
+
+	/* A framebuffer for every swapchain image and frame in flight,
+	 * indexed image * MAX_FRAMES_IN_FLIGHT + frame */
+	VkFramebuffer* frameFb;
+
+	/* Every mesh's descriptor sets come from here. */
+	DescriptorAllocator meshDescAlloc;
+
+	/* Deleted resources waiting on frames in flight */
+	GarbageQueue garbage;
+
+	char memoryBudgetExt;
+	MemoryBudget budget;
+	uint64_t frameCount;
+
+	/* Scratch memory that only lasts until the next frame starts */
+	Arena frameArena;
+
+	/* The main loop's scenes, for making room when an allocation fails
+	 * in the middle of a command */
+	SceneArray* scenes;
+
+	/* Every texture, when the device supports it. */
+	char bindless;
+	TextureTable texTable;
+
+	/* Meshes are uploaded as PackedVertex instead of Vertex. */
+	char packedVertices;
+
+	/* Meshes go through meshopt.c when they're imported. */
+	char optimizeMeshes;
+
+	/* Imported meshes get LODs from simplify.c. */
+	char generateLods;
+
+	/* Meshes are cut into meshlets that cull.comp culls before the geometry
+	 * pass. Cone culling is separate since the geometry pass draws both
+	 * sides of every triangle. */
+	char meshletCull;
+	char coneCull;
+
+	/* Whole meshes outside the viewpoint's frustum are skipped, see
+	 * frustum.c. */
+	char frustumCull;
+	VkPipelineLayout cullPipelineLayout;
+	VkPipeline cullPipeline;
+
+	/* Meshlets hidden behind the last frame's depth get culled as well.
+	 * The pyramid is there whenever meshlet culling is. */
+	char occlusionCull;
+	DepthPyramid depthPyramid;
+
+	/* Meshes share the geometry pool's buffers where they fit, and the
+	 * geometry pass draws them from this frame's draw list. Needs the
+	 * texture table, since there's no binding textures per draw. */
+	char multiDraw;
+	uint32_t maxDrawIndirectCount;
+	GeometryPool geomPool;
+	DrawLists drawLists;
+
+	/* The draw list's pooled meshes are culled by instcull.comp instead
+	 * of frustum.c, against the depth pyramid as well when occlusionCull is
+	 * on. Needs meshlet culling for the count draw and the pyramid. */
+	char gpuCull;
+	VkPipelineLayout drawCullPipelineLayout;
+	VkPipeline drawCullPipeline;
+
+	/* This frame's visible meshes, sorted by state and then front to back */
+	SortedDraws sortedDraws;
+
+	/* Scenes record the geometry pass into secondary command buffers, see
+	 * cmdcache.h, on the recorder's threads. The recorder is on the heap
+	 * since its threads hold on to it. passGeneration goes up whenever
+	 * the render passes are recreated. */
+	char cacheCommands;
+	unsigned int recordThreads;
+	SceneRecorder* recorder;
+	uint32_t passGeneration;
+
+	/* With multi-draw, the draw list's chunks are cached instead of the
+	 * scenes. Each chunk has its own recording thread, the one with the
+	 * same index, and the buffers go with its pools. */
+	CommandCache drawListCommands[RECORDER_MAX_WORKERS];
+
+	/* CPU time spent recording the geometry subpass, see printDrawStats() */
+	uint64_t lastRecordNanos;
+	uint64_t totalRecordNanos;
+	uint64_t recordFrames;
+
+	/* Point lights from every scene, binned into clusters each frame */
+	LightClusters lights;
+
+	/* Their shadows, cached between frames, see shadow.h */
+	ShadowAtlas shadows;
 
 	FramebufferAttachment colour[MAX_FRAMES_IN_FLIGHT];
 	FramebufferAttachment depth[MAX_FRAMES_IN_FLIGHT];
 	FramebufferAttachment normal[MAX_FRAMES_IN_FLIGHT];
-	FramebufferAttachment position[MAX_FRAMES_IN_FLIGHT];
 } Display;
 
+/* What recordSceneJob() gets from recordSceneCommands(). Every array has an
+ * entry per scene. */
+typedef struct
+{
+	Display* display;
+	SceneArray scenes;
+	unsigned int frame;
+
+	SortedDraws* sceneDraws;
+	uint64_t* hashes;
+	char* dirty;
+} SceneRecordJob;
+
+/* What recordDrawListJob() gets from recordDrawListCommands(). Every array
+ * has an entry per chunk. */
+typedef struct
+{
+	Display* display;
+	SceneArray scenes;
+	unsigned int frame;
+
+	DrawListChunk chunks[RECORDER_MAX_WORKERS];
+	unsigned int chunkCount;
+	uint64_t hashes[RECORDER_MAX_WORKERS];
+	char dirty[RECORDER_MAX_WORKERS];
+} DrawListRecordJob;
+
+int beginCommandBuffer(VkCommandBuffer* cmdBuf);
 int beginRenderPass(
 	VkCommandBuffer* cmdBuf,
 	RenderPass pass,
 	VkFramebuffer fb,
-	VkExtent2D ext
+	VkExtent2D ext,
+	VkSubpassContents contents
+);
+void bindPassState(VkCommandBuffer* cmdBuf, RenderPass pass, VkExtent2D ext);
+
+int recordSceneCommands(
+	Display* display,
+	SceneArray scenes,
+	VkCommandBuffer** cmdBufs,
+	unsigned int* cmdBufCount
+);
+int recordSceneJob(void* data, unsigned int worker, VkCommandPool pool);
+
+uint64_t hashDrawListChunk(
+	const Display* display,
+	SceneArray scenes,
+	const DrawListChunk* chunk
+);
+int recordDrawListCommands(
+	Display* display,
+	SceneArray scenes,
+	VkCommandBuffer** cmdBufs,
+	unsigned int* cmdBufCount
 );
+int recordDrawListJob(void* data, unsigned int worker, VkCommandPool pool);
 
-int iterateScenes(
+int cullMeshlets(
 	VkCommandBuffer* cmdBuf,
 	SceneArray scenes,
 	int frame,
-	VkPipelineLayout pipelineLayout
+	VkPipelineLayout pipelineLayout,
+	VkPipeline pipeline,
+	VkDescriptorSet pyramidSet,
+	char coneCull,
+	char occlusionCull
+);
+
+void cullDrawList(
+	VkCommandBuffer* cmdBuf,
+	const DrawList* list,
+	VkPipelineLayout pipelineLayout,
+	VkPipeline pipeline,
+	VkDescriptorSet pyramidSet,
+	char occlusionCull
+);
+
+char meshCulledOnGpu(const Display* display, const Mesh* mesh);
+int cullMeshes(Display* display, SceneArray scenes);
+unsigned int selectMeshLod(
+	const Mesh* mesh,
+	Vec3 eye,
+	float pixelScale,
+	float maxPixels
 );
+void selectLods(Display* display, SceneArray scenes);
+int buildDrawList(
+	Display* display,
+	SceneArray scenes,
+	const SortedDraws* draws
+);
+
+int compareTextureAge(const void* a, const void* b);
+int evictTextures(
+	Display* display,
+	SceneArray scenes,
+	VkDeviceSize size,
+	uint64_t idleFrames
+);
+int enforceMemoryBudget(Display* display, SceneArray scenes);
+int reclaimDeviceMemory(Display* display, VkDeviceSize size);
 
 int endRenderPass(VkCommandBuffer* cmdBuf, VkQueue queue, FrameSync sync);
-int endRenderPassA(VkCommandBuffer* cmdBuf, VkQueue queue, FrameSync sync);
+void waitForFrame(Display* display);
 int renderScenes(Display* display, SceneArray scenes);
 
 int createRenderPasses(Display* display);
 int createGeomPass(Display* display);
 int createBeautyPass(Display* display);
+void writeBeautyLights(Display* display, unsigned int frame);
+int createCullPipeline(Display* display);
+int createDrawListCullPipeline(Display* display);
 int recreateRenderPasses(Display* display);
 void destroyRenderPasses(Display display);
 
@@ -90,6 +287,11 @@ int recreatePOV(Display* display);
 int createDisplaySurface(Display* display);
 #endif
 
+void selectTextureMode(Display* display);
+void selectVertexFormat(Display* display);
+void selectCullMode(Display* display);
+void selectDrawMode(Display* display);
+void printDrawStats(const Display* display);
 int createDisplay(Display* display);
 void destroyDisplay(Display display);
 
@@ -117,7 +319,10 @@ int createLogicalDevice(
 	const char** deviceExtensions,
 	unsigned int deviceExtensionCount,
 	unsigned int instLayerCount,
-	const char* instLayers[]
+	const char* instLayers[],
+	char bindless,
+	char meshletCull,
+	char multiDraw
 );
 
 #endif
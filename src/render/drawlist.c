@@ -0,0 +1,328 @@
+#include "drawlist.h"
+#include <stdio.h>
+
+int createDrawLists(
+	DrawLists* drawLists,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const Viewpoint* pov,
+	char cullable
+)
+{
+	/* Descriptor Set Layout */
+
+	VkDescriptorSetLayoutBinding povLayoutBinding = {};
+	povLayoutBinding.binding = 0;
+	povLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	povLayoutBinding.descriptorCount = 1;
+	povLayoutBinding.stageFlags =
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+	objectLayoutBinding.binding = 1;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.stageFlags =
+		VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+	/* The commands instcull.comp reads, and the ones it writes */
+	VkDescriptorSetLayoutBinding commandLayoutBinding = {};
+	commandLayoutBinding.binding = 2;
+	commandLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	commandLayoutBinding.descriptorCount = 1;
+	commandLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutBinding culledLayoutBinding = commandLayoutBinding;
+	culledLayoutBinding.binding = 3;
+
+	VkDescriptorSetLayoutBinding layoutBindings[] = {
+		povLayoutBinding,
+		objectLayoutBinding,
+		commandLayoutBinding,
+		culledLayoutBinding
+	};
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = layoutBindings;
+
+	if (vkCreateDescriptorSetLayout(
+		device,
+		&layoutInfo,
+		0,
+		&drawLists->layout
+	) != VK_SUCCESS) {
+		printf("Failed to create draw list descriptor set layout\n");
+		return -1;
+	}
+
+	/* Descriptor Pool */
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT * 3;
+
+	VkDescriptorPoolCreateInfo descPoolInfo = {};
+	descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descPoolInfo.poolSizeCount = 2;
+	descPoolInfo.pPoolSizes = poolSizes;
+	descPoolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+	if (vkCreateDescriptorPool(
+		device,
+		&descPoolInfo,
+		0,
+		&drawLists->pool
+	) != VK_SUCCESS) {
+		printf("Failed to create draw list descriptor pool\n");
+		return -1;
+	}
+
+	/* Descriptor Sets */
+
+	VkDescriptorSetLayout setLayouts[MAX_FRAMES_IN_FLIGHT];
+	VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		setLayouts[i] = drawLists->layout;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = drawLists->pool;
+	allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+	allocInfo.pSetLayouts = setLayouts;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets) != VK_SUCCESS) {
+		printf("Failed to allocate draw list descriptor sets\n");
+		return -1;
+	}
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		DrawList* list = &drawLists->lists[i];
+
+		*list = (DrawList){};
+		list->set = sets[i];
+		list->cullable = cullable;
+
+		if (reserveDrawList(
+			list,
+			device,
+			physDev,
+			DRAW_LIST_INITIAL_LIMIT,
+			DRAW_LIST_INITIAL_LIMIT
+		)) {
+			return -1;
+		}
+
+		/* The viewpoint's buffers last as long as the display. */
+		VkDescriptorBufferInfo povBufferInfo = {};
+		povBufferInfo.buffer = pov->uniformBuffers[i];
+		povBufferInfo.offset = 0;
+		povBufferInfo.range = sizeof(ViewpointUniforms);
+
+		VkWriteDescriptorSet povWrite = {};
+		povWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		povWrite.dstSet = list->set;
+		povWrite.dstBinding = 0;
+		povWrite.dstArrayElement = 0;
+		povWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		povWrite.descriptorCount = 1;
+		povWrite.pBufferInfo = &povBufferInfo;
+
+		vkUpdateDescriptorSets(device, 1, &povWrite, 0, 0);
+	}
+
+	return 0;
+}
+
+void destroyDrawLists(VkDevice device, DrawLists drawLists)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		destroyDrawList(device, drawLists.lists[i]);
+	}
+
+	vkDestroyDescriptorPool(device, drawLists.pool, 0);
+	vkDestroyDescriptorSetLayout(device, drawLists.layout, 0);
+}
+
+/* Grows the buffers to fit, doubling so a slowly growing scene doesn't
+ * reallocate every frame. Only for lists the device is done with, which
+ * is also what makes rewriting the set safe. */
+int reserveDrawList(
+	DrawList* list,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	uint32_t objectCount,
+	uint32_t commandCount
+)
+{
+	if (objectCount > list->objectLimit) {
+		uint32_t limit = list->objectLimit ? list->objectLimit : 1;
+
+		while (limit < objectCount) limit *= 2;
+
+		vkDestroyBuffer(device, list->objectBuffer, 0);
+		vkFreeMemory(device, list->objectMemory, 0);
+		list->objectLimit = 0;
+
+		if (createDrawListBuffer(
+			device,
+			physDev,
+			sizeof(ObjectData) * limit,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			&list->objectBuffer,
+			&list->objectMemory,
+			(void**)&list->objects
+		)) {
+			return -1;
+		}
+
+		list->objectLimit = limit;
+		writeDrawListObjects(list, device);
+	}
+
+	if (commandCount > list->commandLimit) {
+		uint32_t limit = list->commandLimit ? list->commandLimit : 1;
+
+		while (limit < commandCount) limit *= 2;
+
+		vkDestroyBuffer(device, list->commandBuffer, 0);
+		vkFreeMemory(device, list->commandMemory, 0);
+		list->commandLimit = 0;
+
+		if (createDrawListBuffer(
+			device,
+			physDev,
+			sizeof(VkDrawIndexedIndirectCommand) * limit,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+			| VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			&list->commandBuffer,
+			&list->commandMemory,
+			(void**)&list->commands
+		)) {
+			return -1;
+		}
+
+		list->commandLimit = limit;
+
+		if (!list->cullable) return 0;
+
+		vkDestroyBuffer(device, list->culledBuffer, 0);
+		vkFreeMemory(device, list->culledMemory, 0);
+		list->culledBuffer = VK_NULL_HANDLE;
+		list->culledMemory = VK_NULL_HANDLE;
+
+		/* The count, then as many commands as could survive */
+		if (createBuffer(
+			device,
+			physDev,
+			sizeof(uint32_t)
+			+ sizeof(VkDrawIndexedIndirectCommand) * limit,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+			| VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+			| VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&list->culledBuffer,
+			&list->culledMemory
+		)) {
+			printf("Failed to create culled draw list buffer\n");
+			return -1;
+		}
+
+		writeDrawListCommands(list, device);
+	}
+
+	return 0;
+}
+
+/* Host visible and left mapped for as long as it lives */
+int createDrawListBuffer(
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkDeviceSize size,
+	VkBufferUsageFlags usage,
+	VkBuffer* buffer,
+	VkDeviceMemory* mem,
+	void** mapped
+)
+{
+	if (createBuffer(
+		device,
+		physDev,
+		size,
+		usage,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		buffer,
+		mem
+	)) {
+		printf("Failed to create draw list buffer\n");
+		return -1;
+	}
+
+	if (vkMapMemory(device, *mem, 0, size, 0, mapped) != VK_SUCCESS) {
+		printf("Failed to map draw list buffer\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+void writeDrawListObjects(DrawList* list, VkDevice device)
+{
+	VkDescriptorBufferInfo objectBufferInfo = {};
+	objectBufferInfo.buffer = list->objectBuffer;
+	objectBufferInfo.offset = 0;
+	objectBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet objectWrite = {};
+	objectWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	objectWrite.dstSet = list->set;
+	objectWrite.dstBinding = 1;
+	objectWrite.dstArrayElement = 0;
+	objectWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectWrite.descriptorCount = 1;
+	objectWrite.pBufferInfo = &objectBufferInfo;
+
+	vkUpdateDescriptorSets(device, 1, &objectWrite, 0, 0);
+}
+
+void writeDrawListCommands(DrawList* list, VkDevice device)
+{
+	VkDescriptorBufferInfo bufferInfos[2] = {};
+	bufferInfos[0].buffer = list->commandBuffer;
+	bufferInfos[0].offset = 0;
+	bufferInfos[0].range = VK_WHOLE_SIZE;
+	bufferInfos[1].buffer = list->culledBuffer;
+	bufferInfos[1].offset = 0;
+	bufferInfos[1].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[2] = {};
+
+	for (int i = 0; i < 2; i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = list->set;
+		writes[i].dstBinding = 2 + i;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].descriptorCount = 1;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(device, 2, writes, 0, 0);
+}
+
+/* The memory gets unmapped along with being freed. */
+void destroyDrawList(VkDevice device, DrawList list)
+{
+	vkDestroyBuffer(device, list.objectBuffer, 0);
+	vkFreeMemory(device, list.objectMemory, 0);
+	vkDestroyBuffer(device, list.commandBuffer, 0);
+	vkFreeMemory(device, list.commandMemory, 0);
+	vkDestroyBuffer(device, list.culledBuffer, 0);
+	vkFreeMemory(device, list.culledMemory, 0);
+}
@@ -0,0 +1,108 @@
+#ifndef RENDER_DRAWLIST_H
+#define RENDER_DRAWLIST_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "misc.h"
+#include "scene.h"
+
+/* Room for this many objects and commands before the first frame that
+ * needs more */
+#define DRAW_LIST_INITIAL_LIMIT 1024
+
+/* Workgroup size of instcull.comp */
+#define DRAW_LIST_CULL_GROUP_SIZE 64
+
+/* What the multi-draw shaders know about a mesh. Draws find theirs with
+ * gl_InstanceIndex, since every draw is one instance starting at its object.
+ * Laid out to match the std430 struct in multidraw.vert. The sphere is the
+ * mesh's bounds in world space, for instcull.comp. */
+typedef struct
+{
+	ModelUniforms model;
+	uint32_t texIndex;
+	uint32_t padding[3];
+	float sphere[4];
+} ObjectData;
+
+/* instcull.comp's push constants */
+typedef struct
+{
+	uint32_t commandCount;
+	uint32_t occlusionCull;
+} DrawListCullConstants;
+
+/* One frame's objects and draw commands, written by the CPU straight into
+ * host visible memory. The commands drawing from the geometry pool come first
+ * so one indirect draw covers all of them.
+ *
+ * Lists made with culling have a device local buffer as well, which
+ * instcull.comp fills with the pooled commands that are in view, after a
+ * count. The geometry pass draws from that instead when culled is set for the
+ * frame. */
+typedef struct
+{
+	VkBuffer objectBuffer;
+	VkDeviceMemory objectMemory;
+	ObjectData* objects;
+	uint32_t objectLimit;
+	uint32_t objectCount;
+
+	VkBuffer commandBuffer;
+	VkDeviceMemory commandMemory;
+	VkDrawIndexedIndirectCommand* commands;
+	uint32_t commandLimit;
+	uint32_t commandCount;
+	uint32_t pooledCommandCount;
+
+	char cullable;
+	char culled;
+	VkBuffer culledBuffer;
+	VkDeviceMemory culledMemory;
+
+	/* Set 0 of the multi-draw pipeline, the viewpoint and the objects */
+	VkDescriptorSet set;
+} DrawList;
+
+/* A list for each frame in flight, so a frame's list is only rewritten once
+ * its fence says the device is done with it. The set layout has instcull.comp's
+ * bindings whether or not the lists are culled. */
+typedef struct
+{
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	DrawList lists[MAX_FRAMES_IN_FLIGHT];
+} DrawLists;
+
+int createDrawLists(
+	DrawLists* drawLists,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const Viewpoint* pov,
+	char cullable
+);
+void destroyDrawLists(VkDevice device, DrawLists drawLists);
+
+int reserveDrawList(
+	DrawList* list,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	uint32_t objectCount,
+	uint32_t commandCount
+);
+
+int createDrawListBuffer(
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkDeviceSize size,
+	VkBufferUsageFlags usage,
+	VkBuffer* buffer,
+	VkDeviceMemory* mem,
+	void** mapped
+);
+
+void writeDrawListObjects(DrawList* list, VkDevice device);
+void writeDrawListCommands(DrawList* list, VkDevice device);
+void destroyDrawList(VkDevice device, DrawList list);
+
+#endif
@@ -0,0 +1,333 @@
+#include "drawrecord.h"
+#include <time.h>
+
+int iterateScenes(
+	VkCommandBuffer* cmdBuf,
+	SceneArray scenes,
+	const SortedDraws* draws,
+	int frame,
+	VkPipelineLayout pipelineLayout,
+	VkDescriptorSet texTableSet
+)
+{
+	VkDeviceSize offsets[] = {0};
+
+	/* The texture table is the same for every mesh, so it only gets bound
+	 * once. Meshes pick their texture with a push constant. */
+	if (texTableSet != VK_NULL_HANDLE) {
+		vkCmdBindDescriptorSets(
+			*cmdBuf,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			1,
+			1,
+			&texTableSet,
+			0,
+			0
+		);
+	}
+
+	/* Nothing's been bound or pushed yet. Meshes in the geometry pool all
+	 * share its buffers, so those mostly only get bound once. */
+	VkDescriptorSet boundSet = VK_NULL_HANDLE;
+	VkBuffer boundVertices = VK_NULL_HANDLE;
+	VkBuffer boundIndices = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_UINT16;
+	uint32_t texIndex = UINT32_MAX;
+
+	/* Sorted by sortDraws(), only the visible meshes */
+	for (int i = 0; i < draws->count; i++) {
+		const DrawItem item = draws->items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
+
+		if (mesh->descriptorSets[frame] != boundSet) {
+			boundSet = mesh->descriptorSets[frame];
+
+			vkCmdBindDescriptorSets(
+				*cmdBuf,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0,
+				1,
+				&boundSet,
+				0,
+				0
+			);
+		}
+
+		/* Meshes sharing a texture are next to each other. */
+		if (texTableSet != VK_NULL_HANDLE && mesh->texIndex != texIndex) {
+			texIndex = mesh->texIndex;
+
+			vkCmdPushConstants(
+				*cmdBuf,
+				pipelineLayout,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				0,
+				sizeof(uint32_t),
+				&texIndex
+			);
+		}
+
+		if (mesh->vertexBuffer != boundVertices) {
+			boundVertices = mesh->vertexBuffer;
+			vkCmdBindVertexBuffers(*cmdBuf, 0, 1, &boundVertices, offsets);
+		}
+
+		if (
+			mesh->indexBuffer != boundIndices
+			|| mesh->indexType != boundIndexType
+		) {
+			boundIndices = mesh->indexBuffer;
+			boundIndexType = mesh->indexType;
+			vkCmdBindIndexBuffer(*cmdBuf, boundIndices, 0, boundIndexType);
+		}
+
+		/* Whatever cullMeshlets() left in the draw list */
+		if (mesh->meshletCount) {
+			vkCmdDrawIndexedIndirectCount(
+				*cmdBuf,
+				mesh->drawBuffer,
+				sizeof(uint32_t),
+				mesh->drawBuffer,
+				0,
+				mesh->lods[mesh->lod].meshletCount,
+				sizeof(VkDrawIndexedIndirectCommand)
+			);
+
+			continue;
+		}
+		
+		/* Submeshes share the buffers, so they're just ranges. */
+		const Submesh* submeshes =
+			&mesh->submeshes[mesh->lod * mesh->submeshCount];
+
+		for (int k = 0; k < mesh->submeshCount; k++) {
+			vkCmdDrawIndexed(
+				*cmdBuf,
+				submeshes[k].indexCount,
+				1,
+				submeshes[k].firstIndex,
+				0,
+				0
+			);
+		}
+	}
+
+	return 0;
+}
+
+/* The chunk iterateDrawList() records when the draw list isn't split up */
+DrawListChunk wholeDrawList(const DrawList* list, const SortedDraws* draws)
+{
+	DrawListChunk chunk = {};
+	chunk.firstCommand = 0;
+	chunk.commandCount = list->culled ? 0 : list->pooledCommandCount;
+	chunk.countDraw = list->culled;
+	chunk.firstItem = 0;
+	chunk.itemCount = draws->count;
+
+	return chunk;
+}
+
+/* Splits the draw list into a chunk for each recording thread. The pooled
+ * commands are a draw or a few wherever they go, so they stay in the first.
+ * The meshes drawn on their own are what's worth sharing out, so each chunk
+ * gets about the same number of them, along with whatever pooled meshes are
+ * between them in the sorted draws. Chunks can come out empty. */
+void splitDrawList(
+	DrawListChunk* chunks,
+	unsigned int chunkCount,
+	SceneArray scenes,
+	const SortedDraws* draws,
+	const DrawList* list
+)
+{
+	unsigned int ownCount = 0;
+
+	for (int i = 0; i < draws->count; i++) {
+		const DrawItem item = draws->items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
+
+		ownCount += !mesh->pooled || mesh->meshletCount;
+	}
+
+	chunks[0] = wholeDrawList(list, draws);
+
+	for (int i = 1; i < chunkCount; i++) chunks[i] = (DrawListChunk){};
+
+	unsigned int chunk = 0;
+	unsigned int seen = 0;
+
+	for (unsigned int i = 0; i < draws->count; i++) {
+		const DrawItem item = draws->items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
+
+		if (mesh->pooled && !mesh->meshletCount) continue;
+
+		/* Each chunk starts at the first mesh of its share */
+		while (
+			chunk + 1 < chunkCount
+			&& seen >= (uint64_t)ownCount * (chunk + 1) / chunkCount
+		) {
+			chunks[chunk].itemCount = i - chunks[chunk].firstItem;
+			++chunk;
+			chunks[chunk].firstItem = i;
+		}
+
+		++seen;
+	}
+
+	chunks[chunk].itemCount = draws->count - chunks[chunk].firstItem;
+}
+
+/* iterateScenes() for the multi-draw pipeline. Pooled meshes that aren't
+ * drawn from meshlets all go in one indirect draw, split only where the
+ * device can't take that many at once. Everything else still gets a draw
+ * of its own, but the sets are bound once and the pool's buffers only
+ * need binding again for meshes that aren't in it. Only the chunk's share
+ * of all that gets recorded. */
+int iterateDrawList(
+	VkCommandBuffer* cmdBuf,
+	SceneArray scenes,
+	const SortedDraws* draws,
+	VkPipelineLayout pipelineLayout,
+	VkDescriptorSet texTableSet,
+	const DrawList* drawList,
+	const GeometryPool* geomPool,
+	uint32_t maxDrawCount,
+	const DrawListChunk* chunk
+)
+{
+	const unsigned int lastItem = chunk->firstItem + chunk->itemCount;
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize offsets[] = {0};
+
+	VkDescriptorSet sets[] = {drawList->set, texTableSet};
+
+	vkCmdBindDescriptorSets(
+		*cmdBuf,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipelineLayout,
+		0,
+		2,
+		sets,
+		0,
+		0
+	);
+
+	vkCmdBindVertexBuffers(
+		*cmdBuf,
+		0,
+		1,
+		&geomPool->vertices.buffer,
+		offsets
+	);
+
+	vkCmdBindIndexBuffer(
+		*cmdBuf,
+		geomPool->indices.buffer,
+		0,
+		VK_INDEX_TYPE_UINT16
+	);
+
+	/* Whatever cullDrawList() left */
+	if (chunk->countDraw) {
+		vkCmdDrawIndexedIndirectCount(
+			*cmdBuf,
+			drawList->culledBuffer,
+			sizeof(uint32_t),
+			drawList->culledBuffer,
+			0,
+			drawList->pooledCommandCount,
+			stride
+		);
+	}
+
+	for (uint32_t i = 0; i < chunk->commandCount; i += maxDrawCount) {
+		const uint32_t remaining = chunk->commandCount - i;
+
+		vkCmdDrawIndexedIndirect(
+			*cmdBuf,
+			drawList->commandBuffer,
+			(VkDeviceSize)(chunk->firstCommand + i) * stride,
+			remaining < maxDrawCount ? remaining : maxDrawCount,
+			stride
+		);
+	}
+
+	/* Pooled meshes drawn from meshlets, while the pool is still bound */
+	for (unsigned int i = chunk->firstItem; i < lastItem; i++) {
+		const DrawItem item = draws->items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
+
+		if (!mesh->pooled || !mesh->meshletCount) continue;
+
+		vkCmdDrawIndexedIndirectCount(
+			*cmdBuf,
+			mesh->drawBuffer,
+			sizeof(uint32_t),
+			mesh->drawBuffer,
+			0,
+			mesh->lods[mesh->lod].meshletCount,
+			stride
+		);
+	}
+
+	/* Meshes with buffers of their own */
+	for (unsigned int i = chunk->firstItem; i < lastItem; i++) {
+		const DrawItem item = draws->items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item.scene, item.mesh);
+
+		if (mesh->pooled) continue;
+
+		vkCmdBindVertexBuffers(
+			*cmdBuf,
+			0,
+			1,
+			&mesh->vertexBuffer,
+			offsets
+		);
+
+		vkCmdBindIndexBuffer(
+			*cmdBuf,
+			mesh->indexBuffer,
+			0,
+			mesh->indexType
+		);
+
+		if (mesh->meshletCount) {
+			vkCmdDrawIndexedIndirectCount(
+				*cmdBuf,
+				mesh->drawBuffer,
+				sizeof(uint32_t),
+				mesh->drawBuffer,
+				0,
+				mesh->lods[mesh->lod].meshletCount,
+				stride
+			);
+
+			continue;
+		}
+
+		vkCmdDrawIndexedIndirect(
+			*cmdBuf,
+			drawList->commandBuffer,
+			(VkDeviceSize)mesh->firstDraw * stride,
+			mesh->submeshCount,
+			stride
+		);
+	}
+
+	return 0;
+}
+
+/* For timing recording, in renderScenes() */
+uint64_t recordClockNanos(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
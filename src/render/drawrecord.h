@@ -0,0 +1,60 @@
+#ifndef RENDER_DRAWRECORD_H
+#define RENDER_DRAWRECORD_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "scene.h"
+#include "drawsort.h"
+#include "drawlist.h"
+#include "geompool.h"
+
+/* Recording the geometry subpass's draws, one mesh at a time or from the
+ * draw list. Nothing in here does more than record commands, so it can be
+ * timed without a device. */
+
+/* A share of the draw list for iterateDrawList() to record. It's the pooled
+ * commands from firstCommand, or with countDraw, all of them up to the count
+ * cullDrawList() leaves. Then the meshes drawn on their own, out of the
+ * sorted draws from firstItem. */
+typedef struct
+{
+	uint32_t firstCommand;
+	uint32_t commandCount;
+	char countDraw;
+	unsigned int firstItem;
+	unsigned int itemCount;
+} DrawListChunk;
+
+int iterateScenes(
+	VkCommandBuffer* cmdBuf,
+	SceneArray scenes,
+	const SortedDraws* draws,
+	int frame,
+	VkPipelineLayout pipelineLayout,
+	VkDescriptorSet texTableSet
+);
+
+int iterateDrawList(
+	VkCommandBuffer* cmdBuf,
+	SceneArray scenes,
+	const SortedDraws* draws,
+	VkPipelineLayout pipelineLayout,
+	VkDescriptorSet texTableSet,
+	const DrawList* drawList,
+	const GeometryPool* geomPool,
+	uint32_t maxDrawCount,
+	const DrawListChunk* chunk
+);
+
+DrawListChunk wholeDrawList(const DrawList* list, const SortedDraws* draws);
+void splitDrawList(
+	DrawListChunk* chunks,
+	unsigned int chunkCount,
+	SceneArray scenes,
+	const SortedDraws* draws,
+	const DrawList* list
+);
+
+uint64_t recordClockNanos(void);
+
+#endif
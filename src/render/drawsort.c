@@ -0,0 +1,142 @@
+#include "drawsort.h"
+#include "frustum.h"
+#include <string.h>
+
+uint64_t drawSortKey(
+	uint32_t pass,
+	uint32_t pipeline,
+	uint32_t texture,
+	float distanceSq
+)
+{
+	uint32_t distanceBits;
+	memcpy(&distanceBits, &distanceSq, sizeof(distanceBits));
+
+	const uint64_t passBits = pass & DRAW_KEY_PASS_MASK;
+	const uint64_t pipelineBits = pipeline & DRAW_KEY_PIPELINE_MASK;
+	const uint64_t textureBits = texture & DRAW_KEY_TEXTURE_MASK;
+
+	return passBits << DRAW_KEY_PASS_SHIFT
+		| pipelineBits << DRAW_KEY_PIPELINE_SHIFT
+		| textureBits << DRAW_KEY_TEXTURE_SHIFT
+		| distanceBits;
+}
+
+/* Keys every visible mesh and sorts them. Distances are to the centre of the
+ * mesh's bounding sphere. */
+int sortDraws(
+	SortedDraws* draws,
+	Arena* arena,
+	SceneArray scenes,
+	Vec3 eye
+)
+{
+	unsigned int count = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		for (int j = 0; j < DENSE_AT(Scene, scenes, i).meshes.count; j++) {
+			count += SCENE_MESH(scenes, i, j).visible;
+		}
+	}
+
+	draws->items = 0;
+	draws->count = 0;
+
+	if (!count) return 0;
+
+	/* Half of it is scratch for the sort. */
+	DrawItem* items = (DrawItem*)arenaAlloc(
+		arena,
+		sizeof(DrawItem) * count * 2
+	);
+
+	if (!items) return -1;
+
+	unsigned int idx = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		for (int j = 0; j < DENSE_AT(Scene, scenes, i).meshes.count; j++) {
+			const Mesh* mesh = &SCENE_MESH(scenes, i, j);
+
+			if (!mesh->visible) continue;
+
+			float pos[3];
+			transformPoint(pos, mesh->tform, mesh->sphereCentre);
+
+			const Vec3 toEye = {
+				eye.x - pos[X],
+				eye.y - pos[Y],
+				eye.z - pos[Z]
+			};
+
+			items[idx].key = drawSortKey(
+				DRAW_PASS_GEOMETRY,
+				DRAW_PIPELINE_DEFAULT,
+				mesh->texIndex,
+				dotVec3(toEye, toEye)
+			);
+			items[idx].scene = i;
+			items[idx].mesh = j;
+			++idx;
+		}
+	}
+
+	draws->items = radixSortDraws(items, items + count, count);
+	draws->count = count;
+
+	return 0;
+}
+
+/* Least significant byte first, so each pass keeps the order of the last.
+ * Every byte's counts come out of one read of the keys, and bytes that are
+ * the same in every key (usually the pass and pipeline ones) are skipped.
+ * Returns whichever of the two arrays the items ended up in. */
+DrawItem* radixSortDraws(
+	DrawItem* items,
+	DrawItem* scratch,
+	unsigned int count
+)
+{
+	const int passCount = 64 / DRAW_SORT_RADIX_BITS;
+	unsigned int counts[64 / DRAW_SORT_RADIX_BITS][DRAW_SORT_RADIX] = {};
+
+	for (int i = 0; i < count; i++) {
+		for (int p = 0; p < passCount; p++) {
+			++counts[p][
+				(items[i].key >> (p * DRAW_SORT_RADIX_BITS))
+				& (DRAW_SORT_RADIX - 1)
+			];
+		}
+	}
+
+	for (int p = 0; p < passCount; p++) {
+		const int shift = p * DRAW_SORT_RADIX_BITS;
+		const unsigned int first =
+			(items[0].key >> shift) & (DRAW_SORT_RADIX - 1);
+
+		if (counts[p][first] == count) continue;
+
+		/* Counts become where each bucket starts. */
+		unsigned int offset = 0;
+
+		for (int b = 0; b < DRAW_SORT_RADIX; b++) {
+			const unsigned int bucketCount = counts[p][b];
+			counts[p][b] = offset;
+			offset += bucketCount;
+		}
+
+		for (int i = 0; i < count; i++) {
+			const unsigned int bucket =
+				(items[i].key >> shift) & (DRAW_SORT_RADIX - 1);
+
+			scratch[counts[p][bucket]] = items[i];
+			++counts[p][bucket];
+		}
+
+		DrawItem* swap = items;
+		items = scratch;
+		scratch = swap;
+	}
+
+	return items;
+}
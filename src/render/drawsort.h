@@ -0,0 +1,71 @@
+#ifndef RENDER_DRAWSORT_H
+#define RENDER_DRAWSORT_H 1
+
+#include <stdint.h>
+#include "scene.h"
+#include "common/arena.h"
+#include "common/maths.h"
+
+/* Draw sort keys, most significant first:
+ *
+ *   63..60  pass
+ *   59..52  pipeline
+ *   51..32  texture, the mesh's slot in the texture table
+ *   31..0   squared distance from the viewpoint, as float bits
+ *
+ * Positive floats sort the same as their bits, so the distance needs no
+ * range to be quantised into and nearer meshes come first for early depth
+ * rejection. */
+#define DRAW_KEY_PASS_SHIFT 60
+#define DRAW_KEY_PIPELINE_SHIFT 52
+#define DRAW_KEY_TEXTURE_SHIFT 32
+
+#define DRAW_KEY_PASS_MASK 0xf
+#define DRAW_KEY_PIPELINE_MASK 0xff
+#define DRAW_KEY_TEXTURE_MASK 0xfffff
+
+/* Everything goes through the geometry pass for now, with its one
+ * pipeline. */
+#define DRAW_PASS_GEOMETRY 0
+#define DRAW_PIPELINE_DEFAULT 0
+
+/* Bits sorted per radix pass */
+#define DRAW_SORT_RADIX_BITS 8
+#define DRAW_SORT_RADIX (1 << DRAW_SORT_RADIX_BITS)
+
+typedef struct
+{
+	uint64_t key;
+	uint32_t scene;
+	uint32_t mesh;
+} DrawItem;
+
+/* This frame's visible meshes in the order they should be drawn. The items
+ * are in the frame arena. */
+typedef struct
+{
+	DrawItem* items;
+	unsigned int count;
+} SortedDraws;
+
+uint64_t drawSortKey(
+	uint32_t pass,
+	uint32_t pipeline,
+	uint32_t texture,
+	float distanceSq
+);
+
+int sortDraws(
+	SortedDraws* draws,
+	Arena* arena,
+	SceneArray scenes,
+	Vec3 eye
+);
+
+DrawItem* radixSortDraws(
+	DrawItem* items,
+	DrawItem* scratch,
+	unsigned int count
+);
+
+#endif
@@ -0,0 +1,255 @@
+#include "frustum.h"
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+/* Everything comes out of one arena allocation. The padding lanes are
+ * zeroed so they never hold anything odd, their results are thrown away. */
+int createMeshBounds(MeshBounds* bounds, Arena* arena, unsigned int count)
+{
+	const unsigned int padded = (count + FRUSTUM_BATCH_WIDTH - 1)
+		/ FRUSTUM_BATCH_WIDTH * FRUSTUM_BATCH_WIDTH;
+
+	/* The float arrays stay 16 byte aligned, since padded is a multiple
+	 * of four. */
+	float* floats = (float*)arenaAlloc(
+		arena,
+		sizeof(float) * padded * 10 + padded
+	);
+
+	if (!floats) return -1;
+
+	memset(floats, 0, sizeof(float) * padded * 10);
+
+	bounds->sphereX = floats;
+	bounds->sphereY = floats + padded;
+	bounds->sphereZ = floats + padded * 2;
+	bounds->radius = floats + padded * 3;
+	bounds->boxX = floats + padded * 4;
+	bounds->boxY = floats + padded * 5;
+	bounds->boxZ = floats + padded * 6;
+	bounds->extentX = floats + padded * 7;
+	bounds->extentY = floats + padded * 8;
+	bounds->extentZ = floats + padded * 9;
+	bounds->visible = (char*)(floats + padded * 10);
+	bounds->count = count;
+
+	return 0;
+}
+
+/* The sphere's centre goes through the transform and its radius grows with
+ * the biggest scale. The box's extents are the model space ones projected
+ * onto each world axis (Arvo's method). */
+void setMeshBounds(MeshBounds* bounds, unsigned int i, const Mesh* mesh)
+{
+	const float (*m)[4] = mesh->tform;
+	float centre[3];
+	float half[3];
+	float pos[3];
+
+	transformPoint(pos, m, mesh->sphereCentre);
+
+	bounds->sphereX[i] = pos[X];
+	bounds->sphereY[i] = pos[Y];
+	bounds->sphereZ[i] = pos[Z];
+	bounds->radius[i] = mesh->sphereRadius * transformMaxScale(m);
+
+	for (int j = 0; j < 3; j++) {
+		centre[j] = (mesh->aabbMin[j] + mesh->aabbMax[j]) * 0.5f;
+		half[j] = (mesh->aabbMax[j] - mesh->aabbMin[j]) * 0.5f;
+	}
+
+	transformPoint(pos, m, centre);
+
+	bounds->boxX[i] = pos[X];
+	bounds->boxY[i] = pos[Y];
+	bounds->boxZ[i] = pos[Z];
+
+	float extent[3];
+
+	for (int j = 0; j < 3; j++) {
+		extent[j] = fabsf(m[0][j]) * half[X]
+			+ fabsf(m[1][j]) * half[Y]
+			+ fabsf(m[2][j]) * half[Z];
+	}
+
+	bounds->extentX[i] = extent[X];
+	bounds->extentY[i] = extent[Y];
+	bounds->extentZ[i] = extent[Z];
+}
+
+/* Gribb and Hartmann. The planes are sums of the rows of proj * view, facing
+ * in, and normalised so distances to them are in world units. Depth runs
+ * from 0 to w in Vulkan, so the near plane is the third row on its own. */
+void extractFrustumPlanes(float (*planes)[4], const ViewpointUniforms* ubo)
+{
+	float view[4][4];
+	float proj[4][4];
+	float m[4][4];
+
+	memcpy(view, &ubo->view, sizeof(view));
+	memcpy(proj, &ubo->proj, sizeof(proj));
+
+	/* Column major, like the shaders */
+	for (int col = 0; col < 4; col++) {
+		for (int row = 0; row < 4; row++) {
+			m[col][row] = 0.0f;
+
+			for (int k = 0; k < 4; k++) {
+				m[col][row] += proj[k][row] * view[col][k];
+			}
+		}
+	}
+
+	for (int i = 0; i < 4; i++) {
+		planes[0][i] = m[i][3] + m[i][0];
+		planes[1][i] = m[i][3] - m[i][0];
+		planes[2][i] = m[i][3] + m[i][1];
+		planes[3][i] = m[i][3] - m[i][1];
+		planes[4][i] = m[i][2];
+		planes[5][i] = m[i][3] - m[i][2];
+	}
+
+	for (int i = 0; i < 6; i++) {
+		const float len = sqrtf(
+			planes[i][X] * planes[i][X]
+			+ planes[i][Y] * planes[i][Y]
+			+ planes[i][Z] * planes[i][Z]
+		);
+
+		if (len <= 0.0f) continue;
+
+		for (int j = 0; j < 4; j++) {
+			planes[i][j] /= len;
+		}
+	}
+}
+
+/* A mesh is visible when both its sphere and its box are at least partly on
+ * the inside of every plane. Each one catches meshes the other lets through:
+ * spheres are loose around long thin meshes, boxes around rotated ones. */
+void cullMeshBounds(MeshBounds* bounds, const float (*planes)[4])
+{
+#ifdef __SSE__
+	__m128 nx[6], ny[6], nz[6], nw[6];
+	__m128 ax[6], ay[6], az[6];
+
+	/* Every plane spread across the lanes once, not once per batch */
+	for (int p = 0; p < 6; p++) {
+		nx[p] = _mm_set1_ps(planes[p][X]);
+		ny[p] = _mm_set1_ps(planes[p][Y]);
+		nz[p] = _mm_set1_ps(planes[p][Z]);
+		nw[p] = _mm_set1_ps(planes[p][W]);
+		ax[p] = _mm_set1_ps(fabsf(planes[p][X]));
+		ay[p] = _mm_set1_ps(fabsf(planes[p][Y]));
+		az[p] = _mm_set1_ps(fabsf(planes[p][Z]));
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+
+	for (int i = 0; i < bounds->count; i += FRUSTUM_BATCH_WIDTH) {
+		const __m128 sx = _mm_load_ps(&bounds->sphereX[i]);
+		const __m128 sy = _mm_load_ps(&bounds->sphereY[i]);
+		const __m128 sz = _mm_load_ps(&bounds->sphereZ[i]);
+		const __m128 negRadius =
+			_mm_sub_ps(zero, _mm_load_ps(&bounds->radius[i]));
+		const __m128 bx = _mm_load_ps(&bounds->boxX[i]);
+		const __m128 by = _mm_load_ps(&bounds->boxY[i]);
+		const __m128 bz = _mm_load_ps(&bounds->boxZ[i]);
+		const __m128 ex = _mm_load_ps(&bounds->extentX[i]);
+		const __m128 ey = _mm_load_ps(&bounds->extentY[i]);
+		const __m128 ez = _mm_load_ps(&bounds->extentZ[i]);
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+
+		for (int p = 0; p < 6; p++) {
+			const __m128 sphereDist = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(nx[p], sx), _mm_mul_ps(ny[p], sy)),
+				_mm_add_ps(_mm_mul_ps(nz[p], sz), nw[p])
+			);
+
+			/* The box's furthest corner along the plane's normal */
+			const __m128 boxDist = _mm_add_ps(
+				_mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(nx[p], bx), _mm_mul_ps(ny[p], by)),
+					_mm_add_ps(_mm_mul_ps(nz[p], bz), nw[p])
+				),
+				_mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+					_mm_mul_ps(az[p], ez)
+				)
+			);
+
+			inside = _mm_and_ps(inside, _mm_and_ps(
+				_mm_cmpge_ps(sphereDist, negRadius),
+				_mm_cmpge_ps(boxDist, zero)
+			));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+
+		for (int j = 0; j < FRUSTUM_BATCH_WIDTH; j++) {
+			bounds->visible[i + j] = (mask >> j) & 1;
+		}
+	}
+#else
+	for (int i = 0; i < bounds->count; i++) {
+		bounds->visible[i] = meshBoundsVisible(bounds, i, planes);
+	}
+#endif
+}
+
+/* One mesh at a time, for when there's no SSE */
+char meshBoundsVisible(
+	const MeshBounds* bounds,
+	unsigned int i,
+	const float (*planes)[4]
+)
+{
+	for (int p = 0; p < 6; p++) {
+		const float* n = planes[p];
+
+		const float sphereDist = n[X] * bounds->sphereX[i]
+			+ n[Y] * bounds->sphereY[i]
+			+ n[Z] * bounds->sphereZ[i]
+			+ n[W];
+
+		const float boxDist = n[X] * bounds->boxX[i]
+			+ n[Y] * bounds->boxY[i]
+			+ n[Z] * bounds->boxZ[i]
+			+ n[W]
+			+ fabsf(n[X]) * bounds->extentX[i]
+			+ fabsf(n[Y]) * bounds->extentY[i]
+			+ fabsf(n[Z]) * bounds->extentZ[i];
+
+		if (sphereDist < -bounds->radius[i] || boxDist < 0.0f) return 0;
+	}
+
+	return 1;
+}
+
+/* Matrices are column major, with the translation in the last column. */
+void transformPoint(float* out, const float (*m)[4], const float* p)
+{
+	for (int i = 0; i < 3; i++) {
+		out[i] = m[0][i] * p[X] + m[1][i] * p[Y] + m[2][i] * p[Z] + m[3][i];
+	}
+}
+
+/* The length of the longest transformed axis */
+float transformMaxScale(const float (*m)[4])
+{
+	float scale = 0.0f;
+
+	for (int i = 0; i < 3; i++) {
+		const float axis =
+			m[i][X] * m[i][X] + m[i][Y] * m[i][Y] + m[i][Z] * m[i][Z];
+
+		scale = fmaxf(scale, sqrtf(axis));
+	}
+
+	return scale;
+}
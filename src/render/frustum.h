@@ -0,0 +1,47 @@
+#ifndef RENDER_FRUSTUM_H
+#define RENDER_FRUSTUM_H 1
+
+#include "scene.h"
+#include "common/arena.h"
+
+/* Meshes are tested this many at a time, one to each SSE lane. */
+#define FRUSTUM_BATCH_WIDTH 4
+
+/* World space bounds of every mesh in the frame. Each component has an array
+ * of its own so a batch of meshes loads straight into one register. The
+ * arrays are padded out to a whole batch. */
+typedef struct
+{
+	/* Bounding spheres */
+	float* sphereX;
+	float* sphereY;
+	float* sphereZ;
+	float* radius;
+
+	/* Axis aligned boxes around the transformed model space boxes */
+	float* boxX;
+	float* boxY;
+	float* boxZ;
+	float* extentX;
+	float* extentY;
+	float* extentZ;
+
+	char* visible;
+	unsigned int count;
+} MeshBounds;
+
+int createMeshBounds(MeshBounds* bounds, Arena* arena, unsigned int count);
+void setMeshBounds(MeshBounds* bounds, unsigned int i, const Mesh* mesh);
+
+void extractFrustumPlanes(float (*planes)[4], const ViewpointUniforms* ubo);
+void cullMeshBounds(MeshBounds* bounds, const float (*planes)[4]);
+char meshBoundsVisible(
+	const MeshBounds* bounds,
+	unsigned int i,
+	const float (*planes)[4]
+);
+
+void transformPoint(float* out, const float (*m)[4], const float* p);
+float transformMaxScale(const float (*m)[4]);
+
+#endif
@@ -0,0 +1,166 @@
+#include "garbage.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int createGarbageQueue(GarbageQueue* garbage)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		garbage->itemCount[i] = 0;
+		garbage->itemLimit[i] = 1;
+		garbage->items[i] = (Garbage*)malloc(sizeof(Garbage));
+
+		if (!garbage->items[i]) {
+			perror("Failed to allocate garbage queue");
+			return -1;
+		}
+	}
+
+	garbage->frame = 0;
+	garbage->pendingBytes = 0;
+
+	return 0;
+}
+
+void destroyGarbageQueue(GarbageQueue garbage)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		free(garbage.items[i]);
+	}
+}
+
+int throwAway(GarbageQueue* garbage, Garbage item)
+{
+	const unsigned int frame = garbage->frame;
+
+	if (garbage->itemCount[frame] >= garbage->itemLimit[frame]) {
+		garbage->itemLimit[frame] *= 2;
+
+		void* newItems = realloc(
+			garbage->items[frame],
+			sizeof(Garbage) * garbage->itemLimit[frame]
+		);
+
+		if (!newItems) {
+			perror("Failed to reallocate garbage queue");
+			return -1;
+		}
+
+		garbage->items[frame] = (Garbage*)newItems;
+	}
+
+	garbage->items[frame][garbage->itemCount[frame]] = item;
+	++garbage->itemCount[frame];
+
+	if (item.type == GARBAGE_MEMORY) {
+		garbage->pendingBytes += item.memSize;
+	} else if (
+		item.type == GARBAGE_VERTEX_RANGE
+		|| item.type == GARBAGE_INDEX_RANGE
+	) {
+		garbage->pendingBytes += item.rangeSize;
+	}
+
+	return 0;
+}
+
+int throwAwayBuffer(
+	GarbageQueue* garbage,
+	VkBuffer buffer,
+	VkDeviceMemory mem,
+	VkDeviceSize memSize
+)
+{
+	Garbage item = {};
+
+	item.type = GARBAGE_BUFFER;
+	item.buffer = buffer;
+	if (throwAway(garbage, item)) return -1;
+
+	item.type = GARBAGE_MEMORY;
+	item.memory = mem;
+	item.memSize = memSize;
+	if (throwAway(garbage, item)) return -1;
+
+	return 0;
+}
+
+void collectGarbage(
+	GarbageQueue* garbage,
+	unsigned int frame,
+	VkDevice device,
+	DescriptorAllocator* descAlloc,
+	TextureTable* texTable,
+	GeometryPool* geomPool,
+	MemoryBudget* budget
+)
+{
+	for (int i = 0; i < garbage->itemCount[frame]; i++) {
+		const Garbage item = garbage->items[frame][i];
+
+		switch (item.type) {
+		case GARBAGE_BUFFER:
+			vkDestroyBuffer(device, item.buffer, 0);
+			break;
+		case GARBAGE_MEMORY:
+			vkFreeMemory(device, item.memory, 0);
+			budgetRelease(budget, item.memSize);
+			garbage->pendingBytes -= item.memSize;
+			break;
+		case GARBAGE_IMAGE:
+			vkDestroyImage(device, item.image, 0);
+			break;
+		case GARBAGE_IMAGE_VIEW:
+			vkDestroyImageView(device, item.view, 0);
+			break;
+		case GARBAGE_DESCRIPTOR_SET:
+			/* The set goes back to the allocator for the next mesh. */
+			freeDescriptorSets(descAlloc, &item.descSet, 1);
+			break;
+		case GARBAGE_TEXTURE_SLOT:
+			if (texTable) texTableRemove(texTable, item.texSlot);
+			break;
+		case GARBAGE_VERTEX_RANGE:
+			if (geomPool) bufferPoolFree(&geomPool->vertices, item.range);
+			budgetRelease(budget, item.rangeSize);
+			garbage->pendingBytes -= item.rangeSize;
+			break;
+		case GARBAGE_INDEX_RANGE:
+			if (geomPool) bufferPoolFree(&geomPool->indices, item.range);
+			budgetRelease(budget, item.rangeSize);
+			garbage->pendingBytes -= item.rangeSize;
+			break;
+		case GARBAGE_COMMAND_BUFFER:
+			vkFreeCommandBuffers(device, item.cmdPool, 1, &item.cmdBuf);
+			break;
+		default:
+			printf("Unknown garbage type: %i\n", item.type);
+			break;
+		}
+	}
+
+	/* The list keeps its size. Whatever was deleted this time around will
+	 * probably be deleted again. */
+	garbage->itemCount[frame] = 0;
+}
+
+void flushGarbage(
+	GarbageQueue* garbage,
+	VkDevice device,
+	DescriptorAllocator* descAlloc,
+	TextureTable* texTable,
+	GeometryPool* geomPool,
+	MemoryBudget* budget
+)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		collectGarbage(
+			garbage,
+			i,
+			device,
+			descAlloc,
+			texTable,
+			geomPool,
+			budget
+		);
+	}
+}
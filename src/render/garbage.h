@@ -0,0 +1,116 @@
+#ifndef RENDER_GARBAGE_H
+#define RENDER_GARBAGE_H 1
+
+/* Things deleted by clients can still be in use by frames in flight. Instead
+ * of waiting for the whole device to go idle on every delete, they get thrown
+ * out here and destroyed once the last frame that could have used them is
+ * done. */
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "misc.h"
+#include "descalloc.h"
+#include "textable.h"
+#include "budget.h"
+#include "geompool.h"
+
+typedef unsigned char garbageType;
+enum
+{
+	GARBAGE_BUFFER = 0,
+	GARBAGE_MEMORY,
+	GARBAGE_IMAGE,
+	GARBAGE_IMAGE_VIEW,
+	GARBAGE_DESCRIPTOR_SET,
+	GARBAGE_TEXTURE_SLOT,
+	GARBAGE_VERTEX_RANGE,
+	GARBAGE_INDEX_RANGE,
+	GARBAGE_COMMAND_BUFFER
+};
+
+typedef struct
+{
+	garbageType type;
+	union
+	{
+		VkBuffer buffer;
+
+		/* memSize is what the memory was charged to the budget, if
+		 * anything. */
+		struct
+		{
+			VkDeviceMemory memory;
+			VkDeviceSize memSize;
+		};
+
+		VkImage image;
+		VkImageView view;
+		VkDescriptorSet descSet;
+		uint32_t texSlot;
+
+		/* Ranges of the geometry pool are charged to the budget like
+		 * memory. */
+		struct
+		{
+			PoolRange range;
+			VkDeviceSize rangeSize;
+		};
+
+		/* Freed back to the pool it came from */
+		struct
+		{
+			VkCommandPool cmdPool;
+			VkCommandBuffer cmdBuf;
+		};
+	};
+} Garbage;
+
+/* One list per frame in flight. Garbage goes into the list of the last frame
+ * submitted and is collected after that frame's fence is next waited on. */
+typedef struct
+{
+	Garbage* items[MAX_FRAMES_IN_FLIGHT];
+	unsigned int itemCount[MAX_FRAMES_IN_FLIGHT];
+	unsigned int itemLimit[MAX_FRAMES_IN_FLIGHT];
+
+	/* The last frame submitted */
+	unsigned int frame;
+
+	/* Budgeted memory thrown away but not freed yet */
+	VkDeviceSize pendingBytes;
+} GarbageQueue;
+
+int createGarbageQueue(GarbageQueue* garbage);
+void destroyGarbageQueue(GarbageQueue garbage);
+
+int throwAway(GarbageQueue* garbage, Garbage item);
+int throwAwayBuffer(
+	GarbageQueue* garbage,
+	VkBuffer buffer,
+	VkDeviceMemory mem,
+	VkDeviceSize memSize
+);
+
+/* texTable is null when the display isn't running bindless, and geomPool
+ * when it isn't drawing through a geometry pool. */
+void collectGarbage(
+	GarbageQueue* garbage,
+	unsigned int frame,
+	VkDevice device,
+	DescriptorAllocator* descAlloc,
+	TextureTable* texTable,
+	GeometryPool* geomPool,
+	MemoryBudget* budget
+);
+
+/* Only for when the device is idle */
+void flushGarbage(
+	GarbageQueue* garbage,
+	VkDevice device,
+	DescriptorAllocator* descAlloc,
+	TextureTable* texTable,
+	GeometryPool* geomPool,
+	MemoryBudget* budget
+);
+
+#endif
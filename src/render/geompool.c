@@ -0,0 +1,296 @@
+#include "geompool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The whole buffer starts out as one free range. */
+int createBufferPool(
+	BufferPool* pool,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkBufferUsageFlags usage,
+	VkDeviceSize stride,
+	uint32_t capacity
+)
+{
+	pool->stride = stride;
+	pool->capacity = capacity;
+
+	if (createBuffer(
+		device,
+		physDev,
+		stride * capacity,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&pool->buffer,
+		&pool->mem
+	)) {
+		printf("Failed to create pool buffer\n");
+		return -1;
+	}
+
+	pool->freeLimit = 16;
+	pool->freeRanges = (PoolRange*)malloc(sizeof(PoolRange) * pool->freeLimit);
+
+	if (!pool->freeRanges) {
+		perror("Failed to allocate pool free list");
+		return -1;
+	}
+
+	pool->freeRanges[0].first = 0;
+	pool->freeRanges[0].count = capacity;
+	pool->freeCount = 1;
+
+	return 0;
+}
+
+void destroyBufferPool(VkDevice device, BufferPool pool)
+{
+	vkDestroyBuffer(device, pool.buffer, 0);
+	vkFreeMemory(device, pool.mem, 0);
+	free(pool.freeRanges);
+}
+
+/* First fit. Returns 1 when there's no free range big enough, which isn't
+ * an error, the caller just has to put the data somewhere else. */
+int bufferPoolAlloc(BufferPool* pool, uint32_t count, PoolRange* range)
+{
+	for (int i = 0; i < pool->freeCount; i++) {
+		PoolRange* gap = &pool->freeRanges[i];
+
+		if (gap->count < count) continue;
+
+		range->first = gap->first;
+		range->count = count;
+
+		gap->first += count;
+		gap->count -= count;
+
+		/* Used up ranges slide out of the list. */
+		if (!gap->count) {
+			memmove(
+				gap,
+				gap + 1,
+				sizeof(PoolRange) * (pool->freeCount - i - 1)
+			);
+			--pool->freeCount;
+		}
+
+		return 0;
+	}
+
+	return 1;
+}
+
+/* The range goes back in order and swallows whichever neighbours it
+ * touches. */
+int bufferPoolFree(BufferPool* pool, PoolRange range)
+{
+	if (!range.count) return 0;
+
+	unsigned int idx = 0;
+
+	while (idx < pool->freeCount
+		&& pool->freeRanges[idx].first < range.first) {
+		++idx;
+	}
+
+	const char joinsPrev = idx > 0
+		&& pool->freeRanges[idx - 1].first + pool->freeRanges[idx - 1].count
+		== range.first;
+	const char joinsNext = idx < pool->freeCount
+		&& range.first + range.count == pool->freeRanges[idx].first;
+
+	if (joinsPrev && joinsNext) {
+		pool->freeRanges[idx - 1].count +=
+			range.count + pool->freeRanges[idx].count;
+
+		memmove(
+			&pool->freeRanges[idx],
+			&pool->freeRanges[idx + 1],
+			sizeof(PoolRange) * (pool->freeCount - idx - 1)
+		);
+		--pool->freeCount;
+
+		return 0;
+	}
+
+	if (joinsPrev) {
+		pool->freeRanges[idx - 1].count += range.count;
+		return 0;
+	}
+
+	if (joinsNext) {
+		pool->freeRanges[idx].first = range.first;
+		pool->freeRanges[idx].count += range.count;
+		return 0;
+	}
+
+	if (pool->freeCount >= pool->freeLimit) {
+		pool->freeLimit *= 2;
+
+		void* newRanges = realloc(
+			pool->freeRanges,
+			sizeof(PoolRange) * pool->freeLimit
+		);
+
+		if (!newRanges) {
+			perror("Failed to reallocate pool free list");
+			return -1;
+		}
+
+		pool->freeRanges = (PoolRange*)newRanges;
+	}
+
+	memmove(
+		&pool->freeRanges[idx + 1],
+		&pool->freeRanges[idx],
+		sizeof(PoolRange) * (pool->freeCount - idx)
+	);
+
+	pool->freeRanges[idx] = range;
+	++pool->freeCount;
+
+	return 0;
+}
+
+/* Like createVertexBuffer(), except the copy lands part way into a buffer
+ * that's already there. */
+int writeBufferPool(
+	BufferPool* pool,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* data,
+	PoolRange range
+)
+{
+	const VkDeviceSize size = range.count * pool->stride;
+
+	VkBuffer stagingBuffer = 0;
+	VkDeviceMemory stagingBufferMemory = 0;
+
+	if (createBuffer(
+		device,
+		physDev,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer,
+		&stagingBufferMemory
+	)) {
+		printf("Failed to create staging buffer\n");
+		return -1;
+	}
+
+	void* mappedData;
+	vkMapMemory(device, stagingBufferMemory, 0, size, 0, &mappedData);
+
+	memcpy(mappedData, data, size);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	beginSingleTimeCommands(cmdBuf);
+
+	VkBufferCopy copyRegion = {};
+	copyRegion.dstOffset = range.first * pool->stride;
+	copyRegion.size = size;
+
+	vkCmdCopyBuffer(cmdBuf, stagingBuffer, pool->buffer, 1, &copyRegion);
+
+	endSingleTimeCommands(cmdBuf, queue);
+
+	vkDestroyBuffer(device, stagingBuffer, 0);
+	vkFreeMemory(device, stagingBufferMemory, 0);
+
+	return 0;
+}
+
+int createGeometryPool(
+	GeometryPool* pool,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkDeviceSize vertexStride
+)
+{
+	if (createBufferPool(
+		&pool->vertices,
+		device,
+		physDev,
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		vertexStride,
+		GEOMETRY_POOL_VERTICES
+	)) {
+		return -1;
+	}
+
+	if (createBufferPool(
+		&pool->indices,
+		device,
+		physDev,
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		sizeof(uint16_t),
+		GEOMETRY_POOL_INDICES
+	)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+void destroyGeometryPool(VkDevice device, GeometryPool pool)
+{
+	destroyBufferPool(device, pool.vertices);
+	destroyBufferPool(device, pool.indices);
+}
+
+/* Finds room for a mesh and uploads it. Returns 1 without touching the pool
+ * when either half doesn't fit. */
+int geometryPoolAdd(
+	GeometryPool* pool,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* vertexData,
+	uint32_t vertexCount,
+	const uint16_t* indexData,
+	uint32_t indexCount,
+	PoolRange* vertexRange,
+	PoolRange* indexRange
+)
+{
+	if (bufferPoolAlloc(&pool->vertices, vertexCount, vertexRange)) {
+		return 1;
+	}
+
+	if (bufferPoolAlloc(&pool->indices, indexCount, indexRange)) {
+		bufferPoolFree(&pool->vertices, *vertexRange);
+		return 1;
+	}
+
+	if (writeBufferPool(
+		&pool->vertices,
+		cmdBuf,
+		queue,
+		device,
+		physDev,
+		vertexData,
+		*vertexRange
+	) || writeBufferPool(
+		&pool->indices,
+		cmdBuf,
+		queue,
+		device,
+		physDev,
+		indexData,
+		*indexRange
+	)) {
+		bufferPoolFree(&pool->vertices, *vertexRange);
+		bufferPoolFree(&pool->indices, *indexRange);
+		return -1;
+	}
+
+	return 0;
+}
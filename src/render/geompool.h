@@ -0,0 +1,92 @@
+#ifndef RENDER_GEOMPOOL_H
+#define RENDER_GEOMPOOL_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "misc.h"
+
+/* 64 MiB of full vertices, half that packed */
+#define GEOMETRY_POOL_VERTICES (1 << 21)
+
+/* 32 MiB of 16-bit indices */
+#define GEOMETRY_POOL_INDICES (1 << 24)
+
+/* A run of elements in a pool, not bytes */
+typedef struct
+{
+	uint32_t first;
+	uint32_t count;
+} PoolRange;
+
+/* One device local buffer carved up between meshes. The free ranges are kept
+ * in order and merged with their neighbours as they come back, so the first
+ * one big enough is as good a pick as any. */
+typedef struct
+{
+	VkBuffer buffer;
+	VkDeviceMemory mem;
+	VkDeviceSize stride;
+	uint32_t capacity;
+
+	PoolRange* freeRanges;
+	unsigned int freeCount;
+	unsigned int freeLimit;
+} BufferPool;
+
+/* Every mesh that fits shares one vertex buffer and one index buffer, so the
+ * geometry pass can draw all of them with one indirect draw. Indices are
+ * 16-bit and relative to the mesh's first vertex, which goes in the draw's
+ * vertex offset. Meshes with more vertices than that keep buffers of their
+ * own. */
+typedef struct
+{
+	BufferPool vertices;
+	BufferPool indices;
+} GeometryPool;
+
+int createBufferPool(
+	BufferPool* pool,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkBufferUsageFlags usage,
+	VkDeviceSize stride,
+	uint32_t capacity
+);
+void destroyBufferPool(VkDevice device, BufferPool pool);
+
+int bufferPoolAlloc(BufferPool* pool, uint32_t count, PoolRange* range);
+int bufferPoolFree(BufferPool* pool, PoolRange range);
+
+int writeBufferPool(
+	BufferPool* pool,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* data,
+	PoolRange range
+);
+
+int createGeometryPool(
+	GeometryPool* pool,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkDeviceSize vertexStride
+);
+void destroyGeometryPool(VkDevice device, GeometryPool pool);
+
+int geometryPoolAdd(
+	GeometryPool* pool,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* vertexData,
+	uint32_t vertexCount,
+	const uint16_t* indexData,
+	uint32_t indexCount,
+	PoolRange* vertexRange,
+	PoolRange* indexRange
+);
+
+#endif
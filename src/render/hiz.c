@@ -0,0 +1,530 @@
+#include "hiz.h"
+#include "common/maths.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const SamplerKey hizSamplerKey = {
+	.filter = VK_FILTER_NEAREST,
+	.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+	.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+	.minLod = 0.0f,
+	.maxLod = VK_LOD_CLAMP_NONE
+};
+
+int createDepthPyramid(
+	DepthPyramid* pyramid,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
+	VkExtent2D extent,
+	VkFormat depthFormat,
+	const FramebufferAttachment* depth
+)
+{
+	*pyramid = (DepthPyramid){};
+
+	pyramid->depthWidth = extent.width;
+	pyramid->depthHeight = extent.height;
+	pyramid->width = previousPowerOfTwo(extent.width);
+	pyramid->height = previousPowerOfTwo(extent.height);
+	pyramid->levelCount = 1;
+
+	/* Without depth attachments to build from, it's only there for
+	 * cull.comp's descriptor to name, so it may as well be tiny. */
+	if (!depth) {
+		pyramid->width = 1;
+		pyramid->height = 1;
+	}
+
+	while (
+		pyramid->levelCount < HIZ_MAX_LEVELS
+		&& (pyramid->width >> pyramid->levelCount
+		|| pyramid->height >> pyramid->levelCount)
+	) {
+		++pyramid->levelCount;
+	}
+
+	pyramid->depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+	if (depthFormat != VK_FORMAT_D32_SFLOAT) {
+		pyramid->depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+
+	if (createImage(
+		device,
+		physDev,
+		pyramid->width,
+		pyramid->height,
+		pyramid->levelCount,
+		VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&pyramid->image,
+		&pyramid->mem
+	)) {
+		return -1;
+	}
+
+	/* cull.comp's descriptor names the pyramid whether it's been built
+	 * yet or not, so it has to be in the right layout from the start. */
+	if (transitionImageLayout(
+		cmdBuf,
+		queue,
+		pyramid->image,
+		VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_GENERAL,
+		pyramid->levelCount
+	)) {
+		return -1;
+	}
+
+	if (createImageView(
+		device,
+		pyramid->image,
+		VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		pyramid->levelCount,
+		&pyramid->view
+	)) {
+		printf("Failed to create depth pyramid view\n");
+		return -1;
+	}
+
+	for (int i = 0; i < pyramid->levelCount; i++) {
+		VkImageViewCreateInfo viewInfo = defImageViewCreateInfo;
+		viewInfo.image = pyramid->image;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.baseMipLevel = i;
+
+		if (vkCreateImageView(
+			device,
+			&viewInfo,
+			0,
+			&pyramid->levelViews[i]
+		) != VK_SUCCESS) {
+			printf("Failed to create depth pyramid level view\n");
+			return -1;
+		}
+	}
+
+	if (getSampler(samplers, device, hizSamplerKey, &pyramid->sampler)) {
+		return -1;
+	}
+
+	if (createDepthPyramidDescriptors(pyramid, device, depth)) {
+		return -1;
+	}
+
+	if (depth && createDepthPyramidPipeline(pyramid, device)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int createDepthPyramidDescriptors(
+	DepthPyramid* pyramid,
+	VkDevice device,
+	const FramebufferAttachment* depth
+)
+{
+	/* Layouts */
+
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(
+		device,
+		&layoutInfo,
+		0,
+		&pyramid->reduceSetLayout
+	) != VK_SUCCESS) {
+		printf("Failed to create descriptor set layout\n");
+		return -1;
+	}
+
+	/* cull.comp only reads */
+	layoutInfo.bindingCount = 1;
+
+	if (vkCreateDescriptorSetLayout(
+		device,
+		&layoutInfo,
+		0,
+		&pyramid->cullSetLayout
+	) != VK_SUCCESS) {
+		printf("Failed to create descriptor set layout\n");
+		return -1;
+	}
+
+	/* Pool */
+
+	const unsigned int reduceSetCount = depth
+		? MAX_FRAMES_IN_FLIGHT + pyramid->levelCount - 1
+		: 0;
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = reduceSetCount + 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = reduceSetCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = reduceSetCount ? 2 : 1;
+	poolInfo.pPoolSizes = poolSizes;
+	poolInfo.maxSets = reduceSetCount + 1;
+
+	if (vkCreateDescriptorPool(
+		device,
+		&poolInfo,
+		0,
+		&pyramid->descPool
+	) != VK_SUCCESS) {
+		printf("Failed to create descriptor pool.\n");
+		return -1;
+	}
+
+	/* Sets */
+
+	VkDescriptorSetLayout setLayouts[MAX_FRAMES_IN_FLIGHT + HIZ_MAX_LEVELS];
+	VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT + HIZ_MAX_LEVELS];
+
+	for (int i = 0; i < reduceSetCount; i++) {
+		setLayouts[i] = pyramid->reduceSetLayout;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pyramid->descPool;
+	allocInfo.descriptorSetCount = reduceSetCount;
+	allocInfo.pSetLayouts = setLayouts;
+
+	if (reduceSetCount && vkAllocateDescriptorSets(
+		device,
+		&allocInfo,
+		sets
+	) != VK_SUCCESS) {
+		printf("Failed to allocate descriptor sets.\n");
+		return -1;
+	}
+
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &pyramid->cullSetLayout;
+
+	if (vkAllocateDescriptorSets(
+		device,
+		&allocInfo,
+		&pyramid->cullSet
+	) != VK_SUCCESS) {
+		printf("Failed to allocate descriptor sets.\n");
+		return -1;
+	}
+
+	/* Level 0 comes from the depth attachments, each level after from the
+	 * one before it. Levels being read or written stay in the general
+	 * layout, since the rest of the image is busy with the other. */
+	for (int i = 0; i < reduceSetCount; i++) {
+		const int level = i < MAX_FRAMES_IN_FLIGHT
+			? 0
+			: i - MAX_FRAMES_IN_FLIGHT + 1;
+
+		VkDescriptorImageInfo srcInfo = {};
+		srcInfo.sampler = pyramid->sampler;
+
+		if (level) {
+			pyramid->levelSets[level] = sets[i];
+			srcInfo.imageView = pyramid->levelViews[level - 1];
+			srcInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		} else {
+			pyramid->depthSets[i] = sets[i];
+			srcInfo.imageView = depth[i].view;
+			srcInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+
+		VkDescriptorImageInfo dstInfo = {};
+		dstInfo.imageView = pyramid->levelViews[level];
+		dstInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet writes[2] = {};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = sets[i];
+		writes[0].dstBinding = 0;
+		writes[0].dstArrayElement = 0;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].descriptorCount = 1;
+		writes[0].pImageInfo = &srcInfo;
+
+		writes[1] = writes[0];
+		writes[1].dstBinding = 1;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo = &dstInfo;
+
+		vkUpdateDescriptorSets(device, 2, writes, 0, 0);
+	}
+
+	VkDescriptorImageInfo pyramidInfo = {};
+	pyramidInfo.sampler = pyramid->sampler;
+	pyramidInfo.imageView = pyramid->view;
+	pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet cullWrite = {};
+	cullWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	cullWrite.dstSet = pyramid->cullSet;
+	cullWrite.dstBinding = 0;
+	cullWrite.dstArrayElement = 0;
+	cullWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	cullWrite.descriptorCount = 1;
+	cullWrite.pImageInfo = &pyramidInfo;
+
+	vkUpdateDescriptorSets(device, 1, &cullWrite, 0, 0);
+
+	return 0;
+}
+
+int createDepthPyramidPipeline(DepthPyramid* pyramid, VkDevice device)
+{
+	VkPushConstantRange constantRange = {};
+	constantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	constantRange.offset = 0;
+	constantRange.size = sizeof(HizReduceConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &pyramid->reduceSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &constantRange;
+
+	if (vkCreatePipelineLayout(
+		device,
+		&pipelineLayoutInfo,
+		0,
+		&pyramid->pipelineLayout
+	) != VK_SUCCESS) {
+		printf("Failed to create pipeline layout\n");
+		return -1;
+	}
+
+	const char* dataDir = getenv("IGNI_RENDER_DATA_DIR");
+
+	/* +1 to account for the null terminator */
+	int dataDirLen = strlen(dataDir) + 1;
+
+	char* compPath = malloc(dataDirLen + 20);
+	memcpy(compPath, dataDir, dataDirLen);
+	strcat(compPath, "/hiz.spv");
+
+	VkShaderModule hizComp;
+
+	int result = loadShaderModule(device, &hizComp, compPath);
+	free(compPath);
+
+	if (result) return -1;
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = hizComp;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pyramid->pipelineLayout;
+
+	VkResult pipelineResult = vkCreateComputePipelines(
+		device,
+		VK_NULL_HANDLE,
+		1,
+		&pipelineInfo,
+		0,
+		&pyramid->pipeline
+	);
+
+	vkDestroyShaderModule(device, hizComp, 0);
+
+	if (pipelineResult != VK_SUCCESS) {
+		printf("Failed to create compute pipeline\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The sampler belongs to the sampler cache. */
+void destroyDepthPyramid(VkDevice device, DepthPyramid pyramid)
+{
+	vkDestroyPipeline(device, pyramid.pipeline, 0);
+	vkDestroyPipelineLayout(device, pyramid.pipelineLayout, 0);
+	vkDestroyDescriptorPool(device, pyramid.descPool, 0);
+	vkDestroyDescriptorSetLayout(device, pyramid.reduceSetLayout, 0);
+	vkDestroyDescriptorSetLayout(device, pyramid.cullSetLayout, 0);
+
+	for (int i = 0; i < pyramid.levelCount; i++) {
+		vkDestroyImageView(device, pyramid.levelViews[i], 0);
+	}
+
+	vkDestroyImageView(device, pyramid.view, 0);
+	vkDestroyImage(device, pyramid.image, 0);
+	vkFreeMemory(device, pyramid.mem, 0);
+}
+
+/* Records the reduction of the depth attachment into every level, ready for
+ * cull.comp. The attachment is handed back in the layout the geometry pass
+ * left it in. */
+void buildDepthPyramid(
+	VkCommandBuffer* cmdBuf,
+	DepthPyramid* pyramid,
+	VkImage depthImage,
+	unsigned int depthIdx
+)
+{
+	/* The last frame's geometry pass wrote the depth and its culling pass
+	 * read the old pyramid, which gets thrown away. */
+	VkImageMemoryBarrier barriers[2] = {};
+	barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].image = depthImage;
+	barriers[0].subresourceRange.aspectMask = pyramid->depthAspect;
+	barriers[0].subresourceRange.baseMipLevel = 0;
+	barriers[0].subresourceRange.levelCount = 1;
+	barriers[0].subresourceRange.baseArrayLayer = 0;
+	barriers[0].subresourceRange.layerCount = 1;
+
+	barriers[1] = barriers[0];
+	barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barriers[1].image = pyramid->image;
+	barriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barriers[1].subresourceRange.levelCount = pyramid->levelCount;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+		| VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0,
+		0,
+		0,
+		0,
+		2,
+		barriers
+	);
+
+	vkCmdBindPipeline(
+		*cmdBuf,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		pyramid->pipeline
+	);
+
+	HizReduceConstants constants = {};
+
+	for (int i = 0; i < pyramid->levelCount; i++) {
+		/* Level 0's source is the attachment, at swapchain size */
+		constants.srcWidth = i ? constants.dstWidth : pyramid->depthWidth;
+		constants.srcHeight = i ? constants.dstHeight : pyramid->depthHeight;
+		constants.dstWidth = max(pyramid->width >> i, 1);
+		constants.dstHeight = max(pyramid->height >> i, 1);
+
+		vkCmdBindDescriptorSets(
+			*cmdBuf,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pyramid->pipelineLayout,
+			0,
+			1,
+			i ? &pyramid->levelSets[i] : &pyramid->depthSets[depthIdx],
+			0,
+			0
+		);
+
+		vkCmdPushConstants(
+			*cmdBuf,
+			pyramid->pipelineLayout,
+			VK_SHADER_STAGE_COMPUTE_BIT,
+			0,
+			sizeof(HizReduceConstants),
+			&constants
+		);
+
+		vkCmdDispatch(
+			*cmdBuf,
+			(constants.dstWidth + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+			(constants.dstHeight + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+			1
+		);
+
+		/* The next level, or cull.comp, reads this one. */
+		VkImageMemoryBarrier levelBarrier = barriers[1];
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		levelBarrier.subresourceRange.baseMipLevel = i;
+		levelBarrier.subresourceRange.levelCount = 1;
+
+		vkCmdPipelineBarrier(
+			*cmdBuf,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0,
+			0,
+			0,
+			0,
+			1,
+			&levelBarrier
+		);
+	}
+
+	/* The attachment goes back for the geometry pass two frames on. It
+	 * clears the depth, so only the reads have to finish first. */
+	barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+		0,
+		0,
+		0,
+		0,
+		0,
+		1,
+		barriers
+	);
+}
+
+uint32_t previousPowerOfTwo(uint32_t n)
+{
+	uint32_t result = 1;
+
+	while (result * 2 <= n && result < 0x80000000u) result *= 2;
+
+	return result;
+}
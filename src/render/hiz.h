@@ -0,0 +1,102 @@
+#ifndef RENDER_HIZ_H
+#define RENDER_HIZ_H 1
+
+#include <vulkan/vulkan.h>
+#include "misc.h"
+#include "pass.h"
+#include "sampler.h"
+
+/* Enough levels for a 65536 texel wide pyramid */
+#define HIZ_MAX_LEVELS 16
+
+/* Workgroup size of hiz.comp, in both directions */
+#define HIZ_GROUP_SIZE 8
+
+/* hiz.comp's push constants. The source is a level of the pyramid, or the
+ * depth attachment for level 0. */
+typedef struct
+{
+	int32_t srcWidth;
+	int32_t srcHeight;
+	int32_t dstWidth;
+	int32_t dstHeight;
+} HizReduceConstants;
+
+/* A mip chain of the farthest depth under every texel, built from the last
+ * frame's depth attachment. cull.comp throws away meshlets that are behind
+ * everything in their footprint. Level 0 is the biggest power of two that
+ * fits in the swapchain, so every level after it halves exactly. */
+typedef struct
+{
+	VkImage image;
+	VkDeviceMemory mem;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+
+	/* Size of the depth attachments it's built from */
+	uint32_t depthWidth;
+	uint32_t depthHeight;
+
+	/* The whole chain for reading, and one view per level for writing */
+	VkImageView view;
+	VkImageView levelViews[HIZ_MAX_LEVELS];
+	VkSampler sampler;
+
+	/* Depth attachments with stencil need both aspects in barriers. */
+	VkImageAspectFlags depthAspect;
+
+	VkDescriptorSetLayout reduceSetLayout;
+	VkDescriptorSetLayout cullSetLayout;
+	VkDescriptorPool descPool;
+
+	/* Level 0 reads whichever depth attachment was drawn last, so it has
+	 * a set for each. The rest read the level before them. */
+	VkDescriptorSet depthSets[MAX_FRAMES_IN_FLIGHT];
+	VkDescriptorSet levelSets[HIZ_MAX_LEVELS];
+	VkDescriptorSet cullSet;
+
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	/* Geometry passes drawn since the depth attachments were made. There's
+	 * nothing to build from before the first. */
+	uint64_t depthFrames;
+} DepthPyramid;
+
+/* Depth is only ever read with texelFetch(), so there's no filtering to get
+ * wrong. */
+extern const SamplerKey hizSamplerKey;
+
+/* depth is null when nothing will be built, for when the depth attachments
+ * are transient. The pyramid is then a single texel for cull.comp to name and
+ * buildDepthPyramid() mustn't be called. */
+int createDepthPyramid(
+	DepthPyramid* pyramid,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
+	VkExtent2D extent,
+	VkFormat depthFormat,
+	const FramebufferAttachment* depth
+);
+int createDepthPyramidDescriptors(
+	DepthPyramid* pyramid,
+	VkDevice device,
+	const FramebufferAttachment* depth
+);
+int createDepthPyramidPipeline(DepthPyramid* pyramid, VkDevice device);
+void destroyDepthPyramid(VkDevice device, DepthPyramid pyramid);
+
+void buildDepthPyramid(
+	VkCommandBuffer* cmdBuf,
+	DepthPyramid* pyramid,
+	VkImage depthImage,
+	unsigned int depthIdx
+);
+
+uint32_t previousPowerOfTwo(uint32_t n);
+
+#endif
@@ -0,0 +1,565 @@
+#include "lights.h"
+#include "frustum.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int createLightClusters(
+	LightClusters* clusters,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const Viewpoint* pov
+)
+{
+	*clusters = (LightClusters){};
+
+	/* Descriptor Set Layout */
+
+	VkDescriptorSetLayoutBinding layoutBindings[3] = {};
+	layoutBindings[0].binding = 0;
+	layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[0].descriptorCount = 1;
+	layoutBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	layoutBindings[1] = layoutBindings[0];
+	layoutBindings[1].binding = 1;
+
+	layoutBindings[2] = layoutBindings[0];
+	layoutBindings[2].binding = 2;
+	layoutBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 3;
+	layoutInfo.pBindings = layoutBindings;
+
+	if (vkCreateDescriptorSetLayout(
+		device,
+		&layoutInfo,
+		0,
+		&clusters->layout
+	) != VK_SUCCESS) {
+		printf("Failed to create light cluster descriptor set layout\n");
+		return -1;
+	}
+
+	/* Descriptor Pool */
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = MAX_FRAMES_IN_FLIGHT * 2;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+
+	VkDescriptorPoolCreateInfo descPoolInfo = {};
+	descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descPoolInfo.poolSizeCount = 2;
+	descPoolInfo.pPoolSizes = poolSizes;
+	descPoolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+	if (vkCreateDescriptorPool(
+		device,
+		&descPoolInfo,
+		0,
+		&clusters->pool
+	) != VK_SUCCESS) {
+		printf("Failed to create light cluster descriptor pool\n");
+		return -1;
+	}
+
+	/* Descriptor Sets */
+
+	VkDescriptorSetLayout setLayouts[MAX_FRAMES_IN_FLIGHT];
+	VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		setLayouts[i] = clusters->layout;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = clusters->pool;
+	allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+	allocInfo.pSetLayouts = setLayouts;
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets) != VK_SUCCESS) {
+		printf("Failed to allocate light cluster descriptor sets\n");
+		return -1;
+	}
+
+	/* Buffers */
+
+	const VkDeviceSize clusterSize =
+		sizeof(uint32_t) * CLUSTER_COUNT * (1 + CLUSTER_MAX_LIGHTS);
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		LightFrame* frame = &clusters->frames[i];
+
+		frame->set = sets[i];
+
+		/* Only ever touched by the device */
+		if (createBuffer(
+			device,
+			physDev,
+			clusterSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&frame->clusterBuffer,
+			&frame->clusterMemory
+		)) {
+			printf("Failed to create light cluster buffer\n");
+			return -1;
+		}
+
+		if (reserveLightFrame(
+			frame,
+			device,
+			physDev,
+			LIGHT_INITIAL_LIMIT
+		) < 0) {
+			return -1;
+		}
+
+		/* The viewpoint's buffers last as long as the display. */
+		VkDescriptorBufferInfo povBufferInfo = {};
+		povBufferInfo.buffer = pov->uniformBuffers[i];
+		povBufferInfo.offset = 0;
+		povBufferInfo.range = sizeof(ViewpointUniforms);
+
+		VkWriteDescriptorSet povWrite = {};
+		povWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		povWrite.dstSet = frame->set;
+		povWrite.dstBinding = 2;
+		povWrite.dstArrayElement = 0;
+		povWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		povWrite.descriptorCount = 1;
+		povWrite.pBufferInfo = &povBufferInfo;
+
+		vkUpdateDescriptorSets(device, 1, &povWrite, 0, 0);
+	}
+
+	/* Timestamps */
+
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physDev, &properties);
+
+	if (properties.limits.timestampComputeAndGraphics) {
+		clusters->timestampPeriod = properties.limits.timestampPeriod;
+	}
+
+	if (clusters->timestampPeriod > 0.0f) {
+		VkQueryPoolCreateInfo queryInfo = {};
+		queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryInfo.queryCount = LIGHT_QUERY_COUNT * MAX_FRAMES_IN_FLIGHT;
+
+		if (vkCreateQueryPool(
+			device,
+			&queryInfo,
+			0,
+			&clusters->queries
+		) != VK_SUCCESS) {
+			printf("Failed to create light timestamp query pool\n");
+			return -1;
+		}
+	}
+
+	if (createLightClusterPipeline(clusters, device)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int createLightClusterPipeline(LightClusters* clusters, VkDevice device)
+{
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &clusters->layout;
+
+	if (vkCreatePipelineLayout(
+		device,
+		&pipelineLayoutInfo,
+		0,
+		&clusters->pipelineLayout
+	) != VK_SUCCESS) {
+		printf("Failed to create pipeline layout\n");
+		return -1;
+	}
+
+	const char* dataDir = getenv("IGNI_RENDER_DATA_DIR");
+
+	/* +1 to account for the null terminator */
+	int dataDirLen = strlen(dataDir) + 1;
+
+	char* compPath = malloc(dataDirLen + 20);
+	memcpy(compPath, dataDir, dataDirLen);
+	strcat(compPath, "/cluster.spv");
+
+	VkShaderModule clusterComp;
+
+	int result = loadShaderModule(device, &clusterComp, compPath);
+	free(compPath);
+
+	if (result) return -1;
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = clusterComp;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = clusters->pipelineLayout;
+
+	VkResult pipelineResult = vkCreateComputePipelines(
+		device,
+		VK_NULL_HANDLE,
+		1,
+		&pipelineInfo,
+		0,
+		&clusters->pipeline
+	);
+
+	vkDestroyShaderModule(device, clusterComp, 0);
+
+	if (pipelineResult != VK_SUCCESS) {
+		printf("Failed to create compute pipeline\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The memory gets unmapped along with being freed. */
+void destroyLightClusters(VkDevice device, LightClusters clusters)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyBuffer(device, clusters.frames[i].lightBuffer, 0);
+		vkFreeMemory(device, clusters.frames[i].lightMemory, 0);
+		vkDestroyBuffer(device, clusters.frames[i].clusterBuffer, 0);
+		vkFreeMemory(device, clusters.frames[i].clusterMemory, 0);
+	}
+
+	vkDestroyQueryPool(device, clusters.queries, 0);
+	vkDestroyPipeline(device, clusters.pipeline, 0);
+	vkDestroyPipelineLayout(device, clusters.pipelineLayout, 0);
+	vkDestroyDescriptorPool(device, clusters.pool, 0);
+	vkDestroyDescriptorSetLayout(device, clusters.layout, 0);
+}
+
+/* Grows the light buffer to fit, doubling like the draw lists do. Only for
+ * frames the device is done with. Returns 1 when the buffer was made again,
+ * since any other set naming it needs writing again too. */
+int reserveLightFrame(
+	LightFrame* frame,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	uint32_t lightCount
+)
+{
+	if (lightCount <= frame->lightLimit) return 0;
+
+	uint32_t limit = frame->lightLimit ? frame->lightLimit : 1;
+
+	while (limit < lightCount) limit *= 2;
+
+	vkDestroyBuffer(device, frame->lightBuffer, 0);
+	vkFreeMemory(device, frame->lightMemory, 0);
+	frame->lightLimit = 0;
+
+	const VkDeviceSize size =
+		sizeof(GpuLightHeader) + sizeof(GpuLight) * limit;
+
+	if (createBuffer(
+		device,
+		physDev,
+		size,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&frame->lightBuffer,
+		&frame->lightMemory
+	)) {
+		printf("Failed to create light buffer\n");
+		return -1;
+	}
+
+	if (vkMapMemory(
+		device,
+		frame->lightMemory,
+		0,
+		size,
+		0,
+		&frame->lights
+	) != VK_SUCCESS) {
+		printf("Failed to map light buffer\n");
+		return -1;
+	}
+
+	frame->lightLimit = limit;
+	writeLightFrameSet(frame, device);
+
+	return 1;
+}
+
+void writeLightFrameSet(LightFrame* frame, VkDevice device)
+{
+	VkDescriptorBufferInfo bufferInfos[2] = {};
+	bufferInfos[0].buffer = frame->lightBuffer;
+	bufferInfos[0].offset = 0;
+	bufferInfos[0].range = VK_WHOLE_SIZE;
+
+	bufferInfos[1].buffer = frame->clusterBuffer;
+	bufferInfos[1].offset = 0;
+	bufferInfos[1].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[2] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = frame->set;
+	writes[0].dstBinding = 0;
+	writes[0].dstArrayElement = 0;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[0].descriptorCount = 1;
+	writes[0].pBufferInfo = &bufferInfos[0];
+
+	writes[1] = writes[0];
+	writes[1].dstBinding = 1;
+	writes[1].pBufferInfo = &bufferInfos[1];
+
+	vkUpdateDescriptorSets(device, 2, writes, 0, 0);
+}
+
+/* Every scene's lights and the made up ones go into the frame's buffer, moved
+ * into view space so the shaders don't have to. Returns what
+ * reserveLightFrame() did. */
+int writeLights(
+	LightClusters* clusters,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	unsigned int frameIdx,
+	SceneArray scenes,
+	const ViewpointUniforms* pov
+)
+{
+	LightFrame* frame = &clusters->frames[frameIdx];
+	uint32_t count = clusters->benchLights;
+
+	for (int i = 0; i < scenes.count; i++) {
+		count += DENSE_AT(Scene, scenes, i).pointLights.count;
+	}
+
+	const int result = reserveLightFrame(frame, device, physDev, count);
+
+	if (result < 0) return -1;
+
+	GpuLightHeader* header = (GpuLightHeader*)frame->lights;
+	GpuLight* lights = (GpuLight*)(header + 1);
+	uint32_t idx = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		const PointLightArray* sceneLights =
+			&DENSE_AT(Scene, scenes, i).pointLights;
+
+		for (int j = 0; j < sceneLights->count; j++) {
+			const PointLight* light = &DENSE_AT(PointLight, *sceneLights, j);
+			const float pos[3] = {light->x, light->y, light->z};
+
+			transformPoint(
+				lights[idx].position,
+				(const float (*)[4])&pov->view,
+				pos
+			);
+			lights[idx].range = light->distance;
+			lights[idx].colour[0] = light->r * light->intensity;
+			lights[idx].colour[1] = light->g * light->intensity;
+			lights[idx].colour[2] = light->b * light->intensity;
+			lights[idx].intensity = light->intensity;
+			lights[idx].shadowTile =
+				light->shadowReady ? light->shadowTile : -1;
+			++idx;
+		}
+	}
+
+	for (uint32_t i = 0; i < clusters->benchLights; i++) {
+		writeBenchLight(&lights[idx], i, pov);
+		++idx;
+	}
+
+	header->count = count;
+	frame->lightCount = count;
+
+	return result;
+}
+
+/* Records cluster.comp over every cluster, ready for the beauty subpass to
+ * read. Also where the frame's timestamps start, since resetting them has to
+ * happen outside the render pass. */
+void binLights(
+	VkCommandBuffer* cmdBuf,
+	LightClusters* clusters,
+	unsigned int frameIdx
+)
+{
+	LightFrame* frame = &clusters->frames[frameIdx];
+
+	if (clusters->queries) {
+		vkCmdResetQueryPool(
+			*cmdBuf,
+			clusters->queries,
+			frameIdx * LIGHT_QUERY_COUNT,
+			LIGHT_QUERY_COUNT
+		);
+		frame->timed = 1;
+	}
+
+	writeLightTimestamp(
+		cmdBuf,
+		clusters,
+		frameIdx,
+		LIGHT_QUERY_BIN_START,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+	);
+
+	vkCmdBindPipeline(
+		*cmdBuf,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		clusters->pipeline
+	);
+
+	vkCmdBindDescriptorSets(
+		*cmdBuf,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		clusters->pipelineLayout,
+		0,
+		1,
+		&frame->set,
+		0,
+		0
+	);
+
+	vkCmdDispatch(
+		*cmdBuf,
+		(CLUSTER_COUNT + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE,
+		1,
+		1
+	);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = frame->clusterBuffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0,
+		0,
+		1,
+		&barrier,
+		0,
+		0
+	);
+
+	writeLightTimestamp(
+		cmdBuf,
+		clusters,
+		frameIdx,
+		LIGHT_QUERY_BIN_END,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+}
+
+void writeLightTimestamp(
+	VkCommandBuffer* cmdBuf,
+	LightClusters* clusters,
+	unsigned int frame,
+	unsigned int query,
+	VkPipelineStageFlagBits stage
+)
+{
+	if (!clusters->queries) return;
+
+	vkCmdWriteTimestamp(
+		*cmdBuf,
+		stage,
+		clusters->queries,
+		frame * LIGHT_QUERY_COUNT + query
+	);
+}
+
+/* Only once the frame's fence has been waited on, so the results are there
+ * without stalling. */
+void readLightTimings(
+	LightClusters* clusters,
+	VkDevice device,
+	unsigned int frameIdx
+)
+{
+	LightFrame* frame = &clusters->frames[frameIdx];
+
+	if (!clusters->queries || !frame->timed) return;
+
+	frame->timed = 0;
+
+	uint64_t stamps[LIGHT_QUERY_COUNT];
+
+	if (vkGetQueryPoolResults(
+		device,
+		clusters->queries,
+		frameIdx * LIGHT_QUERY_COUNT,
+		LIGHT_QUERY_COUNT,
+		sizeof(stamps),
+		stamps,
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT
+	) != VK_SUCCESS) {
+		return;
+	}
+
+	const double nanosToMillis = clusters->timestampPeriod / 1e6;
+
+	clusters->lastLightCount = frame->lightCount;
+	clusters->binMillis =
+		(stamps[LIGHT_QUERY_BIN_END] - stamps[LIGHT_QUERY_BIN_START])
+		* nanosToMillis;
+	clusters->geomMillis =
+		(stamps[LIGHT_QUERY_SHADE_START] - stamps[LIGHT_QUERY_BIN_END])
+		* nanosToMillis;
+	clusters->shadeMillis =
+		(stamps[LIGHT_QUERY_SHADE_END] - stamps[LIGHT_QUERY_SHADE_START])
+		* nanosToMillis;
+}
+
+/* Run with IGNI_RENDER_BENCH_LIGHTS set to a few different counts to see how
+ * binning and shading scale, or with IGNI_RENDER_MESH_OPTIMIZE=0 and then 1
+ * to see what reordering meshes does for the geometry subpass. */
+void printLightStats(const LightClusters* clusters)
+{
+	printf(
+		"Lights: %u (%u made up)\n",
+		clusters->lastLightCount,
+		clusters->benchLights
+	);
+
+	if (!clusters->queries) {
+		printf("\tno timestamps on this device\n");
+		return;
+	}
+
+	printf(
+		"\tbinning: %.3f ms, geometry: %.3f ms, shading: %.3f ms\n",
+		clusters->binMillis,
+		clusters->geomMillis,
+		clusters->shadeMillis
+	);
+}
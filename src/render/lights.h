@@ -0,0 +1,128 @@
+#ifndef RENDER_LIGHTS_H
+#define RENDER_LIGHTS_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "misc.h"
+#include "scene.h"
+#include "cluster.h"
+
+/* Workgroup size of cluster.comp, which is also how many lights it loads
+ * into shared memory at a time */
+#define CLUSTER_GROUP_SIZE 64
+
+/* Room for this many lights before the first frame that needs more */
+#define LIGHT_INITIAL_LIMIT 256
+
+/* Timestamps written each frame. Binning is timed on its own, shading from
+ * the end of the geometry subpass to the end of the beauty one. The geometry
+ * subpass is whatever's between the two. */
+enum
+{
+	LIGHT_QUERY_BIN_START = 0,
+	LIGHT_QUERY_BIN_END = 1,
+	LIGHT_QUERY_SHADE_START = 2,
+	LIGHT_QUERY_SHADE_END = 3,
+	LIGHT_QUERY_COUNT = 4
+};
+
+/* The light buffer starts with how many lights follow, padded out to the
+ * lights' alignment. */
+typedef struct
+{
+	uint32_t count;
+	uint32_t padding[3];
+} GpuLightHeader;
+
+/* One frame's lights, written by the CPU, and which of them reach each
+ * cluster, written by cluster.comp. The cluster buffer is a count for every
+ * cluster followed by CLUSTER_MAX_LIGHTS indices for every cluster. */
+typedef struct
+{
+	VkBuffer lightBuffer;
+	VkDeviceMemory lightMemory;
+	void* lights;
+	uint32_t lightLimit;
+	uint32_t lightCount;
+
+	VkBuffer clusterBuffer;
+	VkDeviceMemory clusterMemory;
+
+	/* cluster.comp's set: the lights, the clusters and the viewpoint */
+	VkDescriptorSet set;
+
+	/* Whether this frame's timestamps have been written since it was last
+	 * read back */
+	char timed;
+} LightFrame;
+
+typedef struct
+{
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	LightFrame frames[MAX_FRAMES_IN_FLIGHT];
+
+	/* Made up lights added to every frame's, from
+	 * IGNI_RENDER_BENCH_LIGHTS */
+	uint32_t benchLights;
+
+	/* No timestamps on devices where timestampPeriod is 0 */
+	VkQueryPool queries;
+	float timestampPeriod;
+
+	/* From the last frame that was read back */
+	uint32_t lastLightCount;
+	double binMillis;
+	double geomMillis;
+	double shadeMillis;
+} LightClusters;
+
+int createLightClusters(
+	LightClusters* clusters,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const Viewpoint* pov
+);
+int createLightClusterPipeline(LightClusters* clusters, VkDevice device);
+void destroyLightClusters(VkDevice device, LightClusters clusters);
+
+int reserveLightFrame(
+	LightFrame* frame,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	uint32_t lightCount
+);
+void writeLightFrameSet(LightFrame* frame, VkDevice device);
+
+int writeLights(
+	LightClusters* clusters,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	unsigned int frame,
+	SceneArray scenes,
+	const ViewpointUniforms* pov
+);
+
+void binLights(
+	VkCommandBuffer* cmdBuf,
+	LightClusters* clusters,
+	unsigned int frame
+);
+void writeLightTimestamp(
+	VkCommandBuffer* cmdBuf,
+	LightClusters* clusters,
+	unsigned int frame,
+	unsigned int query,
+	VkPipelineStageFlagBits stage
+);
+void readLightTimings(
+	LightClusters* clusters,
+	VkDevice device,
+	unsigned int frame
+);
+void printLightStats(const LightClusters* clusters);
+
+#endif
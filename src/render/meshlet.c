@@ -0,0 +1,228 @@
+#include "meshlet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/* Meshlets are cut greedily out of each submesh's triangles in the order
+ * they're drawn. After meshopt.c that order keeps neighbours together, so
+ * the meshlets come out tight without any searching. A meshlet never spans
+ * two submeshes. */
+int buildMeshlets(
+	Meshlet** meshlets,
+	unsigned int* meshletCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices,
+	const Submesh* submeshes,
+	unsigned int submeshCount
+)
+{
+	unsigned int meshletLimit = 1;
+
+	*meshletCount = 0;
+	*meshlets = (Meshlet*)malloc(sizeof(Meshlet) * meshletLimit);
+
+	/* The meshlet that last took each vertex, plus one so zero is none */
+	uint32_t* vertexMeshlet = (uint32_t*)calloc(vertexCount, sizeof(uint32_t));
+
+	if (!*meshlets || !vertexMeshlet) {
+		perror("Failed to allocate meshlets");
+		free(*meshlets);
+		free(vertexMeshlet);
+		*meshlets = 0;
+		return -1;
+	}
+
+	for (int i = 0; i < submeshCount; i++) {
+		Meshlet current = {};
+		current.firstIndex = submeshes[i].firstIndex;
+
+		unsigned int currentVertices = 0;
+
+		for (int j = 0; j < submeshes[i].indexCount; j += 3) {
+			const uint32_t* tri = &indices[submeshes[i].firstIndex + j];
+			unsigned int newVertices = 0;
+
+			/* Degenerate triangles can name a vertex twice. */
+			for (int k = 0; k < 3; k++) {
+				newVertices +=
+					vertexMeshlet[tri[k]] != *meshletCount + 1
+					&& (k < 1 || tri[k] != tri[0])
+					&& (k < 2 || tri[k] != tri[1]);
+			}
+
+			if (current.indexCount && (
+				currentVertices + newVertices > MESHLET_MAX_VERTICES
+				|| current.indexCount / 3 >= MESHLET_MAX_TRIANGLES
+			)) {
+				computeMeshletBounds(&current, vertices, indices);
+
+				if (pushMeshlet(
+					meshlets,
+					meshletCount,
+					&meshletLimit,
+					current
+				)) {
+					free(vertexMeshlet);
+					return -1;
+				}
+
+				current = (Meshlet){};
+				current.firstIndex = submeshes[i].firstIndex + j;
+
+				/* Everything is new to the next meshlet. */
+				currentVertices = 0;
+				newVertices = 1 + (tri[1] != tri[0])
+					+ (tri[2] != tri[0] && tri[2] != tri[1]);
+			}
+
+			for (int k = 0; k < 3; k++) {
+				vertexMeshlet[tri[k]] = *meshletCount + 1;
+			}
+
+			currentVertices += newVertices;
+			current.indexCount += 3;
+		}
+
+		if (!current.indexCount) continue;
+
+		computeMeshletBounds(&current, vertices, indices);
+
+		if (pushMeshlet(meshlets, meshletCount, &meshletLimit, current)) {
+			free(vertexMeshlet);
+			return -1;
+		}
+	}
+
+	free(vertexMeshlet);
+
+	return 0;
+}
+
+/* The array is freed if it can't grow. */
+int pushMeshlet(
+	Meshlet** meshlets,
+	unsigned int* meshletCount,
+	unsigned int* meshletLimit,
+	Meshlet meshlet
+)
+{
+	if (*meshletCount >= *meshletLimit) {
+		*meshletLimit *= 2;
+
+		void* newMeshlets = realloc(
+			*meshlets,
+			sizeof(Meshlet) * *meshletLimit
+		);
+
+		if (!newMeshlets) {
+			perror("Failed to reallocate meshlets");
+			free(*meshlets);
+			*meshlets = 0;
+			return -1;
+		}
+
+		*meshlets = (Meshlet*)newMeshlets;
+	}
+
+	(*meshlets)[*meshletCount] = meshlet;
+	++*meshletCount;
+
+	return 0;
+}
+
+/* The sphere is centred on the bounding box, which is close enough to the
+ * smallest sphere for culling. The cone comes from the area weighted
+ * average of the triangle normals and the one furthest from it. */
+void computeMeshletBounds(
+	Meshlet* meshlet,
+	const Vertex* vertices,
+	const uint32_t* indices
+)
+{
+	const uint32_t* tris = &indices[meshlet->firstIndex];
+
+	float aabbMin[3] = {INFINITY, INFINITY, INFINITY};
+	float aabbMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+	for (int i = 0; i < meshlet->indexCount; i++) {
+		for (int j = 0; j < 3; j++) {
+			aabbMin[j] = fminf(aabbMin[j], vertices[tris[i]].pos[j]);
+			aabbMax[j] = fmaxf(aabbMax[j], vertices[tris[i]].pos[j]);
+		}
+	}
+
+	for (int i = 0; i < 3; i++) {
+		meshlet->centre[i] = (aabbMin[i] + aabbMax[i]) * 0.5f;
+	}
+
+	float radiusSq = 0.0f;
+
+	for (int i = 0; i < meshlet->indexCount; i++) {
+		const float* pos = vertices[tris[i]].pos;
+		const float dx = pos[X] - meshlet->centre[X];
+		const float dy = pos[Y] - meshlet->centre[Y];
+		const float dz = pos[Z] - meshlet->centre[Z];
+
+		radiusSq = fmaxf(radiusSq, dx * dx + dy * dy + dz * dz);
+	}
+
+	meshlet->radius = sqrtf(radiusSq);
+
+	/* Cone */
+
+	Vec3 axis = {};
+
+	for (int i = 0; i < meshlet->indexCount; i += 3) {
+		const float* a = vertices[tris[i]].pos;
+		const float* b = vertices[tris[i + 1]].pos;
+		const float* c = vertices[tris[i + 2]].pos;
+
+		const Vec3 ab = {b[X] - a[X], b[Y] - a[Y], b[Z] - a[Z]};
+		const Vec3 ac = {c[X] - a[X], c[Y] - a[Y], c[Z] - a[Z]};
+		const Vec3 cross = crossVec3(ab, ac);
+
+		axis.x += cross.x;
+		axis.y += cross.y;
+		axis.z += cross.z;
+	}
+
+	meshlet->coneAxis[X] = 0.0f;
+	meshlet->coneAxis[Y] = 0.0f;
+	meshlet->coneAxis[Z] = 1.0f;
+	meshlet->coneCutoff = 1.0f;
+
+	/* Normals that cancel out, like both sides of a thin wall, are
+	 * facing every way at once. */
+	if (dotVec3(axis, axis) <= 0.0f) return;
+
+	axis = normaliseVec3(axis);
+
+	float minDot = 1.0f;
+
+	for (int i = 0; i < meshlet->indexCount; i += 3) {
+		const float* a = vertices[tris[i]].pos;
+		const float* b = vertices[tris[i + 1]].pos;
+		const float* c = vertices[tris[i + 2]].pos;
+
+		const Vec3 ab = {b[X] - a[X], b[Y] - a[Y], b[Z] - a[Z]};
+		const Vec3 ac = {c[X] - a[X], c[Y] - a[Y], c[Z] - a[Z]};
+		const Vec3 cross = crossVec3(ab, ac);
+		const float crossLen = sqrtf(dotVec3(cross, cross));
+
+		/* Degenerate triangles can't be seen from anywhere. */
+		if (crossLen <= 0.0f) continue;
+
+		minDot = fminf(minDot, dotVec3(cross, axis) / crossLen);
+	}
+
+	meshlet->coneAxis[X] = axis.x;
+	meshlet->coneAxis[Y] = axis.y;
+	meshlet->coneAxis[Z] = axis.z;
+
+	if (minDot <= MESHLET_CONE_MIN_DOT) return;
+
+	/* Sine of the widest normal's angle from the axis. Viewed from
+	 * further round than that, every triangle is facing away. */
+	meshlet->coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
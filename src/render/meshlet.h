@@ -0,0 +1,74 @@
+#ifndef RENDER_MESHLET_H
+#define RENDER_MESHLET_H 1
+
+#include <stdint.h>
+#include "scene.h"
+
+/* Small enough that culling one is worth it, big enough that the draw
+ * list doesn't balloon. 64 vertices always fit at least 21 triangles. */
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+/* Normal cones spread wider than this (cos of the angle from the axis) are
+ * facing too many ways to ever be culled. */
+#define MESHLET_CONE_MIN_DOT 0.1f
+
+/* Workgroup size of cull.comp */
+#define MESHLET_CULL_GROUP_SIZE 64
+
+/* A run of a submesh's triangles, culled as one. Laid out to match the
+ * std430 struct in cull.comp. */
+typedef struct
+{
+	/* Bounding sphere in model space */
+	float centre[3];
+	float radius;
+
+	/* Every triangle faces within the cone around the axis. It's culled
+	 * when the viewpoint is far enough behind it, a cutoff of 1 never is. */
+	float coneAxis[3];
+	float coneCutoff;
+
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t padding[2];
+} Meshlet;
+
+/* cull.comp's push constants, one lot per mesh. The meshlets are the
+ * current LOD's. The last three go into every draw, for meshes in the
+ * geometry pool. */
+typedef struct
+{
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	uint32_t coneCull;
+	uint32_t occlusionCull;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t firstInstance;
+} MeshletCullConstants;
+
+int buildMeshlets(
+	Meshlet** meshlets,
+	unsigned int* meshletCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices,
+	const Submesh* submeshes,
+	unsigned int submeshCount
+);
+
+int pushMeshlet(
+	Meshlet** meshlets,
+	unsigned int* meshletCount,
+	unsigned int* meshletLimit,
+	Meshlet meshlet
+);
+
+void computeMeshletBounds(
+	Meshlet* meshlet,
+	const Vertex* vertices,
+	const uint32_t* indices
+);
+
+#endif
@@ -0,0 +1,595 @@
+#include "meshopt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Order matters. The cache pass lays out runs of nearby triangles, the
+ * overdraw pass reorders whole runs, and the fetch pass numbers vertices in
+ * the order the final index buffer reaches them.
+ *
+ * Triangles only ever move around inside their own submesh. Vertices are
+ * shared between all of them. */
+int optimizeMesh(
+	Vertex* vertices,
+	unsigned int* vertexCount,
+	uint32_t* indices,
+	unsigned int indexCount,
+	const Submesh* submeshes,
+	unsigned int submeshCount
+)
+{
+	if (weldVertices(vertices, vertexCount, indices, indexCount)) {
+		return -1;
+	}
+
+	for (int i = 0; i < submeshCount; i++) {
+		uint32_t* subIndices = &indices[submeshes[i].firstIndex];
+
+		if (optimizeVertexCache(
+			subIndices,
+			submeshes[i].indexCount,
+			*vertexCount
+		)) {
+			return -1;
+		}
+
+		if (optimizeOverdraw(
+			vertices,
+			subIndices,
+			submeshes[i].indexCount,
+			*vertexCount
+		)) {
+			return -1;
+		}
+	}
+
+	if (optimizeVertexFetch(vertices, vertexCount, indices, indexCount)) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* FNV-1a over the whole vertex. Only exact duplicates get welded, so the
+ * hash doesn't need to be any smarter. */
+uint32_t hashVertex(const Vertex* vertex)
+{
+	const unsigned char* bytes = (const unsigned char*)vertex;
+	uint32_t hash = 2166136261u;
+
+	for (int i = 0; i < sizeof(Vertex); i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Assimp only joins identical vertices within each of a file's meshes.
+ * Merging them all into one mesh leaves duplicates along the seams. */
+int weldVertices(
+	Vertex* vertices,
+	unsigned int* vertexCount,
+	uint32_t* indices,
+	unsigned int indexCount
+)
+{
+	const unsigned int count = *vertexCount;
+
+	uint32_t tableSize = 1;
+	while (tableSize < count * 2) tableSize *= 2;
+
+	uint32_t* table = (uint32_t*)malloc(sizeof(uint32_t) * tableSize);
+	uint32_t* remap = (uint32_t*)malloc(sizeof(uint32_t) * count);
+
+	if (!table || !remap) {
+		perror("Failed to allocate vertex welding tables");
+		free(table);
+		free(remap);
+		return -1;
+	}
+
+	for (int i = 0; i < tableSize; i++) {
+		table[i] = UINT32_MAX;
+	}
+
+	unsigned int weldedCount = 0;
+
+	for (unsigned int v = 0; v < count; v++) {
+		uint32_t i = hashVertex(&vertices[v]) & (tableSize - 1);
+
+		while (
+			table[i] != UINT32_MAX
+			&& memcmp(&vertices[table[i]], &vertices[v], sizeof(Vertex))
+		) {
+			i = (i + 1) & (tableSize - 1);
+		}
+
+		/* The first of its kind moves down over the gaps duplicates left.
+		 * Nothing past v has been touched yet. */
+		if (table[i] == UINT32_MAX) {
+			vertices[weldedCount] = vertices[v];
+			table[i] = weldedCount;
+			++weldedCount;
+		}
+
+		remap[v] = table[i];
+	}
+
+	for (int i = 0; i < indexCount; i++) {
+		indices[i] = remap[indices[i]];
+	}
+
+	*vertexCount = weldedCount;
+
+	free(table);
+	free(remap);
+
+	return 0;
+}
+
+float vertexCacheScore(int cachePos, unsigned int trisLeft)
+{
+	/* Nothing left to draw with it */
+	if (!trisLeft) return -1.0f;
+
+	float score = 0.0f;
+
+	if (cachePos >= 0) {
+		/* The last triangle's vertices all score the same, otherwise the
+		 * next triangle would always be drawn the same way round. */
+		if (cachePos < 3) {
+			score = MESHOPT_LAST_TRI_SCORE;
+		} else {
+			score = powf(
+				1.0f - (float)(cachePos - 3) / (MESHOPT_CACHE_SIZE - 3),
+				MESHOPT_CACHE_DECAY_POWER
+			);
+		}
+	}
+
+	/* Vertices with few triangles left get finished off before they're
+	 * forgotten about. */
+	score += MESHOPT_VALENCE_BOOST_SCALE
+		* powf((float)trisLeft, -MESHOPT_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+/* Forsyth's algorithm. Triangles are added greedily, always picking the one
+ * whose vertices score best against a simulated LRU cache. Only triangles
+ * using vertices in the cache get rescored, so it runs in linear time. */
+int optimizeVertexCache(
+	uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount
+)
+{
+	const unsigned int triCount = indexCount / 3;
+
+	if (!triCount) return 0;
+
+	/* All the scratch space comes out of one allocation. */
+	const size_t scratchSize =
+		sizeof(unsigned int) * (vertexCount + 1)
+		+ sizeof(unsigned int) * vertexCount
+		+ sizeof(unsigned int) * indexCount
+		+ sizeof(int) * vertexCount
+		+ sizeof(float) * vertexCount
+		+ sizeof(float) * triCount
+		+ sizeof(uint32_t) * indexCount
+		+ triCount;
+
+	char* scratch = (char*)malloc(scratchSize);
+
+	if (!scratch) {
+		perror("Failed to allocate vertex cache optimisation");
+		return -1;
+	}
+
+	/* Each vertex's triangles sit in vertexTris from triStart on. The first
+	 * trisLeft of them haven't been added yet. */
+	unsigned int* triStart = (unsigned int*)scratch;
+	unsigned int* trisLeft = triStart + vertexCount + 1;
+	unsigned int* vertexTris = trisLeft + vertexCount;
+	int* cachePos = (int*)(vertexTris + indexCount);
+	float* vertexScore = (float*)(cachePos + vertexCount);
+	float* triScore = vertexScore + vertexCount;
+	uint32_t* output = (uint32_t*)(triScore + triCount);
+	char* triAdded = (char*)(output + indexCount);
+
+	memset(trisLeft, 0, sizeof(unsigned int) * vertexCount);
+
+	for (int i = 0; i < indexCount; i++) {
+		++trisLeft[indices[i]];
+	}
+
+	triStart[0] = 0;
+	for (int v = 0; v < vertexCount; v++) {
+		triStart[v + 1] = triStart[v] + trisLeft[v];
+	}
+
+	/* trisLeft gets counted back up while the lists are filled in. */
+	memset(trisLeft, 0, sizeof(unsigned int) * vertexCount);
+
+	for (unsigned int t = 0; t < triCount; t++) {
+		for (int k = 0; k < 3; k++) {
+			const uint32_t v = indices[t * 3 + k];
+			vertexTris[triStart[v] + trisLeft[v]] = t;
+			++trisLeft[v];
+		}
+	}
+
+	for (int v = 0; v < vertexCount; v++) {
+		cachePos[v] = -1;
+		vertexScore[v] = vertexCacheScore(-1, trisLeft[v]);
+	}
+
+	int bestTri = -1;
+	float bestScore = -1.0f;
+
+	for (unsigned int t = 0; t < triCount; t++) {
+		triAdded[t] = 0;
+		triScore[t] =
+			vertexScore[indices[t * 3]]
+			+ vertexScore[indices[t * 3 + 1]]
+			+ vertexScore[indices[t * 3 + 2]];
+
+		if (triScore[t] > bestScore) {
+			bestScore = triScore[t];
+			bestTri = t;
+		}
+	}
+
+	/* The three past the end are vertices that just fell out. Their scores
+	 * still need to drop. */
+	uint32_t cache[MESHOPT_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+
+	unsigned int scanCursor = 0;
+
+	for (unsigned int outTri = 0; outTri < triCount; outTri++) {
+		/* Nothing in the cache has anything left. Carry on from wherever
+		 * the original order is up to. */
+		if (bestTri == -1) {
+			while (triAdded[scanCursor]) ++scanCursor;
+			bestTri = scanCursor;
+		}
+
+		const uint32_t* tri = &indices[bestTri * 3];
+		triAdded[bestTri] = 1;
+
+		uint32_t newCache[MESHOPT_CACHE_SIZE + 3];
+		unsigned int newCount = 0;
+
+		for (int k = 0; k < 3; k++) {
+			const uint32_t v = tri[k];
+			unsigned int* tris = &vertexTris[triStart[v]];
+
+			output[outTri * 3 + k] = v;
+
+			/* The triangle comes off the vertex's list of what's left */
+			for (int l = 0; l < trisLeft[v]; l++) {
+				if (tris[l] == bestTri) {
+					tris[l] = tris[trisLeft[v] - 1];
+					--trisLeft[v];
+					break;
+				}
+			}
+
+			char inCache = 0;
+			for (int c = 0; c < newCount; c++) {
+				if (newCache[c] == v) inCache = 1;
+			}
+
+			if (!inCache) {
+				newCache[newCount] = v;
+				++newCount;
+			}
+		}
+
+		/* Everything else shuffles back behind the new triangle. */
+		const unsigned int triVertexCount = newCount;
+
+		for (int c = 0; c < cacheCount; c++) {
+			if (newCount >= MESHOPT_CACHE_SIZE + 3) break;
+
+			char inTri = 0;
+			for (int k = 0; k < triVertexCount; k++) {
+				if (newCache[k] == cache[c]) inTri = 1;
+			}
+
+			if (!inTri) {
+				newCache[newCount] = cache[c];
+				++newCount;
+			}
+		}
+
+		for (int c = 0; c < newCount; c++) {
+			const uint32_t v = newCache[c];
+
+			cachePos[v] = c < MESHOPT_CACHE_SIZE ? c : -1;
+			vertexScore[v] = vertexCacheScore(cachePos[v], trisLeft[v]);
+		}
+
+		memcpy(cache, newCache, sizeof(uint32_t) * newCount);
+		cacheCount = newCount;
+
+		/* Only triangles touching the cache changed score. */
+		bestTri = -1;
+		bestScore = -1.0f;
+
+		for (int c = 0; c < cacheCount; c++) {
+			const uint32_t v = cache[c];
+			const unsigned int* tris = &vertexTris[triStart[v]];
+
+			for (int l = 0; l < trisLeft[v]; l++) {
+				const unsigned int t = tris[l];
+
+				triScore[t] =
+					vertexScore[indices[t * 3]]
+					+ vertexScore[indices[t * 3 + 1]]
+					+ vertexScore[indices[t * 3 + 2]];
+
+				if (triScore[t] > bestScore) {
+					bestScore = triScore[t];
+					bestTri = t;
+				}
+			}
+		}
+	}
+
+	memcpy(indices, output, sizeof(uint32_t) * indexCount);
+
+	free(scratch);
+
+	return 0;
+}
+
+/* Clusters facing away from the middle of the mesh go first. */
+int compareClusters(const void* a, const void* b)
+{
+	const float occlusionA = ((const MeshCluster*)a)->occlusion;
+	const float occlusionB = ((const MeshCluster*)b)->occlusion;
+
+	return (occlusionA < occlusionB) - (occlusionA > occlusionB);
+}
+
+/* Along the lines of Sander, Nehab and Barczak's "Fast Triangle Reordering
+ * for Vertex Locality and Reduced Overdraw". The cache optimised order gets
+ * cut wherever the cache starts over anyway, so moving the pieces around
+ * costs next to nothing in cache misses. The pieces on the outside of the
+ * mesh, facing out, are the ones most likely to hide the rest, so they get
+ * drawn first and the depth test throws more of the rest away. */
+int optimizeOverdraw(
+	const Vertex* vertices,
+	uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount
+)
+{
+	const unsigned int triCount = indexCount / 3;
+
+	if (triCount < 2) return 0;
+
+	unsigned int* enteredAt =
+		(unsigned int*)calloc(vertexCount, sizeof(unsigned int));
+	MeshCluster* clusters =
+		(MeshCluster*)malloc(sizeof(MeshCluster) * triCount);
+	uint32_t* output = (uint32_t*)malloc(sizeof(uint32_t) * indexCount);
+
+	if (!enteredAt || !clusters || !output) {
+		perror("Failed to allocate overdraw optimisation");
+		free(enteredAt);
+		free(clusters);
+		free(output);
+		return -1;
+	}
+
+	/* A triangle that misses the cache on every vertex starts a new
+	 * cluster. enteredAt holds the miss count just after a vertex went in,
+	 * so zero means never, and it's gone once another MESHOPT_FIFO_SIZE
+	 * vertices have gone in behind it. */
+	unsigned int clusterCount = 0;
+	unsigned int misses = 0;
+
+	for (unsigned int t = 0; t < triCount; t++) {
+		unsigned int triMisses = 0;
+
+		for (int k = 0; k < 3; k++) {
+			const uint32_t v = indices[t * 3 + k];
+
+			if (
+				!enteredAt[v]
+				|| misses - enteredAt[v] >= MESHOPT_FIFO_SIZE
+			) {
+				enteredAt[v] = ++misses;
+				++triMisses;
+			}
+		}
+
+		if (!clusterCount || triMisses == 3) {
+			clusters[clusterCount].start = t;
+			clusters[clusterCount].triCount = 0;
+			++clusterCount;
+		}
+
+		++clusters[clusterCount - 1].triCount;
+	}
+
+	/* The middle of the triangles being sorted, which for a submesh isn't
+	 * the middle of the whole vertex buffer */
+	Vec3 meshCentre = {};
+	float meshArea = 0.0f;
+
+	for (int c = 0; c < clusterCount; c++) {
+		MeshCluster* cluster = &clusters[c];
+
+		cluster->centre = (Vec3){};
+		cluster->normal = (Vec3){};
+		cluster->area = 0.0f;
+
+		/* Area weighted, so slivers don't count for much */
+		for (int t = 0; t < cluster->triCount; t++) {
+			const uint32_t* tri = &indices[(cluster->start + t) * 3];
+			const float* a = vertices[tri[0]].pos;
+			const float* b = vertices[tri[1]].pos;
+			const float* d = vertices[tri[2]].pos;
+
+			const Vec3 ab = {b[X] - a[X], b[Y] - a[Y], b[Z] - a[Z]};
+			const Vec3 ad = {d[X] - a[X], d[Y] - a[Y], d[Z] - a[Z]};
+			const Vec3 cross = crossVec3(ab, ad);
+			const float triArea = sqrtf(dotVec3(cross, cross));
+
+			cluster->centre.x += (a[X] + b[X] + d[X]) / 3.0f * triArea;
+			cluster->centre.y += (a[Y] + b[Y] + d[Y]) / 3.0f * triArea;
+			cluster->centre.z += (a[Z] + b[Z] + d[Z]) / 3.0f * triArea;
+
+			cluster->normal.x += cross.x;
+			cluster->normal.y += cross.y;
+			cluster->normal.z += cross.z;
+
+			cluster->area += triArea;
+		}
+
+		meshCentre.x += cluster->centre.x;
+		meshCentre.y += cluster->centre.y;
+		meshCentre.z += cluster->centre.z;
+		meshArea += cluster->area;
+	}
+
+	if (meshArea > 0.0f) {
+		meshCentre.x /= meshArea;
+		meshCentre.y /= meshArea;
+		meshCentre.z /= meshArea;
+	}
+
+	for (int c = 0; c < clusterCount; c++) {
+		MeshCluster* cluster = &clusters[c];
+		const float normalLength =
+			sqrtf(dotVec3(cluster->normal, cluster->normal));
+
+		if (cluster->area == 0.0f || normalLength == 0.0f) {
+			cluster->occlusion = 0.0f;
+			continue;
+		}
+
+		const Vec3 offset = {
+			cluster->centre.x / cluster->area - meshCentre.x,
+			cluster->centre.y / cluster->area - meshCentre.y,
+			cluster->centre.z / cluster->area - meshCentre.z
+		};
+
+		cluster->occlusion = dotVec3(offset, cluster->normal) / normalLength;
+	}
+
+	qsort(clusters, clusterCount, sizeof(MeshCluster), compareClusters);
+
+	uint32_t* outputPtr = output;
+
+	for (int c = 0; c < clusterCount; c++) {
+		memcpy(
+			outputPtr,
+			&indices[clusters[c].start * 3],
+			sizeof(uint32_t) * clusters[c].triCount * 3
+		);
+		outputPtr += clusters[c].triCount * 3;
+	}
+
+	memcpy(indices, output, sizeof(uint32_t) * triCount * 3);
+
+	free(enteredAt);
+	free(clusters);
+	free(output);
+
+	return 0;
+}
+
+/* Vertices get renumbered in the order the index buffer first uses them, so
+ * fetching them walks through memory in order. Vertices nothing uses are
+ * dropped. */
+int optimizeVertexFetch(
+	Vertex* vertices,
+	unsigned int* vertexCount,
+	uint32_t* indices,
+	unsigned int indexCount
+)
+{
+	const unsigned int count = *vertexCount;
+
+	uint32_t* remap = (uint32_t*)malloc(sizeof(uint32_t) * count);
+	Vertex* reordered = (Vertex*)malloc(sizeof(Vertex) * count);
+
+	if (!remap || !reordered) {
+		perror("Failed to allocate vertex fetch optimisation");
+		free(remap);
+		free(reordered);
+		return -1;
+	}
+
+	for (int v = 0; v < count; v++) {
+		remap[v] = UINT32_MAX;
+	}
+
+	unsigned int nextVertex = 0;
+
+	for (int i = 0; i < indexCount; i++) {
+		const uint32_t v = indices[i];
+
+		if (remap[v] == UINT32_MAX) {
+			remap[v] = nextVertex;
+			reordered[nextVertex] = vertices[v];
+			++nextVertex;
+		}
+
+		indices[i] = remap[v];
+	}
+
+	memcpy(vertices, reordered, sizeof(Vertex) * nextVertex);
+	*vertexCount = nextVertex;
+
+	free(remap);
+	free(reordered);
+
+	return 0;
+}
+
+/* Average cache miss ratio, the number of vertices transformed per triangle
+ * with a FIFO cache. 0.5 is about as good as it gets for a regular grid and
+ * 3 is as bad as it gets. */
+float vertexCacheAcmr(
+	const uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount
+)
+{
+	const unsigned int triCount = indexCount / 3;
+
+	if (!triCount) return 0.0f;
+
+	unsigned int* enteredAt =
+		(unsigned int*)calloc(vertexCount, sizeof(unsigned int));
+
+	if (!enteredAt) {
+		perror("Failed to allocate ACMR measurement");
+		return -1.0f;
+	}
+
+	unsigned int misses = 0;
+
+	for (int i = 0; i < triCount * 3; i++) {
+		const uint32_t v = indices[i];
+
+		if (
+			!enteredAt[v]
+			|| misses - enteredAt[v] >= MESHOPT_FIFO_SIZE
+		) {
+			enteredAt[v] = ++misses;
+		}
+	}
+
+	free(enteredAt);
+
+	return (float)misses / triCount;
+}
@@ -0,0 +1,78 @@
+#ifndef RENDER_MESHOPT_H
+#define RENDER_MESHOPT_H 1
+
+#include <stdint.h>
+#include "scene.h"
+
+/* The vertex cache the reordering aims for. Real post-transform caches
+ * aren't LRU or this big, but the ordering holds up on all of them. */
+#define MESHOPT_CACHE_SIZE 32
+
+/* The FIFO cache used for measuring ACMR, roughly what older hardware has */
+#define MESHOPT_FIFO_SIZE 16
+
+/* Scoring from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" */
+#define MESHOPT_CACHE_DECAY_POWER 1.5f
+#define MESHOPT_LAST_TRI_SCORE 0.75f
+#define MESHOPT_VALENCE_BOOST_SCALE 2.0f
+#define MESHOPT_VALENCE_BOOST_POWER 0.5f
+
+/* A run of triangles drawn together by the overdraw pass */
+typedef struct
+{
+	unsigned int start;
+	unsigned int triCount;
+
+	/* Area weighted sums */
+	Vec3 centre;
+	Vec3 normal;
+	float area;
+
+	float occlusion;
+} MeshCluster;
+
+/* Runs every pass below in order. The vertex count can go down. */
+int optimizeMesh(
+	Vertex* vertices,
+	unsigned int* vertexCount,
+	uint32_t* indices,
+	unsigned int indexCount,
+	const Submesh* submeshes,
+	unsigned int submeshCount
+);
+
+uint32_t hashVertex(const Vertex* vertex);
+int weldVertices(
+	Vertex* vertices,
+	unsigned int* vertexCount,
+	uint32_t* indices,
+	unsigned int indexCount
+);
+int optimizeVertexCache(
+	uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount
+);
+int optimizeOverdraw(
+	const Vertex* vertices,
+	uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount
+);
+int optimizeVertexFetch(
+	Vertex* vertices,
+	unsigned int* vertexCount,
+	uint32_t* indices,
+	unsigned int indexCount
+);
+
+float vertexCacheAcmr(
+	const uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount
+);
+
+float vertexCacheScore(int cachePos, unsigned int trisLeft);
+int compareClusters(const void* a, const void* b);
+
+#endif
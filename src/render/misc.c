@@ -132,46 +132,6 @@ int generateMipmaps(
 	return 0;
 }
 
-int createSampler(
-	VkDevice device,
-	VkPhysicalDevice physDev,
-	VkSampler* sampler,
-	float mipLevels
-)
-{
-	VkPhysicalDeviceFeatures supportedFeatures;
-	vkGetPhysicalDeviceFeatures(physDev, &supportedFeatures);
-
-	VkPhysicalDeviceProperties properties = {};
-	vkGetPhysicalDeviceProperties(physDev, &properties);
-
-	VkSamplerCreateInfo samplerInfo = {};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.anisotropyEnable =
-		supportedFeatures.samplerAnisotropy ? VK_TRUE : VK_FALSE;
-	samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE;
-	samplerInfo.compareEnable = VK_FALSE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.mipLodBias = 0.0f;
-	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = mipLevels;
-
-	if (vkCreateSampler(device, &samplerInfo, 0, sampler) != VK_SUCCESS) {
-		printf("Failed to create sampler.\n");
-		return -1;
-	}
-
-	return 0;
-}
-
 int copyBufferToImage(
 	VkCommandBuffer cmdBuf,
 	VkQueue queue,
@@ -264,6 +224,17 @@ int transitionImageLayout(
 
 		srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	} else if (
+		oldLayout == VK_IMAGE_LAYOUT_UNDEFINED
+		&& newLayout == VK_IMAGE_LAYOUT_GENERAL
+	) {
+		/* Storage images written and read by compute shaders */
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask =
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 	} else {
 		printf("Unsupported layout transition.\n");
 		return -1;
@@ -369,7 +340,7 @@ int createIndexBuffer(
 	memcpy(mappedData, data, bufferSize);
 	vkUnmapMemory(device, stagingBufferMemory);
 
-	createBuffer(
+	int result = createBuffer(
 		device,
 		physDev,
 		bufferSize,
@@ -379,12 +350,14 @@ int createIndexBuffer(
 		mem
 	);
 
-	copyBuffer(command, queue, stagingBuffer, *buffer, bufferSize);
+	if (!result) {
+		copyBuffer(command, queue, stagingBuffer, *buffer, bufferSize);
+	}
 
 	vkDestroyBuffer(device, stagingBuffer, 0);
 	vkFreeMemory(device, stagingBufferMemory, 0);
 
-	return 0;
+	return result;
 }
 
 int createCommandBuffers(
@@ -463,7 +436,7 @@ int createVertexBuffer(
 	memcpy(mappedData, data, bufferSize);
 	vkUnmapMemory(device, stagingBufferMemory);
 
-	createBuffer(
+	int result = createBuffer(
 		device,
 		physDev,
 		bufferSize,
@@ -473,12 +446,70 @@ int createVertexBuffer(
 		mem
 	);
 
-	copyBuffer(command, queue, stagingBuffer, *buffer, bufferSize);
+	if (!result) {
+		copyBuffer(command, queue, stagingBuffer, *buffer, bufferSize);
+	}
 
 	vkDestroyBuffer(device, stagingBuffer, 0);
 	vkFreeMemory(device, stagingBufferMemory, 0);
 
-	return 0;
+	return result;
+}
+
+/* Any other device local buffer that starts out with data in it */
+int createDeviceLocalBuffer(
+	VkCommandBuffer command,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* data,
+	VkDeviceSize bufferSize,
+	VkBufferUsageFlags usage,
+	VkBuffer* buffer,
+	VkDeviceMemory* mem
+)
+{
+	VkBuffer stagingBuffer = 0;
+	VkDeviceMemory stagingBufferMemory = 0;
+
+	if (createBuffer(
+		device,
+		physDev,
+		bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+		| VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		&stagingBuffer,
+		&stagingBufferMemory
+	)) {
+		printf("Failed to create staging buffer\n");
+		return -1;
+	}
+
+	void* mappedData;
+	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &mappedData);
+
+	memcpy(mappedData, data, bufferSize);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	int result = createBuffer(
+		device,
+		physDev,
+		bufferSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		buffer,
+		mem
+	);
+
+	if (!result) {
+		copyBuffer(command, queue, stagingBuffer, *buffer, bufferSize);
+	}
+
+	vkDestroyBuffer(device, stagingBuffer, 0);
+	vkFreeMemory(device, stagingBufferMemory, 0);
+
+	return result;
 }
 
 int createBuffer(
@@ -516,6 +547,9 @@ int createBuffer(
 
 	if (vkAllocateMemory(device, &allocInfo, 0, bufferMemory) != VK_SUCCESS) {
 		printf("Failed to allocate buffer memory\n");
+		vkDestroyBuffer(device, *buffer, 0);
+		*buffer = VK_NULL_HANDLE;
+		*bufferMemory = VK_NULL_HANDLE;
 		return -1;
 	}
 
@@ -672,8 +706,10 @@ int createImage(
 
 	if (vkAllocateMemory(device, &allocInfo, 0, imageMemory) != VK_SUCCESS) {
 		printf("Failed to allocate image memory\n");
+		vkDestroyImage(device, *image, 0);
+		*image = VK_NULL_HANDLE;
+		*imageMemory = VK_NULL_HANDLE;
 		return -1;
-
 	}
 
 	vkBindImageMemory(device, *image, *imageMemory, 0);
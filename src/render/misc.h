@@ -17,13 +17,6 @@ int generateMipmaps(
 	uint32_t mipLevels
 );
 
-int createSampler(
-	VkDevice device,
-	VkPhysicalDevice physDev,
-	VkSampler* sampler,
-	float mipLevels
-);
-
 int copyBufferToImage(
 	VkCommandBuffer cmdBuf,
 	VkQueue queue,
@@ -92,6 +85,18 @@ int createVertexBuffer(
 	VkDeviceMemory* mem
 );
 
+int createDeviceLocalBuffer(
+	VkCommandBuffer command,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* data,
+	VkDeviceSize bufferSize,
+	VkBufferUsageFlags usage,
+	VkBuffer* buffer,
+	VkDeviceMemory* mem
+);
+
 int createBuffer(
 	VkDevice device,
 	VkPhysicalDevice physDev,
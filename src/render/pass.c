@@ -118,12 +118,41 @@ int createFramebufferAttachment(
 	VkFormat fmt,
 	VkDevice device,
 	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
 	VkExtent2D extent,
 	VkImageAspectFlagBits aspect,
 	VkImageUsageFlagBits usage
 )
 {
+	return createAliasedAttachments(
+		buf,
+		1,
+		fmt,
+		device,
+		physDev,
+		samplers,
+		extent,
+		aspect,
+		usage
+	);
+}
 
+/* Makes count attachments that all live in the same memory, for ones that
+ * are never in use at the same time. The first one owns the memory. Transient
+ * attachments go in lazily allocated memory when the device has any, which
+ * tilers might never have to back at all. */
+int createAliasedAttachments(
+	FramebufferAttachment* bufs,
+	unsigned int count,
+	VkFormat fmt,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
+	VkExtent2D extent,
+	VkImageAspectFlagBits aspect,
+	VkImageUsageFlagBits usage
+)
+{
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -139,42 +168,115 @@ int createFramebufferAttachment(
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 
-	if (vkCreateImage(device, &imageInfo, 0, &buf->image) != VK_SUCCESS) {
-		printf("Failed to create image\n");
-		return -1;
+	/* The images are all made the same way, so they'd want the same
+	 * memory anyway. */
+	VkMemoryRequirements memRequirements = {};
+	memRequirements.memoryTypeBits = ~0u;
+
+	for (int i = 0; i < count; i++) {
+		bufs[i] = (FramebufferAttachment){};
+
+		if (vkCreateImage(
+			device,
+			&imageInfo,
+			0,
+			&bufs[i].image
+		) != VK_SUCCESS) {
+			printf("Failed to create image\n");
+			return -1;
+		}
+
+		VkMemoryRequirements imageRequirements;
+		vkGetImageMemoryRequirements(
+			device,
+			bufs[i].image,
+			&imageRequirements
+		);
+
+		if (imageRequirements.size > memRequirements.size) {
+			memRequirements.size = imageRequirements.size;
+		}
+
+		memRequirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+	}
+
+	int memType = -1;
+
+	if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+		memType = findLazyMemoryType(physDev, memRequirements.memoryTypeBits);
+	}
+
+	bufs[0].lazy = memType >= 0;
+
+	if (memType < 0) {
+		memType = findMemoryType(
+			physDev,
+			memRequirements.memoryTypeBits,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
 	}
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(device, buf->image, &memRequirements);
 
 	VkMemoryAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(
-		physDev,
-		memRequirements.memoryTypeBits,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-	);
+	allocInfo.memoryTypeIndex = memType;
 
-	if (vkAllocateMemory(device, &allocInfo, 0, &buf->mem) != VK_SUCCESS) {
+	if (vkAllocateMemory(device, &allocInfo, 0, &bufs[0].mem) != VK_SUCCESS) {
 		printf("Failed to allocate image memory\n");
 		return -1;
-
 	}
 
-	vkBindImageMemory(device, buf->image, buf->mem, 0);
+	bufs[0].memSize = memRequirements.size;
 
-	if (createImageView(device, buf->image, fmt, aspect, 1, &buf->view)) {
-		printf("Failed to create image view\n");
-		return -1;
-	}
+	for (int i = 0; i < count; i++) {
+		bufs[i].lazy = bufs[0].lazy;
 
-	if (createSampler(device, physDev, &buf->sampler, 1)) {
-		return -1;
+		vkBindImageMemory(device, bufs[i].image, bufs[0].mem, 0);
+
+		if (createImageView(
+			device,
+			bufs[i].image,
+			fmt,
+			aspect,
+			1,
+			&bufs[i].view
+		)) {
+			printf("Failed to create image view\n");
+			return -1;
+		}
+
+		if (getSampler(samplers, device, defSamplerKey, &bufs[i].sampler)) {
+			return -1;
+		}
 	}
 
 	return 0;
 }
 
+/* Like findMemoryType(), except not finding any is fine. Most desktop GPUs
+ * don't have lazily allocated memory. */
+int findLazyMemoryType(VkPhysicalDevice physDev, uint32_t typeFilter)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physDev, &memProperties);
+
+	const VkMemoryPropertyFlags properties =
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		| VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if (
+			(typeFilter & (1 << i))
+			&& (memProperties.memoryTypes[i].propertyFlags & properties)
+			== properties
+		) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
 const VkRenderPassCreateInfo defRenderPassCreateInfo = {
 	.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO
 };
@@ -238,6 +340,5 @@ void destroyFramebufferAttachment(VkDevice device, FramebufferAttachment att)
 	vkDestroyImage(device, att.image, 0);
 	vkFreeMemory(device, att.mem, 0);
 	vkDestroyImageView(device, att.view, 0);
-	vkDestroySampler(device, att.sampler, 0);
 }
 
@@ -4,6 +4,7 @@
 
 #include <vulkan/vulkan.h>
 #include "sync.h"
+#include "sampler.h"
 
 typedef struct
 {
@@ -12,6 +13,11 @@ typedef struct
 	VkImageView view;
 	VkSampler sampler;
 	VkFramebuffer fb;
+
+	/* How much was allocated for it. Attachments sharing another's memory
+	 * have none of their own. */
+	VkDeviceSize memSize;
+	char lazy;
 } FramebufferAttachment;
 
 typedef struct 
@@ -69,10 +75,23 @@ int createFramebufferAttachment(
 	VkFormat fmt,
 	VkDevice device,
 	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
+	VkExtent2D extent,
+	VkImageAspectFlagBits aspect,
+	VkImageUsageFlagBits usage
+);
+int createAliasedAttachments(
+	FramebufferAttachment* bufs,
+	unsigned int count,
+	VkFormat fmt,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
 	VkExtent2D extent,
 	VkImageAspectFlagBits aspect,
 	VkImageUsageFlagBits usage
 );
+int findLazyMemoryType(VkPhysicalDevice physDev, uint32_t typeFilter);
 
 extern const VkRenderPassCreateInfo defRenderPassCreateInfo;
 extern const VkCommandBufferAllocateInfo defCommandBufferAllocateInfo;
@@ -87,6 +87,69 @@ int deviceHasExtensions(
 	return 1;
 }
 
+/* Bindless textures need Vulkan 1.2 descriptor indexing. A texture array
+ * that can be written while frames are in flight and doesn't need every slot
+ * filled is the bare minimum. */
+int deviceSupportsBindless(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	if (properties.apiVersion < VK_API_VERSION_1_2) {
+		return 0;
+	}
+
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features12;
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return features.features.shaderSampledImageArrayDynamicIndexing
+		&& features12.runtimeDescriptorArray
+		&& features12.descriptorBindingPartiallyBound
+		&& features12.descriptorBindingSampledImageUpdateAfterBind
+		&& features12.descriptorBindingUpdateUnusedWhilePending;
+}
+
+/* Culled meshlets are packed into a draw list on the device, so the number
+ * of draws in it has to come from the device as well. Compute shaders and
+ * storage buffers are a given. */
+int deviceSupportsMeshletCull(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	if (properties.apiVersion < VK_API_VERSION_1_2) {
+		return 0;
+	}
+
+	VkPhysicalDeviceVulkan12Features features12 = {};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features12;
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return features.features.multiDrawIndirect
+		&& features12.drawIndirectCount;
+}
+
+/* Every draw in an indirect draw finds its object through its first
+ * instance, so that has to be allowed to be something other than 0. */
+int deviceSupportsMultiDraw(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceFeatures features = {};
+	vkGetPhysicalDeviceFeatures(device, &features);
+
+	return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+}
+
 VkFormat findDepthFormat(VkPhysicalDevice physicalDevice)
 {   
 	VkFormat fmtCandidates[] = {
@@ -25,6 +25,10 @@ int deviceHasExtensions(
 	unsigned int deviceExtensionCount
 );
 
+int deviceSupportsBindless(VkPhysicalDevice device);
+int deviceSupportsMeshletCull(VkPhysicalDevice device);
+int deviceSupportsMultiDraw(VkPhysicalDevice device);
+
 VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
 
 VkFormat findSupportedFormat(
@@ -0,0 +1,175 @@
+#include "recorder.h"
+#include "swapchain.h"
+#include "drawrecord.h"
+#include <stdio.h>
+
+int createSceneRecorder(
+	SceneRecorder* recorder,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkSurfaceKHR surface,
+	unsigned int workerCount
+)
+{
+	*recorder = (SceneRecorder){};
+
+	if (workerCount < 1) workerCount = 1;
+	if (workerCount > RECORDER_MAX_WORKERS) {
+		workerCount = RECORDER_MAX_WORKERS;
+	}
+
+	recorder->workerCount = workerCount;
+
+	for (int i = 0; i < workerCount; i++) {
+		recorder->workers[i].recorder = recorder;
+		recorder->workers[i].index = i;
+
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++) {
+			if (createCommandPool(
+				device,
+				physDev,
+				surface,
+				&recorder->workers[i].pools[j]
+			)) {
+				return -1;
+			}
+		}
+	}
+
+	if (workerCount == 1) return 0;
+
+	if (pthread_barrier_init(&recorder->barrier, 0, workerCount)) {
+		printf("Failed to create recorder barrier\n");
+		return -1;
+	}
+
+	/* The first worker is whoever calls runRecorder(). */
+	for (int i = 1; i < workerCount; i++) {
+		if (pthread_create(
+			&recorder->workers[i].thread,
+			0,
+			recordWorkerMain,
+			&recorder->workers[i]
+		)) {
+			printf("Failed to start recording thread\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Only once the device is done with every command buffer from the pools */
+void destroySceneRecorder(VkDevice device, SceneRecorder* recorder)
+{
+	if (recorder->workerCount > 1) {
+		recorder->quit = 1;
+		pthread_barrier_wait(&recorder->barrier);
+
+		for (int i = 1; i < recorder->workerCount; i++) {
+			pthread_join(recorder->workers[i].thread, 0);
+		}
+
+		pthread_barrier_destroy(&recorder->barrier);
+	}
+
+	for (int i = 0; i < recorder->workerCount; i++) {
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++) {
+			vkDestroyCommandPool(device, recorder->workers[i].pools[j], 0);
+		}
+	}
+}
+
+/* Every worker runs record with its own index and returns once they're all
+ * done. */
+int runRecorder(
+	SceneRecorder* recorder,
+	RecordFunc record,
+	void* job,
+	unsigned int frame
+)
+{
+	recorder->record = record;
+	recorder->job = job;
+	recorder->frame = frame;
+
+	if (recorder->workerCount > 1) {
+		pthread_barrier_wait(&recorder->barrier);
+	}
+
+	recordWorkerRun(&recorder->workers[0]);
+
+	if (recorder->workerCount > 1) {
+		pthread_barrier_wait(&recorder->barrier);
+	}
+
+	for (int i = 0; i < recorder->workerCount; i++) {
+		if (recorder->workers[i].result) return -1;
+	}
+
+	return 0;
+}
+
+void recordWorkerRun(RecordWorker* worker)
+{
+	const SceneRecorder* recorder = worker->recorder;
+	const uint64_t start = recordClockNanos();
+
+	worker->result = recorder->record(
+		recorder->job,
+		worker->index,
+		worker->pools[recorder->frame]
+	);
+
+	worker->lastNanos = recordClockNanos() - start;
+	worker->totalNanos += worker->lastNanos;
+	++worker->jobCount;
+}
+
+/* The barrier's waits come in pairs, one to start a job and one to finish
+ * it. Quitting only ever happens at the start of one. */
+void* recordWorkerMain(void* arg)
+{
+	RecordWorker* worker = (RecordWorker*)arg;
+	SceneRecorder* recorder = worker->recorder;
+
+	for (;;) {
+		pthread_barrier_wait(&recorder->barrier);
+
+		if (recorder->quit) break;
+
+		recordWorkerRun(worker);
+
+		pthread_barrier_wait(&recorder->barrier);
+	}
+
+	return 0;
+}
+
+unsigned int recorderAssignWorker(SceneRecorder* recorder)
+{
+	const unsigned int worker = recorder->nextWorker;
+
+	recorder->nextWorker = (recorder->nextWorker + 1) % recorder->workerCount;
+
+	return worker;
+}
+
+void printRecorderStats(const SceneRecorder* recorder)
+{
+	printf("Recording threads: %u\n", recorder->workerCount);
+
+	for (int i = 0; i < recorder->workerCount; i++) {
+		const RecordWorker* worker = &recorder->workers[i];
+
+		printf(
+			"\tthread %i: last %.3f ms, average %.3f ms over %llu frames\n",
+			i,
+			worker->lastNanos / 1e6,
+			worker->jobCount
+			? worker->totalNanos / 1e6 / worker->jobCount
+			: 0.0,
+			(unsigned long long)worker->jobCount
+		);
+	}
+}
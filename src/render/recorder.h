@@ -0,0 +1,78 @@
+#ifndef RENDER_RECORDER_H
+#define RENDER_RECORDER_H 1
+
+/* Worker threads for recording secondary command buffers. The main thread
+ * counts as the first worker, so a recorder with one worker runs everything
+ * where it's called and starts no threads at all. */
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vulkan/vulkan.h>
+#include "misc.h"
+
+#define RECORDER_MAX_WORKERS 16
+
+/* Records worker's share of job with its pools for frame */
+typedef int (*RecordFunc)(void* job, unsigned int worker, VkCommandPool pool);
+
+struct SceneRecorder;
+
+typedef struct
+{
+	struct SceneRecorder* recorder;
+	unsigned int index;
+	pthread_t thread;
+
+	/* Command pools are externally synchronised, so every worker gets its
+	 * own. Nothing else touches them while a job is running. */
+	VkCommandPool pools[MAX_FRAMES_IN_FLIGHT];
+
+	int result;
+
+	/* Time spent recording, for printRecorderStats() */
+	uint64_t lastNanos;
+	uint64_t totalNanos;
+	uint64_t jobCount;
+} RecordWorker;
+
+typedef struct SceneRecorder
+{
+	RecordWorker workers[RECORDER_MAX_WORKERS];
+	unsigned int workerCount;
+
+	/* Workers wait here for a job to start, and again for every other
+	 * worker to finish it. */
+	pthread_barrier_t barrier;
+	char quit;
+
+	/* The job being run */
+	RecordFunc record;
+	void* job;
+	unsigned int frame;
+
+	/* Scenes are handed to workers in turn. */
+	unsigned int nextWorker;
+} SceneRecorder;
+
+int createSceneRecorder(
+	SceneRecorder* recorder,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkSurfaceKHR surface,
+	unsigned int workerCount
+);
+void destroySceneRecorder(VkDevice device, SceneRecorder* recorder);
+
+int runRecorder(
+	SceneRecorder* recorder,
+	RecordFunc record,
+	void* job,
+	unsigned int frame
+);
+void recordWorkerRun(RecordWorker* worker);
+void* recordWorkerMain(void* arg);
+
+unsigned int recorderAssignWorker(SceneRecorder* recorder);
+void printRecorderStats(const SceneRecorder* recorder);
+
+#endif
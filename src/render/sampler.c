@@ -0,0 +1,134 @@
+#include "sampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Past the last mip level, the image view clamps the LOD anyway. One sampler
+ * works for textures of every size. */
+const SamplerKey defSamplerKey = {
+	.filter = VK_FILTER_LINEAR,
+	.addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+	.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+	.minLod = 0.0f,
+	.maxLod = VK_LOD_CLAMP_NONE
+};
+
+int createSamplerCache(SamplerCache* cache, VkPhysicalDevice physDev)
+{
+	cache->samplerCount = 0;
+	cache->samplerLimit = 1;
+	cache->keys = (SamplerKey*)malloc(sizeof(SamplerKey));
+	cache->samplers = (VkSampler*)malloc(sizeof(VkSampler));
+
+	if (!cache->keys || !cache->samplers) {
+		perror("Failed to allocate sampler cache");
+		return -1;
+	}
+
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physDev, &supportedFeatures);
+
+	VkPhysicalDeviceProperties properties = {};
+	vkGetPhysicalDeviceProperties(physDev, &properties);
+
+	cache->anisotropy =
+		supportedFeatures.samplerAnisotropy ? VK_TRUE : VK_FALSE;
+	cache->maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+
+	return 0;
+}
+
+void destroySamplerCache(VkDevice device, SamplerCache cache)
+{
+	for (int i = 0; i < cache.samplerCount; i++) {
+		vkDestroySampler(device, cache.samplers[i], 0);
+	}
+
+	free(cache.keys);
+	free(cache.samplers);
+}
+
+int getSampler(
+	SamplerCache* cache,
+	VkDevice device,
+	SamplerKey key,
+	VkSampler* sampler
+)
+{
+	/* There are only ever a handful of these. A linear search is fine. */
+	for (int i = 0; i < cache->samplerCount; i++) {
+		const SamplerKey cached = cache->keys[i];
+
+		if (
+			cached.filter == key.filter
+			&& cached.addressMode == key.addressMode
+			&& cached.mipmapMode == key.mipmapMode
+			&& cached.minLod == key.minLod
+			&& cached.maxLod == key.maxLod
+		) {
+			*sampler = cache->samplers[i];
+			return 0;
+		}
+	}
+
+	if (cache->samplerCount >= cache->samplerLimit) {
+		cache->samplerLimit *= 2;
+
+		void* newKeys = realloc(
+			cache->keys,
+			sizeof(SamplerKey) * cache->samplerLimit
+		);
+
+		if (!newKeys) {
+			perror("Failed to reallocate sampler keys");
+			return -1;
+		}
+
+		cache->keys = (SamplerKey*)newKeys;
+
+		void* newSamplers = realloc(
+			cache->samplers,
+			sizeof(VkSampler) * cache->samplerLimit
+		);
+
+		if (!newSamplers) {
+			perror("Failed to reallocate samplers");
+			return -1;
+		}
+
+		cache->samplers = (VkSampler*)newSamplers;
+	}
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = key.filter;
+	samplerInfo.minFilter = key.filter;
+	samplerInfo.addressModeU = key.addressMode;
+	samplerInfo.addressModeV = key.addressMode;
+	samplerInfo.addressModeW = key.addressMode;
+	samplerInfo.anisotropyEnable = cache->anisotropy;
+	samplerInfo.maxAnisotropy = cache->maxAnisotropy;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = key.mipmapMode;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.minLod = key.minLod;
+	samplerInfo.maxLod = key.maxLod;
+
+	if (vkCreateSampler(
+		device,
+		&samplerInfo,
+		0,
+		&cache->samplers[cache->samplerCount]
+	) != VK_SUCCESS) {
+		printf("Failed to create sampler.\n");
+		return -1;
+	}
+
+	cache->keys[cache->samplerCount] = key;
+	*sampler = cache->samplers[cache->samplerCount];
+	++cache->samplerCount;
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef RENDER_SAMPLER_H
+#define RENDER_SAMPLER_H 1
+
+#include <vulkan/vulkan.h>
+
+/* Everything that can differ between two samplers on this server */
+typedef struct
+{
+	VkFilter filter;
+	VkSamplerAddressMode addressMode;
+	VkSamplerMipmapMode mipmapMode;
+	float minLod;
+	float maxLod;
+} SamplerKey;
+
+/* Samplers are shared by everything that asks for the same parameters.
+ * Drivers only allow a few thousand of them at once, which a server with one
+ * sampler per texture can run through quickly.
+ *
+ * Samplers belong to the cache and live until it is destroyed. Nothing else
+ * should destroy them. */
+typedef struct
+{
+	SamplerKey* keys;
+	VkSampler* samplers;
+	unsigned int samplerCount;
+	unsigned int samplerLimit;
+
+	/* Asked once per device instead of once per sampler */
+	VkBool32 anisotropy;
+	float maxAnisotropy;
+} SamplerCache;
+
+/* Linear filtering, repeating and every mip level the image has. Anything that
+ * doesn't care about its sampler should use this. */
+extern const SamplerKey defSamplerKey;
+
+int createSamplerCache(SamplerCache* cache, VkPhysicalDevice physDev);
+void destroySamplerCache(VkDevice device, SamplerCache cache);
+
+int getSampler(
+	SamplerCache* cache,
+	VkDevice device,
+	SamplerKey key,
+	VkSampler* sampler
+);
+
+#endif
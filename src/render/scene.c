@@ -10,43 +10,24 @@
 
 int createSceneArray(SceneArray* scenes)
 {
-	scenes->sceneLimit = sizeof(Scene);
-	scenes->sceneCount = 0;
-	scenes->scenes = (Scene*)malloc(sizeof(Scene));
-	if (!scenes->scenes) {
-		perror("Failed to allocate memory for scenes");
-		return -1;
-	}
-
-	return 0;
+	return createDenseArray(scenes, sizeof(Scene), 0);
 }
 
-int sceneArrayRemoveEntry(SceneArray* scenes, unsigned int idx, VkDevice device)
+/* The last scene moves into the hole. Callers walking the array backwards
+ * have already been past it. */
+int sceneArrayRemoveEntry(
+	SceneArray* scenes,
+	unsigned int idx,
+	GarbageQueue* garbage
+)
 {
-	destroyScene(device, scenes->scenes[idx]);
-
-	close(scenes->scenes[idx].fd);
+	destroyScene(garbage, DENSE_AT(Scene, *scenes, idx));
 
-	scenes->sceneCount--;
-
-	memcpy(
-		&scenes->scenes[idx],
-		&scenes->scenes[idx + 1],
-		(scenes->sceneCount - idx) * sizeof(Scene)
-	);
+	close(DENSE_AT(Scene, *scenes, idx).fd);
 
-	printf("memcpy\n");
-	/* Allocate less space if too much is allocated */
-	/* sceneLimit is broken for no apparent reason */
-/*	while (scenes->sceneCount < scenes->sceneLimit / 2) {
-		scenes->sceneLimit /= 2;
-		scenes->scenes = (Scene*)
-			realloc(scenes->scenes, scenes->sceneCount);
-		if (!scenes->scenes) {
-			perror("realloc() in sceneArrayRemoveEntry() failed");
-			return -1;
-		}
-	}*/
+	if (denseRemove(scenes, idx)) {
+		return -1;
+	}
 
 	printf("removed scene array entry \n");
 
@@ -55,50 +36,58 @@ int sceneArrayRemoveEntry(SceneArray* scenes, unsigned int idx, VkDevice device)
 
 int sceneArrayAddEntry(SceneArray* scenes, Scene scene)
 {
-	/* Allocate more space if not enough is available */
-	while (scenes->sceneCount >= scenes->sceneLimit) {
-		scenes->sceneLimit *= 2;
-		scenes->scenes = (Scene*)
-			realloc(scenes->scenes, scenes->sceneLimit);
-		if (!scenes->scenes) {
-			perror("realloc() in sceneArrayAddEntry() failed");
-			return -1;
-		}
+	if (denseAdd(scenes, scene.fd, &scene) == -1) {
+		printf("Failed to add scene\n");
+		return -1;
 	}
 
-	scenes->scenes[scenes->sceneCount] = scene;
-
-	++scenes->sceneCount;
+	return 0;
 }
 
-void destroySceneArray(VkDevice device, SceneArray scenes)
+void destroySceneArray(GarbageQueue* garbage, SceneArray scenes)
 {
-	for (int i = 0; i < scenes.sceneCount; i++) {
-		destroyScene(device, scenes.scenes[i]);
+	for (int i = 0; i < scenes.count; i++) {
+		destroyScene(garbage, DENSE_AT(Scene, scenes, i));
 	}
 
-	free(scenes.scenes);
+	destroyDenseArray(scenes);
 }
 
 int createScene(Scene* scene, int fd)
 {
 	scene->fd = fd;
 	scene->version = 0;
+	scene->lodBias = 0.0f;
+	scene->submittedTriangles = 0;
+	scene->fullTriangles = 0;
+	scene->drawnMeshes = 0;
+	scene->culledMeshes = 0;
+	scene->generation = 0;
+	scene->commands = (CommandCache){};
+
+	scene->arena = (Arena*)malloc(sizeof(Arena));
+
+	if (!scene->arena) {
+		perror("Failed to allocate scene arena");
+		return -1;
+	}
 
-	scene->meshes = (Mesh*)malloc(sizeof(Mesh));
-	scene->meshIds = (int*)malloc(sizeof(int));
-	scene->meshCount = 0;
-	scene->meshLimit = 1;
-
-	scene->textures = (Texture*)malloc(sizeof(Texture));
-	scene->textureIds = (int*)malloc(sizeof(int));
-	scene->texCount = 0;
-	scene->texLimit = 1;
-
-	scene->pointLights = (PointLight*)malloc(sizeof(PointLight));
-	scene->pointLightIds = (int*)malloc(sizeof(int));
-	scene->ptLightCount = 0;
-	scene->ptLightLimit = 1;
+	createArena(scene->arena, 0);
+	createFreeList(&scene->bindingList, sizeof(TextureBinding));
+
+	if (
+		createDenseArray(&scene->meshes, sizeof(Mesh), scene->arena)
+		|| createDenseArray(&scene->textures, sizeof(Texture), scene->arena)
+		|| createDenseArray(
+			&scene->pointLights,
+			sizeof(PointLight),
+			scene->arena
+		)
+		|| createIdMap(&scene->refusedMeshes)
+		|| createIdMap(&scene->refusedTextures)
+	) {
+		return -1;
+	}
 
 	if (createCommandQueue(&scene->uniformCommands)) {
 		return -1;
@@ -107,8 +96,154 @@ int createScene(Scene* scene, int fd)
 	return 0;
 }
 
+/* Stats are added up when they're asked for instead of being tracked on every
+ * change. Nothing can drift out of sync that way. */
+void getSceneStats(Scene* scene, SceneStats* stats)
+{
+	*stats = (SceneStats){};
+
+	stats->meshCount = scene->meshes.count;
+	stats->textureCount = scene->textures.count;
+
+	for (int i = 0; i < scene->meshes.count; i++) {
+		const Mesh* mesh = &DENSE_AT(Mesh, scene->meshes, i);
+
+		stats->vertexBytes += mesh->vertexMemSize;
+		stats->indexBytes += mesh->indexMemSize;
+
+		/* Meshlets are just more ways of reading the index buffer. */
+		stats->indexBytes += mesh->meshletMemSize;
+		stats->indexBytes += mesh->drawMemSize;
+		stats->meshletCount += mesh->meshletCount;
+		stats->hostBytes +=
+			mesh->submeshCount * mesh->lodCount * sizeof(Submesh);
+	}
+
+	stats->submittedTriangles = scene->submittedTriangles;
+	stats->fullTriangles = scene->fullTriangles;
+	stats->drawnMeshCount = scene->drawnMeshes;
+	stats->culledMeshCount = scene->culledMeshes;
+
+	stats->uniformBytes =
+		(uint64_t)scene->meshes.count * MAX_FRAMES_IN_FLIGHT
+		* sizeof(ModelUniforms);
+	stats->descriptorSetCount = scene->meshes.count * MAX_FRAMES_IN_FLIGHT;
+
+	stats->hostBytes +=
+		scene->meshes.limit * (sizeof(Mesh) + sizeof(int))
+		+ scene->textures.limit * (sizeof(Texture) + sizeof(int))
+		+ scene->pointLights.limit * (sizeof(PointLight) + sizeof(int))
+		+ scene->uniformCommands.commandLimit * sizeof(QueueCommand)
+		+ (
+			scene->meshes.map.size
+			+ scene->textures.map.size
+			+ scene->pointLights.map.size
+			+ scene->refusedMeshes.size
+			+ scene->refusedTextures.size
+		) * sizeof(IdMapBucket);
+
+	for (int i = 0; i < scene->textures.count; i++) {
+		const Texture tex = DENSE_AT(Texture, scene->textures, i);
+
+		/* memSize covers every mip level. */
+		if (tex.resident) {
+			stats->textureBytes += tex.memSize;
+		} else {
+			++stats->evictedTextureCount;
+		}
+
+		for (
+			TextureBinding* binding = tex.bindings;
+			binding;
+			binding = binding->next
+		) {
+			stats->hostBytes += sizeof(TextureBinding);
+		}
+
+		if (tex.path) stats->hostBytes += strlen(tex.path) + 1;
+	}
+}
+
+void printSceneStats(Scene* scene)
+{
+	SceneStats stats;
+	getSceneStats(scene, &stats);
+
+	printf("Scene (fd %i):\n", scene->fd);
+	printf(
+		"\tmeshes: %u, vertex: %llu KiB, index: %llu KiB\n",
+		stats.meshCount,
+		(unsigned long long)(stats.vertexBytes >> 10),
+		(unsigned long long)(stats.indexBytes >> 10)
+	);
+	printf(
+		"\ttextures: %u (%u evicted), %llu KiB\n",
+		stats.textureCount,
+		stats.evictedTextureCount,
+		(unsigned long long)(stats.textureBytes >> 10)
+	);
+	printf(
+		"\tuniforms: %llu KiB, descriptor sets: %u\n",
+		(unsigned long long)(stats.uniformBytes >> 10),
+		stats.descriptorSetCount
+	);
+	printf(
+		"\thost: %llu KiB\n",
+		(unsigned long long)(stats.hostBytes >> 10)
+	);
+	printf(
+		"\ttriangles: %llu of %llu\n",
+		(unsigned long long)stats.submittedTriangles,
+		(unsigned long long)stats.fullTriangles
+	);
+	printf(
+		"\tdrawn: %u meshes, culled: %u\n",
+		stats.drawnMeshCount,
+		stats.culledMeshCount
+	);
+	printf("\tmeshlets: %u\n", stats.meshletCount);
+}
+
+/* Everything the scene has in device local memory, for quotas. Uniform
+ * buffers are host visible, so they don't count. */
+uint64_t sceneDeviceBytes(Scene* scene)
+{
+	SceneStats stats;
+	getSceneStats(scene, &stats);
+
+	return stats.vertexBytes
+		+ stats.indexBytes
+		+ stats.textureBytes;
+}
+
+
+int createTexture(
+	Texture* tex,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers
+)
+{
+	if (createTextureImage(tex, device, physDev)) {
+		return -1;
+	}
+
+	/* Shared with every other texture, see sampler.c */
+	if (getSampler(samplers, device, defSamplerKey, &tex->sampler)) {
+		return -1;
+	}
+
+	tex->path = 0;
+	tex->lastUsed = 0;
+
+	tex->bindings = 0;
+
+	return 0;
+}
 
-int createTexture(Texture* tex, VkDevice device, VkPhysicalDevice physDev)
+/* Just the parts of a texture that live in device memory. Reloading an
+ * evicted texture only needs these back. */
+int createTextureImage(Texture* tex, VkDevice device, VkPhysicalDevice physDev)
 {
 	const uint32_t mipLevels = 1;
 	tex->mipLevels = floor(log2(max(tex->width, tex->height)));
@@ -145,17 +280,19 @@ int createTexture(Texture* tex, VkDevice device, VkPhysicalDevice physDev)
 		tex->mipLevels,
 		&tex->view
 	)) {
+		/* Nothing's used the image yet, so it can go straight away. */
+		vkDestroyImage(device, tex->img, 0);
+		vkFreeMemory(device, tex->mem, 0);
+		tex->img = VK_NULL_HANDLE;
+		tex->mem = VK_NULL_HANDLE;
 		return -1;
 	}
 
-	if (createSampler(device, physDev, &tex->sampler, tex->mipLevels)) {
-		return -1;
-	}
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, tex->img, &memRequirements);
 
-	tex->boundMeshes = malloc(sizeof(int));
-	tex->boundPasses = malloc(sizeof(int));
-	tex->boundMeshLimit = 1;
-	tex->boundMeshCount = 0;
+	tex->memSize = memRequirements.size;
+	tex->resident = 1;
 
 	return 0;
 }
@@ -241,47 +378,92 @@ int writeTexture(
 	return 0;
 }
 
-void destroyScene(VkDevice device, Scene scene)
+/* Nothing here waits on the GPU. The scene's resources go into the garbage
+ * queue and are destroyed once no frame in flight can be using them. */
+void destroyScene(GarbageQueue* garbage, Scene scene)
 {
-	vkDeviceWaitIdle(device);
-
-	for (int i = 0; i < scene.meshCount; i++) {
-		destroyMesh(device, scene.meshes[i]);
+	for (int i = 0; i < scene.meshes.count; i++) {
+		destroyMesh(garbage, DENSE_AT(Mesh, scene.meshes, i));
 	}
 
-	for (int i = 0; i < scene.texCount; i++) {
-		destroyTexture(device, scene.textures[i]);
+	for (int i = 0; i < scene.textures.count; i++) {
+		destroyTexture(garbage, DENSE_AT(Texture, scene.textures, i));
 	}
 
+	destroyCommandQueue(scene.uniformCommands);
+	destroyCommandCache(garbage, scene.commands);
 
-	free(scene.meshes);
-	free(scene.meshIds);
-
-	free(scene.textures);
-	free(scene.textureIds);
-
-	free(scene.pointLights);
-	free(scene.pointLightIds);
+	destroyDenseArray(scene.meshes);
+	destroyDenseArray(scene.textures);
+	destroyDenseArray(scene.pointLights);
+	destroyIdMap(scene.refusedMeshes);
+	destroyIdMap(scene.refusedTextures);
 
-	destroyCommandQueue(scene.uniformCommands);
+	/* Along with the element arrays and every texture binding */
+	destroyArena(*scene.arena);
+	free(scene.arena);
 }
 
-void destroyMesh(VkDevice device, Mesh mesh)
+void destroyMesh(GarbageQueue* garbage, Mesh mesh)
 {
-	vkDeviceWaitIdle(device);
+	Garbage item = {};
+
+	/* Pooled meshes only give back their ranges. */
+	if (mesh.pooled) {
+		item.type = GARBAGE_VERTEX_RANGE;
+		item.range = mesh.vertexRange;
+		item.rangeSize = mesh.vertexMemSize;
+		throwAway(garbage, item);
+
+		item.type = GARBAGE_INDEX_RANGE;
+		item.range = mesh.indexRange;
+		item.rangeSize = mesh.indexMemSize;
+		throwAway(garbage, item);
+	} else {
+		throwAwayBuffer(
+			garbage,
+			mesh.vertexBuffer,
+			mesh.vertexBufferMemory,
+			mesh.vertexMemSize
+		);
+
+		throwAwayBuffer(
+			garbage,
+			mesh.indexBuffer,
+			mesh.indexBufferMemory,
+			mesh.indexMemSize
+		);
+	}
 
-	vkDestroyBuffer(device, mesh.vertexBuffer, 0);
-	vkFreeMemory(device, mesh.vertexBufferMemory, 0);
-	
-	vkDestroyBuffer(device, mesh.indexBuffer, 0);
-	vkFreeMemory(device, mesh.indexBufferMemory, 0);
+	throwAwayBuffer(
+		garbage,
+		mesh.meshletBuffer,
+		mesh.meshletMemory,
+		mesh.meshletMemSize
+	);
+
+	throwAwayBuffer(
+		garbage,
+		mesh.drawBuffer,
+		mesh.drawMemory,
+		mesh.drawMemSize
+	);
 		
+	/* Uniform buffers are host memory and aren't budgeted. */
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		throwAwayBuffer(garbage, mesh.uniformBuffers[i], mesh.uboMemory[i], 0);
+	}
+
+	/* The sets go back to the allocator for the next mesh to pick up. */
+	item.type = GARBAGE_DESCRIPTOR_SET;
+
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroyBuffer(device, mesh.uniformBuffers[i], 0);
-		vkFreeMemory(device, mesh.uboMemory[i], 0);
+		item.descSet = mesh.descriptorSets[i];
+		throwAway(garbage, item);
 	}
 
-	vkDestroyDescriptorPool(device, mesh.descriptorPool, 0);
+	/* Only the CPU ever looks at these. */
+	free(mesh.submeshes);
 }
 
 void destroyViewpoint(VkDevice device, Viewpoint viewpoint)
@@ -292,18 +474,106 @@ void destroyViewpoint(VkDevice device, Viewpoint viewpoint)
 	}
 }
 
-void destroyTexture(VkDevice device, Texture texture)
+void destroyTexture(GarbageQueue* garbage, Texture texture)
 {
-	vkDeviceWaitIdle(device);
+	if (texture.resident) {
+		evictTexture(garbage, &texture);
+	}
 
-	vkDestroySampler(device, texture.sampler, 0);
-	vkDestroyImageView(device, texture.view, 0);
+	Garbage item = {};
 
-	vkDestroyImage(device, texture.img, 0);
-	vkFreeMemory(device, texture.mem, 0);
+	/* The slot is only handed back once nothing in flight can sample it.
+	 * Ignored when there's no texture table. */
+	item.type = GARBAGE_TEXTURE_SLOT;
+	item.texSlot = texture.tableSlot;
+	throwAway(garbage, item);
 
-	free(texture.boundMeshes);
-	free(texture.boundPasses);
+	/* The bindings belong to the scene's arena. */
+	free(texture.path);
+}
+
+/* Throws away everything the texture has in device memory. The rest stays,
+ * table slot included, so the texture can be loaded again later. */
+void evictTexture(GarbageQueue* garbage, Texture* texture)
+{
+	Garbage item = {};
+
+	item.type = GARBAGE_IMAGE_VIEW;
+	item.view = texture->view;
+	throwAway(garbage, item);
+
+	item.type = GARBAGE_IMAGE;
+	item.image = texture->img;
+	throwAway(garbage, item);
+
+	item.type = GARBAGE_MEMORY;
+	item.memory = texture->mem;
+	item.memSize = texture->memSize;
+	throwAway(garbage, item);
+
+	texture->view = VK_NULL_HANDLE;
+	texture->img = VK_NULL_HANDLE;
+	texture->mem = VK_NULL_HANDLE;
+	texture->resident = 0;
+}
+
+/* Records the mesh as bound to the texture, for unbinding it when the
+ * texture is deleted. */
+int addTextureBinding(Scene* scene, Texture* tex, int meshId, int pass)
+{
+	TextureBinding* binding = (TextureBinding*)
+		freeListAlloc(&scene->bindingList, scene->arena);
+
+	if (!binding) {
+		printf("Failed to allocate texture binding\n");
+		return -1;
+	}
+
+	binding->meshId = meshId;
+	binding->pass = pass;
+	binding->next = tex->bindings;
+	tex->bindings = binding;
+
+	return 0;
+}
+
+/* For when the mesh is bound to something else or deleted */
+void removeTextureBinding(Scene* scene, Texture* tex, int meshId)
+{
+	TextureBinding** link = &tex->bindings;
+
+	while (*link) {
+		TextureBinding* binding = *link;
+
+		if (binding->meshId == meshId) {
+			*link = binding->next;
+			freeListFree(&scene->bindingList, binding);
+		} else {
+			link = &binding->next;
+		}
+	}
+}
+
+/* Hands every binding back before the texture is deleted */
+void freeTextureBindings(Scene* scene, Texture* tex)
+{
+	while (tex->bindings) {
+		TextureBinding* next = tex->bindings->next;
+		freeListFree(&scene->bindingList, tex->bindings);
+		tex->bindings = next;
+	}
+}
+
+/* Whether any mesh in the scene has the texture bound */
+int textureInUse(Scene* scene, int texIdx)
+{
+	const int texId = scene->textures.ids[texIdx];
+
+	for (int i = 0; i < scene->meshes.count; i++) {
+		if (DENSE_AT(Mesh, scene->meshes, i).texId == texId) return 1;
+	}
+
+	return 0;
 }
 
 int createViewpoint(Viewpoint* pov, VkDevice dev, VkPhysicalDevice physDev)
@@ -327,13 +597,4 @@ int createViewpoint(Viewpoint* pov, VkDevice dev, VkPhysicalDevice physDev)
 	return 0;
 }
 
-int findId(int* ids, unsigned int idCount, int query)
-{
-	for (int i = 0; i < idCount; i++) {
-		if (ids[i] == query) return i;
-	}
-
-	return -1;
-}
-
 
@@ -3,19 +3,23 @@
 
 #include <vulkan/vulkan.h>
 #include "misc.h"
+#include "descalloc.h"
+#include "textable.h"
+#include "sampler.h"
+#include "garbage.h"
+#include "cmdcache.h"
+#include "vertex.h"
 #include "common/maths.h"
+#include "common/dense.h"
 #include "input/queuecmd.h"
 
-typedef struct
-{
-	float pos[3];
-	float normal[3];
-	float texCoord[2];
-} Vertex;
-
 typedef struct
 {   
 	float tform[4][4];
+
+	/* Packed positions get scaled and offset back out of the unit cube. */
+	float quantOffset[4];
+	float quantScale[4];
 } ModelUniforms;
 
 typedef struct
@@ -30,8 +34,49 @@ typedef struct
 	VkDeviceMemory uboMemory[MAX_FRAMES_IN_FLIGHT];
 	void* uboMapped[MAX_FRAMES_IN_FLIGHT];
 	float fov;
+
+	/* Kept on the CPU for picking LODs and culling. projScale is how much
+	 * a unit at a distance of one covers of half the screen height. */
+	Vec3 eye;
+	float projScale;
+	ViewpointUniforms uniforms;
 } Viewpoint;
 
+/* One of the meshes in an imported file. They all share the mesh's buffers
+ * and get drawn separately. */
+typedef struct
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+
+	/* Bounding box in model space */
+	float aabbMin[3];
+	float aabbMax[3];
+
+	/* The file's material for it, for when textures can be bound per
+	 * submesh */
+	uint32_t materialIndex;
+} Submesh;
+
+/* Meshes keep up to this many versions of themselves, each with roughly
+ * half the triangles of the last. */
+#define MESH_MAX_LODS 5
+
+/* The finest LOD is picked whose error covers no more pixels than this */
+#define LOD_PIXEL_ERROR 1.0f
+
+/* A LOD's submeshes are the mesh's submeshes, lodCount times over, and its
+ * meshlets are a run of the mesh's. */
+typedef struct
+{
+	/* How far, in model space, the surface can be from the full mesh */
+	float error;
+	unsigned int triangleCount;
+
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+} MeshLod;
+
 typedef struct
 {
 	VkBuffer vertexBuffer;
@@ -42,14 +87,76 @@ typedef struct
 	unsigned int indexCount;
 	VkIndexType indexType;
 
-	/* The properties of a mesh are held in its descriptor sets. */ 
-	VkDescriptorPool descriptorPool;
+	/* The properties of a mesh are held in its descriptor sets. They belong
+	 * to the display's shared descriptor allocator. */ 
 	VkDescriptorSet descriptorSets[MAX_FRAMES_IN_FLIGHT];
 
 	VkBuffer uniformBuffers[MAX_FRAMES_IN_FLIGHT];
 	VkDeviceMemory uboMemory[MAX_FRAMES_IN_FLIGHT];
 	void* uboMapped[MAX_FRAMES_IN_FLIGHT];
 	unsigned int size;
+
+	/* Where the bound texture sits in the texture table, bindless only */
+	uint32_t texIndex;
+
+	/* ID of the bound texture, -1 if there isn't one */
+	int texId;
+
+	/* Device local memory charged to the budget */
+	VkDeviceSize vertexMemSize;
+	VkDeviceSize indexMemSize;
+
+	/* Where the mesh sits in the display's geometry pool, if it's in
+	 * there. Its vertex and index buffers are the pool's then, so they
+	 * aren't the mesh's to destroy. */
+	char pooled;
+	PoolRange vertexRange;
+	PoolRange indexRange;
+
+	/* The mesh's object and first draw command in this frame's draw list,
+	 * see buildDrawList() */
+	uint32_t drawObject;
+	uint32_t firstDraw;
+
+	/* Bounding box and sphere in model space */
+	float aabbMin[3];
+	float aabbMax[3];
+	float sphereCentre[3];
+	float sphereRadius;
+
+	/* Whether the mesh is in view this frame */
+	char visible;
+
+	Submesh* submeshes;
+	unsigned int submeshCount;
+
+	/* Meshlets for the culling pass and the draw list it fills. The list
+	 * starts with the number of draws in it. Both are empty when meshlet
+	 * culling is off. */
+	VkBuffer meshletBuffer;
+	VkDeviceMemory meshletMemory;
+	VkBuffer drawBuffer;
+	VkDeviceMemory drawMemory;
+	unsigned int meshletCount;
+	VkDeviceSize meshletMemSize;
+	VkDeviceSize drawMemSize;
+
+	/* LOD 0 is the mesh as it was imported. lod is the one picked for
+	 * this frame. */
+	MeshLod lods[MESH_MAX_LODS];
+	unsigned int lodCount;
+	unsigned int lod;
+
+	/* Copy of the model matrix in the uniforms, for measuring distances */
+	float tform[4][4];
+
+	/* Shadows, see shadow.c. moved is set by every transform until the
+	 * shadows have seen it, and meshes still for long enough count as
+	 * static casters. shadowSphere is the world space bounding sphere the
+	 * shadows last saw, so lights it's moved away from know too. */
+	char moved;
+	uint32_t stillFrames;
+	float shadowSphere[4];
 } Mesh;
 
 typedef struct
@@ -58,6 +165,15 @@ typedef struct
 	float r, g, b;
 	float intensity;
 	float distance;
+
+	/* The light's tile in the shadow atlas, -1 until it gets one.
+	 * shadowReady once the tile has been drawn. staticDirty means the
+	 * static casters have to be drawn again, and dirty that the tile needs
+	 * refreshing at all. */
+	int shadowTile;
+	char shadowReady;
+	char staticDirty;
+	char dirty;
 } PointLight;
 
 typedef struct
@@ -71,55 +187,138 @@ typedef struct
 	VkImageView view;
 	VkSampler sampler;
 	VkDescriptorSet samplerDescSet;
+	uint32_t tableSlot;
 
-	/* IDs of meshes bound to texture */
-	/* I will definitely completely redo this server. */
-	int* boundMeshes;
-	int* boundPasses;
-	unsigned int boundMeshLimit;
-	unsigned int boundMeshCount;
+	/* Unused textures can be evicted from device memory when the server is
+	 * over budget. They get loaded from path again when they're next
+	 * bound. */
+	char resident;
+	char* path;
+	uint64_t lastUsed;
+	VkDeviceSize memSize;
+
+	/* Meshes bound to the texture */
+	struct TextureBinding* bindings;
 } Texture;
 
-/* IDs are in separate arrays to reduce cache misses. */
+/* One mesh bound to a texture. They come out of the scene's arena and are
+ * recycled through its free list as meshes are bound and unbound. */
+typedef struct TextureBinding
+{
+	struct TextureBinding* next;
+	int meshId;
+	int pass;
+} TextureBinding;
+
+/* Names for what each dense array holds. They're all the same type. */
+typedef DenseArray MeshArray;
+typedef DenseArray TextureArray;
+typedef DenseArray PointLightArray;
+
+/* IDs are in separate arrays to reduce cache misses.
+ *
+ * The element arrays and texture bindings live in the scene's arena, which
+ * goes all at once with the scene. Scenes move around in their own array, so
+ * the arena is allocated separately for the element arrays to point at. */
 typedef struct
 {
-	Mesh* meshes;
-	int* meshIds;
-	unsigned int meshLimit;
-	unsigned int meshCount;
+	Arena* arena;
+	FreeList bindingList;
 
-	Texture* textures;
-	int* textureIds;
-	unsigned int texLimit;
-	unsigned int texCount;
+	MeshArray meshes;
+	TextureArray textures;
+	PointLightArray pointLights;
 
-	PointLight* pointLights;
-	int* pointLightIds;
-	unsigned int ptLightLimit;
-	unsigned int ptLightCount;
+	/* IDs of meshes and textures that were refused for going over the
+	 * scene's quota. Commands naming them are ignored rather than treated
+	 * as errors, since the client had no way of knowing. */
+	IdMap refusedMeshes;
+	IdMap refusedTextures;
 
 	CommandQueue uniformCommands;
 	
 	int fd;
 	char version;
 	char hasViewpoint;
+
+	/* Powers of two on the screen space error allowed before a finer LOD
+	 * is picked. Positive biases towards coarser ones. */
+	float lodBias;
+
+	/* Triangles in the LODs picked last frame, and what the full meshes
+	 * would have cost */
+	uint64_t submittedTriangles;
+	uint64_t fullTriangles;
+
+	/* Meshes in and out of view last frame */
+	uint32_t drawnMeshes;
+	uint32_t culledMeshes;
+
+	/* Bumped whenever a mesh or texture binding changes, which means the
+	 * cached commands have to be recorded again. */
+	uint32_t generation;
+	CommandCache commands;
 } Scene;
 
+/* What a scene is holding on to. Fixed size types since this gets sent to
+ * clients as is. */
 typedef struct
 {
-	Scene* scenes;
-	unsigned int sceneCount;
-	int sceneLimit;
-} SceneArray;
+	/* Device memory */
+	uint64_t vertexBytes;
+	uint64_t indexBytes;
+	uint64_t textureBytes;
+	uint64_t uniformBytes;
+
+	uint32_t meshCount;
+	uint32_t textureCount;
+	uint32_t evictedTextureCount;
+	uint32_t descriptorSetCount;
+
+	/* Host memory for the scene's arrays */
+	uint64_t hostBytes;
+
+	/* Last frame, before any culling */
+	uint64_t submittedTriangles;
+	uint64_t fullTriangles;
+
+	/* Last frame, after frustum culling */
+	uint32_t drawnMeshCount;
+	uint32_t culledMeshCount;
+
+	/* Across every mesh that was split up */
+	uint32_t meshletCount;
+} SceneStats;
+
+/* Scenes are keyed by their socket. */
+typedef DenseArray SceneArray;
+
+/* A mesh by the index of its scene and its index in that scene */
+#define SCENE_MESH(scenes, sceneIdx, meshIdx) \
+	DENSE_AT(Mesh, DENSE_AT(Scene, scenes, sceneIdx).meshes, meshIdx)
 
 int createSceneArray(SceneArray* scenes);
 int sceneArrayAddEntry(SceneArray* scenes, Scene scene);
-int sceneArrayRemoveEntry(SceneArray* scenes, unsigned int idx, VkDevice device);
-void destroySceneArray(VkDevice device, SceneArray scenes);
+int sceneArrayRemoveEntry(
+	SceneArray* scenes,
+	unsigned int idx,
+	GarbageQueue* garbage
+);
+void destroySceneArray(GarbageQueue* garbage, SceneArray scenes);
 
 int createScene(Scene* scene, int fd);
 
-int createTexture(Texture* tex, VkDevice device, VkPhysicalDevice physDev);
+void getSceneStats(Scene* scene, SceneStats* stats);
+void printSceneStats(Scene* scene);
+uint64_t sceneDeviceBytes(Scene* scene);
+
+int createTexture(
+	Texture* tex,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers
+);
+int createTextureImage(Texture* tex, VkDevice device, VkPhysicalDevice physDev);
 int writeTexture(
 	Texture* tex,
 	void* pixels,
@@ -129,14 +328,18 @@ int writeTexture(
 	VkQueue queue
 );
 
-void destroyScene(VkDevice device, Scene scene);
-void destroyMesh(VkDevice device, Mesh mesh);
+void destroyScene(GarbageQueue* garbage, Scene scene);
+void destroyMesh(GarbageQueue* garbage, Mesh mesh);
 void destroyViewpoint(VkDevice device, Viewpoint viewpoint);
-void destroyTexture(VkDevice device, Texture texture);
+void destroyTexture(GarbageQueue* garbage, Texture texture);
+void evictTexture(GarbageQueue* garbage, Texture* texture);
+int addTextureBinding(Scene* scene, Texture* tex, int meshId, int pass);
+void removeTextureBinding(Scene* scene, Texture* tex, int meshId);
+void freeTextureBindings(Scene* scene, Texture* tex);
+int textureInUse(Scene* scene, int texIdx);
 
 int createViewpoint(Viewpoint* pov, VkDevice dev, VkPhysicalDevice physDev);
 
-int findId(int* ids, unsigned int idCount, int query);
 
 #endif
 
@@ -0,0 +1,865 @@
+#include "shadow.h"
+#include "pass.h"
+#include "frustum.h"
+#include "common/maths.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const SamplerKey shadowSamplerKey = {
+	.filter = VK_FILTER_NEAREST,
+	.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+	.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+	.minLod = 0.0f,
+	.maxLod = 0.0f
+};
+
+/* Any basis would do, as long as beauty.frag's is the same. */
+const float shadowFaceAxes[6][3][3] = {
+	{{0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+	{{0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}},
+	{{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}},
+	{{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, -1.0f, 0.0f}},
+	{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+	{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}}
+};
+
+int createShadowAtlas(
+	ShadowAtlas* atlas,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
+	char packedVertices
+)
+{
+	*atlas = (ShadowAtlas){};
+
+	atlas->packedVertices = packedVertices;
+	createShadowCache(&atlas->cache);
+
+	/* Images */
+
+	if (createImage(
+		device,
+		physDev,
+		SHADOW_ATLAS_WIDTH,
+		SHADOW_ATLAS_HEIGHT,
+		1,
+		SHADOW_FORMAT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&atlas->staticImage,
+		&atlas->staticMem
+	)) {
+		return -1;
+	}
+
+	if (createImage(
+		device,
+		physDev,
+		SHADOW_ATLAS_WIDTH,
+		SHADOW_ATLAS_HEIGHT,
+		1,
+		SHADOW_FORMAT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+		| VK_IMAGE_USAGE_TRANSFER_DST_BIT
+		| VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&atlas->image,
+		&atlas->mem
+	)) {
+		return -1;
+	}
+
+	if (createImageView(
+		device,
+		atlas->staticImage,
+		SHADOW_FORMAT,
+		VK_IMAGE_ASPECT_DEPTH_BIT,
+		1,
+		&atlas->staticView
+	)) {
+		printf("Failed to create static shadow atlas view\n");
+		return -1;
+	}
+
+	if (createImageView(
+		device,
+		atlas->image,
+		SHADOW_FORMAT,
+		VK_IMAGE_ASPECT_DEPTH_BIT,
+		1,
+		&atlas->view
+	)) {
+		printf("Failed to create shadow atlas view\n");
+		return -1;
+	}
+
+	/* Both go straight into the layouts they rest in. Tiles aren't read
+	 * until they've been drawn, so what's in them doesn't matter. */
+	VkImageMemoryBarrier barriers[2] = {};
+	barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barriers[0].srcAccessMask = 0;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barriers[0].image = atlas->staticImage;
+	barriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	barriers[0].subresourceRange.baseMipLevel = 0;
+	barriers[0].subresourceRange.levelCount = 1;
+	barriers[0].subresourceRange.baseArrayLayer = 0;
+	barriers[0].subresourceRange.layerCount = 1;
+
+	barriers[1] = barriers[0];
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].image = atlas->image;
+
+	beginSingleTimeCommands(cmdBuf);
+
+	vkCmdPipelineBarrier(
+		cmdBuf,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT
+		| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0,
+		0,
+		0,
+		0,
+		2,
+		barriers
+	);
+
+	endSingleTimeCommands(cmdBuf, queue);
+
+	if (getSampler(samplers, device, shadowSamplerKey, &atlas->sampler)) {
+		return -1;
+	}
+
+	/* Render Passes
+	 * The static atlas is copied from once it's drawn, and the other is
+	 * read by the beauty subpass. */
+
+	if (createShadowRenderPass(
+		device,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_ACCESS_TRANSFER_READ_BIT,
+		&atlas->staticPass
+	)) {
+		return -1;
+	}
+
+	if (createShadowRenderPass(
+		device,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_ACCESS_SHADER_READ_BIT,
+		&atlas->pass
+	)) {
+		return -1;
+	}
+
+	/* Framebuffers */
+
+	VkFramebufferCreateInfo fbInfo = {};
+	fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	fbInfo.renderPass = atlas->staticPass;
+	fbInfo.attachmentCount = 1;
+	fbInfo.pAttachments = &atlas->staticView;
+	fbInfo.width = SHADOW_ATLAS_WIDTH;
+	fbInfo.height = SHADOW_ATLAS_HEIGHT;
+	fbInfo.layers = 1;
+
+	if (vkCreateFramebuffer(
+		device,
+		&fbInfo,
+		0,
+		&atlas->staticFb
+	) != VK_SUCCESS) {
+		printf("Failed to create framebuffer\n");
+		return -1;
+	}
+
+	fbInfo.renderPass = atlas->pass;
+	fbInfo.pAttachments = &atlas->view;
+
+	if (vkCreateFramebuffer(device, &fbInfo, 0, &atlas->fb) != VK_SUCCESS) {
+		printf("Failed to create framebuffer\n");
+		return -1;
+	}
+
+	if (createShadowPipeline(atlas, device)) {
+		return -1;
+	}
+
+	printf(
+		"Shadow atlas: %u tiles, %llu KiB\n",
+		SHADOW_TILE_COUNT,
+		(unsigned long long)SHADOW_ATLAS_WIDTH * SHADOW_ATLAS_HEIGHT
+		* sizeof(uint16_t) * 2 / 1024
+	);
+
+	return 0;
+}
+
+/* Tiles are drawn over what's already there, so the atlas is loaded and
+ * stored whole. Before the pass, whatever last copied to or from it, or read
+ * it, has to be done. */
+int createShadowRenderPass(
+	VkDevice device,
+	VkImageLayout initialLayout,
+	VkImageLayout finalLayout,
+	VkPipelineStageFlags dstStage,
+	VkAccessFlags dstAccess,
+	VkRenderPass* pass
+)
+{
+	VkAttachmentDescription attachment = defAttachmentDescription;
+	attachment.format = SHADOW_FORMAT;
+	attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.initialLayout = initialLayout;
+	attachment.finalLayout = finalLayout;
+
+	VkAttachmentReference attachmentRef = {};
+	attachmentRef.attachment = 0;
+	attachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.pDepthStencilAttachment = &attachmentRef;
+
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask =
+		VK_PIPELINE_STAGE_TRANSFER_BIT
+		| VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+		| VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask =
+		VK_ACCESS_TRANSFER_WRITE_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask =
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+		| VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask =
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+		| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask =
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = dstStage;
+	dependencies[1].dstAccessMask = dstAccess;
+
+	VkRenderPassCreateInfo passInfo = defRenderPassCreateInfo;
+	passInfo.attachmentCount = 1;
+	passInfo.pAttachments = &attachment;
+	passInfo.subpassCount = 1;
+	passInfo.pSubpasses = &subpass;
+	passInfo.dependencyCount = 2;
+	passInfo.pDependencies = dependencies;
+
+	if (vkCreateRenderPass(device, &passInfo, 0, pass) != VK_SUCCESS) {
+		printf("Failed to create shadow render pass\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Depth only, so there's no fragment shader. The two passes only differ in
+ * layouts, so the one pipeline works with both. */
+int createShadowPipeline(ShadowAtlas* atlas, VkDevice device)
+{
+	VkPushConstantRange constantRange = {};
+	constantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	constantRange.offset = 0;
+	constantRange.size = sizeof(ShadowConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &constantRange;
+
+	if (vkCreatePipelineLayout(
+		device,
+		&pipelineLayoutInfo,
+		0,
+		&atlas->pipelineLayout
+	) != VK_SUCCESS) {
+		printf("Failed to create pipeline layout\n");
+		return -1;
+	}
+
+	const char* dataDir = getenv("IGNI_RENDER_DATA_DIR");
+
+	/* +1 to account for the null terminator */
+	int dataDirLen = strlen(dataDir) + 1;
+
+	char* vertPath = malloc(dataDirLen + 20);
+	memcpy(vertPath, dataDir, dataDirLen);
+	strcat(vertPath, "/shadowvert.spv");
+
+	VkShaderModule shadowVert;
+
+	int result = loadShaderModule(device, &shadowVert, vertPath);
+	free(vertPath);
+
+	if (result) return -1;
+
+	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+	vertShaderStageInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStageInfo.module = shadowVert;
+	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStageInfo.pName = "main";
+
+	VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicInfo = {};
+	dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicInfo.dynamicStateCount = 2;
+	dynamicInfo.pDynamicStates = dynamicStates;
+
+	/* Only the position, in whichever format the meshes are in */
+	VkVertexInputAttributeDescription positionAttribute = {};
+	positionAttribute.location = 0;
+	positionAttribute.binding = 0;
+	positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+	positionAttribute.offset = offsetof(Vertex, pos);
+
+	VkVertexInputBindingDescription vertexBinding = {};
+	vertexBinding.binding = 0;
+	vertexBinding.stride = sizeof(Vertex);
+	vertexBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	if (atlas->packedVertices) {
+		positionAttribute.format = VK_FORMAT_R16G16B16A16_UNORM;
+		positionAttribute.offset = offsetof(PackedVertex, pos);
+		vertexBinding.stride = sizeof(PackedVertex);
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &vertexBinding;
+	vertexInputInfo.vertexAttributeDescriptionCount = 1;
+	vertexInputInfo.pVertexAttributeDescriptions = &positionAttribute;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
+	inputAssemblyInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+	/* Set for every face */
+	VkPipelineViewportStateCreateInfo viewportInfo = {};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.scissorCount = 1;
+
+	/* Meshes are double sided, so their shadows have to be too. */
+	VkPipelineRasterizationStateCreateInfo rasteriserInfo = {};
+	rasteriserInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasteriserInfo.depthClampEnable = VK_FALSE;
+	rasteriserInfo.rasterizerDiscardEnable = VK_FALSE;
+	rasteriserInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	rasteriserInfo.lineWidth = 1.0f;
+	rasteriserInfo.cullMode = VK_CULL_MODE_NONE;
+	rasteriserInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasteriserInfo.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampleInfo = {};
+	multisampleInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleInfo.sampleShadingEnable = VK_FALSE;
+	multisampleInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampleInfo.minSampleShading = 1.0f;
+
+	VkPipelineColorBlendStateCreateInfo colourBlendInfo = {};
+	colourBlendInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colourBlendInfo.logicOpEnable = VK_FALSE;
+	colourBlendInfo.attachmentCount = 0;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 1;
+	pipelineInfo.pStages = &vertShaderStageInfo;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
+	pipelineInfo.pViewportState = &viewportInfo;
+	pipelineInfo.pRasterizationState = &rasteriserInfo;
+	pipelineInfo.pMultisampleState = &multisampleInfo;
+	pipelineInfo.pColorBlendState = &colourBlendInfo;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pDynamicState = &dynamicInfo;
+	pipelineInfo.layout = atlas->pipelineLayout;
+	pipelineInfo.renderPass = atlas->staticPass;
+	pipelineInfo.subpass = 0;
+
+	VkResult pipelineResult = vkCreateGraphicsPipelines(
+		device,
+		VK_NULL_HANDLE,
+		1,
+		&pipelineInfo,
+		0,
+		&atlas->pipeline
+	);
+
+	vkDestroyShaderModule(device, shadowVert, 0);
+
+	if (pipelineResult != VK_SUCCESS) {
+		printf("Failed to create graphics pipeline\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The sampler belongs to the sampler cache. */
+void destroyShadowAtlas(VkDevice device, ShadowAtlas atlas)
+{
+	vkDestroyPipeline(device, atlas.pipeline, 0);
+	vkDestroyPipelineLayout(device, atlas.pipelineLayout, 0);
+
+	vkDestroyFramebuffer(device, atlas.staticFb, 0);
+	vkDestroyFramebuffer(device, atlas.fb, 0);
+	vkDestroyRenderPass(device, atlas.staticPass, 0);
+	vkDestroyRenderPass(device, atlas.pass, 0);
+
+	vkDestroyImageView(device, atlas.staticView, 0);
+	vkDestroyImage(device, atlas.staticImage, 0);
+	vkFreeMemory(device, atlas.staticMem, 0);
+
+	vkDestroyImageView(device, atlas.view, 0);
+	vkDestroyImage(device, atlas.image, 0);
+	vkFreeMemory(device, atlas.mem, 0);
+
+	destroyShadowCache(atlas.cache);
+}
+
+/* Records this frame's share of the dirty tiles: their static casters into
+ * the static atlas if those changed, then the static tiles copied across and
+ * the moving casters drawn on top. Goes before the geometry pass, outside any
+ * render pass. */
+int recordShadows(
+	VkCommandBuffer* cmdBuf,
+	ShadowAtlas* atlas,
+	SceneArray scenes
+)
+{
+	PointLight* picked[SHADOW_TILE_COUNT];
+	const unsigned int pickedCount =
+		pickShadowTiles(&atlas->cache, scenes, picked);
+
+	if (!pickedCount) return 0;
+
+	VkRenderPassBeginInfo passBeginInfo = defRenderPassBeginInfo;
+	passBeginInfo.renderArea.offset.x = 0;
+	passBeginInfo.renderArea.offset.y = 0;
+	passBeginInfo.renderArea.extent.width = SHADOW_ATLAS_WIDTH;
+	passBeginInfo.renderArea.extent.height = SHADOW_ATLAS_HEIGHT;
+
+	/* Static Atlas */
+
+	if (atlas->cache.staticTiles) {
+		passBeginInfo.renderPass = atlas->staticPass;
+		passBeginInfo.framebuffer = atlas->staticFb;
+
+		vkCmdBeginRenderPass(
+			*cmdBuf,
+			&passBeginInfo,
+			VK_SUBPASS_CONTENTS_INLINE
+		);
+
+		vkCmdBindPipeline(
+			*cmdBuf,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			atlas->pipeline
+		);
+
+		for (unsigned int i = 0; i < pickedCount; i++) {
+			PointLight* light = picked[i];
+
+			if (!shadowTileNeedsStatic(light)) continue;
+
+			/* Only the tile, the rest of the atlas is other lights' */
+			VkClearAttachment clear = {};
+			clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			clear.clearValue.depthStencil.depth = 1.0f;
+
+			VkClearRect clearRect = {};
+			clearRect.rect = shadowFaceRect(light->shadowTile, 0);
+			clearRect.rect.extent.width = SHADOW_TILE_WIDTH;
+			clearRect.rect.extent.height = SHADOW_TILE_HEIGHT;
+			clearRect.baseArrayLayer = 0;
+			clearRect.layerCount = 1;
+
+			vkCmdClearAttachments(*cmdBuf, 1, &clear, 1, &clearRect);
+
+			drawShadowCasters(cmdBuf, atlas, scenes, light, 1);
+		}
+
+		vkCmdEndRenderPass(*cmdBuf);
+	}
+
+	/* The static tiles, copied over whatever was there. Reads from the
+	 * last frame's beauty subpass have to be done first. */
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = atlas->image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(
+		*cmdBuf,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		0,
+		0,
+		0,
+		1,
+		&barrier
+	);
+
+	VkImageCopy regions[SHADOW_TILE_COUNT] = {};
+
+	for (unsigned int i = 0; i < pickedCount; i++) {
+		const VkRect2D rect = shadowFaceRect(picked[i]->shadowTile, 0);
+
+		regions[i].srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		regions[i].srcSubresource.mipLevel = 0;
+		regions[i].srcSubresource.baseArrayLayer = 0;
+		regions[i].srcSubresource.layerCount = 1;
+		regions[i].srcOffset.x = rect.offset.x;
+		regions[i].srcOffset.y = rect.offset.y;
+		regions[i].dstSubresource = regions[i].srcSubresource;
+		regions[i].dstOffset = regions[i].srcOffset;
+		regions[i].extent.width = SHADOW_TILE_WIDTH;
+		regions[i].extent.height = SHADOW_TILE_HEIGHT;
+		regions[i].extent.depth = 1;
+	}
+
+	vkCmdCopyImage(
+		*cmdBuf,
+		atlas->staticImage,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		atlas->image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		pickedCount,
+		regions
+	);
+
+	/* Moving Casters
+	 * Always begun, even with nothing to draw, since the pass is what puts
+	 * the atlas back for the beauty subpass. */
+
+	passBeginInfo.renderPass = atlas->pass;
+	passBeginInfo.framebuffer = atlas->fb;
+
+	vkCmdBeginRenderPass(*cmdBuf, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	vkCmdBindPipeline(
+		*cmdBuf,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		atlas->pipeline
+	);
+
+	for (unsigned int i = 0; i < pickedCount; i++) {
+		drawShadowCasters(cmdBuf, atlas, scenes, picked[i], 0);
+	}
+
+	vkCmdEndRenderPass(*cmdBuf);
+
+	finishShadowTiles(picked, pickedCount);
+
+	return 0;
+}
+
+/* Draws either the static or the moving meshes in reach of the light into
+ * each face of its tile they could be seen from. Always the full LOD, since
+ * static tiles are kept for a long time. */
+void drawShadowCasters(
+	VkCommandBuffer* cmdBuf,
+	const ShadowAtlas* atlas,
+	SceneArray scenes,
+	const PointLight* light,
+	char staticCasters
+)
+{
+	const VkDeviceSize offsets[] = {0};
+
+	float faceTransforms[6][4][4];
+
+	for (int f = 0; f < 6; f++) {
+		shadowFaceTransform(faceTransforms[f], f, light);
+	}
+
+	for (int i = 0; i < scenes.count; i++) {
+		const MeshArray* meshes = &DENSE_AT(Scene, scenes, i).meshes;
+
+		for (int j = 0; j < meshes->count; j++) {
+			const Mesh* mesh = &DENSE_AT(Mesh, *meshes, j);
+
+			const char isStatic = mesh->stillFrames >= SHADOW_STATIC_FRAMES;
+
+			if (isStatic != staticCasters) continue;
+
+			const float offset[3] = {
+				mesh->shadowSphere[X] - light->x,
+				mesh->shadowSphere[Y] - light->y,
+				mesh->shadowSphere[Z] - light->z
+			};
+			const float radius = mesh->shadowSphere[3];
+			const float reach = light->distance + radius;
+
+			if (
+				offset[X] * offset[X]
+				+ offset[Y] * offset[Y]
+				+ offset[Z] * offset[Z]
+				>= reach * reach
+			) {
+				continue;
+			}
+
+			/* Packed positions come out of the vertex fetch between 0
+			 * and 1, so they're scaled back out of the mesh's box
+			 * first. */
+			float quant[4][4] = FILL_MAT4(0.0f);
+			scale3d(quant, 1.0f, 1.0f, 1.0f);
+
+			if (atlas->packedVertices) {
+				scale3d(
+					quant,
+					mesh->aabbMax[X] - mesh->aabbMin[X],
+					mesh->aabbMax[Y] - mesh->aabbMin[Y],
+					mesh->aabbMax[Z] - mesh->aabbMin[Z]
+				);
+				transform3d(
+					quant,
+					mesh->aabbMin[X],
+					mesh->aabbMin[Y],
+					mesh->aabbMin[Z]
+				);
+			}
+
+			float model[4][4];
+			multiply3d(
+				model,
+				(const float (*)[4])mesh->tform,
+				(const float (*)[4])quant
+			);
+
+			/* Pooled meshes' indices are relative to their first
+			 * vertex. */
+			const uint32_t firstIndex =
+				mesh->pooled ? mesh->indexRange.first : 0;
+			const int32_t vertexOffset =
+				mesh->pooled ? mesh->vertexRange.first : 0;
+
+			char bound = 0;
+
+			for (int f = 0; f < 6; f++) {
+				if (!sphereInShadowFace(f, offset, radius)) continue;
+
+				if (!bound) {
+					vkCmdBindVertexBuffers(
+						*cmdBuf,
+						0,
+						1,
+						&mesh->vertexBuffer,
+						offsets
+					);
+					vkCmdBindIndexBuffer(
+						*cmdBuf,
+						mesh->indexBuffer,
+						0,
+						mesh->indexType
+					);
+					bound = 1;
+				}
+
+				const VkRect2D rect = shadowFaceRect(light->shadowTile, f);
+
+				VkViewport viewport = {};
+				viewport.x = (float)rect.offset.x;
+				viewport.y = (float)rect.offset.y;
+				viewport.width = (float)rect.extent.width;
+				viewport.height = (float)rect.extent.height;
+				viewport.minDepth = 0.0f;
+				viewport.maxDepth = 1.0f;
+
+				vkCmdSetViewport(*cmdBuf, 0, 1, &viewport);
+				vkCmdSetScissor(*cmdBuf, 0, 1, &rect);
+
+				ShadowConstants constants;
+				multiply3d(
+					constants.transform,
+					(const float (*)[4])faceTransforms[f],
+					(const float (*)[4])model
+				);
+
+				vkCmdPushConstants(
+					*cmdBuf,
+					atlas->pipelineLayout,
+					VK_SHADER_STAGE_VERTEX_BIT,
+					0,
+					sizeof(ShadowConstants),
+					&constants
+				);
+
+				for (int k = 0; k < mesh->submeshCount; k++) {
+					vkCmdDrawIndexed(
+						*cmdBuf,
+						mesh->submeshes[k].indexCount,
+						1,
+						firstIndex + mesh->submeshes[k].firstIndex,
+						vertexOffset,
+						0
+					);
+				}
+			}
+		}
+	}
+}
+
+/* World space to the face's clip space. A 90 degree projection along the
+ * face's forward axis, so x and y are just the right and up axes. Depth goes
+ * from 0 at SHADOW_NEAR to 1 at the light's range. */
+void shadowFaceTransform(
+	float (*out)[4],
+	unsigned int face,
+	const PointLight* light
+)
+{
+	const float* right = shadowFaceAxes[face][0];
+	const float* up = shadowFaceAxes[face][1];
+	const float* forward = shadowFaceAxes[face][2];
+
+	const float far = fmaxf(light->distance, SHADOW_NEAR * 2.0f);
+	const float a = far / (far - SHADOW_NEAR);
+	const float b = -far * SHADOW_NEAR / (far - SHADOW_NEAR);
+
+	const float pos[3] = {light->x, light->y, light->z};
+
+	for (int c = 0; c < 3; c++) {
+		out[c][0] = right[c];
+		out[c][1] = up[c];
+		out[c][2] = forward[c] * a;
+		out[c][3] = forward[c];
+	}
+
+	out[3][0] = 0.0f;
+	out[3][1] = 0.0f;
+	out[3][3] = 0.0f;
+
+	for (int c = 0; c < 3; c++) {
+		out[3][0] -= right[c] * pos[c];
+		out[3][1] -= up[c] * pos[c];
+		out[3][3] -= forward[c] * pos[c];
+	}
+
+	out[3][2] = out[3][3] * a + b;
+}
+
+/* Whether a sphere, relative to the light, is anywhere near the face's side
+ * planes. They're at 45 degrees, between forward and each of right, left, up
+ * and down. */
+char sphereInShadowFace(unsigned int face, const float* offset, float radius)
+{
+	const float* right = shadowFaceAxes[face][0];
+	const float* up = shadowFaceAxes[face][1];
+	const float* forward = shadowFaceAxes[face][2];
+
+	float r = 0.0f;
+	float u = 0.0f;
+	float f = 0.0f;
+
+	for (int c = 0; c < 3; c++) {
+		r += right[c] * offset[c];
+		u += up[c] * offset[c];
+		f += forward[c] * offset[c];
+	}
+
+	const float slack = radius * (float)M_SQRT2;
+
+	return f - r >= -slack
+		&& f + r >= -slack
+		&& f - u >= -slack
+		&& f + u >= -slack;
+}
+
+/* Faces are three across and two down in their tile. Face 0's corner is the
+ * tile's. */
+VkRect2D shadowFaceRect(unsigned int tile, unsigned int face)
+{
+	VkRect2D rect = {};
+	rect.offset.x = (tile % SHADOW_ATLAS_COLUMNS) * SHADOW_TILE_WIDTH
+		+ (face % 3) * SHADOW_FACE_SIZE;
+	rect.offset.y = (tile / SHADOW_ATLAS_COLUMNS) * SHADOW_TILE_HEIGHT
+		+ (face / 3) * SHADOW_FACE_SIZE;
+	rect.extent.width = SHADOW_FACE_SIZE;
+	rect.extent.height = SHADOW_FACE_SIZE;
+
+	return rect;
+}
+
+/* Run with IGNI_RENDER_SHADOW_BUDGET set to a few different numbers to see
+ * how many tiles it takes to keep up with a scene. */
+void printShadowStats(const ShadowAtlas* atlas)
+{
+	printf(
+		"Shadows: %u of %u tiles in use, budget %u a frame\n",
+		atlas->cache.tilesInUse,
+		SHADOW_TILE_COUNT,
+		atlas->cache.budget
+	);
+	printf(
+		"\trefreshed: %u (%u static), waiting: %u\n",
+		atlas->cache.refreshedTiles,
+		atlas->cache.staticTiles,
+		atlas->cache.waitingTiles
+	);
+}
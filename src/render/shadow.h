@@ -0,0 +1,113 @@
+#ifndef RENDER_SHADOW_H
+#define RENDER_SHADOW_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "misc.h"
+#include "scene.h"
+#include "sampler.h"
+#include "shadowcache.h"
+
+/* Every light with a shadow gets a tile of the atlas, which is the six faces
+ * of a cube around the light laid out three across and two down. beauty.frag
+ * has the same numbers. */
+#define SHADOW_FACE_SIZE 256
+#define SHADOW_TILE_WIDTH (SHADOW_FACE_SIZE * 3)
+#define SHADOW_TILE_HEIGHT (SHADOW_FACE_SIZE * 2)
+#define SHADOW_ATLAS_WIDTH (SHADOW_TILE_WIDTH * SHADOW_ATLAS_COLUMNS)
+#define SHADOW_ATLAS_HEIGHT (SHADOW_TILE_HEIGHT * SHADOW_ATLAS_ROWS)
+
+/* Every device can render to and sample this, and lights only reach so far
+ * that 16 bits is plenty. */
+#define SHADOW_FORMAT VK_FORMAT_D16_UNORM
+
+/* Where the faces' projections start. They end at the light's range. */
+#define SHADOW_NEAR 0.05f
+
+/* shadow.vert's push constant, from the mesh's vertex buffer straight to the
+ * face's clip space */
+typedef struct
+{
+	float transform[4][4];
+} ShadowConstants;
+
+/* Shadows are cached between frames in two atlases. The static one only has
+ * meshes that have stopped moving and is only drawn again when a light or one
+ * of those meshes changes. A light's tile in the other one, which the beauty
+ * subpass samples, is the static tile copied over with the moving meshes
+ * drawn on top. Only tiles whose light or casters changed get refreshed, no
+ * more than the budget a frame. */
+typedef struct
+{
+	VkImage staticImage;
+	VkDeviceMemory staticMem;
+	VkImageView staticView;
+	VkFramebuffer staticFb;
+
+	VkImage image;
+	VkDeviceMemory mem;
+	VkImageView view;
+	VkFramebuffer fb;
+	VkSampler sampler;
+
+	/* The static atlas rests in TRANSFER_SRC_OPTIMAL and the other in
+	 * SHADER_READ_ONLY_OPTIMAL. Each pass leaves its atlas that way. */
+	VkRenderPass staticPass;
+	VkRenderPass pass;
+
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	char packedVertices;
+	ShadowCache cache;
+} ShadowAtlas;
+
+/* The atlas is only ever read by a gather, which doesn't filter. */
+extern const SamplerKey shadowSamplerKey;
+
+/* Right, up and forward for each face: +x, -x, +y, -y, +z and -z. */
+extern const float shadowFaceAxes[6][3][3];
+
+int createShadowAtlas(
+	ShadowAtlas* atlas,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	SamplerCache* samplers,
+	char packedVertices
+);
+int createShadowRenderPass(
+	VkDevice device,
+	VkImageLayout initialLayout,
+	VkImageLayout finalLayout,
+	VkPipelineStageFlags dstStage,
+	VkAccessFlags dstAccess,
+	VkRenderPass* pass
+);
+int createShadowPipeline(ShadowAtlas* atlas, VkDevice device);
+void destroyShadowAtlas(VkDevice device, ShadowAtlas atlas);
+
+int recordShadows(
+	VkCommandBuffer* cmdBuf,
+	ShadowAtlas* atlas,
+	SceneArray scenes
+);
+void drawShadowCasters(
+	VkCommandBuffer* cmdBuf,
+	const ShadowAtlas* atlas,
+	SceneArray scenes,
+	const PointLight* light,
+	char staticCasters
+);
+void shadowFaceTransform(
+	float (*out)[4],
+	unsigned int face,
+	const PointLight* light
+);
+char sphereInShadowFace(unsigned int face, const float* offset, float radius);
+VkRect2D shadowFaceRect(unsigned int tile, unsigned int face);
+
+void printShadowStats(const ShadowAtlas* atlas);
+
+#endif
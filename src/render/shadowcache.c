@@ -0,0 +1,278 @@
+#include "shadowcache.h"
+#include "frustum.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void createShadowCache(ShadowCache* cache)
+{
+	*cache = (ShadowCache){};
+	cache->budget = SHADOW_DEFAULT_BUDGET;
+}
+
+void destroyShadowCache(ShadowCache cache)
+{
+	free(cache.removals);
+}
+
+/* For meshes about to be deleted. Lights can be in other scenes, which the
+ * socket commands can't see, so it waits for the next frame. */
+int addShadowRemoval(ShadowCache* cache, const Mesh* mesh)
+{
+	if (cache->removalCount == cache->removalLimit) {
+		const unsigned int limit =
+			cache->removalLimit ? cache->removalLimit * 2 : 16;
+
+		ShadowRemoval* removals = (ShadowRemoval*)realloc(
+			cache->removals,
+			sizeof(ShadowRemoval) * limit
+		);
+
+		if (!removals) {
+			perror("Failed to allocate shadow removals");
+			return -1;
+		}
+
+		cache->removals = removals;
+		cache->removalLimit = limit;
+	}
+
+	ShadowRemoval* removal = &cache->removals[cache->removalCount];
+
+	/* Where the shadows last saw it, which is where it's drawn in them */
+	memcpy(removal->sphere, mesh->shadowSphere, sizeof(removal->sphere));
+	removal->staticCaster = mesh->stillFrames >= SHADOW_STATIC_FRAMES;
+	++cache->removalCount;
+
+	return 0;
+}
+
+int addSceneShadowRemovals(ShadowCache* cache, const Scene* scene)
+{
+	for (int i = 0; i < scene->meshes.count; i++) {
+		if (addShadowRemoval(cache, &DENSE_AT(Mesh, scene->meshes, i))) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* x, y, z and radius in world space */
+void meshShadowSphere(float* sphere, const Mesh* mesh)
+{
+	transformPoint(
+		sphere,
+		(const float (*)[4])mesh->tform,
+		mesh->sphereCentre
+	);
+	sphere[3] = mesh->sphereRadius
+		* transformMaxScale((const float (*)[4])mesh->tform);
+}
+
+/* Only lights with tiles have shadows to keep up to date, so there are never
+ * more than there are tiles. Lights that get a tile later are dirty from the
+ * start. */
+unsigned int findTiledLights(SceneArray scenes, PointLight** tiled)
+{
+	unsigned int tiledCount = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		PointLightArray* lights = &DENSE_AT(Scene, scenes, i).pointLights;
+
+		for (int j = 0; j < lights->count; j++) {
+			if (DENSE_AT(PointLight, *lights, j).shadowTile < 0) continue;
+			if (tiledCount == SHADOW_TILE_COUNT) return tiledCount;
+
+			tiled[tiledCount] = &DENSE_AT(PointLight, *lights, j);
+			++tiledCount;
+		}
+	}
+
+	return tiledCount;
+}
+
+/* Every tiled light the sphere reaches needs its tile refreshing, and the
+ * static tile drawing again if the sphere is a static caster's. */
+void markShadowLights(
+	PointLight** tiled,
+	unsigned int tiledCount,
+	const float* sphere,
+	char staticCaster
+)
+{
+	for (unsigned int i = 0; i < tiledCount; i++) {
+		PointLight* light = tiled[i];
+
+		const float dx = sphere[X] - light->x;
+		const float dy = sphere[Y] - light->y;
+		const float dz = sphere[Z] - light->z;
+		const float reach = light->distance + sphere[3];
+
+		if (dx * dx + dy * dy + dz * dz >= reach * reach) continue;
+
+		light->dirty = 1;
+		light->staticDirty |= staticCaster;
+	}
+}
+
+/* Once a frame, before any tiles are refreshed. Moved meshes dirty the lights
+ * around where they were and where they are now. Meshes that have been still
+ * long enough become static casters, which means drawing the static tiles
+ * around them again, once. */
+void updateShadowCasters(ShadowCache* cache, SceneArray scenes)
+{
+	PointLight* tiled[SHADOW_TILE_COUNT];
+	const unsigned int tiledCount = findTiledLights(scenes, tiled);
+
+	for (int i = 0; i < cache->removalCount; i++) {
+		markShadowLights(
+			tiled,
+			tiledCount,
+			cache->removals[i].sphere,
+			cache->removals[i].staticCaster
+		);
+	}
+
+	cache->removalCount = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		MeshArray* meshes = &DENSE_AT(Scene, scenes, i).meshes;
+
+		for (int j = 0; j < meshes->count; j++) {
+			Mesh* mesh = &DENSE_AT(Mesh, *meshes, j);
+
+			if (mesh->moved) {
+				const char wasStatic =
+					mesh->stillFrames >= SHADOW_STATIC_FRAMES;
+
+				markShadowLights(
+					tiled,
+					tiledCount,
+					mesh->shadowSphere,
+					wasStatic
+				);
+				meshShadowSphere(mesh->shadowSphere, mesh);
+				markShadowLights(tiled, tiledCount, mesh->shadowSphere, 0);
+
+				mesh->moved = 0;
+				mesh->stillFrames = 0;
+			} else if (mesh->stillFrames < SHADOW_STATIC_FRAMES) {
+				++mesh->stillFrames;
+
+				if (mesh->stillFrames == SHADOW_STATIC_FRAMES) {
+					markShadowLights(
+						tiled,
+						tiledCount,
+						mesh->shadowSphere,
+						1
+					);
+				}
+			}
+		}
+	}
+}
+
+/* Lights keep their tiles until they're deleted, which frees them here.
+ * Lights past the last tile go without shadows until one is free. */
+void assignShadowTiles(ShadowCache* cache, SceneArray scenes)
+{
+	char used[SHADOW_TILE_COUNT] = {};
+
+	cache->tilesInUse = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		const PointLightArray* lights = &DENSE_AT(Scene, scenes, i).pointLights;
+
+		for (int j = 0; j < lights->count; j++) {
+			if (DENSE_AT(PointLight, *lights, j).shadowTile < 0) continue;
+
+			used[DENSE_AT(PointLight, *lights, j).shadowTile] = 1;
+			++cache->tilesInUse;
+		}
+	}
+
+	unsigned int tile = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		PointLightArray* lights = &DENSE_AT(Scene, scenes, i).pointLights;
+
+		for (int j = 0; j < lights->count; j++) {
+			PointLight* light = &DENSE_AT(PointLight, *lights, j);
+
+			if (light->shadowTile >= 0) continue;
+
+			while (tile < SHADOW_TILE_COUNT && used[tile]) ++tile;
+
+			if (tile == SHADOW_TILE_COUNT) return;
+
+			used[tile] = 1;
+			++cache->tilesInUse;
+
+			light->shadowTile = tile;
+			light->shadowReady = 0;
+			light->staticDirty = 1;
+			light->dirty = 1;
+		}
+	}
+}
+
+
+/* This frame's share of the dirty tiles, going round from where the last
+ * frame stopped. Fills picked with no more than the budget's worth of lights
+ * and counts how many of them need their static casters drawn again. */
+unsigned int pickShadowTiles(
+	ShadowCache* cache,
+	SceneArray scenes,
+	PointLight** picked
+)
+{
+	PointLight* tiled[SHADOW_TILE_COUNT];
+	const unsigned int tiledCount = findTiledLights(scenes, tiled);
+
+	unsigned int pickedCount = 0;
+
+	cache->refreshedTiles = 0;
+	cache->staticTiles = 0;
+	cache->waitingTiles = 0;
+
+	const unsigned int start = tiledCount ? cache->nextLight % tiledCount : 0;
+
+	for (unsigned int n = 0; n < tiledCount; n++) {
+		const unsigned int idx = (start + n) % tiledCount;
+		PointLight* light = tiled[idx];
+
+		if (!light->dirty) continue;
+
+		if (pickedCount == cache->budget) {
+			++cache->waitingTiles;
+			continue;
+		}
+
+		picked[pickedCount] = light;
+		++pickedCount;
+
+		cache->staticTiles += shadowTileNeedsStatic(light);
+		cache->nextLight = idx + 1;
+	}
+
+	cache->refreshedTiles = pickedCount;
+
+	return pickedCount;
+}
+
+/* A tile that's never been drawn has nothing in the static atlas yet */
+char shadowTileNeedsStatic(const PointLight* light)
+{
+	return light->staticDirty || !light->shadowReady;
+}
+
+/* Once the picked tiles have been recorded */
+void finishShadowTiles(PointLight** picked, unsigned int pickedCount)
+{
+	for (unsigned int i = 0; i < pickedCount; i++) {
+		picked[i]->staticDirty = 0;
+		picked[i]->dirty = 0;
+		picked[i]->shadowReady = 1;
+	}
+}
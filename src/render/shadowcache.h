@@ -0,0 +1,75 @@
+#ifndef RENDER_SHADOWCACHE_H
+#define RENDER_SHADOWCACHE_H 1
+
+#include <stdint.h>
+#include "scene.h"
+
+/* Keeping track of which lights' shadow tiles have to be drawn again, and
+ * which of those need their static casters too. None of it touches Vulkan,
+ * so it can be tested on its own. shadow.c does the drawing. */
+
+/* How many lights can have shadows at once. shadow.h lays their tiles out
+ * in the atlas. */
+#define SHADOW_ATLAS_COLUMNS 4
+#define SHADOW_ATLAS_ROWS 4
+#define SHADOW_TILE_COUNT (SHADOW_ATLAS_COLUMNS * SHADOW_ATLAS_ROWS)
+
+/* Tiles refreshed a frame unless IGNI_RENDER_SHADOW_BUDGET says otherwise */
+#define SHADOW_DEFAULT_BUDGET 4
+
+/* Meshes that haven't been transformed for this many frames are drawn into
+ * the static atlas. */
+#define SHADOW_STATIC_FRAMES 30
+
+/* A deleted mesh's last bounding sphere, kept until the next frame marks the
+ * lights it was in. */
+typedef struct
+{
+	float sphere[4];
+	char staticCaster;
+} ShadowRemoval;
+
+typedef struct
+{
+	uint32_t budget;
+
+	/* Refreshes go round the lights, so a busy one can't hog the budget. */
+	uint32_t nextLight;
+
+	ShadowRemoval* removals;
+	unsigned int removalCount;
+	unsigned int removalLimit;
+
+	/* From the last frame */
+	uint32_t tilesInUse;
+	uint32_t refreshedTiles;
+	uint32_t staticTiles;
+	uint32_t waitingTiles;
+} ShadowCache;
+
+void createShadowCache(ShadowCache* cache);
+void destroyShadowCache(ShadowCache cache);
+
+int addShadowRemoval(ShadowCache* cache, const Mesh* mesh);
+int addSceneShadowRemovals(ShadowCache* cache, const Scene* scene);
+
+void meshShadowSphere(float* sphere, const Mesh* mesh);
+unsigned int findTiledLights(SceneArray scenes, PointLight** tiled);
+void markShadowLights(
+	PointLight** tiled,
+	unsigned int tiledCount,
+	const float* sphere,
+	char staticCaster
+);
+void updateShadowCasters(ShadowCache* cache, SceneArray scenes);
+void assignShadowTiles(ShadowCache* cache, SceneArray scenes);
+
+unsigned int pickShadowTiles(
+	ShadowCache* cache,
+	SceneArray scenes,
+	PointLight** picked
+);
+char shadowTileNeedsStatic(const PointLight* light);
+void finishShadowTiles(PointLight** picked, unsigned int pickedCount);
+
+#endif
@@ -0,0 +1,483 @@
+#include "simplify.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Appends a chain of simplified LODs to the index array. Every LOD has a
+ * copy of each submesh, simplified from the LOD before it, and the chain
+ * stops once simplification stalls or MESH_MAX_LODS is reached. Vertices
+ * are never touched, LODs just use fewer of them. */
+int buildLods(
+	uint32_t** indices,
+	unsigned int* indexCount,
+	Submesh** submeshes,
+	unsigned int submeshCount,
+	MeshLod* lods,
+	unsigned int* lodCount,
+	const Vertex* vertices,
+	unsigned int vertexCount
+)
+{
+	for (int l = 1; l < MESH_MAX_LODS; l++) {
+		const unsigned int lastIndexCount = lods[l - 1].triangleCount * 3;
+
+		if (!lastIndexCount) break;
+
+		/* A LOD is never bigger than the one before it. */
+		void* newIndices = realloc(
+			*indices,
+			sizeof(uint32_t) * (*indexCount + lastIndexCount)
+		);
+
+		if (!newIndices) {
+			perror("Failed to reallocate LOD indices");
+			return -1;
+		}
+
+		*indices = (uint32_t*)newIndices;
+
+		void* newSubmeshes = realloc(
+			*submeshes,
+			sizeof(Submesh) * submeshCount * (l + 1)
+		);
+
+		if (!newSubmeshes) {
+			perror("Failed to reallocate LOD submeshes");
+			return -1;
+		}
+
+		*submeshes = (Submesh*)newSubmeshes;
+
+		unsigned int lodIndexCount = 0;
+		float lodError = 0.0f;
+
+		for (int i = 0; i < submeshCount; i++) {
+			const Submesh* last = &(*submeshes)[(l - 1) * submeshCount + i];
+			Submesh* submesh = &(*submeshes)[l * submeshCount + i];
+			float error;
+
+			/* The bounds still hold since LODs only use fewer
+			 * vertices. */
+			*submesh = *last;
+			submesh->firstIndex = *indexCount + lodIndexCount;
+
+			if (simplifyMesh(
+				&(*indices)[submesh->firstIndex],
+				&submesh->indexCount,
+				&error,
+				vertices,
+				vertexCount,
+				&(*indices)[last->firstIndex],
+				last->indexCount,
+				(unsigned int)(last->indexCount / 3 * SIMPLIFY_LOD_RATIO) * 3
+			)) {
+				return -1;
+			}
+
+			lodIndexCount += submesh->indexCount;
+			lodError = fmaxf(lodError, error);
+		}
+
+		if (lodIndexCount > lastIndexCount * SIMPLIFY_MIN_REDUCTION) break;
+
+		/* Each LOD strays from the last, so the errors add up. */
+		lods[l] = (MeshLod){};
+		lods[l].error = lods[l - 1].error + lodError;
+		lods[l].triangleCount = lodIndexCount / 3;
+
+		*indexCount += lodIndexCount;
+		++*lodCount;
+	}
+
+	return 0;
+}
+
+/* Greedy edge collapse. Every pass collapses the cheapest edges it can
+ * without two collapses touching the same triangle, then the index list is
+ * rewritten without the triangles that got squashed. Vertices only ever
+ * move onto one of their neighbours, so no new vertices are needed and
+ * the texture coordinates stay put.
+ *
+ * error is the square root of the worst quadric error accepted, roughly
+ * the furthest any surface moved. */
+int simplifyMesh(
+	uint32_t* out,
+	unsigned int* outCount,
+	float* error,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int targetIndexCount
+)
+{
+	memcpy(out, indices, sizeof(uint32_t) * indexCount);
+	*outCount = indexCount;
+	*error = 0.0f;
+
+	if (indexCount <= targetIndexCount) return 0;
+
+	/* Everything in one go, biggest alignment first */
+	void* memory = malloc(
+		sizeof(Quadric) * vertexCount
+		+ sizeof(EdgeCollapse) * indexCount
+		+ sizeof(uint32_t) * vertexCount
+		+ sizeof(uint32_t) * (vertexCount + 1)
+		+ sizeof(uint32_t) * indexCount
+		+ sizeof(char) * vertexCount * 2
+	);
+
+	if (!memory) {
+		perror("Failed to allocate simplification memory");
+		return -1;
+	}
+
+	Quadric* quadrics = (Quadric*)memory;
+	EdgeCollapse* collapses = (EdgeCollapse*)(quadrics + vertexCount);
+	uint32_t* remap = (uint32_t*)(collapses + indexCount);
+	uint32_t* adjOffsets = remap + vertexCount;
+	uint32_t* adjTris = adjOffsets + vertexCount + 1;
+	char* locked = (char*)(adjTris + indexCount);
+	char* touched = locked + vertexCount;
+
+	if (lockSimplifyVertices(
+		locked,
+		vertices,
+		vertexCount,
+		indices,
+		indexCount
+	)) {
+		free(memory);
+		return -1;
+	}
+
+	/* Every vertex starts with the planes of the triangles around it. */
+	memset(quadrics, 0, sizeof(Quadric) * vertexCount);
+
+	for (int i = 0; i < indexCount; i += 3) {
+		const float* a = vertices[out[i]].pos;
+		const Vec3 cross = faceNormal(
+			a,
+			vertices[out[i + 1]].pos,
+			vertices[out[i + 2]].pos
+		);
+
+		if (dotVec3(cross, cross) <= 0.0f) continue;
+
+		const Vec3 n = normaliseVec3(cross);
+		const double d = -(n.x * a[X] + n.y * a[Y] + n.z * a[Z]);
+
+		for (int j = 0; j < 3; j++) {
+			quadricAddPlane(&quadrics[out[i + j]], n.x, n.y, n.z, d);
+		}
+	}
+
+	double maxCost = 0.0;
+
+	for (int pass = 0; pass < SIMPLIFY_MAX_PASSES; pass++) {
+		if (*outCount <= targetIndexCount) break;
+
+		/* Triangles around each vertex */
+		memset(adjOffsets, 0, sizeof(uint32_t) * (vertexCount + 1));
+
+		for (int i = 0; i < *outCount; i++) {
+			++adjOffsets[out[i]];
+		}
+
+		for (int i = 1; i < vertexCount; i++) {
+			adjOffsets[i] += adjOffsets[i - 1];
+		}
+
+		/* Filled back to front, which leaves each offset at the start of
+		 * its vertex's triangles. */
+		for (int i = *outCount - 1; i >= 0; i--) {
+			adjTris[--adjOffsets[out[i]]] = i / 3;
+		}
+
+		adjOffsets[vertexCount] = *outCount;
+
+		/* Candidates. Edges inside the mesh turn up twice, once each
+		 * way round, so only one of them is kept. Edges on the boundary
+		 * only join locked vertices. */
+		unsigned int collapseCount = 0;
+
+		for (int i = 0; i < *outCount; i++) {
+			const uint32_t a = out[i];
+			const uint32_t b = out[i % 3 == 2 ? i - 2 : i + 1];
+
+			if (a > b || (locked[a] && locked[b])) continue;
+
+			Quadric q = quadrics[a];
+			quadricAdd(&q, &quadrics[b]);
+
+			const double costA = quadricError(&q, vertices[b].pos);
+			const double costB = quadricError(&q, vertices[a].pos);
+
+			EdgeCollapse* collapse = &collapses[collapseCount];
+
+			if (!locked[a] && (locked[b] || costA <= costB)) {
+				collapse->from = a;
+				collapse->to = b;
+				collapse->cost = costA;
+			} else {
+				collapse->from = b;
+				collapse->to = a;
+				collapse->cost = costB;
+			}
+
+			++collapseCount;
+		}
+
+		if (!collapseCount) break;
+
+		qsort(collapses, collapseCount, sizeof(EdgeCollapse), compareCollapses);
+
+		for (int i = 0; i < vertexCount; i++) {
+			remap[i] = i;
+			touched[i] = 0;
+		}
+
+		const unsigned int trisNeeded = (*outCount - targetIndexCount) / 3;
+		unsigned int trisRemoved = 0;
+
+		for (int i = 0; i < collapseCount && trisRemoved < trisNeeded; i++) {
+			const uint32_t from = collapses[i].from;
+			const uint32_t to = collapses[i].to;
+
+			if (touched[from] || touched[to]) continue;
+
+			/* Triangles that would turn over aren't worth any saving. */
+			char flips = 0;
+
+			for (int j = adjOffsets[from]; j < adjOffsets[from + 1]; j++) {
+				const uint32_t* tri = &out[adjTris[j] * 3];
+
+				if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+				const Vec3 before = faceNormal(
+					vertices[tri[0]].pos,
+					vertices[tri[1]].pos,
+					vertices[tri[2]].pos
+				);
+				const Vec3 after = faceNormal(
+					vertices[tri[0] == from ? to : tri[0]].pos,
+					vertices[tri[1] == from ? to : tri[1]].pos,
+					vertices[tri[2] == from ? to : tri[2]].pos
+				);
+
+				if (dotVec3(before, after) <= 0.0f) {
+					flips = 1;
+					break;
+				}
+			}
+
+			if (flips) continue;
+
+			remap[from] = to;
+			quadricAdd(&quadrics[to], &quadrics[from]);
+
+			if (collapses[i].cost > maxCost) maxCost = collapses[i].cost;
+
+			/* Nothing else around here moves until the next pass, so the
+			 * flip check above stays true. */
+			for (int j = adjOffsets[from]; j < adjOffsets[from + 1]; j++) {
+				const uint32_t* tri = &out[adjTris[j] * 3];
+
+				trisRemoved +=
+					tri[0] == to || tri[1] == to || tri[2] == to;
+
+				for (int k = 0; k < 3; k++) {
+					touched[tri[k]] = 1;
+				}
+			}
+		}
+
+		if (!trisRemoved) break;
+
+		/* Squashed triangles are left out. */
+		unsigned int keptCount = 0;
+
+		for (int i = 0; i < *outCount; i += 3) {
+			const uint32_t a = remap[out[i]];
+			const uint32_t b = remap[out[i + 1]];
+			const uint32_t c = remap[out[i + 2]];
+
+			if (a == b || b == c || a == c) continue;
+
+			out[keptCount] = a;
+			out[keptCount + 1] = b;
+			out[keptCount + 2] = c;
+			keptCount += 3;
+		}
+
+		*outCount = keptCount;
+	}
+
+	*error = sqrtf(fmaxf((float)maxCost, 0.0f));
+
+	free(memory);
+
+	return 0;
+}
+
+/* Vertices on the edge of the mesh and on seams, where another vertex sits
+ * in the same place with different normals or texture coordinates, can't
+ * be moved without tearing holes. Both get found with hash tables. */
+int lockSimplifyVertices(
+	char* locked,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices,
+	unsigned int indexCount
+)
+{
+	memset(locked, 0, vertexCount);
+
+	unsigned int posTableSize = 1;
+	while (posTableSize < vertexCount * 2) posTableSize *= 2;
+
+	unsigned int edgeTableSize = 1;
+	while (edgeTableSize < indexCount * 2) edgeTableSize *= 2;
+
+	uint32_t* posTable = (uint32_t*)malloc(sizeof(uint32_t) * posTableSize);
+	uint64_t* edgeKeys = (uint64_t*)malloc(sizeof(uint64_t) * edgeTableSize);
+	uint32_t* edgeCounts = (uint32_t*)
+		calloc(edgeTableSize, sizeof(uint32_t));
+
+	if (!posTable || !edgeKeys || !edgeCounts) {
+		perror("Failed to allocate simplification tables");
+		free(posTable);
+		free(edgeKeys);
+		free(edgeCounts);
+		return -1;
+	}
+
+	/* Seams */
+	memset(posTable, 0xff, sizeof(uint32_t) * posTableSize);
+
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		const unsigned char* bytes = (const unsigned char*)vertices[i].pos;
+		uint32_t hash = 2166136261u;
+
+		for (int j = 0; j < sizeof(vertices[i].pos); j++) {
+			hash = (hash ^ bytes[j]) * 16777619u;
+		}
+
+		uint32_t slot = hash & (posTableSize - 1);
+
+		while (posTable[slot] != UINT32_MAX) {
+			const uint32_t other = posTable[slot];
+
+			if (!memcmp(
+				vertices[other].pos,
+				vertices[i].pos,
+				sizeof(vertices[i].pos)
+			)) {
+				locked[other] = 1;
+				locked[i] = 1;
+				break;
+			}
+
+			slot = (slot + 1) & (posTableSize - 1);
+		}
+
+		if (posTable[slot] == UINT32_MAX) posTable[slot] = i;
+	}
+
+	/* Boundaries, where an edge has one triangle instead of two. Edges
+	 * with more than two are locked as well. */
+	memset(edgeKeys, 0xff, sizeof(uint64_t) * edgeTableSize);
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i = 0; i < indexCount; i++) {
+			const uint32_t a = indices[i];
+			const uint32_t b = indices[i % 3 == 2 ? i - 2 : i + 1];
+			const uint64_t key = a < b
+				? (uint64_t)a << 32 | b
+				: (uint64_t)b << 32 | a;
+
+			/* Fibonacci hashing, keeping the top bits since the low
+			 * ones of a key are just the smaller index. */
+			uint32_t slot = (key * 11400714819323198485ull)
+				>> (64 - __builtin_ctz(edgeTableSize));
+
+			while (edgeKeys[slot] != UINT64_MAX && edgeKeys[slot] != key) {
+				slot = (slot + 1) & (edgeTableSize - 1);
+			}
+
+			if (!pass) {
+				edgeKeys[slot] = key;
+				++edgeCounts[slot];
+			} else if (edgeCounts[slot] != 2) {
+				locked[a] = 1;
+				locked[b] = 1;
+			}
+		}
+	}
+
+	free(posTable);
+	free(edgeKeys);
+	free(edgeCounts);
+
+	return 0;
+}
+
+/* Not normalised, its length is twice the triangle's area. */
+Vec3 faceNormal(const float* a, const float* b, const float* c)
+{
+	const Vec3 ab = {b[X] - a[X], b[Y] - a[Y], b[Z] - a[Z]};
+	const Vec3 ac = {c[X] - a[X], c[Y] - a[Y], c[Z] - a[Z]};
+
+	return crossVec3(ab, ac);
+}
+
+void quadricAddPlane(Quadric* q, double a, double b, double c, double d)
+{
+	q->a2 += a * a;
+	q->ab += a * b;
+	q->ac += a * c;
+	q->ad += a * d;
+	q->b2 += b * b;
+	q->bc += b * c;
+	q->bd += b * d;
+	q->c2 += c * c;
+	q->cd += c * d;
+	q->d2 += d * d;
+}
+
+void quadricAdd(Quadric* q, const Quadric* other)
+{
+	q->a2 += other->a2;
+	q->ab += other->ab;
+	q->ac += other->ac;
+	q->ad += other->ad;
+	q->b2 += other->b2;
+	q->bc += other->bc;
+	q->bd += other->bd;
+	q->c2 += other->c2;
+	q->cd += other->cd;
+	q->d2 += other->d2;
+}
+
+/* Sum of squared distances from pos to every plane in the quadric */
+double quadricError(const Quadric* q, const float* pos)
+{
+	const double x = pos[X];
+	const double y = pos[Y];
+	const double z = pos[Z];
+
+	return q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z
+		+ 2.0 * q->ad * x
+		+ q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+		+ q->c2 * z * z + 2.0 * q->cd * z
+		+ q->d2;
+}
+
+int compareCollapses(const void* a, const void* b)
+{
+	const double costA = ((const EdgeCollapse*)a)->cost;
+	const double costB = ((const EdgeCollapse*)b)->cost;
+
+	return (costA > costB) - (costA < costB);
+}
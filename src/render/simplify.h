@@ -0,0 +1,72 @@
+#ifndef RENDER_SIMPLIFY_H
+#define RENDER_SIMPLIFY_H 1
+
+#include <stdint.h>
+#include "scene.h"
+
+/* Each LOD aims for this fraction of the triangles of the one before. */
+#define SIMPLIFY_LOD_RATIO 0.5f
+
+/* A LOD that couldn't get below this fraction of the last one isn't worth
+ * the index memory, and the chain ends there. */
+#define SIMPLIFY_MIN_REDUCTION 0.8f
+
+/* Collapse passes per LOD before giving up on reaching the target */
+#define SIMPLIFY_MAX_PASSES 32
+
+/* A plane's worth of quadric error metric (Garland and Heckbert), the upper
+ * triangle of a symmetric 4x4 matrix. Doubles, since the sums of squares
+ * get big. */
+typedef struct
+{
+	double a2, ab, ac, ad;
+	double b2, bc, bd;
+	double c2, cd;
+	double d2;
+} Quadric;
+
+/* Moving one vertex onto another */
+typedef struct
+{
+	uint32_t from;
+	uint32_t to;
+	double cost;
+} EdgeCollapse;
+
+int buildLods(
+	uint32_t** indices,
+	unsigned int* indexCount,
+	Submesh** submeshes,
+	unsigned int submeshCount,
+	MeshLod* lods,
+	unsigned int* lodCount,
+	const Vertex* vertices,
+	unsigned int vertexCount
+);
+
+int simplifyMesh(
+	uint32_t* out,
+	unsigned int* outCount,
+	float* error,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices,
+	unsigned int indexCount,
+	unsigned int targetIndexCount
+);
+
+int lockSimplifyVertices(
+	char* locked,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const uint32_t* indices,
+	unsigned int indexCount
+);
+
+Vec3 faceNormal(const float* a, const float* b, const float* c);
+void quadricAddPlane(Quadric* q, double a, double b, double c, double d);
+void quadricAdd(Quadric* q, const Quadric* other);
+double quadricError(const Quadric* q, const float* pos);
+int compareCollapses(const void* a, const void* b);
+
+#endif
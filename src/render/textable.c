@@ -0,0 +1,220 @@
+#include "textable.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int createTextureTable(
+	TextureTable* table,
+	VkDevice device,
+	SamplerCache* samplers
+)
+{
+	table->freeCount = 0;
+	table->freeLimit = 1;
+	table->freeSlots = (uint32_t*)malloc(sizeof(uint32_t));
+	table->nextSlot = 0;
+
+	if (!table->freeSlots) {
+		perror("Failed to allocate texture table");
+		return -1;
+	}
+
+	/* One sampler for the whole table. An unclamped max LOD works for
+	 * textures with any number of mip levels. */
+	if (getSampler(samplers, device, defSamplerKey, &table->sampler)) {
+		return -1;
+	}
+
+	/* Descriptor Set Layout */
+
+	VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
+	samplerLayoutBinding.binding = 0;
+	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	samplerLayoutBinding.descriptorCount = 1;
+	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutBinding imageLayoutBinding = {};
+	imageLayoutBinding.binding = 1;
+	imageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	imageLayoutBinding.descriptorCount = TEX_TABLE_SIZE;
+	imageLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutBinding descSetLayoutBindings[] = {
+		samplerLayoutBinding,
+		imageLayoutBinding
+	};
+
+	/* Unused slots are left empty and slots can change between frames
+	 * without waiting on the GPU. */
+	VkDescriptorBindingFlags bindingFlags[] = {
+		0,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+	};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+	bindingFlagsInfo.sType =
+		VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = 2;
+	bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags =
+		VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = descSetLayoutBindings;
+
+	if (vkCreateDescriptorSetLayout(
+		device,
+		&layoutInfo,
+		0,
+		&table->layout
+	) != VK_SUCCESS) {
+		printf("Failed to create texture table layout\n");
+		return -1;
+	}
+
+	/* Descriptor Pool */
+
+	VkDescriptorPoolSize poolSizes[2] = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	poolSizes[0].descriptorCount = 1;
+
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSizes[1].descriptorCount = TEX_TABLE_SIZE;
+
+	VkDescriptorPoolCreateInfo descPoolInfo = {};
+	descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	descPoolInfo.poolSizeCount = 2;
+	descPoolInfo.pPoolSizes = poolSizes;
+	descPoolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(
+		device,
+		&descPoolInfo,
+		0,
+		&table->pool
+	) != VK_SUCCESS) {
+		printf("Failed to create texture table pool.\n");
+		return -1;
+	}
+
+	/* Descriptor Set */
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = table->pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &table->layout;
+
+	if (vkAllocateDescriptorSets(
+		device,
+		&allocInfo,
+		&table->set
+	) != VK_SUCCESS) {
+		printf("Failed to allocate texture table.\n");
+		return -1;
+	}
+
+	VkDescriptorImageInfo samplerInfo = {};
+	samplerInfo.sampler = table->sampler;
+
+	VkWriteDescriptorSet samplerWrite = {};
+	samplerWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	samplerWrite.dstSet = table->set;
+	samplerWrite.dstBinding = 0;
+	samplerWrite.dstArrayElement = 0;
+	samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	samplerWrite.descriptorCount = 1;
+	samplerWrite.pImageInfo = &samplerInfo;
+
+	vkUpdateDescriptorSets(device, 1, &samplerWrite, 0, 0);
+
+	return 0;
+}
+
+void destroyTextureTable(VkDevice device, TextureTable table)
+{
+	vkDestroyDescriptorPool(device, table.pool, 0);
+	vkDestroyDescriptorSetLayout(device, table.layout, 0);
+
+	free(table.freeSlots);
+}
+
+int texTableAdd(
+	TextureTable* table,
+	VkDevice device,
+	VkImageView view,
+	uint32_t* slot
+)
+{
+	if (table->freeCount) {
+		*slot = table->freeSlots[--table->freeCount];
+	} else if (table->nextSlot < TEX_TABLE_SIZE) {
+		*slot = table->nextSlot;
+		++table->nextSlot;
+	} else {
+		printf("Texture table is full.\n");
+		return -1;
+	}
+
+	texTableWrite(table, device, *slot, view);
+
+	return 0;
+}
+
+int texTableRemove(TextureTable* table, uint32_t slot)
+{
+	/* The null texture never leaves. */
+	if (slot == TEX_TABLE_NUL_SLOT) return 0;
+
+	if (table->freeCount >= table->freeLimit) {
+		table->freeLimit *= 2;
+
+		void* newFreeSlots = realloc(
+			table->freeSlots,
+			sizeof(uint32_t) * table->freeLimit
+		);
+
+		if (!newFreeSlots) {
+			perror("Failed to reallocate texture table slots");
+			return -1;
+		}
+
+		table->freeSlots = (uint32_t*)newFreeSlots;
+	}
+
+	/* The old descriptor is left in place. Nothing points at the slot any
+	 * more, and partially bound arrays don't mind stale entries. */
+	table->freeSlots[table->freeCount] = slot;
+	++table->freeCount;
+
+	return 0;
+}
+
+/* Points a slot at a different image, for textures that get reloaded */
+void texTableWrite(
+	TextureTable* table,
+	VkDevice device,
+	uint32_t slot,
+	VkImageView view
+)
+{
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = view;
+
+	VkWriteDescriptorSet writeDesc = {};
+	writeDesc.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writeDesc.dstSet = table->set;
+	writeDesc.dstBinding = 1;
+	writeDesc.dstArrayElement = slot;
+	writeDesc.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	writeDesc.descriptorCount = 1;
+	writeDesc.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(device, 1, &writeDesc, 0, 0);
+}
@@ -0,0 +1,63 @@
+#ifndef RENDER_TEXTABLE_H
+#define RENDER_TEXTABLE_H 1
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "sampler.h"
+
+/* Devices with descriptor indexing are guaranteed far more than this. */
+#define TEX_TABLE_SIZE 4096
+
+/* Slot 0 always holds the null texture. A mesh with no texture bound points
+ * there. */
+#define TEX_TABLE_NUL_SLOT 0
+
+/* The bindless texture table. Every texture on the server sits in one big
+ * sampled image array that all meshes share, so binding a texture to a mesh
+ * is just a matter of handing the mesh an index into it.
+ *
+ * The array gets bound once per frame as set 1 of the geometry pipeline.
+ * Slots can be written while frames are in flight since the ones being
+ * written are never the ones being drawn with. */
+typedef struct
+{
+	VkDescriptorSetLayout layout;
+	VkDescriptorPool pool;
+	VkDescriptorSet set;
+	/* Belongs to the sampler cache */
+	VkSampler sampler;
+
+	/* Slots handed back by deleted textures */
+	uint32_t* freeSlots;
+	unsigned int freeCount;
+	unsigned int freeLimit;
+
+	/* Slots past this one have never been used. */
+	uint32_t nextSlot;
+} TextureTable;
+
+int createTextureTable(
+	TextureTable* table,
+	VkDevice device,
+	SamplerCache* samplers
+);
+
+void destroyTextureTable(VkDevice device, TextureTable table);
+
+int texTableAdd(
+	TextureTable* table,
+	VkDevice device,
+	VkImageView view,
+	uint32_t* slot
+);
+
+int texTableRemove(TextureTable* table, uint32_t slot);
+
+void texTableWrite(
+	TextureTable* table,
+	VkDevice device,
+	uint32_t slot,
+	VkImageView view
+);
+
+#endif
@@ -0,0 +1,30 @@
+#include "vertex.h"
+#include "common/maths.h"
+#include <math.h>
+
+void packVertex(
+	PackedVertex* packed,
+	const Vertex* vertex,
+	const float* quantOffset,
+	const float* quantScale
+)
+{
+	for (int i = 0; i < 3; i++) {
+		/* Flat boxes have nothing to scale by. */
+		const float unit = quantScale[i] > 0.0f
+			? (vertex->pos[i] - quantOffset[i]) / quantScale[i]
+			: 0.0f;
+
+		packed->pos[i] = (uint16_t)roundf(
+			fmaxf(0.0f, fminf(1.0f, unit)) * 65535.0f
+		);
+	}
+
+	packed->pos[W] = 0;
+
+	Vec3 normal = {vertex->normal[X], vertex->normal[Y], vertex->normal[Z]};
+	octEncode(normal, packed->normal);
+
+	packed->texCoord[X] = floatToHalf(vertex->texCoord[X]);
+	packed->texCoord[Y] = floatToHalf(vertex->texCoord[Y]);
+}
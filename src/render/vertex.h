@@ -0,0 +1,32 @@
+#ifndef RENDER_VERTEX_H
+#define RENDER_VERTEX_H 1
+
+#include <stdint.h>
+
+typedef struct
+{
+	float pos[3];
+	float normal[3];
+	float texCoord[2];
+} Vertex;
+
+/* Half the size of a Vertex. Positions are unorm against the mesh's bounding
+ * box, normals are octahedral snorm and texture coordinates are halves.
+ * main.vert's packed twin unpacks them. */
+typedef struct
+{
+	/* The fourth one is padding, since 3 component 16-bit formats are
+	 * barely supported as vertex input. */
+	uint16_t pos[4];
+	int16_t normal[2];
+	uint16_t texCoord[2];
+} PackedVertex;
+
+void packVertex(
+	PackedVertex* packed,
+	const Vertex* vertex,
+	const float* quantOffset,
+	const float* quantScale
+);
+
+#endif
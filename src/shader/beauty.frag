@@ -1,21 +1,239 @@
 #version 450
 
-layout(binding = 1) uniform GlobalUniformBufferObject
+/* The same numbers as cluster.h */
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define CLUSTER_MAX_LIGHTS 256
+
+/* So the sides facing away from every light aren't black */
+#define AMBIENT 0.05
+
+/* The same numbers as shadow.h */
+#define SHADOW_FACE_SIZE 256
+#define SHADOW_ATLAS_COLUMNS 4
+#define SHADOW_ATLAS_ROWS 4
+#define SHADOW_TILE_WIDTH (SHADOW_FACE_SIZE * 3)
+#define SHADOW_TILE_HEIGHT (SHADOW_FACE_SIZE * 2)
+#define SHADOW_ATLAS_SIZE vec2( \
+	SHADOW_TILE_WIDTH * SHADOW_ATLAS_COLUMNS, \
+	SHADOW_TILE_HEIGHT * SHADOW_ATLAS_ROWS \
+)
+#define SHADOW_NEAR 0.05
+
+/* How much closer to the light a surface is taken to be than it is, so it
+ * doesn't shadow itself */
+#define SHADOW_BIAS 0.02
+
+/* The G-buffer, straight out of the subpass before */
+layout(input_attachment_index = 0, binding = 0)
+	uniform subpassInput colourInput;
+layout(input_attachment_index = 1, binding = 1)
+	uniform subpassInput normalInput;
+layout(input_attachment_index = 2, binding = 2)
+	uniform subpassInput depthInput;
+
+layout(binding = 3) uniform GlobalUniformBufferObject
 {
 	mat4 view;
 	mat4 proj;
 } globalUbo;
 
-layout(binding = 0) uniform sampler2D colourSampler;
-layout(binding = 1) uniform sampler2D normalSampler;
-layout(binding = 2) uniform sampler2D positionSampler;
+/* This frame's lights and which of them reach each cluster, from
+ * cluster.comp */
+struct Light
+{
+	vec3 position;
+	float range;
+	vec3 colour;
+	float intensity;
+	int shadowTile;
+};
+
+layout(std430, binding = 4) readonly buffer Lights
+{
+	uint count;
+	Light lights[];
+} lightBuf;
+
+layout(std430, binding = 5) readonly buffer Clusters
+{
+	uint counts[CLUSTER_COUNT];
+	uint indices[];
+} clusters;
+
+/* Every shadowed light's cube of depths, from recordShadows() */
+layout(binding = 6) uniform sampler2D shadowAtlas;
+
+/* Right and up for each cube face, the same as shadowFaceAxes in shadow.c.
+ * Forward is just the axis the face is on. */
+const vec3 faceRight[6] = vec3[](
+	vec3(0.0, 0.0, 1.0),
+	vec3(0.0, 0.0, 1.0),
+	vec3(1.0, 0.0, 0.0),
+	vec3(1.0, 0.0, 0.0),
+	vec3(1.0, 0.0, 0.0),
+	vec3(1.0, 0.0, 0.0)
+);
+const vec3 faceUp[6] = vec3[](
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 0.0, 1.0),
+	vec3(0.0, 0.0, 1.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 1.0, 0.0)
+);
 
 layout(location = 0) in vec2 inUV;
 
 layout(location = 0) out vec4 outColour;
 
-void main()
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+	/* Unfold the lower half */
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+
+	return normalize(n);
+}
+
+/* The view space position the geometry pass used to write out. The
+ * projection only scales x and y and puts z through z * a + b over -z, so
+ * undoing it needs four of its entries rather than a whole inverse. */
+vec3 viewPosition(vec2 uv, float depth)
+{
+	mat4 proj = globalUbo.proj;
+	vec2 ndc = uv * 2.0 - 1.0;
+
+	float z = -proj[3][2] / (depth + proj[2][2]);
+
+	return vec3(
+		ndc.x * -z / proj[0][0],
+		ndc.y * -z / proj[1][1],
+		z
+	);
+}
+
+/* The cluster a view space position is in, the same way cluster.comp
+ * slices the frustum. clusterAt() in cluster.c is the same on the CPU. */
+uint clusterIndex(vec2 uv, float depth)
+{
+	float near = globalUbo.proj[3][2] / globalUbo.proj[2][2];
+	float far = globalUbo.proj[3][2] / (1.0 + globalUbo.proj[2][2]);
+
+	uvec2 cell = min(
+		uvec2(uv * vec2(CLUSTER_X, CLUSTER_Y)),
+		uvec2(CLUSTER_X - 1, CLUSTER_Y - 1)
+	);
+	uint slice = uint(clamp(
+		log(depth / near) / log(far / near) * CLUSTER_Z,
+		0.0,
+		CLUSTER_Z - 1
+	));
+
+	return (slice * CLUSTER_Y + cell.y) * CLUSTER_X + cell.x;
+}
+
+/* How much of the light gets to a view space position, from 0 to 1. The
+ * faces were drawn in world space, so the direction gets rotated back there
+ * first. Four texels are compared and averaged, since the sampler can't do
+ * the comparisons itself. */
+float shadow(Light light, vec3 position)
 {
-	outColour = texture(colourSampler, inUV);
+	if (light.shadowTile < 0) return 1.0;
+
+	vec3 dir = transpose(mat3(globalUbo.view)) * (position - light.position);
+	vec3 absDir = abs(dir);
+
+	int axis = absDir.x >= absDir.y && absDir.x >= absDir.z ? 0
+		: absDir.y >= absDir.z ? 1 : 2;
+	int face = axis * 2 + (dir[axis] < 0.0 ? 1 : 0);
+	float dist = absDir[axis];
+
+	/* Kept a texel in from the edges so the gather stays on the face */
+	vec2 faceUV = vec2(dot(faceRight[face], dir), dot(faceUp[face], dir))
+		/ dist * 0.5 + 0.5;
+	faceUV = clamp(
+		faceUV,
+		1.0 / SHADOW_FACE_SIZE,
+		1.0 - 1.0 / SHADOW_FACE_SIZE
+	);
+
+	vec2 corner = vec2(
+		light.shadowTile % SHADOW_ATLAS_COLUMNS * SHADOW_TILE_WIDTH
+			+ face % 3 * SHADOW_FACE_SIZE,
+		light.shadowTile / SHADOW_ATLAS_COLUMNS * SHADOW_TILE_HEIGHT
+			+ face / 3 * SHADOW_FACE_SIZE
+	);
+	vec2 uv = (corner + faceUV * SHADOW_FACE_SIZE) / SHADOW_ATLAS_SIZE;
+
+	/* The depth the face's projection would have written here */
+	float far = max(light.range, SHADOW_NEAR * 2.0);
+	float biased = max(dist * (1.0 - SHADOW_BIAS), SHADOW_NEAR);
+	float ref = far / (far - SHADOW_NEAR) * (1.0 - SHADOW_NEAR / biased);
+
+	vec4 depths = textureGather(shadowAtlas, uv);
+
+	return dot(step(vec4(ref), depths), vec4(0.25));
+}
+
+/* Diffuse only. Lights fall off with 1 / (1 + d^2) and get faded out to
+ * nothing at their range, so the cut off doesn't show. */
+vec3 pointLight(Light light, vec3 position, vec3 normal)
+{
+	vec3 toLight = light.position - position;
+	float distSq = dot(toLight, toLight);
+	float rangeSq = light.range * light.range;
+
+	if (distSq >= rangeSq) return vec3(0.0);
+
+	float fade = 1.0 - distSq / rangeSq;
+	float lambert = max(dot(normal, toLight * inversesqrt(distSq)), 0.0);
+
+	return light.colour * lambert * fade * fade / (1.0 + distSq)
+		* shadow(light, position);
 }
 
+void main()
+{
+	float depth = subpassLoad(depthInput).r;
+
+	/* Nothing was drawn here. */
+	if (depth >= 1.0) {
+		outColour = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	/* Blending onto black, which is what used to happen */
+	vec4 colour = subpassLoad(colourInput);
+	vec3 albedo = colour.rgb * colour.a;
+
+	/* Scenes without lights look the way they did before there were any */
+	if (lightBuf.count == 0) {
+		outColour = vec4(albedo, 1.0);
+		return;
+	}
+
+	vec3 normal = octDecode(subpassLoad(normalInput).rg);
+	vec3 position = viewPosition(inUV, depth);
+
+	uint cluster = clusterIndex(inUV, -position.z);
+	uint first = cluster * CLUSTER_MAX_LIGHTS;
+	uint count = clusters.counts[cluster];
+
+	vec3 light = vec3(AMBIENT);
+
+	for (uint i = 0; i < count; i++) {
+		light += pointLight(
+			lightBuf.lights[clusters.indices[first + i]],
+			position,
+			normal
+		);
+	}
+
+	outColour = vec4(albedo * light, 1.0);
+}
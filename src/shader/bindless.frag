@@ -0,0 +1,51 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(binding = 0) uniform GlobalUniformBufferObject
+{
+	mat4 view;
+	mat4 proj;
+} globalUbo;
+
+/* The texture table. Every texture on the server lives in here. */
+layout(set = 1, binding = 0) uniform sampler texTableSampler;
+layout(set = 1, binding = 1) uniform texture2D texTable[];
+
+/* The same for the whole draw, so the index doesn't need nonuniformEXT. */
+layout(push_constant) uniform MeshConstants
+{
+	uint texIndex;
+} mesh;
+
+layout(location = 0) in vec3 fragColour;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec3 fragPosition;
+
+layout(location = 0) out vec4 outColour;
+layout(location = 1) out vec2 outNormal;
+
+/* Octahedral encoding, the same as octEncode() on the CPU */
+vec2 octEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+
+	/* The lower half folds over the diagonals. */
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(
+			n.x >= 0.0 ? 1.0 : -1.0,
+			n.y >= 0.0 ? 1.0 : -1.0
+		);
+	}
+
+	return n.xy;
+}
+
+void main()
+{
+	outColour = texture(
+		sampler2D(texTable[mesh.texIndex], texTableSampler),
+		fragTexCoord
+	);
+	outNormal = octEncode(normalize(fragNormal));
+}
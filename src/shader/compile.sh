@@ -4,7 +4,17 @@
 # is ready.
 
 glslc main.vert -o vert.spv
+glslc packed.vert -o packedvert.spv
 glslc main.frag -o frag.spv
+glslc --target-env=vulkan1.2 bindless.frag -o bindlessfrag.spv
+glslc multidraw.vert -o multidrawvert.spv
+glslc multidrawpacked.vert -o multidrawpackedvert.spv
+glslc --target-env=vulkan1.2 multidraw.frag -o multidrawfrag.spv
 glslc beauty.vert -o beautyvert.spv
 glslc beauty.frag -o beautyfrag.spv
+glslc shadow.vert -o shadowvert.spv
+glslc cull.comp -o cull.spv
+glslc instcull.comp -o instcull.spv
+glslc cluster.comp -o cluster.spv
 
+glslc hiz.comp -o hiz.spv
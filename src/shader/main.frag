@@ -14,14 +14,28 @@ layout(location = 2) in vec3 fragNormal;
 layout(location = 3) in vec3 fragPosition;
 
 layout(location = 0) out vec4 outColour;
-layout(location = 1) out vec4 outNormal;
-layout(location = 2) out vec4 outPosition;
+layout(location = 1) out vec2 outNormal;
+
+/* Octahedral encoding, the same as octEncode() on the CPU */
+vec2 octEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+
+	/* The lower half folds over the diagonals. */
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(
+			n.x >= 0.0 ? 1.0 : -1.0,
+			n.y >= 0.0 ? 1.0 : -1.0
+		);
+	}
+
+	return n.xy;
+}
 
 void main()
 {
 	outColour = texture(texSampler, fragTexCoord);
-	outNormal = vec4(normalize(fragNormal * 0.5 + 0.5), 1.0);
-	outPosition = vec4(fragPosition, 1.0);
+	outNormal = octEncode(normalize(fragNormal));
 }
 
 
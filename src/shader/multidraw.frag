@@ -0,0 +1,45 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+/* bindless.frag for the multi-draw pipeline. The texture index comes from
+ * the mesh's object instead of a push constant. */
+
+/* The texture table. Every texture on the server lives in here. */
+layout(set = 1, binding = 0) uniform sampler texTableSampler;
+layout(set = 1, binding = 1) uniform texture2D texTable[];
+
+layout(location = 0) in vec3 fragColour;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec3 fragPosition;
+layout(location = 4) flat in uint fragTexIndex;
+
+layout(location = 0) out vec4 outColour;
+layout(location = 1) out vec2 outNormal;
+
+/* Octahedral encoding, the same as octEncode() on the CPU */
+vec2 octEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+
+	/* The lower half folds over the diagonals. */
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(
+			n.x >= 0.0 ? 1.0 : -1.0,
+			n.y >= 0.0 ? 1.0 : -1.0
+		);
+	}
+
+	return n.xy;
+}
+
+void main()
+{
+	/* Draws in one multi-draw can land in the same subgroup, so the index
+	 * isn't uniform any more. */
+	outColour = texture(
+		sampler2D(texTable[nonuniformEXT(fragTexIndex)], texTableSampler),
+		fragTexCoord
+	);
+	outNormal = octEncode(normalize(fragNormal));
+}
@@ -0,0 +1,54 @@
+#version 450
+
+/* main.vert for the multi-draw pipeline. Every draw is one instance starting
+ * at its mesh's object, so gl_InstanceIndex finds it. See drawlist.h. */
+
+layout(binding = 0) uniform GlobalUniformBufferObject
+{
+	mat4 view;
+	mat4 proj;
+} globalUbo;
+
+/* ObjectData in drawlist.h */
+struct Object
+{
+	mat4 model;
+	vec4 quantOffset;
+	vec4 quantScale;
+	uint texIndex;
+	uint padding[3];
+	vec4 sphere;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer
+{
+	Object objects[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColour;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec3 fragPosition;
+layout(location = 4) flat out uint fragTexIndex;
+
+void main()
+{
+	mat4 model = objects[gl_InstanceIndex].model;
+
+	gl_Position = globalUbo.proj
+		* globalUbo.view
+		* model
+		* vec4(inPosition, 1.0);
+
+	fragTexCoord = inTexCoord;
+	fragTexIndex = objects[gl_InstanceIndex].texIndex;
+
+	fragPosition = vec3(globalUbo.view * model * vec4(inPosition, 1.0));
+
+	mat3 normalMat = transpose(inverse(mat3(globalUbo.view * model)));
+	fragNormal = normalMat * inNormal;
+}
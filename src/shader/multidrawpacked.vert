@@ -0,0 +1,70 @@
+#version 450
+
+/* multidraw.vert for PackedVertex meshes, see packed.vert */
+
+layout(binding = 0) uniform GlobalUniformBufferObject
+{
+	mat4 view;
+	mat4 proj;
+} globalUbo;
+
+/* ObjectData in drawlist.h */
+struct Object
+{
+	mat4 model;
+	vec4 quantOffset;
+	vec4 quantScale;
+	uint texIndex;
+	uint padding[3];
+	vec4 sphere;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer
+{
+	Object objects[];
+};
+
+/* unorm, snorm and half, unpacked by the vertex fetch */
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColour;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec3 fragPosition;
+layout(location = 4) flat out uint fragTexIndex;
+
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+	/* Unfold the lower half */
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+
+	return normalize(n);
+}
+
+void main()
+{
+	Object object = objects[gl_InstanceIndex];
+
+	vec3 position = object.quantOffset.xyz
+		+ inPosition.xyz * object.quantScale.xyz;
+	vec3 normal = octDecode(inNormal);
+
+	gl_Position = globalUbo.proj
+		* globalUbo.view
+		* object.model
+		* vec4(position, 1.0);
+
+	fragTexCoord = inTexCoord;
+	fragTexIndex = object.texIndex;
+
+	fragPosition = vec3(globalUbo.view * object.model * vec4(position, 1.0));
+
+	mat3 normalMat = transpose(inverse(mat3(globalUbo.view * object.model)));
+	fragNormal = normalMat * normal;
+}
@@ -0,0 +1,57 @@
+#version 450
+
+/* main.vert for PackedVertex meshes */
+
+layout(binding = 0) uniform GlobalUniformBufferObject
+{
+	mat4 view;
+	mat4 proj;
+} globalUbo;
+
+layout(binding = 2) uniform UniformBufferObject
+{
+	mat4 model;
+	vec4 quantOffset;
+	vec4 quantScale;
+} ubo;
+
+/* unorm, snorm and half, unpacked by the vertex fetch */
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColour;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec3 fragPosition;
+
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+	/* Unfold the lower half */
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 position = ubo.quantOffset.xyz + inPosition.xyz * ubo.quantScale.xyz;
+	vec3 normal = octDecode(inNormal);
+
+	gl_Position = globalUbo.proj
+		* globalUbo.view
+		* ubo.model
+		* vec4(position, 1.0);
+
+	fragTexCoord = inTexCoord;
+
+	fragPosition = vec3(globalUbo.view * ubo.model * vec4(position, 1.0));
+
+	mat3 normalMat = transpose(inverse(mat3(globalUbo.view * ubo.model)));
+	fragNormal = normalMat * normal;
+
+}
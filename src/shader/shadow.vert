@@ -0,0 +1,21 @@
+#version 450
+
+/* Depth only, into one face of a light's tile. See drawShadowCasters() in
+ * shadow.c. Packed positions are already scaled back out by the transform. */
+
+layout(push_constant) uniform ShadowConstants
+{
+	mat4 transform;
+} constants;
+
+layout(location = 0) in vec3 inPosition;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+
+void main()
+{
+	gl_Position = constants.transform * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,243 @@
+#include "test.h"
+#include "../common/arena.h"
+#include "../common/dense.h"
+#include "../input/queuecmd.h"
+#include "../render/scene.h"
+#include <stdlib.h>
+
+/* Counts heap allocations in the steady state of the render loop. The test
+ * is linked with malloc, calloc and realloc wrapped (see Makefile.am), so
+ * every call from the arena, dense array, ID map and command queue code goes
+ * through the counters below. It plays out what a scene does each frame
+ * with the same calls the server makes: meshes coming and going, texture
+ * binds queued and run down, and the per frame arena filled and reset. */
+
+#define ALLOC_TEST_MESHES 500
+#define ALLOC_TEST_TEXTURES 50
+#define ALLOC_TEST_FRAMES_IN_FLIGHT 2
+#define ALLOC_TEST_WARMUP_FRAMES 100
+#define ALLOC_TEST_FRAMES 1000
+
+/* Each frame this many meshes are deleted and made again, and as many binds
+ * queued */
+#define ALLOC_TEST_CHURN 20
+
+int testFailures = 0;
+unsigned long heapAllocs = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+	++heapAllocs;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	++heapAllocs;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	++heapAllocs;
+	return __real_realloc(ptr, size);
+}
+
+typedef struct
+{
+	Arena arena;
+	FreeList bindingList;
+	MeshArray meshes;
+	TextureArray textures;
+	CommandQueue uniformCommands;
+	Arena frameArena;
+	int nextMeshId;
+} AllocTestScene;
+
+int createTestScene(AllocTestScene* scene)
+{
+	createArena(&scene->arena, 0);
+	createFreeList(&scene->bindingList, sizeof(TextureBinding));
+	createArena(&scene->frameArena, ARENA_DEFAULT_BLOCK_SIZE);
+	scene->nextMeshId = 0;
+
+	if (
+		createDenseArray(&scene->meshes, sizeof(Mesh), &scene->arena)
+		|| createDenseArray(&scene->textures, sizeof(Texture), &scene->arena)
+		|| createCommandQueue(&scene->uniformCommands)
+	) {
+		return -1;
+	}
+
+	for (int i = 0; i < ALLOC_TEST_TEXTURES; i++) {
+		Texture tex = {};
+		CHECK(denseAdd(&scene->textures, i, &tex) == i);
+	}
+
+	return 0;
+}
+
+void destroyTestScene(AllocTestScene scene)
+{
+	destroyDenseArray(scene.meshes);
+	destroyDenseArray(scene.textures);
+	destroyCommandQueue(scene.uniformCommands);
+	destroyArena(scene.frameArena);
+	destroyArena(scene.arena);
+}
+
+/* Mirrors cmdMeshCreate's part in it */
+void addMesh(AllocTestScene* scene)
+{
+	const int id = scene->nextMeshId++;
+	Mesh mesh = {};
+	mesh.texId = id % ALLOC_TEST_TEXTURES;
+
+	CHECK(denseAdd(&scene->meshes, id, &mesh) >= 0);
+
+	Texture* tex = &DENSE_AT(
+		Texture,
+		scene->textures,
+		denseFind(&scene->textures, mesh.texId)
+	);
+	TextureBinding* binding = (TextureBinding*)
+		freeListAlloc(&scene->bindingList, &scene->arena);
+
+	CHECK(binding != 0);
+	if (!binding) return;
+
+	binding->meshId = id;
+	binding->pass = 0;
+	binding->next = tex->bindings;
+	tex->bindings = binding;
+}
+
+/* And cmdMeshDelete's */
+void removeMesh(AllocTestScene* scene, unsigned int idx)
+{
+	const int id = scene->meshes.ids[idx];
+	const int texId = DENSE_AT(Mesh, scene->meshes, idx).texId;
+	Texture* tex = &DENSE_AT(
+		Texture,
+		scene->textures,
+		denseFind(&scene->textures, texId)
+	);
+	TextureBinding** link = &tex->bindings;
+
+	while (*link) {
+		TextureBinding* binding = *link;
+
+		if (binding->meshId == id) {
+			*link = binding->next;
+			freeListFree(&scene->bindingList, binding);
+		} else {
+			link = &binding->next;
+		}
+	}
+
+	CHECK(!denseRemove(&scene->meshes, idx));
+}
+
+/* Queues binds the way cmdMeshBindTexture does, then runs the queue down
+ * the way execUniformCommands does. */
+void runCommands(AllocTestScene* scene)
+{
+	CommandQueue* queue = &scene->uniformCommands;
+
+	for (int i = 0; i < ALLOC_TEST_CHURN; i++) {
+		QueueCommand cmd = {};
+		cmd.opcode = QUEUE_CMD_MESH_BIND_TEXTURE;
+		cmd.repeats = ALLOC_TEST_FRAMES_IN_FLIGHT;
+		cmd.data = allocCommandData(queue);
+
+		CHECK(cmd.data != 0);
+		CHECK(!pushCommandToQueue(queue, cmd));
+	}
+
+	unsigned int keptCount = 0;
+
+	for (int i = 0; i < queue->commandCount; i++) {
+		QueueCommand cmd = queue->commands[i];
+
+		if (!cmd.repeats) {
+			freeCommandData(queue, cmd.data);
+			continue;
+		}
+
+		cmd.repeats--;
+		queue->commands[keptCount] = cmd;
+		++keptCount;
+	}
+
+	queue->commandCount = keptCount;
+}
+
+/* What renderScenes takes from the frame arena for culling and sorting */
+void useFrameArena(AllocTestScene* scene)
+{
+	arenaReset(&scene->frameArena);
+
+	const unsigned int meshCount = scene->meshes.count;
+
+	CHECK(arenaAlloc(&scene->frameArena, sizeof(float) * 4 * meshCount));
+	CHECK(arenaAlloc(&scene->frameArena, sizeof(uint64_t) * meshCount));
+	CHECK(arenaAlloc(&scene->frameArena, sizeof(uint32_t) * meshCount));
+	CHECK(arenaAlloc(&scene->frameArena, sizeof(char) * meshCount));
+}
+
+void runFrame(AllocTestScene* scene)
+{
+	for (int i = 0; i < ALLOC_TEST_CHURN; i++) {
+		removeMesh(scene, rand() % scene->meshes.count);
+	}
+
+	for (int i = 0; i < ALLOC_TEST_CHURN; i++) {
+		addMesh(scene);
+	}
+
+	runCommands(scene);
+	useFrameArena(scene);
+}
+
+int main(int argc, char* argv[])
+{
+	AllocTestScene scene;
+
+	CHECK(!createTestScene(&scene));
+
+	for (int i = 0; i < ALLOC_TEST_MESHES; i++) {
+		addMesh(&scene);
+	}
+
+	srand(3);
+
+	for (int i = 0; i < ALLOC_TEST_WARMUP_FRAMES; i++) {
+		runFrame(&scene);
+	}
+
+	/* Otherwise the wrapping isn't working and the test means nothing */
+	CHECK(heapAllocs > 0);
+
+	const unsigned long warmupAllocs = heapAllocs;
+
+	for (int i = 0; i < ALLOC_TEST_FRAMES; i++) {
+		runFrame(&scene);
+	}
+
+	printf(
+		"%lu heap allocations setting up, %lu over %d frames\n",
+		warmupAllocs,
+		heapAllocs - warmupAllocs,
+		ALLOC_TEST_FRAMES
+	);
+	CHECK(heapAllocs == warmupAllocs);
+	CHECK(scene.meshes.count == ALLOC_TEST_MESHES);
+
+	destroyTestScene(scene);
+
+	return testFailures != 0;
+}
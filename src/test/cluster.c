@@ -0,0 +1,241 @@
+#include "test.h"
+#include "../render/cluster.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CLUSTER_TEST_PIXELS 100000
+
+/* Lights are binned at each of these counts. The last is what the renderer
+ * is meant to handle. */
+#define CLUSTER_TEST_STEPS 3
+const uint32_t lightSteps[CLUSTER_TEST_STEPS] = {100, 1000, 10000};
+
+int testFailures = 0;
+
+float randomFloat(float min, float max)
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+/* Looking down at the bench lights' slab, set up the way
+ * cmdViewpointTransform does it. matPersp() makes a much wider view than its
+ * fov says, so a small one here is an ordinary view. */
+ViewpointUniforms makeViewpoint(void)
+{
+	const Vec3 eye = {0.0f, -30.0f, 10.0f};
+	const Vec3 centre = {0.0f, 0.0f, 0.0f};
+	const Vec3 up = {0.0f, 0.0f, 1.0f};
+
+	ViewpointUniforms ubo = {};
+	ubo.view = matLook(eye, centre, up);
+	ubo.proj = matPersp(0.2f, 16.0f / 9.0f, 0.1f, 10.0f);
+
+	return ubo;
+}
+
+/* A pixel's view space position, as beauty.frag's viewPosition() gets it */
+void pixelPosition(
+	float* pos,
+	float u,
+	float v,
+	float distance,
+	const ViewpointUniforms* pov
+)
+{
+	pos[X] = (u * 2.0f - 1.0f) * distance / pov->proj.x.x;
+	pos[Y] = (v * 2.0f - 1.0f) * distance / pov->proj.y.y;
+	pos[Z] = -distance;
+}
+
+float randomDistance(ClusterDepth depth)
+{
+	/* Even in log depth, like the slices */
+	return depth.near * powf(depth.far / depth.near, randomFloat(0.0f, 1.0f));
+}
+
+void testRange(void)
+{
+	const float intensities[] = {0.01f, 0.05f, 1.0f, 100.0f};
+
+	for (int i = 0; i < sizeof(intensities) / sizeof(intensities[0]); i++) {
+		const float range = pointLightRange(intensities[i]);
+		const float atRange = intensities[i] / (1.0f + range * range);
+
+		CHECK(fabsf(atRange - LIGHT_CUTOFF) < LIGHT_CUTOFF * 1e-4f);
+	}
+
+	/* Too dim to reach anywhere */
+	CHECK(pointLightRange(LIGHT_CUTOFF) == 0.0f);
+	CHECK(pointLightRange(LIGHT_CUTOFF * 0.5f) == 0.0f);
+}
+
+/* The slices have to run from the near plane to the far one without gaps,
+ * and every pixel has to land in a cluster whose box holds it. Otherwise
+ * it'd be shaded with some other cluster's lights. */
+void testClusters(void)
+{
+	const ViewpointUniforms pov = makeViewpoint();
+	const ClusterDepth depth = clusterDepth(&pov);
+
+	CHECK(depth.near > 0.0f);
+	CHECK(depth.far > depth.near);
+
+	float boxMin[3];
+	float boxMax[3];
+	float lastMin[3];
+	float lastMax[3];
+
+	clusterBox(boxMin, boxMax, 0, &pov);
+	CHECK(fabsf(boxMax[Z] + depth.near) < depth.near * 1e-5f);
+
+	clusterBox(boxMin, boxMax, CLUSTER_COUNT - 1, &pov);
+	CHECK(fabsf(boxMin[Z] + depth.far) < depth.far * 1e-5f);
+
+	for (int z = 1; z < CLUSTER_Z; z++) {
+		clusterBox(lastMin, lastMax, (z - 1) * CLUSTER_X * CLUSTER_Y, &pov);
+		clusterBox(boxMin, boxMax, z * CLUSTER_X * CLUSTER_Y, &pov);
+
+		CHECK(fabsf(lastMin[Z] - boxMax[Z]) < -lastMin[Z] * 1e-5f);
+		CHECK(boxMax[Z] - boxMin[Z] > lastMax[Z] - lastMin[Z]);
+	}
+
+	unsigned int outside = 0;
+
+	for (int i = 0; i < CLUSTER_TEST_PIXELS; i++) {
+		const float u = randomFloat(0.0f, 1.0f);
+		const float v = randomFloat(0.0f, 1.0f);
+		const float distance = randomDistance(depth);
+
+		float pos[3];
+		pixelPosition(pos, u, v, distance, &pov);
+
+		const uint32_t cluster = clusterAt(u, v, distance, &pov);
+		CHECK(cluster < CLUSTER_COUNT);
+		if (cluster >= CLUSTER_COUNT) continue;
+
+		clusterBox(boxMin, boxMax, cluster, &pov);
+
+		/* Give or take float rounding right on a cluster's edge */
+		for (int j = 0; j < 3; j++) {
+			const float slack = fmaxf(fabsf(pos[j]), 1.0f) * 1e-4f;
+
+			outside += pos[j] < boxMin[j] - slack
+				|| pos[j] > boxMax[j] + slack;
+		}
+	}
+
+	CHECK(!outside);
+}
+
+/* Bins the bench lights at each count. Every light reaching a pixel has to
+ * be in its cluster's list, and 10,000 of them can't overflow any cluster.
+ * How long binning takes on the CPU is printed along the way, though it's
+ * cluster.comp's time that matters, and that's in the SIGUSR1 stats. */
+void testBinning(void)
+{
+	const ViewpointUniforms pov = makeViewpoint();
+	const ClusterDepth depth = clusterDepth(&pov);
+	const uint32_t maxLights = lightSteps[CLUSTER_TEST_STEPS - 1];
+
+	GpuLight* lights = (GpuLight*)malloc(sizeof(GpuLight) * maxLights);
+	uint32_t* counts = (uint32_t*)malloc(sizeof(uint32_t) * CLUSTER_COUNT);
+	uint32_t* indices = (uint32_t*)malloc(
+		sizeof(uint32_t) * CLUSTER_COUNT * CLUSTER_MAX_LIGHTS
+	);
+
+	for (uint32_t i = 0; i < maxLights; i++) {
+		writeBenchLight(&lights[i], i, &pov);
+	}
+
+	for (int step = 0; step < CLUSTER_TEST_STEPS; step++) {
+		const uint32_t lightCount = lightSteps[step];
+
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		const uint32_t dropped =
+			binLightsOnCpu(counts, indices, lights, lightCount, &pov);
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		uint32_t busiest = 0;
+		uint64_t total = 0;
+		uint32_t lit = 0;
+
+		for (int i = 0; i < CLUSTER_COUNT; i++) {
+			if (counts[i] > busiest) busiest = counts[i];
+			total += counts[i];
+			lit += counts[i] > 0;
+		}
+
+		printf(
+			"%u lights: %u of %d clusters lit, %.1f lights in a lit "
+			"cluster on average, %u in the busiest, %u dropped. "
+			"%.2f ms on the CPU\n",
+			lightCount,
+			lit,
+			CLUSTER_COUNT,
+			lit ? (double)total / lit : 0.0,
+			busiest,
+			dropped,
+			(end.tv_sec - start.tv_sec) * 1e3
+				+ (end.tv_nsec - start.tv_nsec) / 1e6
+		);
+
+		CHECK(!dropped);
+
+		/* Check pixels against every light by brute force */
+		unsigned int missing = 0;
+		unsigned int reached = 0;
+
+		for (int i = 0; i < CLUSTER_TEST_PIXELS / 100; i++) {
+			const float u = randomFloat(0.0f, 1.0f);
+			const float v = randomFloat(0.0f, 1.0f);
+			const float distance = randomDistance(depth);
+
+			float pos[3];
+			pixelPosition(pos, u, v, distance, &pov);
+
+			const uint32_t cluster = clusterAt(u, v, distance, &pov);
+			const uint32_t* list = &indices[cluster * CLUSTER_MAX_LIGHTS];
+
+			for (uint32_t l = 0; l < lightCount; l++) {
+				const float dx = pos[X] - lights[l].position[X];
+				const float dy = pos[Y] - lights[l].position[Y];
+				const float dz = pos[Z] - lights[l].position[Z];
+				const float range = lights[l].range * 0.999f;
+
+				if (dx * dx + dy * dy + dz * dz > range * range) continue;
+
+				++reached;
+
+				/* Lists are in light order */
+				uint32_t j = 0;
+				while (j < counts[cluster] && list[j] < l) ++j;
+
+				missing += j == counts[cluster] || list[j] != l;
+			}
+		}
+
+		CHECK(!missing);
+
+		/* Some pixels have to have been lit for that to mean anything */
+		if (lightCount == maxLights) CHECK(reached > 0);
+	}
+
+	free(lights);
+	free(counts);
+	free(indices);
+}
+
+int main(int argc, char* argv[])
+{
+	srand(8);
+
+	testRange();
+	testClusters();
+	testBinning();
+
+	return testFailures != 0;
+}
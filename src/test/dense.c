@@ -0,0 +1,124 @@
+#include "test.h"
+#include "../common/dense.h"
+#include <stdlib.h>
+
+#define DENSE_TEST_COUNT 5000
+
+typedef struct
+{
+	int id;
+	float weight;
+	char name[20];
+} DenseTestItem;
+
+int testFailures = 0;
+
+DenseTestItem makeItem(int id)
+{
+	DenseTestItem item = {};
+	item.id = id;
+	item.weight = id * 0.5f;
+	snprintf(item.name, sizeof(item.name), "item %d", id);
+
+	return item;
+}
+
+/* Every item has to be where the map says, and still hold what it was added
+ * with. */
+void checkConsistent(const DenseArray* array, const char* present)
+{
+	unsigned int count = 0;
+
+	for (int id = 0; id < DENSE_TEST_COUNT; id++) {
+		const int idx = denseFind(array, id);
+
+		if (!present[id]) {
+			CHECK(idx == -1);
+			continue;
+		}
+
+		++count;
+		CHECK(idx >= 0 && idx < array->count);
+		if (idx < 0) continue;
+
+		const DenseTestItem* item = &DENSE_AT(DenseTestItem, *array, idx);
+		CHECK(item->id == id);
+		CHECK(item->weight == id * 0.5f);
+		CHECK(array->ids[idx] == id);
+	}
+
+	CHECK(count == array->count);
+	CHECK(array->count <= array->limit);
+}
+
+void testArray(Arena* arena)
+{
+	DenseArray array;
+	CHECK(!createDenseArray(&array, sizeof(DenseTestItem), arena));
+	CHECK(array.stride == sizeof(DenseTestItem));
+
+	char* present = (char*)calloc(DENSE_TEST_COUNT, 1);
+
+	/* Growing past the initial limit a few times over */
+	for (int id = 0; id < DENSE_TEST_COUNT; id++) {
+		const DenseTestItem item = makeItem(id);
+		CHECK(denseAdd(&array, id, &item) == id);
+		present[id] = 1;
+	}
+
+	checkConsistent(&array, present);
+	const unsigned int fullLimit = array.limit;
+
+	/* Removing from the front moves the last item into the hole every
+	 * time */
+	for (int i = 0; i < DENSE_TEST_COUNT - 10; i++) {
+		const int id = DENSE_AT(DenseTestItem, array, 0).id;
+		CHECK(!denseRemove(&array, 0));
+		present[id] = 0;
+	}
+
+	checkConsistent(&array, present);
+
+	/* Heap arrays shrink once they're mostly empty. Arena arrays never
+	 * give anything back. */
+	if (arena) {
+		CHECK(array.limit == fullLimit);
+	} else {
+		CHECK(array.limit < fullLimit);
+		CHECK(array.limit >= DENSE_INITIAL_LIMIT);
+	}
+
+	/* Then random churn */
+	srand(2);
+
+	for (int i = 0; i < DENSE_TEST_COUNT * 4; i++) {
+		const int id = rand() % DENSE_TEST_COUNT;
+		const int idx = denseFind(&array, id);
+
+		if (idx == -1) {
+			const DenseTestItem item = makeItem(id);
+			CHECK(denseAdd(&array, id, &item) == array.count - 1);
+			present[id] = 1;
+		} else {
+			CHECK(!denseRemove(&array, idx));
+			present[id] = 0;
+		}
+	}
+
+	checkConsistent(&array, present);
+
+	free(present);
+	destroyDenseArray(array);
+}
+
+int main(int argc, char* argv[])
+{
+	testArray(0);
+
+	Arena arena;
+	CHECK(!createArena(&arena, 0));
+	testArray(&arena);
+	destroyArena(arena);
+
+	return testFailures != 0;
+}
@@ -0,0 +1,470 @@
+#include "test.h"
+#include "../render/drawrecord.h"
+#include "../render/recorder.h"
+#include <stdlib.h>
+#include <time.h>
+
+#define DRAWRECORD_TEST_MESHES 10000
+#define DRAWRECORD_TEST_TEXTURES 64
+
+/* Each way of recording is timed over this many frames */
+#define DRAWRECORD_TEST_FRAMES 50
+
+/* What the multi-draw path is meant to save */
+#define DRAWRECORD_TEST_TARGET 10
+
+int testFailures = 0;
+
+/* Stands in for the driver, counting the commands it's given and the draws
+ * they add up to. Real drivers take a lot longer per command, which is why
+ * the counts matter as much as the times. */
+unsigned int recordedCommands = 0;
+unsigned int recordedDraws = 0;
+
+void vkCmdBindDescriptorSets(
+	VkCommandBuffer commandBuffer,
+	VkPipelineBindPoint pipelineBindPoint,
+	VkPipelineLayout layout,
+	uint32_t firstSet,
+	uint32_t descriptorSetCount,
+	const VkDescriptorSet* pDescriptorSets,
+	uint32_t dynamicOffsetCount,
+	const uint32_t* pDynamicOffsets
+)
+{
+	++recordedCommands;
+}
+
+void vkCmdPushConstants(
+	VkCommandBuffer commandBuffer,
+	VkPipelineLayout layout,
+	VkShaderStageFlags stageFlags,
+	uint32_t offset,
+	uint32_t size,
+	const void* pValues
+)
+{
+	++recordedCommands;
+}
+
+void vkCmdBindVertexBuffers(
+	VkCommandBuffer commandBuffer,
+	uint32_t firstBinding,
+	uint32_t bindingCount,
+	const VkBuffer* pBuffers,
+	const VkDeviceSize* pOffsets
+)
+{
+	++recordedCommands;
+}
+
+void vkCmdBindIndexBuffer(
+	VkCommandBuffer commandBuffer,
+	VkBuffer buffer,
+	VkDeviceSize offset,
+	VkIndexType indexType
+)
+{
+	++recordedCommands;
+}
+
+void vkCmdDrawIndexed(
+	VkCommandBuffer commandBuffer,
+	uint32_t indexCount,
+	uint32_t instanceCount,
+	uint32_t firstIndex,
+	int32_t vertexOffset,
+	uint32_t firstInstance
+)
+{
+	++recordedCommands;
+	++recordedDraws;
+}
+
+void vkCmdDrawIndexedIndirect(
+	VkCommandBuffer commandBuffer,
+	VkBuffer buffer,
+	VkDeviceSize offset,
+	uint32_t drawCount,
+	uint32_t stride
+)
+{
+	++recordedCommands;
+	recordedDraws += drawCount;
+}
+
+void vkCmdDrawIndexedIndirectCount(
+	VkCommandBuffer commandBuffer,
+	VkBuffer buffer,
+	VkDeviceSize offset,
+	VkBuffer countBuffer,
+	VkDeviceSize countBufferOffset,
+	uint32_t maxDrawCount,
+	uint32_t stride
+)
+{
+	++recordedCommands;
+	recordedDraws += maxDrawCount;
+}
+
+/* Fake handles, different for every mesh, the way they'd be after
+ * cmdNewMesh */
+#define FAKE_HANDLE(type, i) ((type)(uintptr_t)((i) + 1))
+
+/* One scene of single submesh meshes, every one of them in the geometry
+ * pool, with the draw list and sorted draws buildDrawList() and sortDraws()
+ * would leave for them */
+void makeScene(
+	SceneArray* scenes,
+	Submesh* submesh,
+	SortedDraws* draws,
+	DrawList* list
+)
+{
+	CHECK(!createDenseArray(scenes, sizeof(Scene), 0));
+
+	Scene scene = {};
+	CHECK(!createDenseArray(&scene.meshes, sizeof(Mesh), 0));
+
+	submesh->firstIndex = 0;
+	submesh->indexCount = 300;
+
+	draws->items = (DrawItem*)malloc(
+		sizeof(DrawItem) * DRAWRECORD_TEST_MESHES
+	);
+	draws->count = DRAWRECORD_TEST_MESHES;
+
+	for (int i = 0; i < DRAWRECORD_TEST_MESHES; i++) {
+		Mesh mesh = {};
+		mesh.submeshes = submesh;
+		mesh.submeshCount = 1;
+		mesh.pooled = 1;
+		mesh.drawObject = i;
+		mesh.firstDraw = i;
+		mesh.vertexBuffer = FAKE_HANDLE(VkBuffer, i);
+		mesh.indexBuffer = FAKE_HANDLE(VkBuffer, i);
+		mesh.indexType = VK_INDEX_TYPE_UINT16;
+
+		/* Sorted by texture first */
+		mesh.texIndex = i * DRAWRECORD_TEST_TEXTURES / DRAWRECORD_TEST_MESHES;
+
+		for (int j = 0; j < MAX_FRAMES_IN_FLIGHT; j++) {
+			mesh.descriptorSets[j] = FAKE_HANDLE(VkDescriptorSet, i);
+		}
+
+		CHECK(denseAdd(&scene.meshes, i, &mesh) == i);
+
+		draws->items[i].key = 0;
+		draws->items[i].scene = 0;
+		draws->items[i].mesh = i;
+	}
+
+	CHECK(denseAdd(scenes, 0, &scene) == 0);
+
+	*list = (DrawList){};
+	list->set = FAKE_HANDLE(VkDescriptorSet, DRAWRECORD_TEST_MESHES);
+	list->commandBuffer = FAKE_HANDLE(VkBuffer, DRAWRECORD_TEST_MESHES);
+	list->objectCount = DRAWRECORD_TEST_MESHES;
+	list->commandCount = DRAWRECORD_TEST_MESHES;
+	list->pooledCommandCount = DRAWRECORD_TEST_MESHES;
+}
+
+double elapsedMs(struct timespec start, struct timespec end)
+{
+	return (end.tv_sec - start.tv_sec) * 1e3
+		+ (end.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+/* Records the same 10k meshes both ways. Every mesh has to be drawn either
+ * way, and the draw list has to do it in at least a tenth of the commands.
+ * The times per frame are printed along the way, and the SIGUSR1 stats
+ * have the real thing. */
+void testRecording(void)
+{
+	SceneArray scenes;
+	Submesh submesh;
+	SortedDraws draws;
+	DrawList list;
+	makeScene(&scenes, &submesh, &draws, &list);
+
+	GeometryPool pool = {};
+	const DrawListChunk chunk = wholeDrawList(&list, &draws);
+	VkCommandBuffer cmdBuf = VK_NULL_HANDLE;
+	const VkDescriptorSet texTableSet =
+		FAKE_HANDLE(VkDescriptorSet, DRAWRECORD_TEST_MESHES + 1);
+
+	struct timespec start, end;
+	unsigned int failed = 0;
+
+	recordedCommands = 0;
+	recordedDraws = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < DRAWRECORD_TEST_FRAMES; i++) {
+		failed += iterateScenes(
+			&cmdBuf,
+			scenes,
+			&draws,
+			i % MAX_FRAMES_IN_FLIGHT,
+			VK_NULL_HANDLE,
+			texTableSet
+		) != 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	const unsigned int meshCommands =
+		recordedCommands / DRAWRECORD_TEST_FRAMES;
+	const double meshMs = elapsedMs(start, end) / DRAWRECORD_TEST_FRAMES;
+
+	CHECK(recordedDraws == DRAWRECORD_TEST_MESHES * DRAWRECORD_TEST_FRAMES);
+
+	recordedCommands = 0;
+	recordedDraws = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < DRAWRECORD_TEST_FRAMES; i++) {
+		failed += iterateDrawList(
+			&cmdBuf,
+			scenes,
+			&draws,
+			VK_NULL_HANDLE,
+			texTableSet,
+			&list,
+			&pool,
+			UINT32_MAX,
+			&chunk
+		) != 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	const unsigned int listCommands =
+		recordedCommands / DRAWRECORD_TEST_FRAMES;
+	const double listMs = elapsedMs(start, end) / DRAWRECORD_TEST_FRAMES;
+
+	CHECK(recordedDraws == DRAWRECORD_TEST_MESHES * DRAWRECORD_TEST_FRAMES);
+
+	printf(
+		"%d meshes: per mesh %u commands, %.3f ms. "
+		"Draw list %u commands, %.3f ms\n",
+		DRAWRECORD_TEST_MESHES,
+		meshCommands,
+		meshMs,
+		listCommands,
+		listMs
+	);
+
+	CHECK(!failed);
+	CHECK(listCommands * DRAWRECORD_TEST_TARGET <= meshCommands);
+
+	/* A device that takes fewer draws at once only costs a command for
+	 * each share. */
+	recordedCommands = 0;
+	recordedDraws = 0;
+
+	CHECK(!iterateDrawList(
+		&cmdBuf,
+		scenes,
+		&draws,
+		VK_NULL_HANDLE,
+		texTableSet,
+		&list,
+		&pool,
+		DRAWRECORD_TEST_MESHES / 4,
+		&chunk
+	));
+
+	CHECK(recordedDraws == DRAWRECORD_TEST_MESHES);
+	CHECK(recordedCommands == listCommands + 3);
+
+	destroyDenseArray(DENSE_AT(Scene, scenes, 0).meshes);
+	destroyDenseArray(scenes);
+	free(draws.items);
+}
+
+/* Meshes in the geometry pool share its buffers, so drawn one at a time
+ * they're only bound once. Each mesh still has its own descriptor sets,
+ * and each texture its push. */
+void testSharedBuffers(void)
+{
+	SceneArray scenes;
+	Submesh submesh;
+	SortedDraws draws;
+	DrawList list;
+	makeScene(&scenes, &submesh, &draws, &list);
+
+	Scene* scene = &DENSE_AT(Scene, scenes, 0);
+
+	for (int i = 0; i < DRAWRECORD_TEST_MESHES; i++) {
+		Mesh* mesh = &DENSE_AT(Mesh, scene->meshes, i);
+		mesh->vertexBuffer = FAKE_HANDLE(VkBuffer, DRAWRECORD_TEST_MESHES);
+		mesh->indexBuffer = FAKE_HANDLE(VkBuffer, DRAWRECORD_TEST_MESHES);
+	}
+
+	VkCommandBuffer cmdBuf = VK_NULL_HANDLE;
+	const VkDescriptorSet texTableSet =
+		FAKE_HANDLE(VkDescriptorSet, DRAWRECORD_TEST_MESHES + 1);
+
+	recordedCommands = 0;
+	recordedDraws = 0;
+
+	CHECK(!iterateScenes(
+		&cmdBuf,
+		scenes,
+		&draws,
+		0,
+		VK_NULL_HANDLE,
+		texTableSet
+	));
+
+	/* The texture table, a set and a draw for every mesh, a push for every
+	 * texture and the pool's two buffers */
+	const unsigned int expected = 1
+		+ DRAWRECORD_TEST_MESHES * 2
+		+ DRAWRECORD_TEST_TEXTURES
+		+ 2;
+
+	CHECK(recordedDraws == DRAWRECORD_TEST_MESHES);
+	CHECK(recordedCommands == expected);
+
+	destroyDenseArray(DENSE_AT(Scene, scenes, 0).meshes);
+	destroyDenseArray(scenes);
+	free(draws.items);
+}
+
+/* Every third mesh is drawn from meshlets and every third one after that
+ * has buffers of its own. Split between the recording threads, the chunks
+ * have to draw everything the whole list does, with the meshes drawn on
+ * their own shared out evenly and in order. */
+void testSplit(void)
+{
+	SceneArray scenes;
+	Submesh submesh;
+	SortedDraws draws;
+	DrawList list;
+	makeScene(&scenes, &submesh, &draws, &list);
+
+	Scene* scene = &DENSE_AT(Scene, scenes, 0);
+	unsigned int pooledCommands = 0;
+	unsigned int ownCount = 0;
+
+	for (int i = 0; i < DRAWRECORD_TEST_MESHES; i++) {
+		Mesh* mesh = &DENSE_AT(Mesh, scene->meshes, i);
+
+		if (i % 3 == 1) {
+			mesh->meshletCount = 8;
+			mesh->lods[0].meshletCount = 8;
+			mesh->drawBuffer = FAKE_HANDLE(VkBuffer, i);
+		} else if (i % 3 == 2) {
+			mesh->pooled = 0;
+			mesh->firstDraw = DRAWRECORD_TEST_MESHES + i;
+		} else {
+			mesh->firstDraw = pooledCommands;
+			++pooledCommands;
+		}
+
+		ownCount += i % 3 != 0;
+	}
+
+	list.pooledCommandCount = pooledCommands;
+
+	GeometryPool pool = {};
+	VkCommandBuffer cmdBuf = VK_NULL_HANDLE;
+	const DrawListChunk whole = wholeDrawList(&list, &draws);
+
+	recordedCommands = 0;
+	recordedDraws = 0;
+
+	CHECK(!iterateDrawList(
+		&cmdBuf,
+		scenes,
+		&draws,
+		VK_NULL_HANDLE,
+		VK_NULL_HANDLE,
+		&list,
+		&pool,
+		UINT32_MAX,
+		&whole
+	));
+
+	const unsigned int wholeDraws = recordedDraws;
+
+	for (unsigned int count = 1; count <= RECORDER_MAX_WORKERS; count++) {
+		DrawListChunk chunks[RECORDER_MAX_WORKERS];
+		splitDrawList(chunks, count, scenes, &draws, &list);
+
+		recordedDraws = 0;
+		unsigned int nextItem = 0;
+		unsigned int fewest = UINT32_MAX;
+		unsigned int most = 0;
+
+		for (int i = 0; i < count; i++) {
+			CHECK(chunks[i].firstItem == nextItem);
+			nextItem += chunks[i].itemCount;
+
+			/* The pooled commands only go in the first */
+			CHECK(!i || !chunks[i].commandCount);
+
+			CHECK(!iterateDrawList(
+				&cmdBuf,
+				scenes,
+				&draws,
+				VK_NULL_HANDLE,
+				VK_NULL_HANDLE,
+				&list,
+				&pool,
+				UINT32_MAX,
+				&chunks[i]
+			));
+
+			unsigned int own = 0;
+
+			for (int j = 0; j < chunks[i].itemCount; j++) {
+				const DrawItem item = draws.items[chunks[i].firstItem + j];
+				own += item.mesh % 3 != 0;
+			}
+
+			if (own < fewest) fewest = own;
+			if (own > most) most = own;
+		}
+
+		CHECK(nextItem == draws.count);
+		CHECK(recordedDraws == wholeDraws);
+		CHECK(most - fewest <= 1);
+		CHECK(most <= ownCount / count + 1);
+	}
+
+	/* With fewer meshes of their own than threads, some chunks are empty,
+	 * and nothing is drawn twice. */
+	draws.count = 4;
+
+	DrawListChunk chunks[RECORDER_MAX_WORKERS];
+	splitDrawList(chunks, RECORDER_MAX_WORKERS, scenes, &draws, &list);
+
+	unsigned int items = 0;
+	unsigned int empty = 0;
+
+	for (int i = 0; i < RECORDER_MAX_WORKERS; i++) {
+		items += chunks[i].itemCount;
+		empty += !chunks[i].itemCount && !chunks[i].commandCount;
+	}
+
+	CHECK(items == 4);
+	CHECK(empty >= RECORDER_MAX_WORKERS - 3);
+
+	draws.count = DRAWRECORD_TEST_MESHES;
+
+	destroyDenseArray(scene->meshes);
+	destroyDenseArray(scenes);
+	free(draws.items);
+}
+
+int main(int argc, char* argv[])
+{
+	testRecording();
+	testSharedBuffers();
+	testSplit();
+
+	return testFailures != 0;
+}
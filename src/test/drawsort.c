@@ -0,0 +1,290 @@
+#include "test.h"
+#include "../render/drawsort.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DRAWSORT_TEST_COUNT 100000
+#define DRAWSORT_TEST_SCENES 4
+#define DRAWSORT_TEST_MESHES 500
+
+int testFailures = 0;
+
+void testKeys(void)
+{
+	/* Pass beats pipeline beats texture beats distance */
+	CHECK(drawSortKey(0, 5, 5, 100.0f) < drawSortKey(1, 0, 0, 0.0f));
+	CHECK(drawSortKey(0, 0, 5, 100.0f) < drawSortKey(0, 1, 0, 0.0f));
+	CHECK(drawSortKey(0, 0, 0, 100.0f) < drawSortKey(0, 0, 1, 0.0f));
+
+	/* Nearer comes first, all the way down to 0 and up to infinity */
+	CHECK(drawSortKey(0, 0, 0, 0.0f) < drawSortKey(0, 0, 0, 1e-30f));
+	CHECK(drawSortKey(0, 0, 0, 1.5f) < drawSortKey(0, 0, 0, 1.75f));
+	CHECK(drawSortKey(0, 0, 0, 1e30f) < drawSortKey(0, 0, 0, INFINITY));
+
+	/* Fields too big for their bits don't spill into the next one */
+	CHECK(
+		drawSortKey(0, DRAW_KEY_PIPELINE_MASK + 1, 0, 0.0f)
+		== drawSortKey(0, 0, 0, 0.0f)
+	);
+	CHECK(
+		drawSortKey(0, 0, DRAW_KEY_TEXTURE_MASK + 2, 0.0f)
+		== drawSortKey(0, 0, 1, 0.0f)
+	);
+	CHECK(
+		drawSortKey(DRAW_KEY_PASS_MASK, 0, 0, 0.0f) >> DRAW_KEY_PASS_SHIFT
+		== DRAW_KEY_PASS_MASK
+	);
+}
+
+/* The reference order. Equal keys stay in the order they came in, which
+ * the mesh field holds here. */
+int compareItems(const void* a, const void* b)
+{
+	const DrawItem* itemA = (const DrawItem*)a;
+	const DrawItem* itemB = (const DrawItem*)b;
+
+	if (itemA->key != itemB->key) return itemA->key < itemB->key ? -1 : 1;
+
+	return (itemA->mesh > itemB->mesh) - (itemA->mesh < itemB->mesh);
+}
+
+/* Sorts count items with keys from makeKey and compares with qsort */
+void checkSort(unsigned int count, uint64_t (*makeKey)(void))
+{
+	DrawItem* items = (DrawItem*)malloc(sizeof(DrawItem) * count * 2);
+	DrawItem* expected = (DrawItem*)malloc(sizeof(DrawItem) * count);
+
+	for (int i = 0; i < count; i++) {
+		items[i].key = makeKey();
+		items[i].scene = 0;
+		items[i].mesh = i;
+		expected[i] = items[i];
+	}
+
+	qsort(expected, count, sizeof(DrawItem), compareItems);
+
+	const DrawItem* sorted = radixSortDraws(items, items + count, count);
+	unsigned int wrong = 0;
+
+	for (int i = 0; i < count; i++) {
+		wrong += sorted[i].key != expected[i].key
+			|| sorted[i].mesh != expected[i].mesh;
+	}
+
+	CHECK(!wrong);
+
+	free(items);
+	free(expected);
+}
+
+uint64_t randomKey(void)
+{
+	return (uint64_t)rand() << 62 ^ (uint64_t)rand() << 31 ^ rand();
+}
+
+/* What a frame really looks like. Pass and pipeline are the same throughout,
+ * so their bytes get skipped, and there are few enough textures for lots of
+ * equal keys. */
+uint64_t frameKey(void)
+{
+	return drawSortKey(
+		DRAW_PASS_GEOMETRY,
+		DRAW_PIPELINE_DEFAULT,
+		rand() % 8,
+		(float)(rand() % 64)
+	);
+}
+
+uint64_t sameKey(void)
+{
+	return drawSortKey(1, 2, 3, 4.0f);
+}
+
+void testRadixSort(void)
+{
+	checkSort(1, randomKey);
+	checkSort(2, randomKey);
+	checkSort(1000, randomKey);
+	checkSort(DRAWSORT_TEST_COUNT, randomKey);
+	checkSort(DRAWSORT_TEST_COUNT, frameKey);
+	checkSort(1000, sameKey);
+
+	/* Already sorted and backwards */
+	DrawItem* items = (DrawItem*)malloc(sizeof(DrawItem) * 2000);
+
+	for (int i = 0; i < 1000; i++) {
+		items[i].key = drawSortKey(0, 0, 0, (float)i);
+		items[i].mesh = i;
+	}
+
+	const DrawItem* sorted = radixSortDraws(items, items + 1000, 1000);
+
+	for (int i = 1; i < 1000; i++) {
+		CHECK(sorted[i - 1].key <= sorted[i].key);
+	}
+
+	for (int i = 0; i < 1000; i++) {
+		items[i].key = drawSortKey(0, 0, 0, (float)(1000 - i));
+		items[i].mesh = i;
+	}
+
+	sorted = radixSortDraws(items, items + 1000, 1000);
+
+	for (int i = 0; i < 1000; i++) {
+		CHECK(sorted[i].mesh == 999 - i);
+	}
+
+	free(items);
+}
+
+/* Times sorting a frame's worth of draws, to compare with qsort */
+void benchmarkRadixSort(void)
+{
+	const unsigned int count = DRAWSORT_TEST_COUNT;
+	DrawItem* items = (DrawItem*)malloc(sizeof(DrawItem) * count * 2);
+	DrawItem* copy = (DrawItem*)malloc(sizeof(DrawItem) * count);
+
+	for (int i = 0; i < count; i++) {
+		copy[i].key = drawSortKey(0, 0, rand() % 256, rand() / 1e3f);
+		copy[i].mesh = i;
+	}
+
+	struct timespec start, end;
+	double radixMillis = 0.0;
+	double qsortMillis = 0.0;
+
+	for (int run = 0; run < 10; run++) {
+		memcpy(items, copy, sizeof(DrawItem) * count);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		radixSortDraws(items, items + count, count);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		radixMillis += (end.tv_sec - start.tv_sec) * 1e3
+			+ (end.tv_nsec - start.tv_nsec) / 1e6;
+
+		memcpy(items, copy, sizeof(DrawItem) * count);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		qsort(items, count, sizeof(DrawItem), compareItems);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		qsortMillis += (end.tv_sec - start.tv_sec) * 1e3
+			+ (end.tv_nsec - start.tv_nsec) / 1e6;
+	}
+
+	printf(
+		"Sorting %u draws: radix %.2f ms, qsort %.2f ms\n",
+		count,
+		radixMillis / 10.0,
+		qsortMillis / 10.0
+	);
+
+	free(items);
+	free(copy);
+}
+
+/* sortDraws over a few scenes, with some meshes not visible */
+void testSortDraws(void)
+{
+	SceneArray scenes;
+	CHECK(!createDenseArray(&scenes, sizeof(Scene), 0));
+
+	for (int i = 0; i < DRAWSORT_TEST_SCENES; i++) {
+		Scene scene = {};
+		CHECK(!createDenseArray(&scene.meshes, sizeof(Mesh), 0));
+
+		for (int j = 0; j < DRAWSORT_TEST_MESHES; j++) {
+			Mesh mesh = {};
+			mesh.visible = rand() % 4 != 0;
+			mesh.texIndex = rand() % 16;
+
+			for (int k = 0; k < 4; k++) mesh.tform[k][k] = 1.0f;
+
+			/* Placed by the transform, centred by the sphere */
+			mesh.tform[3][X] = rand() % 200 - 100.0f;
+			mesh.tform[3][Z] = rand() % 200 - 100.0f;
+			mesh.sphereCentre[Y] = rand() % 20 - 10.0f;
+
+			CHECK(denseAdd(&scene.meshes, j, &mesh) == j);
+		}
+
+		CHECK(denseAdd(&scenes, i, &scene) == i);
+	}
+
+	Arena arena;
+	createArena(&arena, 0);
+
+	const Vec3 eye = {3.0f, 4.0f, -5.0f};
+	SortedDraws draws;
+	CHECK(!sortDraws(&draws, &arena, scenes, eye));
+
+	unsigned int visibleCount = 0;
+
+	for (int i = 0; i < scenes.count; i++) {
+		for (int j = 0; j < DRAWSORT_TEST_MESHES; j++) {
+			visibleCount += SCENE_MESH(scenes, i, j).visible;
+		}
+	}
+
+	CHECK(draws.count == visibleCount);
+
+	/* Every visible mesh once, by texture and then nearest first */
+	char* seen =
+		(char*)calloc(DRAWSORT_TEST_SCENES * DRAWSORT_TEST_MESHES, 1);
+	float lastDistance = 0.0f;
+
+	for (int i = 0; i < draws.count; i++) {
+		const DrawItem* item = &draws.items[i];
+		const Mesh* mesh = &SCENE_MESH(scenes, item->scene, item->mesh);
+
+		CHECK(mesh->visible);
+		CHECK(!seen[item->scene * DRAWSORT_TEST_MESHES + item->mesh]);
+		seen[item->scene * DRAWSORT_TEST_MESHES + item->mesh] = 1;
+
+		const float dx = eye.x - mesh->tform[3][X];
+		const float dy = eye.y - mesh->sphereCentre[Y];
+		const float dz = eye.z - mesh->tform[3][Z];
+		const float distance = dx * dx + dy * dy + dz * dz;
+
+		if (i) {
+			const DrawItem* last = &draws.items[i - 1];
+			const uint32_t lastTexture = SCENE_MESH(
+				scenes,
+				last->scene,
+				last->mesh
+			).texIndex;
+
+			CHECK(lastTexture <= mesh->texIndex);
+
+			if (lastTexture == mesh->texIndex) {
+				CHECK(lastDistance <= distance);
+			}
+		}
+
+		lastDistance = distance;
+	}
+
+	free(seen);
+	destroyArena(arena);
+
+	for (int i = 0; i < scenes.count; i++) {
+		destroyDenseArray(DENSE_AT(Scene, scenes, i).meshes);
+	}
+
+	destroyDenseArray(scenes);
+}
+
+int main(int argc, char* argv[])
+{
+	srand(6);
+
+	testKeys();
+	testRadixSort();
+	testSortDraws();
+	benchmarkRadixSort();
+
+	return testFailures != 0;
+}
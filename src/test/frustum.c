@@ -0,0 +1,276 @@
+#include "test.h"
+#include "../render/frustum.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FRUSTUM_TEST_MESHES 100000
+#define FRUSTUM_TEST_POINTS 100000
+
+/* Points sampled in each mesh's box when looking for one the camera sees */
+#define FRUSTUM_TEST_SAMPLES 27
+
+int testFailures = 0;
+
+float randomFloat(float min, float max)
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+/* Set up the way cmdViewpointTransform does it */
+ViewpointUniforms makeViewpoint(void)
+{
+	const Vec3 eye = {0.0f, -20.0f, 5.0f};
+	const Vec3 centre = {0.0f, 0.0f, 0.0f};
+	const Vec3 up = {0.0f, 0.0f, 1.0f};
+
+	ViewpointUniforms ubo = {};
+	ubo.view = matLook(eye, centre, up);
+	ubo.proj = matPersp(1.0f, 16.0f / 9.0f, 0.1f, 10.0f);
+
+	return ubo;
+}
+
+/* Whether the world space point lands inside the clip volume, and how far
+ * inside it is in clip units */
+int pointVisible(const ViewpointUniforms* ubo, const float* p, float* margin)
+{
+	float view[4][4];
+	float proj[4][4];
+	float viewPos[4];
+	float clip[4];
+
+	memcpy(view, &ubo->view, sizeof(view));
+	memcpy(proj, &ubo->proj, sizeof(proj));
+
+	for (int row = 0; row < 4; row++) {
+		viewPos[row] = view[0][row] * p[X] + view[1][row] * p[Y]
+			+ view[2][row] * p[Z] + view[3][row];
+	}
+
+	for (int row = 0; row < 4; row++) {
+		clip[row] = 0.0f;
+
+		for (int k = 0; k < 4; k++) {
+			clip[row] += proj[k][row] * viewPos[k];
+		}
+	}
+
+	const float distances[6] = {
+		clip[W] + clip[X], clip[W] - clip[X],
+		clip[W] + clip[Y], clip[W] - clip[Y],
+		clip[Z], clip[W] - clip[Z]
+	};
+	float nearest = INFINITY;
+
+	for (int i = 0; i < 6; i++) {
+		nearest = fminf(nearest, fabsf(distances[i]));
+		if (distances[i] < 0.0f) {
+			if (margin) *margin = nearest;
+			return 0;
+		}
+	}
+
+	if (margin) *margin = nearest;
+
+	return 1;
+}
+
+/* The planes have to agree with the clip volume about every point, apart
+ * from ones too close to a plane for float rounding to decide */
+void testPlanes(void)
+{
+	const ViewpointUniforms ubo = makeViewpoint();
+	float planes[6][4];
+	extractFrustumPlanes(planes, &ubo);
+
+	unsigned int insideCount = 0;
+
+	for (int i = 0; i < FRUSTUM_TEST_POINTS; i++) {
+		const float p[3] = {
+			randomFloat(-300.0f, 300.0f),
+			randomFloat(-200.0f, 200.0f),
+			randomFloat(-300.0f, 300.0f)
+		};
+
+		float margin;
+		const int visible = pointVisible(&ubo, p, &margin);
+
+		if (margin < 1e-3f) continue;
+
+		int inside = 1;
+
+		for (int j = 0; j < 6; j++) {
+			const float distance = planes[j][X] * p[X]
+				+ planes[j][Y] * p[Y]
+				+ planes[j][Z] * p[Z]
+				+ planes[j][W];
+
+			if (distance < 0.0f) inside = 0;
+		}
+
+		CHECK(inside == visible);
+		insideCount += inside;
+	}
+
+	/* Otherwise the points above weren't a fair test */
+	CHECK(insideCount > FRUSTUM_TEST_POINTS / 20);
+	CHECK(insideCount < FRUSTUM_TEST_POINTS - FRUSTUM_TEST_POINTS / 20);
+}
+
+/* A box scaled, turned and moved somewhere around the camera */
+Mesh makeMesh(void)
+{
+	Mesh mesh = {};
+
+	for (int i = 0; i < 3; i++) {
+		mesh.aabbMin[i] = randomFloat(-2.0f, 0.0f);
+		mesh.aabbMax[i] = randomFloat(0.0f, 2.0f);
+		mesh.sphereCentre[i] = (mesh.aabbMin[i] + mesh.aabbMax[i]) * 0.5f;
+	}
+
+	const float dx = mesh.aabbMax[X] - mesh.aabbMin[X];
+	const float dy = mesh.aabbMax[Y] - mesh.aabbMin[Y];
+	const float dz = mesh.aabbMax[Z] - mesh.aabbMin[Z];
+	mesh.sphereRadius = sqrtf(dx * dx + dy * dy + dz * dz) * 0.5f;
+
+	float scale[4][4] = {};
+	float rotation[4][4] = {};
+	float translation[4][4] = {};
+	float scaled[4][4];
+
+	const float s = randomFloat(0.2f, 3.0f);
+	scale3d(scale, s, s * randomFloat(0.5f, 2.0f), s);
+	rotate3d(
+		rotation,
+		randomFloat(0.0f, 6.3f),
+		randomFloat(0.0f, 6.3f),
+		randomFloat(0.0f, 6.3f)
+	);
+	rotation[3][3] = 1.0f;
+
+	for (int i = 0; i < 4; i++) translation[i][i] = 1.0f;
+	translation[3][X] = randomFloat(-300.0f, 300.0f);
+	translation[3][Y] = randomFloat(-200.0f, 200.0f);
+	translation[3][Z] = randomFloat(-300.0f, 300.0f);
+
+	multiply3d(
+		scaled,
+		(const float (*)[4])rotation,
+		(const float (*)[4])scale
+	);
+	multiply3d(
+		mesh.tform,
+		(const float (*)[4])translation,
+		(const float (*)[4])scaled
+	);
+
+	return mesh;
+}
+
+/* Whether any of a grid of points through the mesh's box is seen */
+int meshSeen(const ViewpointUniforms* ubo, const Mesh* mesh)
+{
+	for (int i = 0; i < FRUSTUM_TEST_SAMPLES; i++) {
+		const int steps[3] = {i % 3, i / 3 % 3, i / 9};
+		float p[3];
+		float world[3];
+
+		for (int j = 0; j < 3; j++) {
+			p[j] = mesh->aabbMin[j]
+				+ (mesh->aabbMax[j] - mesh->aabbMin[j]) * steps[j] * 0.5f;
+		}
+
+		transformPoint(world, mesh->tform, p);
+
+		if (pointVisible(ubo, world, 0)) return 1;
+	}
+
+	return 0;
+}
+
+/* Culling is only allowed to be loose. A mesh with any part of it seen has
+ * to be kept, and the SSE path has to agree with the scalar one. Also
+ * times the whole thing at 100k meshes. */
+void testCull(void)
+{
+	const ViewpointUniforms ubo = makeViewpoint();
+	float planes[6][4];
+	extractFrustumPlanes(planes, &ubo);
+
+	Mesh* meshes = (Mesh*)malloc(sizeof(Mesh) * FRUSTUM_TEST_MESHES);
+
+	for (int i = 0; i < FRUSTUM_TEST_MESHES; i++) {
+		meshes[i] = makeMesh();
+	}
+
+	Arena arena;
+	createArena(&arena, 0);
+
+	MeshBounds bounds;
+	CHECK(!createMeshBounds(&bounds, &arena, FRUSTUM_TEST_MESHES));
+
+	struct timespec start, mid, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < FRUSTUM_TEST_MESHES; i++) {
+		setMeshBounds(&bounds, i, &meshes[i]);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &mid);
+	cullMeshBounds(&bounds, (const float (*)[4])planes);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	unsigned int drawn = 0;
+	unsigned int seen = 0;
+	unsigned int wronglyCulled = 0;
+	unsigned int disagree = 0;
+
+	for (int i = 0; i < FRUSTUM_TEST_MESHES; i++) {
+		const int meshIsSeen = meshSeen(&ubo, &meshes[i]);
+
+		drawn += bounds.visible[i];
+		seen += meshIsSeen;
+		wronglyCulled += meshIsSeen && !bounds.visible[i];
+		disagree += bounds.visible[i] != meshBoundsVisible(
+			&bounds,
+			i,
+			(const float (*)[4])planes
+		);
+	}
+
+	printf(
+		"%d meshes: %u drawn, %u culled, %u seen. "
+		"Bounds %.2f ms, culling %.2f ms\n",
+		FRUSTUM_TEST_MESHES,
+		drawn,
+		FRUSTUM_TEST_MESHES - drawn,
+		seen,
+		(mid.tv_sec - start.tv_sec) * 1e3
+			+ (mid.tv_nsec - start.tv_nsec) / 1e6,
+		(end.tv_sec - mid.tv_sec) * 1e3
+			+ (end.tv_nsec - mid.tv_nsec) / 1e6
+	);
+
+	CHECK(!wronglyCulled);
+	CHECK(!disagree);
+
+	/* Loose, but only around the edges */
+	CHECK(drawn >= seen);
+	CHECK(drawn - seen < FRUSTUM_TEST_MESHES / 100);
+	CHECK(drawn < FRUSTUM_TEST_MESHES / 2);
+
+	destroyArena(arena);
+	free(meshes);
+}
+
+int main(int argc, char* argv[])
+{
+	srand(7);
+
+	testPlanes();
+	testCull();
+
+	return testFailures != 0;
+}
@@ -0,0 +1,152 @@
+#include "test.h"
+#include "../common/idmap.h"
+#include <stdlib.h>
+
+#define IDMAP_TEST_COUNT 10000
+
+/* IDs per stride, and how far from its bucket any one of them can end up.
+ * The map's never more than half full, so a fair hash keeps runs short. */
+#define IDMAP_TEST_STRIDED 1000
+#define IDMAP_TEST_MAX_PROBE 16
+
+int testFailures = 0;
+
+/* IDs counting up from zero, like most clients hand them out */
+void testSequential(void)
+{
+	IdMap map;
+	CHECK(!createIdMap(&map));
+
+	for (int i = 0; i < IDMAP_TEST_COUNT; i++) {
+		CHECK(!idMapSet(&map, i, i * 3));
+	}
+
+	CHECK(map.count == IDMAP_TEST_COUNT);
+
+	/* Never more than half full */
+	CHECK(map.count * 2 <= map.size);
+
+	for (int i = 0; i < IDMAP_TEST_COUNT; i++) {
+		CHECK(idMapFind(&map, i) == i * 3);
+	}
+
+	CHECK(idMapFind(&map, IDMAP_TEST_COUNT) == -1);
+	CHECK(idMapFind(&map, -1) == -1);
+
+	/* Setting an ID that's there already moves it instead of adding it */
+	CHECK(!idMapSet(&map, 7, 1234));
+	CHECK(idMapFind(&map, 7) == 1234);
+	CHECK(map.count == IDMAP_TEST_COUNT);
+
+	destroyIdMap(map);
+}
+
+/* The furthest any ID in the map sits from the bucket it hashes to */
+uint32_t longestProbe(const IdMap* map)
+{
+	uint32_t longest = 0;
+
+	for (uint32_t i = 0; i < map->size; i++) {
+		if (map->buckets[i].index == IDMAP_EMPTY) continue;
+
+		const uint32_t home = IDMAP_HASH(map->buckets[i].id, map->shift);
+		const uint32_t probe = (i - home) & (map->size - 1);
+
+		if (probe > longest) longest = probe;
+	}
+
+	return longest;
+}
+
+/* IDs a power of two apart only differ in their high bits, and IDs counting
+ * up in other strides aren't much better. Whatever the stride, lookups have
+ * to stay a short walk from where they start. Removing every other one then
+ * has to leave the rest of each run findable. */
+void testStrided(void)
+{
+	const int strides[] = {1, 3, 64, 1000, 4096, 1 << 16};
+	const int strideCount = sizeof(strides) / sizeof(strides[0]);
+
+	for (int s = 0; s < strideCount; s++) {
+		IdMap map;
+		CHECK(!createIdMap(&map));
+
+		for (int i = 0; i < IDMAP_TEST_STRIDED; i++) {
+			CHECK(!idMapSet(&map, i * strides[s], i));
+		}
+
+		const uint32_t longest = longestProbe(&map);
+
+		if (longest > IDMAP_TEST_MAX_PROBE) {
+			printf("stride %i: probe of %u\n", strides[s], longest);
+		}
+
+		CHECK(longest <= IDMAP_TEST_MAX_PROBE);
+
+		for (int i = 0; i < IDMAP_TEST_STRIDED; i += 2) {
+			idMapRemove(&map, i * strides[s]);
+		}
+
+		for (int i = 0; i < IDMAP_TEST_STRIDED; i++) {
+			const int expected = i % 2 ? i : -1;
+			CHECK(idMapFind(&map, i * strides[s]) == expected);
+		}
+
+		CHECK(map.count == IDMAP_TEST_STRIDED / 2);
+		CHECK(longestProbe(&map) <= IDMAP_TEST_MAX_PROBE);
+
+		/* Removing what isn't there does nothing */
+		idMapRemove(&map, -12345);
+		CHECK(map.count == IDMAP_TEST_STRIDED / 2);
+
+		destroyIdMap(map);
+	}
+}
+
+/* Random adds and removes, checked against a plain array */
+void testAgainstArray(void)
+{
+	IdMap map;
+	CHECK(!createIdMap(&map));
+
+	int* expected = (int*)malloc(sizeof(int) * IDMAP_TEST_COUNT);
+
+	for (int i = 0; i < IDMAP_TEST_COUNT; i++) {
+		expected[i] = -1;
+	}
+
+	srand(1);
+
+	for (int i = 0; i < IDMAP_TEST_COUNT * 10; i++) {
+		const int id = rand() % IDMAP_TEST_COUNT;
+
+		if (rand() % 3) {
+			CHECK(!idMapSet(&map, id, i));
+			expected[id] = i;
+		} else {
+			idMapRemove(&map, id);
+			expected[id] = -1;
+		}
+	}
+
+	unsigned int count = 0;
+
+	for (int i = 0; i < IDMAP_TEST_COUNT; i++) {
+		CHECK(idMapFind(&map, i) == expected[i]);
+		if (expected[i] != -1) ++count;
+	}
+
+	CHECK(map.count == count);
+
+	free(expected);
+	destroyIdMap(map);
+}
+
+int main(int argc, char* argv[])
+{
+	testSequential();
+	testStrided();
+	testAgainstArray();
+
+	return testFailures != 0;
+}
@@ -0,0 +1,230 @@
+#include "test.h"
+#include "../render/meshopt.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* A grid this many quads on a side, two triangles each */
+#define MESHOPT_TEST_GRID 64
+
+int testFailures = 0;
+
+/* Hand counted ACMR for small index buffers, mostly to pin down exactly
+ * when the FIFO evicts. */
+void testAcmr(void)
+{
+	const uint32_t triangle[] = {0, 1, 2};
+	CHECK(vertexCacheAcmr(triangle, 3, 3) == 3.0f);
+
+	/* A quad shares two of its second triangle's vertices */
+	const uint32_t quad[] = {0, 1, 2, 2, 1, 3};
+	CHECK(vertexCacheAcmr(quad, 6, 4) == 2.0f);
+
+	/* A vertex is still there after MESHOPT_FIFO_SIZE - 1 others go in
+	 * behind it, and gone after MESHOPT_FIFO_SIZE. */
+	uint32_t indices[MESHOPT_FIFO_SIZE + 5];
+	unsigned int count = 0;
+
+	for (int i = 0; i < MESHOPT_FIFO_SIZE; i++) indices[count++] = i;
+	indices[count++] = 0;
+	while (count % 3) indices[count++] = MESHOPT_FIFO_SIZE - 1;
+
+	CHECK(
+		vertexCacheAcmr(indices, count, MESHOPT_FIFO_SIZE + 1)
+		== (float)MESHOPT_FIFO_SIZE / (count / 3)
+	);
+
+	count = 0;
+	for (int i = 0; i <= MESHOPT_FIFO_SIZE; i++) indices[count++] = i;
+	indices[count++] = 0;
+	while (count % 3) indices[count++] = MESHOPT_FIFO_SIZE;
+
+	CHECK(
+		vertexCacheAcmr(indices, count, MESHOPT_FIFO_SIZE + 1)
+		== (float)(MESHOPT_FIFO_SIZE + 2) / (count / 3)
+	);
+}
+
+/* Every triangle gets a copy of its vertices, the way an unindexed file
+ * would come in. The vertex at (x, y) of the grid is unique by its
+ * position. */
+void makeGrid(Vertex* vertices, uint32_t* indices)
+{
+	const int corners[6][2] = {{0, 0}, {1, 0}, {0, 1}, {0, 1}, {1, 0}, {1, 1}};
+	unsigned int v = 0;
+
+	for (int y = 0; y < MESHOPT_TEST_GRID; y++) {
+		for (int x = 0; x < MESHOPT_TEST_GRID; x++) {
+			for (int i = 0; i < 6; i++) {
+				Vertex vertex = {};
+				vertex.pos[X] = x + corners[i][X];
+				vertex.pos[Y] = y + corners[i][Y];
+				vertex.normal[Z] = 1.0f;
+				vertex.texCoord[X] = vertex.pos[X] / MESHOPT_TEST_GRID;
+				vertex.texCoord[Y] = vertex.pos[Y] / MESHOPT_TEST_GRID;
+
+				vertices[v] = vertex;
+				indices[v] = v;
+				++v;
+			}
+		}
+	}
+}
+
+/* Triangles are compared by what their vertices hold, starting from the
+ * smallest so the winding has to match too. */
+typedef struct
+{
+	Vertex corners[3];
+} TestTriangle;
+
+int compareTriangles(const void* a, const void* b)
+{
+	return memcmp(a, b, sizeof(TestTriangle));
+}
+
+TestTriangle* collectTriangles(
+	const Vertex* vertices,
+	const uint32_t* indices,
+	unsigned int indexCount
+)
+{
+	const unsigned int triCount = indexCount / 3;
+	TestTriangle* tris = (TestTriangle*)malloc(sizeof(TestTriangle) * triCount);
+
+	for (int t = 0; t < triCount; t++) {
+		int first = 0;
+
+		for (int i = 1; i < 3; i++) {
+			if (memcmp(
+				&vertices[indices[t * 3 + i]],
+				&vertices[indices[t * 3 + first]],
+				sizeof(Vertex)
+			) < 0) {
+				first = i;
+			}
+		}
+
+		for (int i = 0; i < 3; i++) {
+			tris[t].corners[i] = vertices[indices[t * 3 + (first + i) % 3]];
+		}
+	}
+
+	qsort(tris, triCount, sizeof(TestTriangle), compareTriangles);
+
+	return tris;
+}
+
+/* The grid is split into two submeshes, bottom and top half, and put
+ * through everything optimizeMesh does. */
+void testOptimizeMesh(void)
+{
+	const unsigned int indexCount = MESHOPT_TEST_GRID * MESHOPT_TEST_GRID * 6;
+	const unsigned int halfCount = indexCount / 2;
+
+	Vertex* vertices = (Vertex*)malloc(sizeof(Vertex) * indexCount);
+	uint32_t* indices = (uint32_t*)malloc(sizeof(uint32_t) * indexCount);
+	unsigned int vertexCount = indexCount;
+
+	makeGrid(vertices, indices);
+
+	/* Triangles shuffled within each half, to start from a bad order */
+	srand(5);
+
+	for (int half = 0; half < 2; half++) {
+		uint32_t* subIndices = &indices[half * halfCount];
+
+		for (int t = halfCount / 3 - 1; t > 0; t--) {
+			const int other = rand() % (t + 1);
+
+			for (int i = 0; i < 3; i++) {
+				const uint32_t index = subIndices[t * 3 + i];
+				subIndices[t * 3 + i] = subIndices[other * 3 + i];
+				subIndices[other * 3 + i] = index;
+			}
+		}
+	}
+
+	TestTriangle* before[2];
+
+	for (int half = 0; half < 2; half++) {
+		before[half] = collectTriangles(
+			vertices,
+			&indices[half * halfCount],
+			halfCount
+		);
+	}
+
+	const float acmrBefore =
+		vertexCacheAcmr(indices, indexCount, vertexCount);
+
+	Submesh submeshes[2] = {};
+	submeshes[0].indexCount = halfCount;
+	submeshes[1].firstIndex = halfCount;
+	submeshes[1].indexCount = halfCount;
+
+	CHECK(!optimizeMesh(
+		vertices,
+		&vertexCount,
+		indices,
+		indexCount,
+		submeshes,
+		2
+	));
+
+	const float acmrAfter = vertexCacheAcmr(indices, indexCount, vertexCount);
+
+	printf(
+		"%dx%d grid: ACMR %.3f before, %.3f after\n",
+		MESHOPT_TEST_GRID,
+		MESHOPT_TEST_GRID,
+		acmrBefore,
+		acmrAfter
+	);
+
+	/* Welding leaves one vertex per grid point */
+	CHECK(vertexCount == (MESHOPT_TEST_GRID + 1) * (MESHOPT_TEST_GRID + 1));
+
+	/* A FIFO of 16 can't do much better than 0.7 on a grid, and a shuffled
+	 * one is close to the worst there is */
+	CHECK(acmrBefore > 2.0f);
+	CHECK(acmrAfter < 0.8f);
+
+	/* Same triangles with the same winding, each still in its submesh */
+	for (int half = 0; half < 2; half++) {
+		TestTriangle* after = collectTriangles(
+			vertices,
+			&indices[half * halfCount],
+			halfCount
+		);
+
+		CHECK(!memcmp(
+			before[half],
+			after,
+			sizeof(TestTriangle) * (halfCount / 3)
+		));
+
+		free(before[half]);
+		free(after);
+	}
+
+	/* Vertices are numbered in the order they're first used */
+	uint32_t nextVertex = 0;
+
+	for (int i = 0; i < indexCount; i++) {
+		CHECK(indices[i] <= nextVertex);
+		if (indices[i] == nextVertex) ++nextVertex;
+	}
+
+	CHECK(nextVertex == vertexCount);
+
+	free(vertices);
+	free(indices);
+}
+
+int main(int argc, char* argv[])
+{
+	testAcmr();
+	testOptimizeMesh();
+
+	return testFailures != 0;
+}
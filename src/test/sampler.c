@@ -0,0 +1,210 @@
+#include "test.h"
+#include "../render/sampler.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLER_TEST_TEXTURES 50000
+
+/* What a lot of drivers report for maxSamplerAllocationCount */
+#define SAMPLER_TEST_LIMIT 4000
+
+int testFailures = 0;
+
+/* Stands in for the driver. Samplers are just numbers, and making one past
+ * the limit fails the way a real driver would. */
+unsigned int liveSamplers = 0;
+unsigned int createdSamplers = 0;
+unsigned int deviceQueries = 0;
+
+VkResult vkCreateSampler(
+	VkDevice device,
+	const VkSamplerCreateInfo* pCreateInfo,
+	const VkAllocationCallbacks* pAllocator,
+	VkSampler* pSampler
+)
+{
+	if (liveSamplers >= SAMPLER_TEST_LIMIT) {
+		return VK_ERROR_TOO_MANY_OBJECTS;
+	}
+
+	++liveSamplers;
+	++createdSamplers;
+	*pSampler = (VkSampler)(uintptr_t)createdSamplers;
+
+	return VK_SUCCESS;
+}
+
+void vkDestroySampler(
+	VkDevice device,
+	VkSampler sampler,
+	const VkAllocationCallbacks* pAllocator
+)
+{
+	CHECK(sampler != VK_NULL_HANDLE);
+	CHECK(liveSamplers > 0);
+	--liveSamplers;
+}
+
+void vkGetPhysicalDeviceFeatures(
+	VkPhysicalDevice physicalDevice,
+	VkPhysicalDeviceFeatures* pFeatures
+)
+{
+	++deviceQueries;
+	*pFeatures = (VkPhysicalDeviceFeatures){};
+	pFeatures->samplerAnisotropy = VK_TRUE;
+}
+
+void vkGetPhysicalDeviceProperties(
+	VkPhysicalDevice physicalDevice,
+	VkPhysicalDeviceProperties* pProperties
+)
+{
+	++deviceQueries;
+	*pProperties = (VkPhysicalDeviceProperties){};
+	pProperties->limits.maxSamplerAllocationCount = SAMPLER_TEST_LIMIT;
+	pProperties->limits.maxSamplerAnisotropy = 16.0f;
+}
+
+/* Each one differs from defSamplerKey in one way, the way the hiz pyramid
+ * and the shadow atlas ask for theirs */
+SamplerKey otherKey(int i)
+{
+	SamplerKey key = defSamplerKey;
+
+	switch (i) {
+	case 0:
+		key.filter = VK_FILTER_NEAREST;
+		break;
+	case 1:
+		key.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		break;
+	case 2:
+		key.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		break;
+	case 3:
+		key.minLod = 1.0f;
+		break;
+	default:
+		key.maxLod = 0.0f;
+		break;
+	}
+
+	return key;
+}
+
+#define SAMPLER_TEST_KEYS 5
+
+/* Every texture asks for a sampler the way createTexture does, with a few
+ * other keys mixed in. Before the cache, each of those was a sampler of its
+ * own and the driver ran out at 4000. */
+void testManyTextures(void)
+{
+	SamplerCache cache;
+	CHECK(!createSamplerCache(&cache, VK_NULL_HANDLE));
+	CHECK(cache.anisotropy == VK_TRUE);
+	CHECK(cache.maxAnisotropy == 16.0f);
+
+	VkSampler* textures =
+		(VkSampler*)malloc(sizeof(VkSampler) * SAMPLER_TEST_TEXTURES);
+	VkSampler others[SAMPLER_TEST_KEYS] = {};
+	unsigned int failed = 0;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (int i = 0; i < SAMPLER_TEST_TEXTURES; i++) {
+		failed += getSampler(
+			&cache,
+			VK_NULL_HANDLE,
+			defSamplerKey,
+			&textures[i]
+		) != 0;
+
+		if (i % 1000 == 0) {
+			const int k = i / 1000 % SAMPLER_TEST_KEYS;
+			VkSampler sampler;
+
+			failed += getSampler(
+				&cache,
+				VK_NULL_HANDLE,
+				otherKey(k),
+				&sampler
+			) != 0;
+
+			if (!others[k]) others[k] = sampler;
+			CHECK(others[k] == sampler);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf(
+		"%d textures: %u samplers made, %.2f ms\n",
+		SAMPLER_TEST_TEXTURES,
+		createdSamplers,
+		(end.tv_sec - start.tv_sec) * 1e3
+			+ (end.tv_nsec - start.tv_nsec) / 1e6
+	);
+
+	CHECK(!failed);
+
+	/* One for the textures and one for each other key, nothing more */
+	CHECK(createdSamplers == 1 + SAMPLER_TEST_KEYS);
+	CHECK(cache.samplerCount == 1 + SAMPLER_TEST_KEYS);
+
+	/* The device was asked about features and properties once, up front */
+	CHECK(deviceQueries == 2);
+
+	unsigned int different = 0;
+
+	for (int i = 1; i < SAMPLER_TEST_TEXTURES; i++) {
+		different += textures[i] != textures[0];
+	}
+
+	CHECK(!different);
+
+	for (int i = 0; i < SAMPLER_TEST_KEYS; i++) {
+		CHECK(others[i] != VK_NULL_HANDLE);
+		CHECK(others[i] != textures[0]);
+
+		for (int j = 0; j < i; j++) CHECK(others[i] != others[j]);
+	}
+
+	destroySamplerCache(VK_NULL_HANDLE, cache);
+	CHECK(liveSamplers == 0);
+
+	free(textures);
+}
+
+/* When the driver does run out, getSampler says so, and whatever was made
+ * before that is still destroyed with the cache. */
+void testDriverLimit(void)
+{
+	liveSamplers = SAMPLER_TEST_LIMIT - 1;
+
+	SamplerCache cache;
+	CHECK(!createSamplerCache(&cache, VK_NULL_HANDLE));
+
+	VkSampler sampler;
+	CHECK(!getSampler(&cache, VK_NULL_HANDLE, defSamplerKey, &sampler));
+	CHECK(getSampler(&cache, VK_NULL_HANDLE, otherKey(0), &sampler));
+	CHECK(cache.samplerCount == 1);
+
+	/* Already made, so there's no need to ask the driver */
+	CHECK(!getSampler(&cache, VK_NULL_HANDLE, defSamplerKey, &sampler));
+
+	destroySamplerCache(VK_NULL_HANDLE, cache);
+	CHECK(liveSamplers == SAMPLER_TEST_LIMIT - 1);
+
+	liveSamplers = 0;
+}
+
+int main(int argc, char* argv[])
+{
+	testManyTextures();
+	testDriverLimit();
+
+	return testFailures != 0;
+}
@@ -0,0 +1,312 @@
+#include "test.h"
+#include "../render/shadowcache.h"
+#include <string.h>
+
+/* Lights far enough apart that no mesh reaches two of them */
+#define SHADOW_TEST_LIGHTS 3
+#define SHADOW_TEST_SPACING 100.0f
+
+/* A static caster by each light, and one that never stops moving by the
+ * first */
+#define SHADOW_TEST_MESHES (SHADOW_TEST_LIGHTS + 1)
+#define SHADOW_TEST_MOVING SHADOW_TEST_LIGHTS
+
+int testFailures = 0;
+
+/* Counted across every runFrames() call, to keep the moving mesh moving */
+unsigned int frame = 0;
+
+/* Per light, what the atlas would have drawn over some frames */
+typedef struct
+{
+	unsigned int refreshed[SHADOW_TEST_LIGHTS];
+	unsigned int staticDrawn[SHADOW_TEST_LIGHTS];
+} ShadowCounts;
+
+/* As cmdMeshTransform leaves it */
+void moveMesh(Mesh* mesh, float x, float y, float z)
+{
+	memset(mesh->tform, 0, sizeof(mesh->tform));
+
+	for (int i = 0; i < 4; i++) mesh->tform[i][i] = 1.0f;
+
+	mesh->tform[3][X] = x;
+	mesh->tform[3][Y] = y;
+	mesh->tform[3][Z] = z;
+	mesh->moved = 1;
+}
+
+/* As cmdNewMesh and cmdNewPointLight leave them */
+void makeScene(Scene* scene)
+{
+	*scene = (Scene){};
+	CHECK(!createDenseArray(&scene->meshes, sizeof(Mesh), 0));
+	CHECK(!createDenseArray(&scene->pointLights, sizeof(PointLight), 0));
+
+	for (int i = 0; i < SHADOW_TEST_LIGHTS; i++) {
+		PointLight light = {};
+		light.x = i * SHADOW_TEST_SPACING;
+		light.intensity = 1.0f;
+		light.distance = 10.0f;
+		light.shadowTile = -1;
+		light.staticDirty = 1;
+		light.dirty = 1;
+
+		CHECK(denseAdd(&scene->pointLights, i, &light) == i);
+	}
+
+	for (int i = 0; i < SHADOW_TEST_MESHES; i++) {
+		Mesh mesh = {};
+		mesh.sphereRadius = 1.0f;
+
+		const int light = i % SHADOW_TEST_LIGHTS;
+		moveMesh(&mesh, light * SHADOW_TEST_SPACING + 3.0f, 0.0f, 0.0f);
+		meshShadowSphere(mesh.shadowSphere, &mesh);
+
+		CHECK(denseAdd(&scene->meshes, i, &mesh) == i);
+	}
+}
+
+/* What display.c and recordShadows do with the cache each frame, counting
+ * tiles instead of drawing them. The moving mesh goes round the first light
+ * unless it's been stopped. */
+void runFrames(
+	ShadowCache* cache,
+	SceneArray scenes,
+	unsigned int frames,
+	char keepMoving,
+	ShadowCounts* counts
+)
+{
+	*counts = (ShadowCounts){};
+
+	Scene* scene = &DENSE_AT(Scene, scenes, 0);
+
+	for (unsigned int f = 0; f < frames; f++) {
+		++frame;
+
+		if (keepMoving) {
+			const int idx = denseFind(&scene->meshes, SHADOW_TEST_MOVING);
+
+			moveMesh(
+				&DENSE_AT(Mesh, scene->meshes, idx),
+				frame % 2 ? -3.0f : 3.0f,
+				frame % 2 ? 0.0f : 2.0f,
+				0.0f
+			);
+		}
+
+		updateShadowCasters(cache, scenes);
+		assignShadowTiles(cache, scenes);
+
+		PointLight* picked[SHADOW_TILE_COUNT];
+		const unsigned int pickedCount = pickShadowTiles(cache, scenes, picked);
+		unsigned int staticTiles = 0;
+
+		CHECK(pickedCount <= cache->budget);
+		CHECK(cache->refreshedTiles == pickedCount);
+
+		for (unsigned int i = 0; i < pickedCount; i++) {
+			const int light = picked[i] - &DENSE_AT(
+				PointLight,
+				scene->pointLights,
+				0
+			);
+
+			++counts->refreshed[light];
+
+			if (shadowTileNeedsStatic(picked[i])) {
+				++counts->staticDrawn[light];
+				++staticTiles;
+			}
+		}
+
+		CHECK(cache->staticTiles == staticTiles);
+
+		finishShadowTiles(picked, pickedCount);
+	}
+}
+
+/* Static casters go in the static atlas once, when they stop moving, and
+ * only go in again when one of them moves or goes. A mesh moving every frame
+ * only refreshes its own light's tile, which never draws its static casters
+ * again for it. */
+void testStaticCasters(void)
+{
+	SceneArray scenes;
+	CHECK(!createDenseArray(&scenes, sizeof(Scene), 0));
+
+	Scene scene;
+	makeScene(&scene);
+	CHECK(denseAdd(&scenes, 0, &scene) == 0);
+
+	Scene* sceneP = &DENSE_AT(Scene, scenes, 0);
+	PointLight* lights = &DENSE_AT(PointLight, sceneP->pointLights, 0);
+
+	ShadowCache cache;
+	createShadowCache(&cache);
+	cache.budget = SHADOW_TILE_COUNT;
+
+	/* Every light gets a tile and draws it whole, then again once its
+	 * casters have been still long enough to be static */
+	ShadowCounts counts;
+	runFrames(&cache, scenes, SHADOW_STATIC_FRAMES + 10, 1, &counts);
+
+	CHECK(cache.tilesInUse == SHADOW_TEST_LIGHTS);
+
+	for (int i = 0; i < SHADOW_TEST_LIGHTS; i++) {
+		CHECK(lights[i].shadowTile >= 0);
+		CHECK(lights[i].shadowReady);
+		CHECK(counts.staticDrawn[i] == 2);
+	}
+
+	CHECK(counts.refreshed[0] == SHADOW_STATIC_FRAMES + 10);
+	CHECK(counts.refreshed[1] == 2);
+	CHECK(counts.refreshed[2] == 2);
+
+	/* Settled. Only the moving mesh's light is refreshed, and never its
+	 * static tile. */
+	runFrames(&cache, scenes, 100, 1, &counts);
+
+	CHECK(counts.refreshed[0] == 100);
+	CHECK(counts.staticDrawn[0] == 0);
+
+	for (int i = 1; i < SHADOW_TEST_LIGHTS; i++) {
+		CHECK(counts.refreshed[i] == 0);
+		CHECK(counts.staticDrawn[i] == 0);
+	}
+
+	/* A static caster moved a little by its light comes out of the static
+	 * tile straight away and goes back in once it's still again */
+	Mesh* caster = &DENSE_AT(Mesh, sceneP->meshes, 1);
+	moveMesh(caster, SHADOW_TEST_SPACING + 3.0f, 2.0f, 0.0f);
+
+	runFrames(&cache, scenes, SHADOW_STATIC_FRAMES + 10, 1, &counts);
+
+	CHECK(counts.refreshed[1] == 2);
+	CHECK(counts.staticDrawn[1] == 2);
+	CHECK(counts.staticDrawn[0] == 0);
+	CHECK(counts.refreshed[2] == 0);
+
+	/* Moved over to the third light, it leaves the second one's static
+	 * tile and only joins the third one's when it's settled there */
+	moveMesh(caster, SHADOW_TEST_SPACING * 2.0f - 3.0f, 0.0f, 0.0f);
+
+	runFrames(&cache, scenes, 1, 1, &counts);
+
+	CHECK(counts.refreshed[1] == 1);
+	CHECK(counts.staticDrawn[1] == 1);
+	CHECK(counts.refreshed[2] == 1);
+	CHECK(counts.staticDrawn[2] == 0);
+
+	runFrames(&cache, scenes, SHADOW_STATIC_FRAMES + 10, 1, &counts);
+
+	CHECK(counts.refreshed[1] == 0);
+	CHECK(counts.refreshed[2] == 1);
+	CHECK(counts.staticDrawn[2] == 1);
+
+	/* Deleting a static caster takes it out of its light's static tile.
+	 * The moving mesh takes its place in the array. */
+	CHECK(!addShadowRemoval(&cache, caster));
+	CHECK(!denseRemove(&sceneP->meshes, 1));
+
+	runFrames(&cache, scenes, 10, 1, &counts);
+
+	CHECK(counts.refreshed[2] == 1);
+	CHECK(counts.staticDrawn[2] == 1);
+	CHECK(counts.refreshed[1] == 0);
+	CHECK(cache.removalCount == 0);
+
+	/* Lights only move or change through the socket commands, which mark
+	 * their tiles whole. With a budget of one, they take turns. */
+	cache.budget = 1;
+
+	for (int i = 0; i < SHADOW_TEST_LIGHTS; i++) {
+		lights[i].staticDirty = 1;
+		lights[i].dirty = 1;
+	}
+
+	runFrames(&cache, scenes, 1, 0, &counts);
+	CHECK(cache.refreshedTiles == 1);
+	CHECK(cache.waitingTiles == SHADOW_TEST_LIGHTS - 1);
+
+	runFrames(&cache, scenes, SHADOW_TEST_LIGHTS - 1, 0, &counts);
+	CHECK(cache.waitingTiles == 0);
+
+	for (int i = 0; i < SHADOW_TEST_LIGHTS; i++) {
+		CHECK(!lights[i].dirty);
+		CHECK(!lights[i].staticDirty);
+	}
+
+	/* Nothing moving and nothing changed, so nothing to draw */
+	runFrames(&cache, scenes, 10, 0, &counts);
+
+	for (int i = 0; i < SHADOW_TEST_LIGHTS; i++) {
+		CHECK(counts.refreshed[i] == 0);
+	}
+
+	destroyShadowCache(cache);
+	destroyDenseArray(sceneP->meshes);
+	destroyDenseArray(sceneP->pointLights);
+	destroyDenseArray(scenes);
+}
+
+/* Moving meshes only look at lights with tiles. One without a tile is left
+ * alone, and is dirty anyway once it gets one. */
+void testUntiledLights(void)
+{
+	SceneArray scenes;
+	CHECK(!createDenseArray(&scenes, sizeof(Scene), 0));
+
+	Scene scene;
+	makeScene(&scene);
+	CHECK(denseAdd(&scenes, 0, &scene) == 0);
+
+	Scene* sceneP = &DENSE_AT(Scene, scenes, 0);
+	PointLight* lights = &DENSE_AT(PointLight, sceneP->pointLights, 0);
+
+	ShadowCache cache;
+	createShadowCache(&cache);
+	cache.budget = SHADOW_TILE_COUNT;
+
+	ShadowCounts counts;
+	runFrames(&cache, scenes, 1, 0, &counts);
+
+	/* Taken back as if the light had never had one */
+	lights[1].shadowTile = -1;
+	lights[1].dirty = 0;
+	lights[1].staticDirty = 0;
+
+	PointLight* tiled[SHADOW_TILE_COUNT];
+	CHECK(findTiledLights(scenes, tiled) == SHADOW_TEST_LIGHTS - 1);
+
+	moveMesh(
+		&DENSE_AT(Mesh, sceneP->meshes, 1),
+		SHADOW_TEST_SPACING,
+		2.0f,
+		0.0f
+	);
+	updateShadowCasters(&cache, scenes);
+
+	CHECK(!lights[1].dirty);
+	CHECK(!lights[1].staticDirty);
+
+	assignShadowTiles(&cache, scenes);
+
+	CHECK(lights[1].shadowTile >= 0);
+	CHECK(lights[1].dirty);
+	CHECK(lights[1].staticDirty);
+
+	destroyShadowCache(cache);
+	destroyDenseArray(sceneP->meshes);
+	destroyDenseArray(sceneP->pointLights);
+	destroyDenseArray(scenes);
+}
+
+int main(int argc, char* argv[])
+{
+	testStaticCasters();
+	testUntiledLights();
+
+	return testFailures != 0;
+}
@@ -0,0 +1,384 @@
+#include "test.h"
+#include "../input/socket.h"
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int testFailures = 0;
+
+/* Only the light commands get run here, so the rest of the renderer socket.c
+ * calls into is stood in for. None of these should be reached. */
+unsigned int fakeCalls = 0;
+unsigned int removedScenes = 0;
+
+const SamplerKey defSamplerKey = {};
+
+int allocDescriptorSets(
+	DescriptorAllocator* alloc,
+	VkDevice device,
+	VkDescriptorSetLayout layout,
+	VkDescriptorSet* sets,
+	unsigned int setCount
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+void budgetCharge(MemoryBudget* budget, VkDeviceSize size)
+{
+	++fakeCalls;
+}
+
+int createBuffer(
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkDeviceSize size,
+	VkBufferUsageFlags usage,
+	VkMemoryPropertyFlags properties,
+	VkBuffer* buffer,
+	VkDeviceMemory* bufferMemory
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int createVertexBuffer(
+	VkCommandBuffer command,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* data,
+	VkDeviceSize bufferSize,
+	VkBuffer* buffer,
+	VkDeviceMemory* mem
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int createIndexBuffer(
+	VkCommandBuffer command,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* data,
+	VkDeviceSize bufferSize,
+	int entrySz,
+	VkBuffer* buffer,
+	VkDeviceMemory* mem
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int createDeviceLocalBuffer(
+	VkCommandBuffer command,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* data,
+	VkDeviceSize bufferSize,
+	VkBufferUsageFlags usage,
+	VkBuffer* buffer,
+	VkDeviceMemory* mem
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int geometryPoolAdd(
+	GeometryPool* pool,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	const void* vertexData,
+	uint32_t vertexCount,
+	const uint16_t* indexData,
+	uint32_t indexCount,
+	PoolRange* vertexRange,
+	PoolRange* indexRange
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int getSampler(
+	SamplerCache* cache,
+	VkDevice device,
+	SamplerKey key,
+	VkSampler* sampler
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int texTableAdd(
+	TextureTable* table,
+	VkDevice device,
+	VkImageView view,
+	uint32_t* slot
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+void texTableWrite(
+	TextureTable* table,
+	VkDevice device,
+	uint32_t slot,
+	VkImageView view
+)
+{
+	++fakeCalls;
+}
+
+int reclaimDeviceMemory(Display* display, VkDeviceSize size)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int createTextureImage(Texture* tex, VkDevice device, VkPhysicalDevice physDev)
+{
+	++fakeCalls;
+	return -1;
+}
+
+int writeTexture(
+	Texture* tex,
+	void* pixels,
+	VkDevice device,
+	VkPhysicalDevice physDev,
+	VkCommandBuffer cmdBuf,
+	VkQueue queue
+)
+{
+	++fakeCalls;
+	return -1;
+}
+
+void destroyMesh(GarbageQueue* garbage, Mesh mesh)
+{
+	++fakeCalls;
+}
+
+void destroyTexture(GarbageQueue* garbage, Texture texture)
+{
+	++fakeCalls;
+}
+
+void evictTexture(GarbageQueue* garbage, Texture* texture)
+{
+	++fakeCalls;
+}
+
+int addTextureBinding(Scene* scene, Texture* tex, int meshId, int pass)
+{
+	++fakeCalls;
+	return -1;
+}
+
+void removeTextureBinding(Scene* scene, Texture* tex, int meshId)
+{
+	++fakeCalls;
+}
+
+void freeTextureBindings(Scene* scene, Texture* tex)
+{
+	++fakeCalls;
+}
+
+void getSceneStats(Scene* scene, SceneStats* stats)
+{
+	++fakeCalls;
+}
+
+uint64_t sceneDeviceBytes(Scene* scene)
+{
+	++fakeCalls;
+	return 0;
+}
+
+/* The one that should be reached, when a command fails and the scene gets
+ * closed. The scene is left where it is so the test can tidy it up. */
+int sceneArrayRemoveEntry(
+	SceneArray* scenes,
+	unsigned int idx,
+	GarbageQueue* garbage
+)
+{
+	++removedScenes;
+	return 0;
+}
+
+/* One scene, reading from the other end of a socket pair */
+void makeScene(SceneArray* scenes, int* fds)
+{
+	CHECK(!socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+	CHECK(!createDenseArray(scenes, sizeof(Scene), 0));
+
+	Scene scene = {};
+	scene.fd = fds[1];
+	CHECK(!createDenseArray(&scene.meshes, sizeof(Mesh), 0));
+	CHECK(!createDenseArray(&scene.pointLights, sizeof(PointLight), 0));
+	CHECK(denseAdd(scenes, 0, &scene) == 0);
+}
+
+void destroyTestScene(SceneArray scenes, int* fds)
+{
+	destroyDenseArray(DENSE_AT(Scene, scenes, 0).meshes);
+	destroyDenseArray(DENSE_AT(Scene, scenes, 0).pointLights);
+	destroyDenseArray(scenes);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+/* Writes the opcode and the command after it, the way libigni would. */
+void sendCmd(int fd, IgniRndOpcode opcode, const void* cmd, size_t size)
+{
+	CHECK(write(fd, &opcode, sizeof(opcode)) == sizeof(opcode));
+	CHECK(write(fd, cmd, size) == size);
+}
+
+PointLight* findLight(Scene* scene, int id)
+{
+	int idx = denseFind(&scene->pointLights, id);
+
+	if (idx == -1) {
+		return 0;
+	}
+
+	return &DENSE_AT(PointLight, scene->pointLights, idx);
+}
+
+/* The scene executeCmd works on has to be the one at idx, so there are two
+ * and the command goes to the second. */
+void testConfigure(void)
+{
+	int fds[2];
+	SceneArray scenes;
+	makeScene(&scenes, fds);
+
+	Scene other = {};
+	other.fd = fds[1];
+	CHECK(denseAdd(&scenes, 1, &other) == 1);
+	DENSE_AT(Scene, scenes, 0).fd = -1;
+
+	Display* display = (Display*)calloc(1, sizeof(Display));
+
+	IgniRndCmdConfigure cmd = {};
+	cmd.majVersion = 2;
+	sendCmd(fds[0], IGNI_RENDER_OP_CONFIGURE, &cmd, sizeof(cmd));
+	CHECK(executeCmd(&scenes, display, 1) == 0);
+	CHECK(DENSE_AT(Scene, scenes, 1).version == 2);
+	CHECK(DENSE_AT(Scene, scenes, 0).version == 0);
+	CHECK(fakeCalls == 0);
+
+	free(display);
+	destroyTestScene(scenes, fds);
+}
+
+/* Runs libigni's point light commands through executeCmd, from one end of a
+ * socket pair to the scene on the other. */
+void testPointLights(void)
+{
+	int fds[2];
+	SceneArray scenes;
+	makeScene(&scenes, fds);
+
+	Scene* scene = &DENSE_AT(Scene, scenes, 0);
+	Display* display = (Display*)calloc(1, sizeof(Display));
+	removedScenes = 0;
+
+	IgniRndCmdPointLightCreate create = {};
+	create.lightId = 7;
+	sendCmd(fds[0], IGNI_RENDER_OP_POINT_LIGHT_CREATE, &create, sizeof(create));
+	CHECK(executeCmd(&scenes, display, 0) == 0);
+
+	PointLight* light = findLight(scene, 7);
+	CHECK(light);
+
+	if (light) {
+		CHECK(light->r == 1.0f && light->g == 1.0f && light->b == 1.0f);
+		CHECK(light->shadowTile == -1);
+		CHECK(light->dirty);
+	}
+
+	/* The same ID twice is the client's mistake, and closes the scene */
+	sendCmd(fds[0], IGNI_RENDER_OP_POINT_LIGHT_CREATE, &create, sizeof(create));
+	CHECK(executeCmd(&scenes, display, 0) == -1);
+	CHECK(removedScenes == 1);
+
+	IgniRndCmdPointLightTransform transform = {};
+	transform.lightId = 7;
+	transform.xLoc = 1.0f;
+	transform.yLoc = 2.0f;
+	transform.zLoc = 3.0f;
+	sendCmd(
+		fds[0],
+		IGNI_RENDER_OP_POINT_LIGHT_TRANSFORM,
+		&transform,
+		sizeof(transform)
+	);
+	CHECK(executeCmd(&scenes, display, 0) == 0);
+
+	light = findLight(scene, 7);
+	CHECK(light && light->x == 1.0f && light->y == 2.0f && light->z == 3.0f);
+
+	IgniRndCmdPointLightSetColour colour = {};
+	colour.lightId = 7;
+	colour.r = 0.5f;
+	colour.g = 0.25f;
+	colour.b = 0.0f;
+	colour.intensity = 4.0f;
+	sendCmd(
+		fds[0],
+		IGNI_RENDER_OP_POINT_LIGHT_SET_COLOUR,
+		&colour,
+		sizeof(colour)
+	);
+	CHECK(executeCmd(&scenes, display, 0) == 0);
+
+	light = findLight(scene, 7);
+	CHECK(light && light->r == 0.5f && light->g == 0.25f && light->b == 0.0f);
+	CHECK(light && light->distance == pointLightRange(4.0f));
+
+	IgniRndCmdPointLightDelete delete = {};
+	delete.lightId = 7;
+	sendCmd(fds[0], IGNI_RENDER_OP_POINT_LIGHT_DELETE, &delete, sizeof(delete));
+	CHECK(executeCmd(&scenes, display, 0) == 0);
+	CHECK(!findLight(scene, 7));
+	CHECK(scene->pointLights.count == 0);
+
+	/* Now it's gone, moving it is a mistake as well */
+	sendCmd(
+		fds[0],
+		IGNI_RENDER_OP_POINT_LIGHT_TRANSFORM,
+		&transform,
+		sizeof(transform)
+	);
+	CHECK(executeCmd(&scenes, display, 0) == -1);
+	CHECK(removedScenes == 2);
+
+	CHECK(fakeCalls == 0);
+
+	free(display);
+	destroyTestScene(scenes, fds);
+}
+
+int main(int argc, char* argv[])
+{
+	testConfigure();
+	testPointLights();
+
+	return testFailures != 0;
+}
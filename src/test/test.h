@@ -0,0 +1,18 @@
+#ifndef TEST_TEST_H
+#define TEST_TEST_H 1
+
+#include <stdio.h>
+
+/* Every test program counts its own failures and exits with 1 if there were
+ * any, which is what `make check` takes as a failure. */
+extern int testFailures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++testFailures; \
+		} \
+	} while (0)
+
+#endif
@@ -0,0 +1,202 @@
+#include "test.h"
+#include "../render/vertex.h"
+#include "../common/maths.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VERTEX_TEST_COUNT 100000
+
+int testFailures = 0;
+
+/* The decoding below is what packed.vert and the vertex fetch do with a
+ * PackedVertex. */
+float halfToFloat(uint16_t half)
+{
+	const int exponent = (half >> 10) & 0x1f;
+	const int mantissa = half & 0x3ff;
+	const float sign = half & 0x8000 ? -1.0f : 1.0f;
+
+	if (exponent == 0) return sign * ldexpf(mantissa, -24);
+	if (exponent == 31) return mantissa ? NAN : sign * INFINITY;
+
+	return sign * ldexpf(mantissa + 1024, exponent - 25);
+}
+
+Vec3 octDecode(const int16_t* e)
+{
+	/* snorm, where -32768 also means -1 */
+	Vec3 n = {
+		fmaxf(e[X] / 32767.0f, -1.0f),
+		fmaxf(e[Y] / 32767.0f, -1.0f),
+		0.0f
+	};
+	n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+
+	const float t = fmaxf(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	return normaliseVec3(n);
+}
+
+/* Measured in doubles, since a float dot product of two close unit
+ * vectors can't tell apart anything nearer than about 0.02 degrees */
+double angleBetween(Vec3 a, Vec3 b)
+{
+	const double x = (double)a.y * b.z - (double)a.z * b.y;
+	const double y = (double)a.z * b.x - (double)a.x * b.z;
+	const double z = (double)a.x * b.y - (double)a.y * b.x;
+	const double dot =
+		(double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+
+	return atan2(sqrt(x * x + y * y + z * z), dot) * 180.0 / M_PI;
+}
+
+float randomFloat(float min, float max)
+{
+	return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+void testHalves(void)
+{
+	CHECK(floatToHalf(0.0f) == 0x0000);
+	CHECK(floatToHalf(-0.0f) == 0x8000);
+	CHECK(floatToHalf(1.0f) == 0x3c00);
+	CHECK(floatToHalf(-2.0f) == 0xc000);
+	CHECK(floatToHalf(65504.0f) == 0x7bff);
+
+	/* Too big turns to infinity, NaN stays NaN */
+	CHECK(floatToHalf(1e6f) == 0x7c00);
+	CHECK(floatToHalf(-INFINITY) == 0xfc00);
+	CHECK(isnan(halfToFloat(floatToHalf(NAN))));
+
+	/* The smallest subnormal, and half of it rounding up to it */
+	CHECK(floatToHalf(ldexpf(1.0f, -24)) == 0x0001);
+	CHECK(floatToHalf(ldexpf(1.0f, -25)) == 0x0001);
+	CHECK(floatToHalf(ldexpf(1.0f, -36)) == 0x0000);
+
+	/* Rounding the mantissa up can carry into the exponent */
+	CHECK(floatToHalf(2047.9f) == 0x6800);
+
+	/* Everything else is within half a unit in the last place */
+	for (int i = 0; i < VERTEX_TEST_COUNT; i++) {
+		const float f = randomFloat(-4.0f, 4.0f);
+		const float back = halfToFloat(floatToHalf(f));
+		const float ulp = fmaxf(fabsf(f), ldexpf(1.0f, -14)) / 1024.0f;
+
+		CHECK(fabsf(back - f) <= ulp / 2.0f);
+	}
+}
+
+void testNormals(void)
+{
+	const Vec3 axes[] = {
+		{1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+		{0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+		{0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}
+	};
+
+	for (int i = 0; i < sizeof(axes) / sizeof(axes[0]); i++) {
+		int16_t e[2];
+		octEncode(axes[i], e);
+
+		CHECK(angleBetween(octDecode(e), axes[i]) < 0.001);
+	}
+
+	int16_t e[2];
+	octEncode((Vec3){0.0f, 0.0f, 0.0f}, e);
+	CHECK(e[X] == 0 && e[Y] == 0);
+
+	/* 16 bits per component keeps every direction within a hundredth of a
+	 * degree */
+	double worst = 0.0;
+
+	for (int i = 0; i < VERTEX_TEST_COUNT; i++) {
+		const Vec3 n = normaliseVec3((Vec3){
+			randomFloat(-1.0f, 1.0f),
+			randomFloat(-1.0f, 1.0f),
+			randomFloat(-1.0f, 1.0f)
+		});
+
+		octEncode(n, e);
+		worst = fmax(worst, angleBetween(octDecode(e), n));
+	}
+
+	printf("Worst normal error %f degrees\n", worst);
+	CHECK(worst < 0.01);
+}
+
+void testVertices(void)
+{
+	const float quantOffset[3] = {-3.0f, 10.0f, -0.5f};
+	const float quantScale[3] = {6.0f, 250.0f, 1.0f};
+
+	for (int i = 0; i < VERTEX_TEST_COUNT; i++) {
+		Vertex vertex = {};
+
+		for (int j = 0; j < 3; j++) {
+			vertex.pos[j] = randomFloat(
+				quantOffset[j],
+				quantOffset[j] + quantScale[j]
+			);
+		}
+
+		const Vec3 n = normaliseVec3((Vec3){
+			randomFloat(-1.0f, 1.0f),
+			randomFloat(-1.0f, 1.0f),
+			randomFloat(-1.0f, 1.0f)
+		});
+		vertex.normal[X] = n.x;
+		vertex.normal[Y] = n.y;
+		vertex.normal[Z] = n.z;
+		vertex.texCoord[X] = randomFloat(0.0f, 1.0f);
+		vertex.texCoord[Y] = randomFloat(-2.0f, 2.0f);
+
+		PackedVertex packed;
+		packVertex(&packed, &vertex, quantOffset, quantScale);
+
+		CHECK(packed.pos[W] == 0);
+
+		/* Positions are off by at most half a step of the box, give or
+		 * take float rounding */
+		for (int j = 0; j < 3; j++) {
+			const float back =
+				quantOffset[j] + packed.pos[j] / 65535.0f * quantScale[j];
+			const float step = quantScale[j] / 65535.0f;
+			const float rounding =
+				(fabsf(quantOffset[j]) + quantScale[j]) * FLT_EPSILON * 4.0f;
+
+			CHECK(fabsf(back - vertex.pos[j]) <= step * 0.5f + rounding);
+		}
+
+		CHECK(angleBetween(octDecode(packed.normal), n) < 0.01);
+
+		for (int j = 0; j < 2; j++) {
+			const float back = halfToFloat(packed.texCoord[j]);
+			CHECK(fabsf(back - vertex.texCoord[j]) <= 1.0f / 1024.0f);
+		}
+	}
+
+	/* Outside the box clamps to its edges. A flat box packs to 0. */
+	const float flatScale[3] = {6.0f, 0.0f, 1.0f};
+	Vertex outside = {{-10.0f, 500.0f, 100.0f}};
+	PackedVertex packed;
+
+	packVertex(&packed, &outside, quantOffset, flatScale);
+	CHECK(packed.pos[X] == 0);
+	CHECK(packed.pos[Y] == 0);
+	CHECK(packed.pos[Z] == 65535);
+}
+
+int main(int argc, char* argv[])
+{
+	srand(4);
+
+	testHalves();
+	testNormals();
+	testVertices();
+
+	return testFailures != 0;
+}